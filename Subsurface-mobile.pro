@@ -30,6 +30,7 @@ SOURCES += subsurface-mobile-main.cpp \
 	core/qthelper.cpp \
 	core/checkcloudconnection.cpp \
 	core/color.cpp \
+	core/compressedsamples.cpp \
 	core/configuredivecomputer.cpp \
 	core/divelogexportlogic.cpp \
 	core/divesitehelpers.cpp \
@@ -53,6 +54,7 @@ SOURCES += subsurface-mobile-main.cpp \
 	core/divefilter.cpp \
 	core/event.c \
 	core/eventtype.cpp \
+	core/filtercolumns.cpp \
 	core/filterconstraint.cpp \
 	core/filterpreset.cpp \
 	core/divelist.c \
@@ -86,12 +88,16 @@ SOURCES += subsurface-mobile-main.cpp \
 	core/save-xml.cpp \
 	core/cochran.cpp \
 	core/deco.cpp \
+	core/decocache.cpp \
+	core/diveindex.cpp \
 	core/divesite.c \
+	core/divesiteindex.cpp \
 	core/equipment.c \
 	core/gas.c \
 	core/membuffer.cpp \
 	core/selection.cpp \
 	core/sha1.c \
+	core/snapshot.cpp \
 	core/string-format.cpp \
 	core/strtod.c \
 	core/tag.cpp \
@@ -142,6 +148,7 @@ SOURCES += subsurface-mobile-main.cpp \
 	stats/regressionitem.cpp \
 	stats/scatterseries.cpp \
 	stats/statsaxis.cpp \
+	stats/statscache.cpp \
 	stats/statscolors.cpp \
 	stats/statsgrid.cpp \
 	stats/statshelper.cpp \
@@ -220,13 +227,18 @@ HEADERS += \
 	core/pictureobj.h \
 	core/planner.h \
 	core/divesite.h \
+	core/divesiteindex.h \
 	core/checkcloudconnection.h \
 	core/cochran.h \
 	core/color.h \
+	core/compressedsamples.h \
 	core/configuredivecomputer.h \
 	core/datatrak.h \
 	core/deco.h \
+	core/decocache.h \
 	core/divefilter.h \
+	core/diveindex.h \
+	core/filtercolumns.h \
 	core/filterconstraint.h \
 	core/filterpreset.h \
 	core/divelist.h \
@@ -245,6 +257,7 @@ HEADERS += \
 	core/sample.h \
 	core/selection.h \
 	core/sha1.h \
+	core/snapshot.h \
 	core/string-format.h \
 	core/subsurfacestartup.h \
 	core/subsurfacesysinfo.h \
@@ -295,6 +308,7 @@ HEADERS += \
 	stats/regressionitem.h \
 	stats/scatterseries.h \
 	stats/statsaxis.h \
+	stats/statscache.h \
 	stats/statscolors.h \
 	stats/statsgrid.h \
 	stats/statshelper.h \
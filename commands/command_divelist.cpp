@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0
 
 #include "command_divelist.h"
+#include "core/diveindex.h"
 #include "core/divelist.h"
 #include "core/divelog.h"
 #include "core/qthelper.h"
@@ -81,6 +82,7 @@ dive *DiveListBase::addDive(DiveToAdd &d)
 	int idx = dive_table_get_insertion_index(divelog.dives, res);
 	fulltext_register(res);				// Register the dive's fulltext cache
 	add_to_dive_table(divelog.dives, idx, res);	// Return ownership to backend
+	diveindex_register(res);			// Register the dive for download deduplication
 	invalidate_dive_cache(res);		// Ensure that dive is written in git_save()
 
 	return res;
@@ -249,7 +251,7 @@ static void renumberDives(QVector<QPair<dive *, int>> &divesToRenumber)
 			continue;
 		std::swap(d->number, pair.second);
 		dives.push_back(d);
-		invalidate_dive_cache(d);
+		invalidate_dive_cache_except_dcs(d);
 	}
 
 	// Send signals.
@@ -280,7 +282,7 @@ static OwningTripPtr moveDiveToTrip(DiveToTrip &diveToTrip)
 	std::swap(trip, diveToTrip.trip);
 	if (trip)
 		add_dive_to_trip(diveToTrip.dive, trip);
-	invalidate_dive_cache(diveToTrip.dive);		// Ensure that dive is written in git_save()
+	invalidate_dive_cache_except_dcs(diveToTrip.dive);		// Ensure that dive is written in git_save()
 	return res;
 }
 
@@ -642,6 +644,7 @@ void ShiftTime::redoit()
 	std::vector<dive_trip *> trips;
 	for (dive *d: diveList) {
 		d->when += timeChanged;
+		invalidate_dive_cache(d); // Ensure that dive is written in git_save()
 		if (d->divetrip && std::find(trips.begin(), trips.end(), d->divetrip) == trips.end())
 			trips.push_back(d->divetrip);
 	}
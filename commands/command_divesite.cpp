@@ -3,6 +3,7 @@
 #include "command_divesite.h"
 #include "core/divelog.h"
 #include "core/divesite.h"
+#include "core/divesiteindex.h"
 #include "core/subsurface-qt/divelistnotifier.h"
 #include "core/qthelper.h"
 #include "core/subsurface-string.h"
@@ -298,6 +299,7 @@ bool EditDiveSiteLocation::workToBeDone()
 void EditDiveSiteLocation::redo()
 {
 	std::swap(value, ds->location);
+	divesiteindex_update(ds);
 	emit diveListNotifier.diveSiteChanged(ds, LocationInformationModel::LOCATION); // Inform frontend of changed dive site.
 }
 
@@ -407,6 +409,7 @@ ApplyGPSFixes::ApplyGPSFixes(const std::vector<DiveAndLocation> &fixes)
 		} else {
 			ds = create_dive_site(qPrintable(dl.name), divelog.sites);
 			ds->location = dl.location;
+			divesiteindex_update(ds);
 			add_dive_to_dive_site(dl.d, ds);
 			dl.d->dive_site = nullptr; // This will be set on redo()
 			sitesToAdd.emplace_back(ds);
@@ -423,6 +426,7 @@ void ApplyGPSFixes::editDiveSites()
 {
 	for (SiteAndLocation &sl: siteLocations) {
 		std::swap(sl.location, sl.ds->location);
+		divesiteindex_update(sl.ds);
 		emit diveListNotifier.diveSiteChanged(sl.ds, LocationInformationModel::LOCATION); // Inform frontend of changed dive site.
 	}
 }
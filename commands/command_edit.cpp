@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: GPL-2.0
 
 #include "command_edit.h"
+#include "core/diveindex.h"
+#include "core/divesiteindex.h"
 #include "core/divelist.h"
 #include "core/divelog.h"
 #include "core/fulltext.h"
@@ -150,7 +152,11 @@ void EditBase<T>::undo()
 	for (dive *d: dives) {
 		set(d, value);
 		fulltext_register(d); // Update the fulltext cache
-		invalidate_dive_cache(d); // Ensure that dive is written in git_save()
+		// Ensure that dive is written in git_save()
+		if (changesDiveComputers())
+			invalidate_dive_cache(d);
+		else
+			invalidate_dive_cache_except_dcs(d);
 	}
 
 	std::swap(old, value);
@@ -251,6 +257,11 @@ QString EditAirTemp::fieldName() const
 	return Command::Base::tr("air temperature");
 }
 
+bool EditAirTemp::changesDiveComputers() const
+{
+	return false;
+}
+
 // ***** Water Temperature *****
 void EditWaterTemp::set(struct dive *d, int value) const
 {
@@ -286,6 +297,11 @@ QString EditWaterTypeUser::fieldName() const
 	return Command::Base::tr("salinity");
 }
 
+bool EditWaterTypeUser::changesDiveComputers() const
+{
+	return false;
+}
+
 // ***** Atmospheric pressure *****
 void EditAtmPress::set(struct dive *d, int value) const
 {
@@ -302,6 +318,11 @@ QString EditAtmPress::fieldName() const
 	return Command::Base::tr("Atm. pressure");
 }
 
+bool EditAtmPress::changesDiveComputers() const
+{
+	return false;
+}
+
 // ***** Duration *****
 void EditDuration::set(struct dive *d, int value) const
 {
@@ -359,6 +380,11 @@ QString EditDiveSite::fieldName() const
 	return Command::Base::tr("dive site");
 }
 
+bool EditDiveSite::changesDiveComputers() const
+{
+	return false;
+}
+
 void EditDiveSite::undo()
 {
 	// Do the normal undo thing, then send dive site changed signals
@@ -544,7 +570,7 @@ void EditTagsBase::undo()
 		}
 		set(d, tags);
 		fulltext_register(d); // Update the fulltext cache
-		invalidate_dive_cache(d); // Ensure that dive is written in git_save()
+		invalidate_dive_cache_except_dcs(d); // Ensure that dive is written in git_save()
 	}
 
 	std::swap(tagsToAdd, tagsToRemove);
@@ -968,7 +994,7 @@ void AddWeight::undo()
 			continue;
 		remove_weightsystem(d, d->weightsystems.nr - 1);
 		emit diveListNotifier.weightRemoved(d, d->weightsystems.nr);
-		invalidate_dive_cache(d); // Ensure that dive is written in git_save()
+		invalidate_dive_cache_except_dcs(d); // Ensure that dive is written in git_save()
 	}
 }
 
@@ -977,7 +1003,7 @@ void AddWeight::redo()
 	for (dive *d: dives) {
 		add_cloned_weightsystem(&d->weightsystems, empty_weightsystem);
 		emit diveListNotifier.weightAdded(d, d->weightsystems.nr - 1);
-		invalidate_dive_cache(d); // Ensure that dive is written in git_save()
+		invalidate_dive_cache_except_dcs(d); // Ensure that dive is written in git_save()
 	}
 }
 
@@ -1049,7 +1075,7 @@ void RemoveWeight::undo()
 	for (size_t i = 0; i < dives.size(); ++i) {
 		add_to_weightsystem_table(&dives[i]->weightsystems, indices[i], clone_weightsystem(ws));
 		emit diveListNotifier.weightAdded(dives[i], indices[i]);
-		invalidate_dive_cache(dives[i]); // Ensure that dive is written in git_save()
+		invalidate_dive_cache_except_dcs(dives[i]); // Ensure that dive is written in git_save()
 	}
 }
 
@@ -1058,7 +1084,7 @@ void RemoveWeight::redo()
 	for (size_t i = 0; i < dives.size(); ++i) {
 		remove_weightsystem(dives[i], indices[i]);
 		emit diveListNotifier.weightRemoved(dives[i], indices[i]);
-		invalidate_dive_cache(dives[i]); // Ensure that dive is written in git_save()
+		invalidate_dive_cache_except_dcs(dives[i]); // Ensure that dive is written in git_save()
 	}
 }
 
@@ -1105,7 +1131,7 @@ void EditWeight::redo()
 		add_weightsystem_description(&new_ws); // This updates the weightsystem info table
 		set_weightsystem(dives[i], indices[i], new_ws);
 		emit diveListNotifier.weightEdited(dives[i], indices[i]);
-		invalidate_dive_cache(dives[i]); // Ensure that dive is written in git_save()
+		invalidate_dive_cache_except_dcs(dives[i]); // Ensure that dive is written in git_save()
 	}
 	std::swap(ws, new_ws);
 }
@@ -1475,11 +1501,13 @@ void EditDive::exchangeDives()
 	// Don't forget to unregister the old and register the new dive!
 	// Likewise take care to add/remove the dive from the dive site.
 	fulltext_unregister(oldDive);
+	diveindex_unregister(oldDive);
 	dive_site *oldDiveSite = oldDive->dive_site;
 	if (oldDiveSite)
 		unregister_dive_from_dive_site(oldDive); // the dive-site pointer in the dive is now NULL
 	std::swap(*newDive, *oldDive);
 	fulltext_register(oldDive);
+	diveindex_register(oldDive);
 	if (newDiveSite)
 		add_dive_to_dive_site(oldDive, newDiveSite);
 	newDiveSite = oldDiveSite; // remember the previous dive site
@@ -1509,6 +1537,7 @@ void EditDive::editDs()
 {
 	if (siteToEdit) {
 		std::swap(siteToEdit->location, dsLocation);
+		divesiteindex_update(siteToEdit);
 		emit diveListNotifier.diveSiteChanged(siteToEdit, LocationInformationModel::LOCATION); // Inform frontend of changed dive site.
 	}
 }
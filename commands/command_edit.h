@@ -61,6 +61,9 @@ protected:
 	virtual T data(struct dive *d) const = 0;
 	virtual QString fieldName() const = 0;	// Name of the field, used to create the undo menu-entry
 	virtual DiveField fieldId() const = 0;
+	// Whether the field is saved in the dive computer files of the git storage.
+	// If not, these files are not written again on save.
+	virtual bool changesDiveComputers() const { return true; }
 };
 
 // The individual Edit-commands define a virtual function that return the field-id.
@@ -84,6 +87,7 @@ private:
 	using EditTemplate<T, ID>::EditTemplate;
 	void set(struct dive *d, T) const override final;	// final prevents further overriding - then just don't use this template
 	T data(struct dive *d) const override final;	// final prevents further overriding - then just don't use this template
+	bool changesDiveComputers() const override final { return false; }
 };
 
 // Automatically generate getter and setter in the case for string assignments.
@@ -94,6 +98,7 @@ private:
 	using EditTemplate<QString, ID>::EditTemplate;
 	void set(struct dive *d, QString) const override final;	// final prevents further overriding - then just don't use this template
 	QString data(struct dive *d) const override final;	// final prevents further overriding - then just don't use this template
+	bool changesDiveComputers() const override final { return false; }
 };
 
 class EditNotes : public EditStringSetter<DiveField::NOTES, &dive::notes> {
@@ -150,6 +155,7 @@ public:
 	void set(struct dive *d, int value) const override;
 	int data(struct dive *d) const override;
 	QString fieldName() const override;
+	bool changesDiveComputers() const override;
 };
 
 class EditWaterTemp : public EditTemplate<int, DiveField::WATER_TEMP> {
@@ -166,6 +172,7 @@ public:
 	void set(struct dive *d, int value) const override;
 	int data(struct dive *d) const override;
 	QString fieldName() const override;
+	bool changesDiveComputers() const override;
 };
 
 class EditWaterTypeUser : public EditTemplate<int, DiveField::SALINITY> {
@@ -174,6 +181,7 @@ public:
 	void set(struct dive *d, int value) const override;
 	int data(struct dive *d) const override;
 	QString fieldName() const override;
+	bool changesDiveComputers() const override;
 };
 
 class EditDuration : public EditTemplate<int, DiveField::DURATION> {
@@ -198,6 +206,7 @@ public:
 	void set(struct dive *d, struct dive_site *value) const override;
 	struct dive_site *data(struct dive *d) const override;
 	QString fieldName() const override;
+	bool changesDiveComputers() const override;
 
 	// We specialize these so that we can send dive-site changed signals.
 	void undo() override;
@@ -35,7 +35,7 @@ void SetPictureOffset::redo()
 	// If someone complains about speed, do our usual "smart" thing.
 	sort_picture_table(&d->pictures);
 	emit diveListNotifier.pictureOffsetChanged(d, filename, newOffset);
-	invalidate_dive_cache(d);
+	invalidate_dive_cache_except_dcs(d);
 }
 
 // Undo and redo do the same thing
@@ -83,7 +83,7 @@ static std::vector<PictureListForAddition> removePictures(std::vector<PictureLis
 		}
 		if (!toAdd.pics.empty())
 			res.push_back(toAdd);
-		invalidate_dive_cache(list.d);
+		invalidate_dive_cache_except_dcs(list.d);
 		emit diveListNotifier.picturesRemoved(list.d, std::move(filenames));
 	}
 	picturesToRemove.clear();
@@ -113,7 +113,7 @@ static std::vector<PictureListForDeletion> addPictures(std::vector<PictureListFo
 		}
 		if (!toRemove.filenames.empty())
 			res.push_back(toRemove);
-		invalidate_dive_cache(list.d);
+		invalidate_dive_cache_except_dcs(list.d);
 		emit diveListNotifier.picturesAdded(list.d, std::move(picsForSignal));
 	}
 	picturesToAdd.clear();
@@ -0,0 +1,353 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "compressedsamples.h"
+#include "divecomputer.h"
+
+#include <algorithm>
+#include <stdlib.h>
+
+// The fields of struct sample in the order they are stored
+enum sample_field {
+	FIELD_TIME,
+	FIELD_STOPTIME,
+	FIELD_NDL,
+	FIELD_TTS,
+	FIELD_RBT,
+	FIELD_DEPTH,
+	FIELD_STOPDEPTH,
+	FIELD_TEMPERATURE,
+	FIELD_PRESSURE0,
+	FIELD_PRESSURE1,
+	FIELD_SETPOINT,
+	FIELD_O2SENSOR0, // MAX_O2_SENSORS fields
+	FIELD_BEARING = FIELD_O2SENSOR0 + MAX_O2_SENSORS,
+	FIELD_SENSOR0,
+	FIELD_SENSOR1,
+	FIELD_CNS,
+	FIELD_HEARTBEAT,
+	FIELD_SAC,
+	FIELD_IN_DECO,
+	FIELD_MANUALLY_ENTERED,
+	NUM_FIELDS
+};
+
+static_assert(NUM_FIELDS <= 32, "present fields are stored in a 32-bit bit-field");
+
+static int64_t get_field(const struct sample &s, int field)
+{
+	switch (field) {
+	case FIELD_TIME: return s.time.seconds;
+	case FIELD_STOPTIME: return s.stoptime.seconds;
+	case FIELD_NDL: return s.ndl.seconds;
+	case FIELD_TTS: return s.tts.seconds;
+	case FIELD_RBT: return s.rbt.seconds;
+	case FIELD_DEPTH: return s.depth.mm;
+	case FIELD_STOPDEPTH: return s.stopdepth.mm;
+	case FIELD_TEMPERATURE: return s.temperature.mkelvin;
+	case FIELD_PRESSURE0: return s.pressure[0].mbar;
+	case FIELD_PRESSURE1: return s.pressure[1].mbar;
+	case FIELD_SETPOINT: return s.setpoint.mbar;
+	case FIELD_BEARING: return s.bearing.degrees;
+	case FIELD_SENSOR0: return s.sensor[0];
+	case FIELD_SENSOR1: return s.sensor[1];
+	case FIELD_CNS: return s.cns;
+	case FIELD_HEARTBEAT: return s.heartbeat;
+	case FIELD_SAC: return s.sac.mliter;
+	case FIELD_IN_DECO: return s.in_deco;
+	case FIELD_MANUALLY_ENTERED: return s.manually_entered;
+	default: return s.o2sensor[field - FIELD_O2SENSOR0].mbar;
+	}
+}
+
+static void set_field(struct sample &s, int field, int64_t v)
+{
+	switch (field) {
+	case FIELD_TIME: s.time.seconds = v; break;
+	case FIELD_STOPTIME: s.stoptime.seconds = v; break;
+	case FIELD_NDL: s.ndl.seconds = v; break;
+	case FIELD_TTS: s.tts.seconds = v; break;
+	case FIELD_RBT: s.rbt.seconds = v; break;
+	case FIELD_DEPTH: s.depth.mm = v; break;
+	case FIELD_STOPDEPTH: s.stopdepth.mm = v; break;
+	case FIELD_TEMPERATURE: s.temperature.mkelvin = v; break;
+	case FIELD_PRESSURE0: s.pressure[0].mbar = v; break;
+	case FIELD_PRESSURE1: s.pressure[1].mbar = v; break;
+	case FIELD_SETPOINT: s.setpoint.mbar = v; break;
+	case FIELD_BEARING: s.bearing.degrees = v; break;
+	case FIELD_SENSOR0: s.sensor[0] = v; break;
+	case FIELD_SENSOR1: s.sensor[1] = v; break;
+	case FIELD_CNS: s.cns = v; break;
+	case FIELD_HEARTBEAT: s.heartbeat = v; break;
+	case FIELD_SAC: s.sac.mliter = v; break;
+	case FIELD_IN_DECO: s.in_deco = v; break;
+	case FIELD_MANUALLY_ENTERED: s.manually_entered = v; break;
+	default: s.o2sensor[field - FIELD_O2SENSOR0].mbar = v; break;
+	}
+}
+
+static void put_varint(std::vector<unsigned char> &buf, uint64_t v)
+{
+	while (v >= 0x80) {
+		buf.push_back((unsigned char)(v | 0x80));
+		v >>= 7;
+	}
+	buf.push_back((unsigned char)v);
+}
+
+static bool get_varint(const unsigned char *&p, const unsigned char *end, uint64_t &v)
+{
+	v = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (p == end)
+			return false;
+		unsigned char c = *p++;
+		v |= (uint64_t)(c & 0x7f) << shift;
+		if (!(c & 0x80))
+			return true;
+	}
+	return false;
+}
+
+static uint64_t zigzag(int64_t v)
+{
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static void compress_field(const struct sample *samples, int nr, int field, int64_t value, std::vector<unsigned char> &buf)
+{
+	int64_t delta = 0;
+	uint64_t zeros = 0;
+	for (int i = 0; i < nr; ++i) {
+		int64_t v = get_field(samples[i], field);
+		int64_t new_delta = v - value;
+		int64_t dd = new_delta - delta;
+		value = v;
+		delta = new_delta;
+		if (dd == 0) {
+			++zeros;
+			continue;
+		}
+		if (zeros) {
+			put_varint(buf, 0);
+			put_varint(buf, zeros - 1);
+			zeros = 0;
+		}
+		put_varint(buf, zigzag(dd));
+	}
+	if (zeros) {
+		put_varint(buf, 0);
+		put_varint(buf, zeros - 1);
+	}
+}
+
+std::vector<unsigned char> compress_samples(const struct sample *samples, int nr)
+{
+	const struct sample empty;
+	std::vector<unsigned char> res;
+	uint32_t present = 0;
+	for (int field = 0; field < NUM_FIELDS; ++field) {
+		int64_t def = get_field(empty, field);
+		for (int i = 0; i < nr; ++i) {
+			if (get_field(samples[i], field) != def) {
+				present |= 1u << field;
+				break;
+			}
+		}
+	}
+	put_varint(res, nr);
+	put_varint(res, present);
+
+	std::vector<unsigned char> column;
+	for (int field = 0; field < NUM_FIELDS; ++field) {
+		if (!(present & (1u << field)))
+			continue;
+		column.clear();
+		compress_field(samples, nr, field, get_field(empty, field), column);
+		put_varint(res, column.size());
+		res.insert(res.end(), column.begin(), column.end());
+	}
+	return res;
+}
+
+compressed_sample_reader::compressed_sample_reader(const unsigned char *data, size_t size) :
+	present(0), nr(0), pos(0), ok(false)
+{
+	static_assert(num_fields == NUM_FIELDS, "field count mismatch");
+	const struct sample empty;
+	const unsigned char *p = data, *end = data + size;
+	uint64_t n, mask;
+	if (!get_varint(p, end, n) || n > INT32_MAX || !get_varint(p, end, mask) || mask >= (1ull << NUM_FIELDS))
+		return;
+	nr = (int)n;
+	present = (uint32_t)mask;
+	for (int field = 0; field < NUM_FIELDS; ++field) {
+		column &c = columns[field];
+		c.value = get_field(empty, field);
+		c.delta = 0;
+		c.zeros = 0;
+		c.p = c.end = p;
+		if (!(present & (1u << field)))
+			continue;
+		uint64_t len;
+		if (!get_varint(p, end, len) || len > (uint64_t)(end - p))
+			return;
+		c.p = p;
+		c.end = p + len;
+		p += len;
+	}
+	ok = true;
+}
+
+int compressed_sample_reader::size() const
+{
+	return nr;
+}
+
+bool compressed_sample_reader::good() const
+{
+	return ok;
+}
+
+bool compressed_sample_reader::next_value(column &c)
+{
+	int64_t dd = 0;
+	if (c.zeros) {
+		--c.zeros;
+	} else {
+		uint64_t token;
+		if (!get_varint(c.p, c.end, token))
+			return false;
+		if (token == 0) {
+			if (!get_varint(c.p, c.end, c.zeros))
+				return false;
+		} else {
+			dd = unzigzag(token);
+		}
+	}
+	// Unsigned arithmetic, because malformed input may overflow
+	c.delta = (int64_t)((uint64_t)c.delta + (uint64_t)dd);
+	c.value = (int64_t)((uint64_t)c.value + (uint64_t)c.delta);
+	return true;
+}
+
+bool compressed_sample_reader::next(struct sample &s)
+{
+	if (!ok || pos >= nr)
+		return false;
+	s = sample();
+	for (int field = 0; field < NUM_FIELDS; ++field) {
+		if (!(present & (1u << field)))
+			continue;
+		column &c = columns[field];
+		if (!next_value(c)) {
+			ok = false;
+			return false;
+		}
+		set_field(s, field, c.value);
+	}
+	++pos;
+	return true;
+}
+
+bool compressed_sample_reader::decode_all(struct sample *samples)
+{
+	if (!ok || pos != 0)
+		return false;
+	std::fill(samples, samples + nr, sample());
+	for (int field = 0; field < NUM_FIELDS; ++field) {
+		if (!(present & (1u << field)))
+			continue;
+		column &c = columns[field];
+		for (int i = 0; i < nr; ++i) {
+			if (!next_value(c)) {
+				ok = false;
+				return false;
+			}
+			set_field(samples[i], field, c.value);
+		}
+	}
+	pos = nr;
+	return true;
+}
+
+// Runs of constant values take only a few bytes, therefore the number of
+// samples can't be checked against the size of the data. Limit it to protect
+// against huge allocations on malformed input. This is more than six months
+// of samples in one second intervals.
+static const int max_samples = 1 << 24;
+
+bool decompress_samples(const unsigned char *data, size_t size, struct divecomputer *dc)
+{
+	compressed_sample_reader reader(data, size);
+	free_samples(dc);
+	if (!reader.good() || reader.size() > max_samples)
+		return false;
+	int nr = reader.size();
+	alloc_samples(dc, nr);
+	if (nr && !dc->sample)
+		return false;
+	if (!reader.decode_all(dc->sample)) {
+		free_samples(dc);
+		return false;
+	}
+	dc->samples = nr;
+	return true;
+}
+
+void pack_samples(struct divecomputer *dc)
+{
+	if (dc->packed_samples || !dc->samples)
+		return;
+	std::vector<unsigned char> data = compress_samples(dc->sample, dc->samples);
+	unsigned char *packed = (unsigned char *)malloc(data.size());
+	if (!packed)
+		return;
+	std::copy(data.begin(), data.end(), packed);
+	free(dc->sample);
+	dc->sample = nullptr;
+	dc->alloc_samples = 0;
+	dc->packed_samples = packed;
+	dc->packed_size = (int)data.size();
+}
+
+bool unpack_samples(struct divecomputer *dc)
+{
+	if (!dc->packed_samples)
+		return true;
+	compressed_sample_reader reader(dc->packed_samples, dc->packed_size);
+	if (!reader.good() || reader.size() != dc->samples)
+		return false;
+	struct sample *samples = (struct sample *)malloc(dc->samples * sizeof(struct sample));
+	if (!samples || !reader.decode_all(samples)) {
+		free(samples);
+		return false;
+	}
+	free(dc->packed_samples);
+	dc->packed_samples = nullptr;
+	dc->packed_size = 0;
+	dc->sample = samples;
+	dc->alloc_samples = dc->samples;
+	return true;
+}
+
+sample_iterator::sample_iterator(const struct divecomputer *dc) :
+	samples(dc->sample), nr(dc->samples), pos(0),
+	reader(dc->packed_samples, dc->packed_samples ? dc->packed_size : 0)
+{
+}
+
+const struct sample *sample_iterator::next()
+{
+	if (pos >= nr)
+		return nullptr;
+	if (samples)
+		return &samples[pos++];
+	if (!reader.next(current))
+		return nullptr;
+	++pos;
+	return &current;
+}
@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: GPL-2.0
+// A compact encoding of the samples of a dive computer.
+//
+// The samples are stored column-wise, i.e. all values of one field of
+// struct sample follow each other. Each value is stored as the difference
+// to the change of the previous value (second order delta) in zig-zag varint
+// encoding. Runs of zeros, i.e. constant or linearly changing values, are run
+// length encoded. Fields that keep their default value for the whole dive
+// (which is the case for most fields on most dives) are left out.
+//
+// Typical samples take a few bytes instead of sizeof(struct sample).
+//
+// The encoding is used by the git snapshot and, on request, in memory: by
+// default the samples of a dive computer are kept in the flat dc->sample
+// array, but pack_samples() replaces the array by the encoded samples.
+#ifndef COMPRESSED_SAMPLES_H
+#define COMPRESSED_SAMPLES_H
+
+#include "sample.h"
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+struct divecomputer;
+
+std::vector<unsigned char> compress_samples(const struct sample *samples, int nr);
+
+// Decodes the samples one at a time, without allocating the whole array.
+// The data is not trusted: the reader stops on malformed input and good()
+// returns false.
+class compressed_sample_reader {
+public:
+	compressed_sample_reader(const unsigned char *data, size_t size);
+	int size() const; // Number of samples
+	bool good() const;
+	bool next(struct sample &s); // Returns false at the end or on error
+	// Decode all samples into an array of size() samples. Faster than next(),
+	// because it decodes one column at a time. Must be called before next().
+	bool decode_all(struct sample *samples);
+private:
+	struct column {
+		const unsigned char *p, *end;
+		int64_t value, delta;
+		uint64_t zeros; // Remaining zeros of a run
+	};
+	static constexpr int num_fields = 25;
+	column columns[num_fields];
+	uint32_t present; // Bit-field of the stored fields
+	int nr, pos;
+	bool ok;
+	bool next_value(column &c);
+};
+
+// Replaces the samples of the dive computer. Returns false on malformed input.
+bool decompress_samples(const unsigned char *data, size_t size, struct divecomputer *dc);
+
+// Opt-in compact storage of the samples of a dive computer that is not being
+// worked on. While the samples are packed, dc->sample is null, dc->samples is
+// the number of samples and dc->packed_samples contains the encoded samples.
+// Code that accesses dc->sample must unpack the samples first. Code that only
+// reads the samples in order should use sample_iterator, which works on both
+// representations. Copying and freeing a dive computer keeps them packed.
+void pack_samples(struct divecomputer *dc);
+bool unpack_samples(struct divecomputer *dc); // Returns false on failure, the samples stay packed
+
+// Reads the samples of a dive computer in order, whether they are packed or not.
+class sample_iterator {
+public:
+	sample_iterator(const struct divecomputer *dc);
+	const struct sample *next(); // Returns null at the end
+private:
+	const struct sample *samples;
+	int nr, pos;
+	compressed_sample_reader reader;
+	struct sample current;
+};
+
+#endif
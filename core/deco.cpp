@@ -10,10 +10,14 @@
  *
  * add_segment()	- add <seconds> at the given pressure, breathing gasmix
  * deco_allowed_depth() - ceiling based on lead tissue, surface pressure, 3m increments or smooth
+ * init_deco_config()	- fill deco model settings (GF, VPM-B conservatism) from the preferences
  * set_gf()		- set Buehlmann gradient factors
  * set_vpmb_conservatism() - set VPM-B conservatism value
  * clear_deco()
  * dump_tissues()
+ *
+ * There is no global state: the model settings are part of the deco_state, which is
+ * passed to all functions. Thus, independent calculations can run in parallel.
  */
 #include <stdlib.h>
 #include <math.h>
@@ -27,6 +31,7 @@
 #include "subsurface-string.h"
 #include "errorhelper.h"
 #include "planner.h"
+#include "pref.h"
 #include "qthelper.h"
 
 #define cube(x) (x * x * x)
@@ -41,17 +46,13 @@ struct buehlmann_config {
 	double satmult;			//! safety at inert gas accumulation as percentage of effect (more than 100).
 	double desatmult;		//! safety at inert gas depletion as percentage of effect (less than 100).
 	int last_deco_stop_in_mtr;	//! depth of last_deco_stop.
-	double gf_high;			//! gradient factor high (at surface).
-	double gf_low;			//! gradient factor low (at bottom/start of deco calculation).
 	double gf_low_position_min;	//! gf_low_position below surface_min_shallow.
 };
 
-struct buehlmann_config buehlmann_config = {
+static const struct buehlmann_config buehlmann_config = {
 	.satmult = 1.0,
 	.desatmult = 1.0,
 	.last_deco_stop_in_mtr =  0,
-	.gf_high = 0.75,
-	.gf_low = 0.35,
 	.gf_low_position_min = 1.0,
 };
 
@@ -65,10 +66,9 @@ struct vpmb_config {
 	double skin_compression_gammaC;   //! Skin compression gammaC (N / bar = m2).
 	double regeneration_time;         //! Time needed for the bubble to regenerate to the start radius (min).
 	double other_gases_pressure;      //! Always present pressure of other gasses in tissues (bar).
-	short conservatism;		  //! VPM-B conservatism level (0-4)
 };
 
-static struct vpmb_config vpmb_config = {
+static const struct vpmb_config vpmb_config = {
 	.crit_radius_N2 = 0.55,
 	.crit_radius_He = 0.45,
 	.crit_volume_lambda = 199.58,
@@ -77,7 +77,6 @@ static struct vpmb_config vpmb_config = {
 	.skin_compression_gammaC = 2.6040525,	// = 0.257 N/msw
 	.regeneration_time = 20160.0,
 	.other_gases_pressure = 0.1359888,
-	.conservatism = 3
 };
 
 static const double buehlmann_N2_a[] = { 1.1696, 1.0, 0.8618, 0.7562,
@@ -154,20 +153,26 @@ static const double vpmb_conservatism_lvls[] = { 1.0, 1.05, 1.12, 1.22, 1.35 };
 
 #define TISSUE_ARRAY_SZ sizeof(ds->tissue_n2_sat)
 
-static double get_crit_radius_He()
+static double get_crit_radius_He(const struct deco_config *config)
 {
-	if (vpmb_config.conservatism <= 4)
-		return vpmb_config.crit_radius_He * vpmb_conservatism_lvls[vpmb_config.conservatism] * subsurface_conservatism_factor;
+	if (config->vpmb_conservatism <= 4)
+		return vpmb_config.crit_radius_He * vpmb_conservatism_lvls[config->vpmb_conservatism] * subsurface_conservatism_factor;
 	return vpmb_config.crit_radius_He;
 }
 
-static double get_crit_radius_N2()
+static double get_crit_radius_N2(const struct deco_config *config)
 {
-	if (vpmb_config.conservatism <= 4)
-		return vpmb_config.crit_radius_N2 * vpmb_conservatism_lvls[vpmb_config.conservatism] * subsurface_conservatism_factor;
+	if (config->vpmb_conservatism <= 4)
+		return vpmb_config.crit_radius_N2 * vpmb_conservatism_lvls[config->vpmb_conservatism] * subsurface_conservatism_factor;
 	return vpmb_config.crit_radius_N2;
 }
 
+// Buehlmann uses a different water vapor pressure than VPM-B in the planner, see above
+static double wv_pressure(const struct deco_config *config)
+{
+	return config->in_planner && config->mode == VPMB ? WV_PRESSURE_SCHREINER : WV_PRESSURE;
+}
+
 // Solve another cubic equation, this time
 // x^3 - B x - C == 0
 // Use trigonometric formula for negative discriminants (see Wikipedia for details)
@@ -216,28 +221,154 @@ static double vpmb_tolerated_ambient_pressure(struct deco_state *ds, double refe
 	return ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci] + vpmb_config.other_gases_pressure - total_gradient;
 }
 
-extern "C" double tissue_tolerance_calc(struct deco_state *ds, const struct dive *dive, double pressure, bool in_planner)
+/*
+ * Buehlmann exposition factors 1 - exp(-t * ln(2) / halflife) of all compartments for
+ * a given period. Calculating these takes 32 calls to exp(), which used to dominate
+ * add_segment() for periods other than one second. Since only a handful of different
+ * periods are in use at any time (e.g. the 20 s steps of the profile or the planner
+ * timestep), the factors are kept in a small, direct-mapped per-thread cache.
+ */
+struct exposition_factors {
+	bool valid;
+	int period_in_seconds;
+	double n2[16];
+	double he[16];
+};
+
+#define EXPOSITION_CACHE_SIZE 16
+
+static void get_exposition_factors(int period_in_seconds, const double **n2_f, const double **he_f)
+{
+	thread_local struct exposition_factors cache[EXPOSITION_CACHE_SIZE];
+	struct exposition_factors *entry;
+	int ci;
+
+	if (period_in_seconds == 1) {
+		*n2_f = buehlmann_N2_factor_expositon_one_second;
+		*he_f = buehlmann_He_factor_expositon_one_second;
+		return;
+	}
+
+	entry = &cache[(unsigned int)period_in_seconds % EXPOSITION_CACHE_SIZE];
+	if (!entry->valid || entry->period_in_seconds != period_in_seconds) {
+		// ln(2)/60 = 1.155245301e-02
+		for (ci = 0; ci < 16; ci++) {
+			entry->n2[ci] = 1.0 - exp(-period_in_seconds * 1.155245301e-02 / buehlmann_N2_t_halflife[ci]);
+			entry->he[ci] = 1.0 - exp(-period_in_seconds * 1.155245301e-02 / buehlmann_He_t_halflife[ci]);
+		}
+		entry->period_in_seconds = period_in_seconds;
+		entry->valid = true;
+	}
+	*n2_f = entry->n2;
+	*he_f = entry->he;
+}
+
+/*
+ * The tissue kernels below work on all 16 compartments at once. The deco state
+ * is stored as struct-of-arrays and the loops are written without branches, so
+ * that the compiler can turn them into SIMD code (SSE2 being the baseline on
+ * x86-64). On x86 we additionally compile an AVX2 version of each kernel and pick
+ * it at runtime if the CPU supports it. Other architectures use the generic code.
+ */
+static inline void saturate_tissues_generic(struct deco_state *ds, const double *__restrict n2_f, const double *__restrict he_f,
+					    double pn2, double phe, double satmult, double desatmult)
+{
+	for (int ci = 0; ci < 16; ci++) {
+		double pn2_oversat = pn2 - ds->tissue_n2_sat[ci];
+		double phe_oversat = phe - ds->tissue_he_sat[ci];
+		double n2_satmult = pn2_oversat > 0 ? satmult : desatmult;
+		double he_satmult = phe_oversat > 0 ? satmult : desatmult;
+
+		ds->tissue_n2_sat[ci] += n2_satmult * pn2_oversat * n2_f[ci];
+		ds->tissue_he_sat[ci] += he_satmult * phe_oversat * he_f[ci];
+		ds->tissue_inertgas_saturation[ci] = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci];
+	}
+}
+
+// Calculate the Buehlmann a and b coefficients weighted by the inert gas loading of each tissue.
+static inline void inertgas_coefficients_generic(struct deco_state *ds)
+{
+	for (int ci = 0; ci < 16; ci++) {
+		ds->buehlmann_inertgas_a[ci] = ((buehlmann_N2_a[ci] * ds->tissue_n2_sat[ci]) + (buehlmann_He_a[ci] * ds->tissue_he_sat[ci])) / ds->tissue_inertgas_saturation[ci];
+		ds->buehlmann_inertgas_b[ci] = ((buehlmann_N2_b[ci] * ds->tissue_n2_sat[ci]) + (buehlmann_He_b[ci] * ds->tissue_he_sat[ci])) / ds->tissue_inertgas_saturation[ci];
+	}
+}
+
+// Ceiling of each tissue at gf_low, which is used to find the gf_low anchor depth.
+static inline void lowest_ceilings_generic(const struct deco_state *ds, double gf_low, double *__restrict ceilings)
+{
+	for (int ci = 0; ci < 16; ci++) {
+		/* tolerated = (tissue_inertgas_saturation - buehlmann_inertgas_a) * buehlmann_inertgas_b; */
+		ceilings[ci] = (ds->buehlmann_inertgas_b[ci] * ds->tissue_inertgas_saturation[ci] - gf_low * ds->buehlmann_inertgas_a[ci] * ds->buehlmann_inertgas_b[ci]) /
+			       ((1.0 - ds->buehlmann_inertgas_b[ci]) * gf_low + ds->buehlmann_inertgas_b[ci]);
+	}
+}
+
+typedef void (*saturate_tissues_fn)(struct deco_state *, const double *, const double *, double, double, double, double);
+typedef void (*inertgas_coefficients_fn)(struct deco_state *);
+typedef void (*lowest_ceilings_fn)(const struct deco_state *, double, double *);
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_AVX2_DECO_KERNELS 1
+
+__attribute__((target("avx2")))
+static void saturate_tissues_avx2(struct deco_state *ds, const double *n2_f, const double *he_f,
+				  double pn2, double phe, double satmult, double desatmult)
+{
+	saturate_tissues_generic(ds, n2_f, he_f, pn2, phe, satmult, desatmult);
+}
+
+__attribute__((target("avx2")))
+static void inertgas_coefficients_avx2(struct deco_state *ds)
+{
+	inertgas_coefficients_generic(ds);
+}
+
+__attribute__((target("avx2")))
+static void lowest_ceilings_avx2(const struct deco_state *ds, double gf_low, double *ceilings)
+{
+	lowest_ceilings_generic(ds, gf_low, ceilings);
+}
+
+static bool cpu_has_avx2()
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+#endif
+
+struct deco_kernels {
+	saturate_tissues_fn saturate_tissues;
+	inertgas_coefficients_fn inertgas_coefficients;
+	lowest_ceilings_fn lowest_ceilings;
+};
+
+static struct deco_kernels select_deco_kernels()
+{
+#ifdef HAVE_AVX2_DECO_KERNELS
+	if (cpu_has_avx2())
+		return { saturate_tissues_avx2, inertgas_coefficients_avx2, lowest_ceilings_avx2 };
+#endif
+	return { saturate_tissues_generic, inertgas_coefficients_generic, lowest_ceilings_generic };
+}
+
+static const struct deco_kernels deco_kernels = select_deco_kernels();
+
+extern "C" double tissue_tolerance_calc(struct deco_state *ds, const struct dive *dive, double pressure)
 {
 	int ci = -1;
 	double ret_tolerance_limit_ambient_pressure = 0.0;
-	double gf_high = buehlmann_config.gf_high;
-	double gf_low = buehlmann_config.gf_low;
+	double gf_high = ds->config.gf_high;
+	double gf_low = ds->config.gf_low;
 	double surface = get_surface_pressure_in_mbar(dive, true) / 1000.0;
 	double lowest_ceiling = 0.0;
 	double tissue_lowest_ceiling[16];
 
-	for (ci = 0; ci < 16; ci++) {
-		ds->buehlmann_inertgas_a[ci] = ((buehlmann_N2_a[ci] * ds->tissue_n2_sat[ci]) + (buehlmann_He_a[ci] * ds->tissue_he_sat[ci])) / ds->tissue_inertgas_saturation[ci];
-		ds->buehlmann_inertgas_b[ci] = ((buehlmann_N2_b[ci] * ds->tissue_n2_sat[ci]) + (buehlmann_He_b[ci] * ds->tissue_he_sat[ci])) / ds->tissue_inertgas_saturation[ci];
-	}
+	deco_kernels.inertgas_coefficients(ds);
 
-	if (decoMode(in_planner) != VPMB) {
+	if (ds->config.mode != VPMB) {
+		deco_kernels.lowest_ceilings(ds, gf_low, tissue_lowest_ceiling);
 		for (ci = 0; ci < 16; ci++) {
-
-			/* tolerated = (tissue_inertgas_saturation - buehlmann_inertgas_a) * buehlmann_inertgas_b; */
-
-			tissue_lowest_ceiling[ci] = (ds->buehlmann_inertgas_b[ci] * ds->tissue_inertgas_saturation[ci] - gf_low * ds->buehlmann_inertgas_a[ci] * ds->buehlmann_inertgas_b[ci]) /
-						     ((1.0 - ds->buehlmann_inertgas_b[ci]) * gf_low + ds->buehlmann_inertgas_b[ci]);
 			if (tissue_lowest_ceiling[ci] > lowest_ceiling)
 				lowest_ceiling = tissue_lowest_ceiling[ci];
 			if (lowest_ceiling > ds->gf_low_pressure_this_dive)
@@ -288,28 +419,9 @@ extern "C" double tissue_tolerance_calc(struct deco_state *ds, const struct dive
 	return ret_tolerance_limit_ambient_pressure;
 }
 
-/*
- * Return Buehlmann factor for a particular period and tissue index.
- */
-static double factor(int period_in_seconds, int ci, enum gas_component gas)
+static double calc_surface_phase(const struct deco_config *config, double surface_pressure, double he_pressure, double n2_pressure, double he_time_constant, double n2_time_constant)
 {
-	if (period_in_seconds == 1) {
-		if (gas == N2)
-			return buehlmann_N2_factor_expositon_one_second[ci];
-		else
-			return buehlmann_He_factor_expositon_one_second[ci];
-	}
-
-	// ln(2)/60 = 1.155245301e-02
-	if (gas == N2)
-		return 1.0 - exp(-period_in_seconds * 1.155245301e-02 / buehlmann_N2_t_halflife[ci]);
-	else
-		return 1.0 - exp(-period_in_seconds * 1.155245301e-02 / buehlmann_He_t_halflife[ci]);
-}
-
-static double calc_surface_phase(double surface_pressure, double he_pressure, double n2_pressure, double he_time_constant, double n2_time_constant, bool in_planner)
-{
-	double inspired_n2 = (surface_pressure - ((in_planner && (decoMode(true) == VPMB)) ? WV_PRESSURE_SCHREINER : WV_PRESSURE)) * NITROGEN_FRACTION;
+	double inspired_n2 = (surface_pressure - wv_pressure(config)) * NITROGEN_FRACTION;
 
 	if (n2_pressure > inspired_n2)
 		return (he_pressure / he_time_constant + (n2_pressure - inspired_n2) / n2_time_constant) / (he_pressure + n2_pressure - inspired_n2);
@@ -333,7 +445,7 @@ extern "C" void vpmb_start_gradient(struct deco_state *ds)
 	}
 }
 
-extern "C" void vpmb_next_gradient(struct deco_state *ds, double deco_time, double surface_pressure, bool in_planner)
+extern "C" void vpmb_next_gradient(struct deco_state *ds, double deco_time, double surface_pressure)
 {
 	int ci;
 	double n2_b, n2_c;
@@ -342,7 +454,7 @@ extern "C" void vpmb_next_gradient(struct deco_state *ds, double deco_time, doub
 	deco_time /= 60.0;
 
 	for (ci = 0; ci < 16; ++ci) {
-		desat_time = deco_time + calc_surface_phase(surface_pressure, ds->tissue_he_sat[ci], ds->tissue_n2_sat[ci], log(2.0) / buehlmann_He_t_halflife[ci], log(2.0) / buehlmann_N2_t_halflife[ci], in_planner);
+		desat_time = deco_time + calc_surface_phase(&ds->config, surface_pressure, ds->tissue_he_sat[ci], ds->tissue_n2_sat[ci], log(2.0) / buehlmann_He_t_halflife[ci], log(2.0) / buehlmann_N2_t_halflife[ci]);
 
 		n2_b = ds->initial_n2_gradient[ci] + (vpmb_config.crit_volume_lambda * vpmb_config.surface_tension_gamma) / (vpmb_config.skin_compression_gammaC * desat_time);
 		he_b = ds->initial_he_gradient[ci] + (vpmb_config.crit_volume_lambda * vpmb_config.surface_tension_gamma) / (vpmb_config.skin_compression_gammaC * desat_time);
@@ -386,11 +498,11 @@ extern "C" void nuclear_regeneration(struct deco_state *ds, double time)
 	double crushing_radius_N2, crushing_radius_He;
 	for (ci = 0; ci < 16; ++ci) {
 		//rm
-		crushing_radius_N2 = 1.0 / (ds->max_n2_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_N2());
-		crushing_radius_He = 1.0 / (ds->max_he_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_He());
+		crushing_radius_N2 = 1.0 / (ds->max_n2_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_N2(&ds->config));
+		crushing_radius_He = 1.0 / (ds->max_he_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_He(&ds->config));
 		//rs
-		ds->n2_regen_radius[ci] = crushing_radius_N2 + (get_crit_radius_N2() - crushing_radius_N2) * (1.0 - exp (-time / vpmb_config.regeneration_time));
-		ds->he_regen_radius[ci] = crushing_radius_He + (get_crit_radius_He() - crushing_radius_He) * (1.0 - exp (-time / vpmb_config.regeneration_time));
+		ds->n2_regen_radius[ci] = crushing_radius_N2 + (get_crit_radius_N2(&ds->config) - crushing_radius_N2) * (1.0 - exp (-time / vpmb_config.regeneration_time));
+		ds->he_regen_radius[ci] = crushing_radius_He + (get_crit_radius_He(&ds->config) - crushing_radius_He) * (1.0 - exp (-time / vpmb_config.regeneration_time));
 	}
 }
 
@@ -430,8 +542,8 @@ extern "C" void calc_crushing_pressure(struct deco_state *ds, double pressure)
 			if (ds->max_ambient_pressure >= pressure)
 				return;
 
-			n2_inner_pressure = calc_inner_pressure(get_crit_radius_N2(), ds->crushing_onset_tension[ci], pressure);
-			he_inner_pressure = calc_inner_pressure(get_crit_radius_He(), ds->crushing_onset_tension[ci], pressure);
+			n2_inner_pressure = calc_inner_pressure(get_crit_radius_N2(&ds->config), ds->crushing_onset_tension[ci], pressure);
+			he_inner_pressure = calc_inner_pressure(get_crit_radius_He(&ds->config), ds->crushing_onset_tension[ci], pressure);
 
 			n2_crushing_pressure = pressure - n2_inner_pressure;
 			he_crushing_pressure = pressure - he_inner_pressure;
@@ -443,33 +555,30 @@ extern "C" void calc_crushing_pressure(struct deco_state *ds, double pressure)
 }
 
 /* add period_in_seconds at the given pressure and gas to the deco calculation */
-extern "C" void add_segment(struct deco_state *ds, double pressure, struct gasmix gasmix, int period_in_seconds, int ccpo2, enum divemode_t divemode, int, bool in_planner)
+extern "C" void add_segment(struct deco_state *ds, double pressure, struct gasmix gasmix, int period_in_seconds, int ccpo2, enum divemode_t divemode, int)
 {
-	int ci;
+	int ci = ds->ci_pointing_to_guiding_tissue;
 	struct gas_pressures pressures;
+	const double *n2_f, *he_f;
 	bool icd = false;
-	fill_pressures(&pressures, pressure - ((in_planner && (decoMode(true) == VPMB)) ? WV_PRESSURE_SCHREINER : WV_PRESSURE),
-		       gasmix, (double) ccpo2 / 1000.0, divemode);
+	fill_pressures(&pressures, pressure - wv_pressure(&ds->config), gasmix, (double) ccpo2 / 1000.0, divemode);
+	get_exposition_factors(period_in_seconds, &n2_f, &he_f);
 
-	for (ci = 0; ci < 16; ci++) {
+	// Report ICD if N2 is more on-gasing than He off-gasing in leading tissue
+	if (ci >= 0 && ci < 16) {
 		double pn2_oversat = pressures.n2 - ds->tissue_n2_sat[ci];
 		double phe_oversat = pressures.he - ds->tissue_he_sat[ci];
-		double n2_f = factor(period_in_seconds, ci, N2);
-		double he_f = factor(period_in_seconds, ci, HE);
 		double n2_satmult = pn2_oversat > 0 ? buehlmann_config.satmult : buehlmann_config.desatmult;
 		double he_satmult = phe_oversat > 0 ? buehlmann_config.satmult : buehlmann_config.desatmult;
 
-		// Report ICD if N2 is more on-gasing than He off-gasing in leading tissue
-		if (ci == ds->ci_pointing_to_guiding_tissue && pn2_oversat > 0.0 && phe_oversat < 0.0 &&
-		    pn2_oversat * n2_satmult * n2_f + phe_oversat * he_satmult * he_f > 0)
+		if (pn2_oversat > 0.0 && phe_oversat < 0.0 &&
+		    pn2_oversat * n2_satmult * n2_f[ci] + phe_oversat * he_satmult * he_f[ci] > 0)
 			icd = true;
-
-		ds->tissue_n2_sat[ci] += n2_satmult * pn2_oversat * n2_f;
-		ds->tissue_he_sat[ci] += he_satmult * phe_oversat * he_f;
-		ds->tissue_inertgas_saturation[ci] = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci];
-
 	}
-	if (decoMode(in_planner) == VPMB)
+
+	deco_kernels.saturate_tissues(ds, n2_f, he_f, pressures.n2, pressures.he,
+				      buehlmann_config.satmult, buehlmann_config.desatmult);
+	if (ds->config.mode == VPMB)
 		calc_crushing_pressure(ds, pressure);
 	ds->icd_warning = icd;
 	return;
@@ -501,19 +610,20 @@ extern "C" void clear_vpmb_state(struct deco_state *ds)
 	ds->max_bottom_ceiling_pressure.mbar = 0;
 }
 
-extern "C" void clear_deco(struct deco_state *ds, double surface_pressure, bool in_planner)
+extern "C" void clear_deco(struct deco_state *ds, const struct deco_config *config, double surface_pressure)
 {
 	int ci;
 
 	memset(ds, 0, sizeof(*ds));
+	ds->config = *config;
 	clear_vpmb_state(ds);
 	for (ci = 0; ci < 16; ci++) {
-		ds->tissue_n2_sat[ci] = (surface_pressure - ((in_planner && (decoMode(true) == VPMB)) ? WV_PRESSURE_SCHREINER : WV_PRESSURE)) * N2_IN_AIR / 1000;
+		ds->tissue_n2_sat[ci] = (surface_pressure - wv_pressure(config)) * N2_IN_AIR / 1000;
 		ds->tissue_he_sat[ci] = 0.0;
 		ds->max_n2_crushing_pressure[ci] = 0.0;
 		ds->max_he_crushing_pressure[ci] = 0.0;
-		ds->n2_regen_radius[ci] = get_crit_radius_N2();
-		ds->he_regen_radius[ci] = get_crit_radius_He();
+		ds->n2_regen_radius[ci] = get_crit_radius_N2(&ds->config);
+		ds->he_regen_radius[ci] = get_crit_radius_He(&ds->config);
 	}
 	ds->gf_low_pressure_this_dive = surface_pressure + buehlmann_config.gf_low_position_min;
 	ds->max_ambient_pressure = 0.0;
@@ -564,29 +674,38 @@ extern "C" int deco_allowed_depth(double tissues_tolerance, double surface_press
 	return depth;
 }
 
-extern "C" void set_gf(short gflow, short gfhigh)
+extern "C" void init_deco_config(struct deco_config *config, bool in_planner)
+{
+	config->mode = decoMode(in_planner);
+	config->in_planner = in_planner;
+	config->gf_low = (double)prefs.gflow / 100.0;
+	config->gf_high = (double)prefs.gfhigh / 100.0;
+	set_vpmb_conservatism(config, prefs.vpmb_conservatism);
+}
+
+extern "C" void set_gf(struct deco_config *config, short gflow, short gfhigh)
 {
 	if (gflow != -1)
-		buehlmann_config.gf_low = (double)gflow / 100.0;
+		config->gf_low = (double)gflow / 100.0;
 	if (gfhigh != -1)
-		buehlmann_config.gf_high = (double)gfhigh / 100.0;
+		config->gf_high = (double)gfhigh / 100.0;
 }
 
-extern "C" void set_vpmb_conservatism(short conservatism)
+extern "C" void set_vpmb_conservatism(struct deco_config *config, short conservatism)
 {
 	if (conservatism < 0)
-		vpmb_config.conservatism = 0;
+		config->vpmb_conservatism = 0;
 	else if (conservatism > 4)
-		vpmb_config.conservatism = 4;
+		config->vpmb_conservatism = 4;
 	else
-		vpmb_config.conservatism = conservatism;
+		config->vpmb_conservatism = conservatism;
 }
 
 extern "C" double get_gf(struct deco_state *ds, double ambpressure_bar, const struct dive *dive)
 {
 	double surface_pressure_bar = get_surface_pressure_in_mbar(dive, true) / 1000.0;
-	double gf_low = buehlmann_config.gf_low;
-	double gf_high = buehlmann_config.gf_high;
+	double gf_low = ds->config.gf_low;
+	double gf_high = ds->config.gf_high;
 	double gf;
 	if (ds->gf_low_pressure_this_dive > surface_pressure_bar)
 		gf = std::max((double)gf_low, (ambpressure_bar - surface_pressure_bar) /
@@ -5,6 +5,7 @@
 #include "units.h"
 #include "gas.h"
 #include "divemode.h"
+#include "pref.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,7 +15,17 @@ struct dive;
 struct divecomputer;
 struct decostop;
 
+// Settings of the decompression model. Initialize with init_deco_config().
+struct deco_config {
+	enum deco_mode mode;
+	bool in_planner;
+	double gf_low, gf_high;
+	short vpmb_conservatism;
+};
+
 struct deco_state {
+	struct deco_config config;
+
 	double tissue_n2_sat[16];
 	double tissue_he_sat[16];
 	double tolerated_by_tissue[16];
@@ -52,18 +63,19 @@ extern const double buehlmann_N2_t_halflife[];
 extern int deco_allowed_depth(double tissues_tolerance, double surface_pressure, const struct dive *dive, bool smooth);
 
 double get_gf(struct deco_state *ds, double ambpressure_bar, const struct dive *dive);
-extern void clear_deco(struct deco_state *ds, double surface_pressure, bool in_planner);
+extern void init_deco_config(struct deco_config *config, bool in_planner);
+extern void clear_deco(struct deco_state *ds, const struct deco_config *config, double surface_pressure);
 extern void dump_tissues(struct deco_state *ds);
-extern void set_gf(short gflow, short gfhigh);
-extern void set_vpmb_conservatism(short conservatism);
+extern void set_gf(struct deco_config *config, short gflow, short gfhigh);
+extern void set_vpmb_conservatism(struct deco_config *config, short conservatism);
 extern void nuclear_regeneration(struct deco_state *ds, double time);
 extern void vpmb_start_gradient(struct deco_state *ds);
-extern void vpmb_next_gradient(struct deco_state *ds, double deco_time, double surface_pressure, bool in_planner);
-extern double tissue_tolerance_calc(struct deco_state *ds, const struct dive *dive, double pressure, bool in_planner);
+extern void vpmb_next_gradient(struct deco_state *ds, double deco_time, double surface_pressure);
+extern double tissue_tolerance_calc(struct deco_state *ds, const struct dive *dive, double pressure);
 extern void calc_crushing_pressure(struct deco_state *ds, double pressure);
 extern void vpmb_start_gradient(struct deco_state *ds);
 extern void clear_vpmb_state(struct deco_state *ds);
-extern void add_segment(struct deco_state *ds, double pressure, struct gasmix gasmix, int period_in_seconds, int setpoint, enum divemode_t divemode, int sac, bool in_planner);
+extern void add_segment(struct deco_state *ds, double pressure, struct gasmix gasmix, int period_in_seconds, int setpoint, enum divemode_t divemode, int sac);
 
 extern double regressiona(const struct deco_state *ds);
 extern double regressionb(const struct deco_state *ds);
@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: GPL-2.0
+/* The tissue state at the end of a dive depends on all previous dives of
+ * the repetitive series. Replaying these second-by-second for every profile
+ * that is shown is expensive on multi-day trips. Therefore, init_decompression()
+ * stores the end-of-dive state of every dive it replays. A later call can then
+ * start from the most recent cached dive and only has to add the final surface
+ * interval.
+ *
+ * Entries are invalidated when a dive is changed, added or removed: every entry
+ * whose series could contain that dive is dropped. To also catch dives that were
+ * moved in time, we remember the time span of each dive at the point it was cached.
+ * Note that invalidate_dive_cache() is also called on copies of dives. These are
+ * recognized by comparing the dive pointer and ignored.
+ */
+#include "decocache.h"
+#include "deco.h"
+#include "dive.h"
+#include "divelist.h"
+#include "diveindex.h"
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+// Dives with a larger surface interval don't influence each other, see init_decompression()
+static const timestamp_t max_surface_interval = 48 * 60 * 60;
+
+// Each entry is about 3 kB. Limit the memory footprint for huge logs.
+static const size_t max_entries = 4096;
+
+namespace {
+struct deco_cache_key {
+	int id;
+	bool trip_chain;
+	bool in_planner;
+	bool operator==(const deco_cache_key &k) const
+	{
+		return id == k.id && trip_chain == k.trip_chain && in_planner == k.in_planner;
+	}
+};
+
+struct deco_cache_key_hash {
+	size_t operator()(const deco_cache_key &k) const
+	{
+		return std::hash<int>()(k.id) ^ (k.trip_chain << 1) ^ (k.in_planner << 2);
+	}
+};
+
+// The settings that influence the replay of previous dives. Notably, the
+// gradient factors don't.
+static bool same_settings(const deco_config &c1, const deco_config &c2)
+{
+	return c1.mode == c2.mode && c1.in_planner == c2.in_planner &&
+	       c1.vpmb_conservatism == c2.vpmb_conservatism;
+}
+
+struct deco_cache_entry {
+	timestamp_t when, endtime;
+	timestamp_t chain_start;
+	deco_state ds;
+};
+
+struct cached_dive {
+	const struct dive *dive;
+	timestamp_t when, endtime;
+};
+}
+
+static std::mutex deco_cache_lock;
+static std::unordered_map<deco_cache_key, deco_cache_entry, deco_cache_key_hash> deco_cache;
+static std::deque<deco_cache_key> deco_cache_order;
+static std::unordered_map<int, cached_dive> cached_dives;
+static uint64_t generation;
+
+extern "C" bool deco_cache_get(const struct dive *dive, bool trip_chain, const struct deco_config *config, timestamp_t chain_start, struct deco_state *ds)
+{
+	std::lock_guard<std::mutex> guard(deco_cache_lock);
+	auto it = deco_cache.find({ dive->id, trip_chain, config->in_planner });
+	if (it == deco_cache.end())
+		return false;
+	const deco_cache_entry &entry = it->second;
+	if (entry.chain_start != chain_start || entry.when != dive->when ||
+	    !same_settings(entry.ds.config, *config))
+		return false;
+	if (ds) {
+		*ds = entry.ds;
+		ds->config = *config;
+	}
+	return true;
+}
+
+extern "C" void deco_cache_put(const struct dive *dive, bool trip_chain, timestamp_t chain_start, const struct deco_state *ds)
+{
+	std::lock_guard<std::mutex> guard(deco_cache_lock);
+	deco_cache_key key { dive->id, trip_chain, ds->config.in_planner };
+	timestamp_t endtime = dive_endtime(dive);
+	auto [it, inserted] = deco_cache.insert_or_assign(key,
+		deco_cache_entry { dive->when, endtime, chain_start, *ds });
+	if (inserted)
+		deco_cache_order.push_back(key);
+	cached_dives[dive->id] = { dive, dive->when, endtime };
+
+	// Drop the oldest entries. Missing entries are simply recalculated.
+	while (deco_cache.size() > max_entries) {
+		deco_cache.erase(deco_cache_order.front());
+		deco_cache_order.pop_front();
+	}
+}
+
+// Drop all entries of series that contain a dive in the given time span.
+static void invalidate_timespan(timestamp_t when, timestamp_t endtime)
+{
+	for (auto it = deco_cache.begin(); it != deco_cache.end(); ) {
+		if (it->second.when >= when && it->second.chain_start <= endtime + max_surface_interval)
+			it = deco_cache.erase(it);
+		else
+			++it;
+	}
+}
+
+extern "C" void deco_cache_invalidate(const struct dive *dive)
+{
+	std::lock_guard<std::mutex> guard(deco_cache_lock);
+	// Conservatively, this includes copies of dives. Users of the generation
+	// must not rely on it for dives that are not in the dive list.
+	++generation;
+	if (deco_cache.empty())
+		return;
+
+	// Copies of dives and dives that are not part of the dive list (e.g. in the
+	// planner or in the import dialog) don't influence the cached series.
+	auto it = cached_dives.find(dive->id);
+	if (it != cached_dives.end() && it->second.dive != dive)
+		return;
+	if (it == cached_dives.end() && !diveindex_contains(dive))
+		return;
+
+	// The dive may have been moved in time. Invalidate at the old position, too.
+	if (it != cached_dives.end()) {
+		invalidate_timespan(it->second.when, it->second.endtime);
+		cached_dives.erase(it);
+	}
+	invalidate_timespan(dive->when, dive_endtime(dive));
+
+	// Forget the keys of the dropped entries
+	std::deque<deco_cache_key> order;
+	for (const deco_cache_key &key: deco_cache_order) {
+		if (deco_cache.count(key))
+			order.push_back(key);
+	}
+	deco_cache_order = std::move(order);
+}
+
+extern "C" void deco_cache_clear()
+{
+	std::lock_guard<std::mutex> guard(deco_cache_lock);
+	++generation;
+	deco_cache.clear();
+	deco_cache_order.clear();
+	cached_dives.clear();
+}
+
+extern "C" uint64_t deco_cache_generation()
+{
+	std::lock_guard<std::mutex> guard(deco_cache_lock);
+	return generation;
+}
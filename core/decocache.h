@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0
+// Cache of the tissue loadings at the end of dives. Used by init_decompression()
+// to avoid replaying all previous dives of a repetitive series.
+#ifndef DECOCACHE_H
+#define DECOCACHE_H
+
+#include "units.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct dive;
+struct deco_state;
+struct deco_config;
+
+/* trip_chain: the chain of previous dives was restricted to the trip of the dive
+ * chain_start: start time of the first dive of the repetitive series
+ * if ds is NULL, only check whether a state is cached */
+extern bool deco_cache_get(const struct dive *dive, bool trip_chain, const struct deco_config *config, timestamp_t chain_start, struct deco_state *ds);
+extern void deco_cache_put(const struct dive *dive, bool trip_chain, timestamp_t chain_start, const struct deco_state *ds);
+extern void deco_cache_invalidate(const struct dive *dive);
+extern void deco_cache_clear(void);
+/* changes whenever a dive that may be part of a repetitive series is changed, added or removed */
+extern uint64_t deco_cache_generation(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
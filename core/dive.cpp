@@ -5,15 +5,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <algorithm>
 #include <memory>
 #include "dive.h"
 #include "gettext.h"
 #include "subsurface-string.h"
 #include "libdivecomputer.h"
 #include "device.h"
+#include "compressedsamples.h"
+#include "decocache.h"
 #include "divelist.h"
 #include "divelog.h"
 #include "divesite.h"
+#include "divesiteindex.h"
 #include "errorhelper.h"
 #include "event.h"
 #include "extradata.h"
@@ -53,11 +57,12 @@ static double calculate_depth_to_mbarf(int depth, pressure_t surface_pressure, i
  */
 extern "C" int legacy_format_o2pressures(const struct dive *dive, const struct divecomputer *dc)
 {
-	int i, o2sensor;
+	int o2sensor;
 
 	o2sensor = (dc->divemode == CCR) ? get_cylinder_idx_by_use(dive, OXYGEN) : -1;
-	for (i = 0; i < dc->samples; i++) {
-		const struct sample *s = dc->sample + i;
+	/* Used by the savers, therefore the samples may be packed */
+	sample_iterator it(dc);
+	while (const struct sample *s = it.next()) {
 		int seen_pressure = 0, idx;
 
 		for (idx = 0; idx < MAX_SENSORS; idx++) {
@@ -187,6 +192,7 @@ static void copy_extra_data(struct extra_data *sed, struct extra_data *ded)
 static void copy_dc(const struct divecomputer *sdc, struct divecomputer *ddc)
 {
 	*ddc = *sdc;
+	memset(ddc->git_id, 0, 20); // Like the dive, the copy is not cached
 	ddc->model = copy_string(sdc->model);
 	ddc->serial = copy_string(sdc->serial);
 	ddc->fw_version = copy_string(sdc->fw_version);
@@ -1263,7 +1269,9 @@ static void fixup_dive_dc(struct dive *dive, struct divecomputer *dc)
 		fake_dc(dc);
 }
 
-extern "C" struct dive *fixup_dive(struct dive *dive)
+/* The part of fixup_dive() that only accesses the dive itself. Thus, it
+ * can be run for different dives in parallel. */
+extern "C" void fixup_dive_local(struct dive *dive)
 {
 	int i;
 	struct divecomputer *dc;
@@ -1290,13 +1298,22 @@ extern "C" struct dive *fixup_dive(struct dive *dive)
 	fixup_airtemp(dive);
 	for (i = 0; i < dive->cylinders.nr; i++) {
 		cylinder_t *cyl = get_cylinder(dive, i);
-		add_cylinder_description(&cyl->type);
 		if (same_rounded_pressure(cyl->sample_start, cyl->start))
 			cyl->start.mbar = 0;
 		if (same_rounded_pressure(cyl->sample_end, cyl->end))
 			cyl->end.mbar = 0;
 	}
-	update_cylinder_related_info(dive);
+	update_sac_and_otu(dive);
+}
+
+/* The part of fixup_dive() that accesses global state, apart from the
+ * CNS calculation, which depends on the previous dives. */
+extern "C" void fixup_dive_global(struct dive *dive)
+{
+	int i;
+
+	for (i = 0; i < dive->cylinders.nr; i++)
+		add_cylinder_description(&get_cylinder(dive, i)->type);
 	for (i = 0; i < dive->weightsystems.nr; i++) {
 		weightsystem_t *ws = &dive->weightsystems.weightsystems[i];
 		add_weightsystem_description(ws);
@@ -1305,6 +1322,13 @@ extern "C" struct dive *fixup_dive(struct dive *dive)
 	 * but we want to make sure... */
 	if (!dive->id)
 		dive->id = dive_getUniqID();
+}
+
+extern "C" struct dive *fixup_dive(struct dive *dive)
+{
+	fixup_dive_local(dive);
+	fixup_dive_global(dive);
+	update_cns(dive);
 
 	return dive;
 }
@@ -2467,6 +2491,8 @@ static void copy_dive_computer(struct divecomputer *res, const struct divecomput
 	STRUCTURED_LIST_COPY(struct extra_data, a->extra_data, res->extra_data, copy_extra_data);
 	res->samples = res->alloc_samples = 0;
 	res->sample = NULL;
+	res->packed_samples = NULL;
+	res->packed_size = 0;
 	res->events = NULL;
 	res->next = NULL;
 }
@@ -2663,6 +2689,7 @@ extern "C" struct dive *merge_dives(const struct dive *a, const struct dive *b,
 		 * GPS data (that could be a download from a GPS enabled dive computer).
 		 * Keep the dive site, but add the GPS data */
 		(*site)->location = b->dive_site->location;
+		divesiteindex_update(*site);
 	}
 	fixup_dive(res);
 	return res;
@@ -3191,8 +3218,23 @@ extern "C" fraction_t best_he(depth_t depth, const struct dive *dive, bool o2nar
 }
 
 extern "C" void invalidate_dive_cache(struct dive *dive)
+{
+	for (struct divecomputer *dc = &dive->dc; dc; dc = dc->next)
+		memset(dc->git_id, 0, 20);
+	invalidate_dive_cache_except_dcs(dive);
+}
+
+/*
+ * The git saver writes a blob per dive computer, which depends on the samples,
+ * events and data of the dive computer, but also on the start time, the
+ * duration of the first dive computer and the cylinders of the dive. For
+ * edits that change none of these, the cached dive computer blobs are kept,
+ * so that only the small "Dive" file has to be rewritten.
+ */
+extern "C" void invalidate_dive_cache_except_dcs(struct dive *dive)
 {
 	memset(dive->git_id, 0, 20);
+	deco_cache_invalidate(dive);
 }
 
 extern "C" bool dive_cache_is_valid(const struct dive *dive)
@@ -3201,6 +3243,12 @@ extern "C" bool dive_cache_is_valid(const struct dive *dive)
 	return !!memcmp(dive->git_id, null_id, 20);
 }
 
+extern "C" bool dc_cache_is_valid(const struct divecomputer *dc)
+{
+	static const unsigned char null_id[20] = { 0, };
+	return !!memcmp(dc->git_id, null_id, 20);
+}
+
 extern "C" int get_surface_pressure_in_mbar(const struct dive *dive, bool non_null)
 {
 	int mbar = dive->surface_pressure.mbar;
@@ -3515,6 +3563,57 @@ extern "C" struct gasmix get_gasmix_at_time(const struct dive *d, const struct d
 	return get_gasmix(d, dc, time.seconds, &ev, gasmix);
 }
 
+extern "C" void init_gas_change_table(struct gas_change_table *table, const struct dive *dive, const struct divecomputer *dc)
+{
+	table->initial = gasmix_air;
+	table->nr = 0;
+	table->changes = NULL;
+
+	/* if there is no cylinder, it's air all the way */
+	if (dive->cylinders.nr <= 0)
+		return;
+	table->initial = get_cylinder(dive, explicit_first_cylinder(dive, dc))->gasmix;
+	if (!dc)
+		return;
+
+	int nr = 0;
+	for (const struct event *ev = get_next_event(dc->events, "gaschange"); ev; ev = get_next_event(ev->next, "gaschange"))
+		nr++;
+	if (!nr)
+		return;
+	table->changes = (struct gas_change *)malloc(nr * sizeof(struct gas_change));
+	if (!table->changes)
+		return;
+
+	/* get_gasmix() stops at the first event after the given time, even if the
+	 * events are not sorted. Storing the running maximum of the times gives the
+	 * same result with a binary search. */
+	int time = INT_MIN;
+	for (const struct event *ev = get_next_event(dc->events, "gaschange"); ev; ev = get_next_event(ev->next, "gaschange")) {
+		time = std::max(time, (int)ev->time.seconds);
+		table->changes[table->nr].time = time;
+		table->changes[table->nr].gasmix = get_gasmix_from_event(dive, ev);
+		table->nr++;
+	}
+}
+
+extern "C" void free_gas_change_table(struct gas_change_table *table)
+{
+	free(table->changes);
+	table->changes = NULL;
+	table->nr = 0;
+}
+
+/* If there is a gasswitch at that time, it returns the new gasmix */
+extern "C" struct gasmix gas_change_table_at(const struct gas_change_table *table, int time)
+{
+	const struct gas_change *begin = table->changes;
+	const struct gas_change *end = begin + table->nr;
+	const struct gas_change *it = std::upper_bound(begin, end, time,
+			[](int t, const struct gas_change &change) { return t < change.time; });
+	return it == begin ? table->initial : it[-1].gasmix;
+}
+
 /* Does that cylinder have any pressure readings? */
 extern "C" bool cylinder_with_sensor_sample(const struct dive *dive, int cylinder_id)
 {
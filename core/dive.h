@@ -69,7 +69,9 @@ struct dive_or_trip {
 };
 
 extern void invalidate_dive_cache(struct dive *dive);
+extern void invalidate_dive_cache_except_dcs(struct dive *dive);
 extern bool dive_cache_is_valid(const struct dive *dive);
+extern bool dc_cache_is_valid(const struct divecomputer *dc);
 
 extern int get_cylinder_idx_by_use(const struct dive *dive, enum cylinderuse cylinder_use_type);
 extern void cylinder_renumber(struct dive *dive, int mapping[]);
@@ -178,6 +180,8 @@ extern int legacy_format_o2pressures(const struct dive *dive, const struct divec
 extern bool dive_less_than(const struct dive *a, const struct dive *b);
 extern bool dive_or_trip_less_than(struct dive_or_trip a, struct dive_or_trip b);
 extern struct dive *fixup_dive(struct dive *dive);
+extern void fixup_dive_local(struct dive *dive);
+extern void fixup_dive_global(struct dive *dive);
 extern pressure_t calculate_surface_pressure(const struct dive *dive);
 extern pressure_t un_fixup_surface_pressure(const struct dive *d);
 extern int get_dive_salinity(const struct dive *dive);
@@ -218,6 +222,26 @@ extern struct gasmix get_gasmix(const struct dive *dive, const struct divecomput
 /* Get gasmix at a given time */
 extern struct gasmix get_gasmix_at_time(const struct dive *dive, const struct divecomputer *dc, duration_t time);
 
+/* The gas switches of a dive computer in a time-sorted array. For code that asks
+ * for the gasmix at many, not necessarily increasing, times: each lookup is a binary
+ * search instead of a walk through the list of events. Gives the same results as
+ * get_gasmix_at_time(). Must be rebuilt when the events or cylinders change.
+ */
+struct gas_change {
+	int time;
+	struct gasmix gasmix;
+};
+
+struct gas_change_table {
+	struct gasmix initial;
+	int nr;
+	struct gas_change *changes;
+};
+
+extern void init_gas_change_table(struct gas_change_table *table, const struct dive *dive, const struct divecomputer *dc);
+extern void free_gas_change_table(struct gas_change_table *table);
+extern struct gasmix gas_change_table_at(const struct gas_change_table *table, int time);
+
 extern void update_setpoint_events(const struct dive *dive, struct divecomputer *dc);
 
 #ifdef __cplusplus
@@ -232,6 +256,19 @@ Q_DECLARE_METATYPE(struct dive *);
 
 extern std::string existing_filename;
 
+/* While an object of this class exists, record_dive_to_table() only adds the dives
+ * to the table. The fixups are done when the object is destroyed. The parts that
+ * don't depend on other dives are run in parallel. For loaders that don't access
+ * the dives they recorded.
+ */
+class deferred_fixups {
+public:
+	deferred_fixups();
+	~deferred_fixups();
+private:
+	bool owner;
+};
+
 #endif
 
 #endif // DIVE_H
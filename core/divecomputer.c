@@ -258,9 +258,12 @@ void free_samples(struct divecomputer *dc)
 {
 	if (dc) {
 		free(dc->sample);
+		free(dc->packed_samples);
 		dc->sample = 0;
 		dc->samples = 0;
 		dc->alloc_samples = 0;
+		dc->packed_samples = 0;
+		dc->packed_size = 0;
 	}
 }
 
@@ -411,10 +414,25 @@ void copy_samples(const struct divecomputer *s, struct divecomputer *d)
 	// if its a valid pointer, so don't expect malloc() to return NULL for
 	// zero-sized malloc, do it ourselves.
 	d->sample = NULL;
+	d->packed_samples = NULL;
+	d->packed_size = 0;
 
 	if(!nr)
 		return;
 
+	/* packed samples stay packed */
+	if (s->packed_samples) {
+		d->alloc_samples = 0;
+		d->packed_samples = malloc(s->packed_size);
+		if (d->packed_samples) {
+			memcpy(d->packed_samples, s->packed_samples, s->packed_size);
+			d->packed_size = s->packed_size;
+		} else {
+			d->samples = 0;
+		}
+		return;
+	}
+
 	d->sample = malloc(nr * sizeof(struct sample));
 	if (d->sample)
 		memcpy(d->sample, s->sample, nr * sizeof(struct sample));
@@ -530,6 +548,7 @@ static void free_extra_data(struct extra_data *ed)
 void free_dc_contents(struct divecomputer *dc)
 {
 	free(dc->sample);
+	free(dc->packed_samples);
 	free((void *)dc->model);
 	free((void *)dc->serial);
 	free((void *)dc->fw_version);
@@ -41,9 +41,12 @@ struct divecomputer {
 	uint32_t deviceid, diveid;
 	int samples, alloc_samples;
 	struct sample *sample;
+	unsigned char *packed_samples;	// the samples if they are packed, see pack_samples()
+	int packed_size;
 	struct event *events;
 	struct extra_data *extra_data;
 	struct divecomputer *next;
+	unsigned char git_id[20];	// blob of the dive computer in the git repository, see dc_cache_is_valid()
 };
 
 extern void fake_dc(struct divecomputer *dc);
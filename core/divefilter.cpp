@@ -3,9 +3,11 @@
 #include "divefilter.h"
 #include "divelist.h"
 #include "divelog.h"
+#include "divesite.h"
 #include "gettextfromc.h"
 #include "qthelper.h"
 #include "selection.h"
+#include "trip.h"
 #include "subsurface-qt/divelistnotifier.h"
 #if !defined(SUBSURFACE_MOBILE) && !defined(SUBSURFACE_DOWNLOADER)
 #include "desktop-widgets/mapwidget.h"
@@ -78,6 +80,7 @@ void DiveFilter::reset()
 	shown_dives = divelog.dives->nr;
 	for_each_dive(i, d)
 		d->hidden_by_filter = false;
+	columns.clear();
 	updateAll();
 }
 
@@ -94,15 +97,22 @@ ShownChange DiveFilter::updateAll() const
 			bool newStatus = dive_sites.contains(d->dive_site);
 			updateDiveStatus(d, newStatus, res, removeFromSelection);
 		}
-	} else if (filterData.fullText.doit()) {
-		FullTextResult ft = fulltext_find_dives(filterData.fullText, filterData.fulltextStringMode);
-		for_each_dive(i, d) {
-			bool newStatus = ft.dive_matches(d) && showDive(d);
-			updateDiveStatus(d, newStatus, res, removeFromSelection);
-		}
 	} else {
+		// Test the constraints on all dives at once. This is the same as
+		// showDive(), but doesn't have to access the dives.
+		std::vector<char> matches;
+		if (!filterData.constraints.empty()) {
+			columns.refresh();
+			matches = columns.match(filterData.constraints);
+		}
+		bool doFullText = filterData.fullText.doit();
+		FullTextResult ft;
+		if (doFullText)
+			ft = fulltext_find_dives(filterData.fullText, filterData.fulltextStringMode);
 		for_each_dive(i, d) {
-			bool newStatus = showDive(d);
+			bool newStatus = (!d->invalid || prefs.display_invalid_dives) &&
+					 (matches.empty() || matches[i]) &&
+					 (!doFullText || ft.dive_matches(d));
 			updateDiveStatus(d, newStatus, res, removeFromSelection);
 		}
 	}
@@ -121,12 +131,51 @@ DiveFilter::DiveFilter() :
 	shown_dives(0),
 	diveSiteRefCount(0)
 {
+	// Keep track of the dives whose data changed, so that updateAll() only
+	// has to reread those.
+	QObject::connect(&diveListNotifier, &DiveListNotifier::dataReset, [this]() { columns.clear(); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::divesImported, [this]() { columns.clear(); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::divesAdded,
+			 [this](dive_trip *, bool, const QVector<dive *> &dives) { invalidateDives(dives); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::divesDeleted,
+			 [this](dive_trip *, bool, const QVector<dive *> &dives) { for (dive *d: dives) columns.remove(d); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::divesMovedBetweenTrips,
+			 [this](dive_trip *, dive_trip *, bool, bool, const QVector<dive *> &dives) { invalidateDives(dives); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::divesChanged,
+			 [this](const QVector<dive *> &dives, DiveField) { invalidateDives(dives); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::divesTimeChanged,
+			 [this](timestamp_t, const QVector<dive *> &dives) { invalidateDives(dives); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::cylindersReset, [this](const QVector<dive *> &dives) { invalidateDives(dives); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::cylinderAdded, [this](dive *d, int) { columns.invalidate(d); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::cylinderRemoved, [this](dive *d, int) { columns.invalidate(d); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::cylinderEdited, [this](dive *d, int) { columns.invalidate(d); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::weightsystemsReset, [this](const QVector<dive *> &dives) { invalidateDives(dives); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::weightAdded, [this](dive *d, int) { columns.invalidate(d); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::weightRemoved, [this](dive *d, int) { columns.invalidate(d); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::weightEdited, [this](dive *d, int) { columns.invalidate(d); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::tripChanged,
+			 [this](dive_trip *trip, TripField) { invalidateDives(trip->dives); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::diveSiteChanged,
+			 [this](dive_site *ds, int) { invalidateDives(ds->dives); });
+}
+
+void DiveFilter::invalidateDives(const QVector<dive *> &dives)
+{
+	for (const dive *d: dives)
+		columns.invalidate(d);
+}
+
+void DiveFilter::invalidateDives(const struct dive_table &dives)
+{
+	for (int i = 0; i < dives.nr; ++i)
+		columns.invalidate(dives.dives[i]);
 }
 
 void DiveFilter::diveRemoved(const dive *d) const
 {
 	if (!d->hidden_by_filter)
 		--shown_dives;
+	columns.remove(d);
 }
 
 bool DiveFilter::showDive(const struct dive *d) const
@@ -5,6 +5,7 @@
 
 #include "fulltext.h"
 #include "filterconstraint.h"
+#include "filtercolumns.h"
 #include <vector>
 #include <QVector>
 #include <QStringList>
@@ -12,6 +13,7 @@
 struct dive;
 struct dive_trip;
 struct dive_site;
+struct dive_table;
 
 // Structure describing changes of shown status upon applying the filter
 struct ShownChange {
@@ -61,10 +63,13 @@ private:
 			     std::vector<dive *> &removeFromSelection) const;
 	void updateDiveStatus(dive *d, bool newStatus, ShownChange &change,
 			      std::vector<dive *> &removeFromSelection) const;
+	void invalidateDives(const QVector<dive *> &dives);
+	void invalidateDives(const struct dive_table &dives);
 
 	QVector<dive_site *> dive_sites;
 	FilterData filterData;
 	mutable int shown_dives;
+	mutable FilterColumns columns; // Data of the dives accessed by updateAll()
 
 	// We use ref-counting for the dive site mode. The reason is that when switching
 	// between two tabs that both need dive site mode, the following course of
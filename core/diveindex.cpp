@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "diveindex.h"
+#include "dive.h"
+#include "divelist.h"
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+// The keys under which a dive was registered, so that it can be unregistered
+// even if its dive computers were changed in the meantime.
+struct dive_keys {
+	std::vector<uint64_t> ids;
+	std::vector<timestamp_t> times;
+};
+}
+
+// Lookups are done from the download thread
+static std::mutex diveindex_lock;
+static std::unordered_map<uint64_t, std::vector<dive *>> dives_by_id;
+static std::unordered_map<timestamp_t, std::vector<dive *>> dives_by_time;
+static std::unordered_map<const dive *, dive_keys> registered_dives;
+
+static uint64_t id_key(uint32_t deviceid, uint32_t diveid)
+{
+	return ((uint64_t)deviceid << 32) | diveid;
+}
+
+template <typename Map, typename Key>
+static void remove_from_index(Map &map, const Key &key, const dive *d)
+{
+	auto it = map.find(key);
+	if (it == map.end())
+		return;
+	std::vector<dive *> &dives = it->second;
+	dives.erase(std::remove(dives.begin(), dives.end(), d), dives.end());
+	if (dives.empty())
+		map.erase(it);
+}
+
+static void unregister_locked(const dive *d)
+{
+	auto it = registered_dives.find(d);
+	if (it == registered_dives.end())
+		return;
+	for (uint64_t id: it->second.ids)
+		remove_from_index(dives_by_id, id, d);
+	for (timestamp_t when: it->second.times)
+		remove_from_index(dives_by_time, when, d);
+	registered_dives.erase(it);
+}
+
+static void register_locked(dive *d)
+{
+	unregister_locked(d);
+	dive_keys &keys = registered_dives[d];
+	for (const divecomputer *dc = &d->dc; dc; dc = dc->next) {
+		// A dive may have several dive computers with the same keys. Add it only once.
+		uint64_t id = id_key(dc->deviceid, dc->diveid);
+		if (std::find(keys.ids.begin(), keys.ids.end(), id) == keys.ids.end()) {
+			keys.ids.push_back(id);
+			dives_by_id[id].push_back(d);
+		}
+		if (std::find(keys.times.begin(), keys.times.end(), dc->when) == keys.times.end()) {
+			keys.times.push_back(dc->when);
+			dives_by_time[dc->when].push_back(d);
+		}
+	}
+}
+
+extern "C" void diveindex_register(struct dive *d)
+{
+	std::lock_guard<std::mutex> guard(diveindex_lock);
+	register_locked(d);
+}
+
+extern "C" void diveindex_unregister(const struct dive *d)
+{
+	std::lock_guard<std::mutex> guard(diveindex_lock);
+	unregister_locked(d);
+}
+
+extern "C" void diveindex_populate()
+{
+	std::lock_guard<std::mutex> guard(diveindex_lock);
+	dives_by_id.clear();
+	dives_by_time.clear();
+	registered_dives.clear();
+	int i;
+	struct dive *d;
+	for_each_dive (i, d)
+		register_locked(d);
+}
+
+extern "C" bool diveindex_has_dive(uint32_t deviceid, uint32_t diveid)
+{
+	std::lock_guard<std::mutex> guard(diveindex_lock);
+	return dives_by_id.count(id_key(deviceid, diveid)) > 0;
+}
+
+extern "C" bool diveindex_contains(const struct dive *d)
+{
+	std::lock_guard<std::mutex> guard(diveindex_lock);
+	return registered_dives.count(d) > 0;
+}
+
+std::vector<struct dive *> diveindex_candidates(const struct divecomputer *dc)
+{
+	std::lock_guard<std::mutex> guard(diveindex_lock);
+	std::vector<dive *> res;
+	auto it = dives_by_id.find(id_key(dc->deviceid, dc->diveid));
+	if (it != dives_by_id.end())
+		res = it->second;
+	auto it2 = dives_by_time.find(dc->when);
+	if (it2 != dives_by_time.end())
+		res.insert(res.end(), it2->second.begin(), it2->second.end());
+	std::sort(res.begin(), res.end());
+	res.erase(std::unique(res.begin(), res.end()), res.end());
+	return res;
+}
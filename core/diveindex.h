@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: GPL-2.0
+// An index of the dives in the dive table by the identifiers of their dive
+// computers. Used to find already downloaded dives without scanning the
+// whole dive log for every downloaded dive.
+//
+// Dives are indexed by (deviceid, diveid) and by the start time of each of
+// their dive computers. The index is updated when dives are added to or
+// removed from the dive table and rebuilt when a dive log is loaded.
+#ifndef DIVEINDEX_H
+#define DIVEINDEX_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct dive;
+struct divecomputer;
+
+void diveindex_register(struct dive *d); // Note: can be called repeatedly
+void diveindex_unregister(const struct dive *d); // Note: can be called repeatedly
+void diveindex_populate(); // Registers all dives in the dive table
+bool diveindex_has_dive(uint32_t deviceid, uint32_t diveid);
+bool diveindex_contains(const struct dive *d); // Is the dive registered, i.e. in the dive table?
+
+#ifdef __cplusplus
+}
+
+#include <vector>
+
+// Dives that have a dive computer with the same deviceid and diveid or
+// the same start time as the given dive computer. Sorted by address.
+std::vector<struct dive *> diveindex_candidates(const struct divecomputer *dc);
+
+#endif
+
+#endif
@@ -4,8 +4,10 @@
 #include "divelist.h"
 #include "subsurface-string.h"
 #include "deco.h"
+#include "decocache.h"
 #include "device.h"
 #include "dive.h"
+#include "diveindex.h"
 #include "divelog.h"
 #include "divesite.h"
 #include "event.h"
@@ -14,6 +16,7 @@
 #include "fulltext.h"
 #include "interpolate.h"
 #include "planner.h"
+#include "profile.h"
 #include "qthelper.h"
 #include "gettext.h"
 #include "git-access.h"
@@ -73,14 +76,15 @@ int total_weight(const struct dive *dive)
 	return total_grams;
 }
 
-static int active_o2(const struct dive *dive, const struct divecomputer *dc, duration_t time)
+static int active_o2(const struct gas_change_table *gases, duration_t time)
 {
-	struct gasmix gas = get_gasmix_at_time(dive, dc, time);
+	struct gasmix gas = gas_change_table_at(gases, time.seconds);
 	return get_o2(gas);
 }
 
 // Do not call on first sample as it acccesses the previous sample
-static int get_sample_o2(const struct dive *dive, const struct divecomputer *dc, const struct sample *sample)
+static int get_sample_o2(const struct dive *dive, const struct divecomputer *dc, const struct gas_change_table *gases,
+			 const struct sample *sample)
 {
 	int po2i, po2f, po2;
 	const struct sample *psample = sample - 1;
@@ -96,10 +100,10 @@ static int get_sample_o2(const struct dive *dive, const struct divecomputer *dc,
 		double amb_presure = depth_to_bar(sample->depth.mm, dive);
 		double pamb_pressure = depth_to_bar(psample->depth.mm , dive);
 		if (dc->divemode == PSCR) {
-			po2i = pscr_o2(pamb_pressure, get_gasmix_at_time(dive, dc, psample->time));
-			po2f = pscr_o2(amb_presure, get_gasmix_at_time(dive, dc, sample->time));
+			po2i = pscr_o2(pamb_pressure, gas_change_table_at(gases, psample->time.seconds));
+			po2f = pscr_o2(amb_presure, gas_change_table_at(gases, sample->time.seconds));
 		} else {
-			int o2 = active_o2(dive, dc, psample->time);	// 	... calculate po2 from depth and FiO2.
+			int o2 = active_o2(gases, psample->time);	// 	... calculate po2 from depth and FiO2.
 			po2i = lrint(o2 * pamb_pressure);	// (initial) po2 at start of segment
 			po2f = lrint(o2 * amb_presure);	// (final) po2 at end of segment
 		}
@@ -120,6 +124,8 @@ static int calculate_otu(const struct dive *dive)
 	int i;
 	double otu = 0.0;
 	const struct divecomputer *dc = &dive->dc;
+	struct gas_change_table gases;
+	init_gas_change_table(&gases, dive, dc);
 	for (i = 1; i < dc->samples; i++) {
 		int t;
 		int po2i, po2f;
@@ -144,10 +150,10 @@ static int calculate_otu(const struct dive *dive)
 				double amb_presure = depth_to_bar(sample->depth.mm, dive);
 				double pamb_pressure = depth_to_bar(psample->depth.mm , dive);
 				if (dc->divemode == PSCR) {
-					po2i = pscr_o2(pamb_pressure, get_gasmix_at_time(dive, dc, psample->time));
-					po2f = pscr_o2(amb_presure, get_gasmix_at_time(dive, dc, sample->time));
+					po2i = pscr_o2(pamb_pressure, gas_change_table_at(&gases, psample->time.seconds));
+					po2f = pscr_o2(amb_presure, gas_change_table_at(&gases, sample->time.seconds));
 				} else {
-					int o2 = active_o2(dive, dc, psample->time);	// 	... calculate po2 from depth and FiO2.
+					int o2 = active_o2(&gases, psample->time);	// 	... calculate po2 from depth and FiO2.
 					po2i = lrint(o2 * pamb_pressure);	// (initial) po2 at start of segment
 					po2f = lrint(o2 * amb_presure);	// (final) po2 at end of segment
 				}
@@ -168,6 +174,7 @@ static int calculate_otu(const struct dive *dive)
 			otu += t / 60.0 * pow(pm, 5.0/6.0) * (1.0 - 5.0 * (po2f - po2i) * (po2f - po2i) / 216000000.0 / (pm * pm));
 		}
 	}
+	free_gas_change_table(&gases);
 	return lrint(otu);
 }
 
@@ -180,12 +187,14 @@ static int calculate_otu(const struct dive *dive)
    po2 for each segment. Empirical testing showed that, for large changes in depth, the cns calculation for the mean po2
    value is extremely close, if not identical to the additive calculations for 0.1 bar increments in po2 from the start
    to the end of the segment, assuming a constant rate of change in po2 (i.e. depth) with time. */
-static double calculate_cns_dive(const struct dive *dive)
+double calculate_cns_dive(const struct dive *dive)
 {
 	int n;
 	const struct divecomputer *dc = &dive->dc;
 	double cns = 0.0;
 	double rate;
+	struct gas_change_table gases;
+	init_gas_change_table(&gases, dive, dc);
 	/* Calculate the CNS for each sample in this dive and sum them */
 	for (n = 1; n < dc->samples; n++) {
 		int t;
@@ -193,7 +202,7 @@ static double calculate_cns_dive(const struct dive *dive)
 		struct sample *sample = dc->sample + n;
 		struct sample *psample = sample - 1;
 		t = sample->time.seconds - psample->time.seconds;
-		po2 = get_sample_o2(dive, dc, sample);
+		po2 = get_sample_o2(dive, dc, &gases, sample);
 		/* Don't increase CNS when po2 below 500 matm */
 		if (po2 <= 500)
 			continue;
@@ -202,13 +211,19 @@ static double calculate_cns_dive(const struct dive *dive)
 		rate = po2 <= 1500 ? exp(-11.7853 + 0.00193873 * po2) : exp(-23.6349 + 0.00980829 * po2);
 		cns += (double) t * rate * 100.0;
 	}
+	free_gas_change_table(&gases);
 	return cns;
 }
 
 /* this only gets called if dive->maxcns == 0 which means we know that
  * none of the divecomputers has tracked any CNS for us
- * so we calculated it "by hand" */
-static int calculate_cns(struct dive *dive)
+ * so we calculated it "by hand"
+ * Only the first nr dives of the dive list are considered as previous dives.
+ * trip is used instead of dive->divetrip, because during loading the dive may
+ * be added to the trip only later.
+ * If dive_cns is not NULL, it is used to get the CNS of the single dives. */
+int calculate_cns_partial(struct dive *dive, const struct dive_trip *trip, int nr,
+			  double (*dive_cns)(const struct dive *, void *), void *data)
 {
 	int i, divenr;
 	double cns = 0.0;
@@ -219,7 +234,9 @@ static int calculate_cns(struct dive *dive)
 		return dive->cns;
 
 	divenr = get_divenr(dive);
-	i = divenr >= 0 ? divenr : divelog.dives->nr;
+	if (divenr >= nr)
+		divenr = -1;
+	i = divenr >= 0 ? divenr : nr;
 #if DECO_CALC_DEBUG & 2
 	if (i >= 0 && i < dive_table.nr)
 		printf("\n\n*** CNS for dive #%d %d\n", i, get_dive(i)->number);
@@ -227,7 +244,7 @@ static int calculate_cns(struct dive *dive)
 		printf("\n\n*** CNS for dive #%d\n", i);
 #endif
 	/* Look at next dive in dive list table and correct i when needed */
-	while (i < divelog.dives->nr - 1) {
+	while (i < nr - 1) {
 		struct dive *pdive = get_dive(i);
 		if (!pdive || pdive->when > dive->when)
 			break;
@@ -254,7 +271,7 @@ static int calculate_cns(struct dive *dive)
 		struct dive *pdive = get_dive(i);
 		/* we don't want to mix dives from different trips as we keep looking
 		 * for how far back we need to go */
-		if (dive->divetrip && pdive->divetrip != dive->divetrip) {
+		if (trip && pdive->divetrip != trip) {
 #if DECO_CALC_DEBUG & 2
 			printf("No - other dive trip\n");
 #endif
@@ -272,13 +289,13 @@ static int calculate_cns(struct dive *dive)
 #endif
 	}
 	/* Walk forward and add dives and surface intervals to CNS */
-	while (++i < divelog.dives->nr) {
+	while (++i < nr) {
 #if DECO_CALC_DEBUG & 2
 		printf("Check if dive #%d %d will be really added to CNS calc: ", i, get_dive(i)->number);
 #endif
 		struct dive *pdive = get_dive(i);
 		/* again skip dives from different trips */
-		if (dive->divetrip && dive->divetrip != pdive->divetrip) {
+		if (trip && trip != pdive->divetrip) {
 #if DECO_CALC_DEBUG & 2
 			printf("No - other dive trip\n");
 #endif
@@ -309,7 +326,7 @@ static int calculate_cns(struct dive *dive)
 		printf("CNS after surface interval: %f\n", cns);
 #endif
 
-		cns += calculate_cns_dive(pdive);
+		cns += dive_cns ? dive_cns(pdive, data) : calculate_cns_dive(pdive);
 #if DECO_CALC_DEBUG & 2
 		printf("CNS after previous dive: %f\n", cns);
 #endif
@@ -325,7 +342,7 @@ static int calculate_cns(struct dive *dive)
 	printf("CNS after last surface interval: %f\n", cns);
 #endif
 
-	cns += calculate_cns_dive(dive);
+	cns += dive_cns ? dive_cns(dive, data) : calculate_cns_dive(dive);
 #if DECO_CALC_DEBUG & 2
 	printf("CNS after dive: %f\n", cns);
 #endif
@@ -334,6 +351,12 @@ static int calculate_cns(struct dive *dive)
 	dive->cns = lrint(cns);
 	return dive->cns;
 }
+
+static int calculate_cns(struct dive *dive)
+{
+	return calculate_cns_partial(dive, dive->divetrip, divelog.dives->nr, NULL, NULL);
+}
+
 /*
  * Return air usage (in liters).
  */
@@ -396,7 +419,7 @@ static int calculate_sac(const struct dive *dive)
 }
 
 /* for now we do this based on the first divecomputer */
-static void add_dive_to_deco(struct deco_state *ds, struct dive *dive, bool in_planner)
+static void add_dive_to_deco(struct deco_state *ds, struct dive *dive)
 {
 	struct divecomputer *dc = &dive->dc;
 	struct gasmix gasmix = gasmix_air;
@@ -418,22 +441,46 @@ static void add_dive_to_deco(struct deco_state *ds, struct dive *dive, bool in_p
 			int depth = interpolate(psample->depth.mm, sample->depth.mm, j - t0, t1 - t0);
 			gasmix = get_gasmix(dive, dc, j, &ev, gasmix);
 			add_segment(ds, depth_to_bar(depth, dive), gasmix, 1, sample->setpoint.mbar,
-				    get_current_divemode(&dive->dc, j, &evd, &current_divemode), dive->sac,
-				    in_planner);
+				    get_current_divemode(&dive->dc, j, &evd, &current_divemode), dive->sac);
 		}
 	}
 }
 
+/* Index of the first dive in the dive table that doesn't start before the given time.
+ * The dive table is sorted by start time, so we can do a binary search. */
+static int first_dive_not_before(timestamp_t when)
+{
+	int lo = 0, hi = divelog.dives->nr;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (divelog.dives->dives[mid]->when < when)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
 int get_divenr(const struct dive *dive)
 {
 	int i;
 	const struct dive *d;
 	// tempting as it may be, don't die when called with dive=NULL
-	if (dive)
-		for_each_dive(i, d) {
-			if (d->id == dive->id) // don't compare pointers, we could be passing in a copy of the dive
-				return i;
-		}
+	if (!dive)
+		return -1;
+	// don't compare pointers, we could be passing in a copy of the dive
+	for (i = first_dive_not_before(dive->when); i < divelog.dives->nr; i++) {
+		d = divelog.dives->dives[i];
+		if (d->when != dive->when)
+			break;
+		if (d->id == dive->id)
+			return i;
+	}
+	// the copy of the dive might have a different start time
+	for_each_dive(i, d) {
+		if (d->id == dive->id)
+			return i;
+	}
 	return -1;
 }
 
@@ -444,12 +491,12 @@ static struct gasmix air = { .o2.permille = O2_IN_AIR, .he.permille = 0 };
 /* return negative surface time if dives are overlapping */
 /* The place you call this function is likely the place where you want
  * to create the deco_state */
-int init_decompression(struct deco_state *ds, const struct dive *dive, bool in_planner)
+int init_decompression(struct deco_state *ds, const struct dive *dive, const struct deco_config *config)
 {
-	int i, divenr = -1;
+	int i, j, divenr = -1, cached = -1;
 	int surface_time = 48 * 60 * 60;
-	timestamp_t last_endtime = 0, last_starttime = 0;
-	bool deco_init = false;
+	timestamp_t last_endtime = 0, last_starttime = 0, chain_start = 0;
+	bool deco_init = false, use_cache, trip_chain;
 	double surface_pressure;
 
 	if (!dive)
@@ -508,6 +555,39 @@ int init_decompression(struct deco_state *ds, const struct dive *dive, bool in_p
 		printf("Yes\n");
 #endif
 	}
+
+	/* The end-of-dive tissue states of previous dives are cached (see decocache.cpp).
+	 * This doesn't work if a copy of a dive was moved past the original dive,
+	 * because then the original has to be skipped. */
+	trip_chain = dive->divetrip != NULL;
+	use_cache = divenr < 0 || get_dive(divenr)->when >= dive->when ||
+		    (trip_chain && get_dive(divenr)->divetrip != dive->divetrip);
+	if (use_cache) {
+		/* Find the last dive of the series with a cached state */
+		for (j = i + 1; j < divelog.dives->nr; j++) {
+			struct dive *pdive = get_dive(j);
+			if (trip_chain && dive->divetrip != pdive->divetrip)
+				continue;
+			if (pdive->when >= dive->when)
+				break;
+			if (!chain_start)
+				chain_start = pdive->when;
+			if (deco_cache_get(pdive, trip_chain, config, chain_start, NULL))
+				cached = j;
+		}
+		if (cached >= 0) {
+			struct dive *pdive = get_dive(cached);
+			deco_cache_get(pdive, trip_chain, config, chain_start, ds);
+			deco_init = true;
+			last_starttime = pdive->when;
+			last_endtime = dive_endtime(pdive);
+			i = cached;
+#if DECO_CALC_DEBUG & 2
+			printf("Restored cached tissues after dive #%d %d\n", i, pdive->number);
+#endif
+		}
+	}
+
 	/* Walk forward an add dives and surface intervals to deco */
 	while (++i < divelog.dives->nr) {
 #if DECO_CALC_DEBUG & 2
@@ -545,7 +625,7 @@ int init_decompression(struct deco_state *ds, const struct dive *dive, bool in_p
 #if DECO_CALC_DEBUG & 2
 			printf("Init deco\n");
 #endif
-			clear_deco(ds, surface_pressure, in_planner);
+			clear_deco(ds, config, surface_pressure);
 			deco_init = true;
 #if DECO_CALC_DEBUG & 2
 			printf("Tissues after init:\n");
@@ -559,18 +639,20 @@ int init_decompression(struct deco_state *ds, const struct dive *dive, bool in_p
 #endif
 				return surface_time;
 			}
-			add_segment(ds, surface_pressure, air, surface_time, 0, OC, prefs.decosac, in_planner);
+			add_segment(ds, surface_pressure, air, surface_time, 0, OC, prefs.decosac);
 #if DECO_CALC_DEBUG & 2
 			printf("Tissues after surface intervall of %d:%02u:\n", FRACTION_TUPLE(surface_time, 60));
 			dump_tissues(ds);
 #endif
 		}
 
-		add_dive_to_deco(ds, pdive, in_planner);
+		add_dive_to_deco(ds, pdive);
 
 		last_starttime = pdive->when;
 		last_endtime = dive_endtime(pdive);
 		clear_vpmb_state(ds);
+		if (use_cache)
+			deco_cache_put(pdive, trip_chain, chain_start, ds);
 #if DECO_CALC_DEBUG & 2
 		printf("Tissues after added dive #%d:\n", pdive->number);
 		dump_tissues(ds);
@@ -583,7 +665,7 @@ int init_decompression(struct deco_state *ds, const struct dive *dive, bool in_p
 #if DECO_CALC_DEBUG & 2
 		printf("Init deco\n");
 #endif
-		clear_deco(ds, surface_pressure, in_planner);
+		clear_deco(ds, config, surface_pressure);
 #if DECO_CALC_DEBUG & 2
 		printf("Tissues after no previous dive, surface time set to 48h:\n");
 		dump_tissues(ds);
@@ -596,7 +678,7 @@ int init_decompression(struct deco_state *ds, const struct dive *dive, bool in_p
 #endif
 			return surface_time;
 		}
-		add_segment(ds, surface_pressure, air, surface_time, 0, OC, prefs.decosac, in_planner);
+		add_segment(ds, surface_pressure, air, surface_time, 0, OC, prefs.decosac);
 #if DECO_CALC_DEBUG & 2
 		printf("Tissues after surface intervall of %d:%02u:\n", FRACTION_TUPLE(surface_time, 60));
 		dump_tissues(ds);
@@ -604,20 +686,31 @@ int init_decompression(struct deco_state *ds, const struct dive *dive, bool in_p
 	}
 
 	// I do not dare to remove this call. We don't need the result but it might have side effects. Bummer.
-	tissue_tolerance_calc(ds, dive, surface_pressure, in_planner);
+	tissue_tolerance_calc(ds, dive, surface_pressure);
 	return surface_time;
 }
 
 void update_cylinder_related_info(struct dive *dive)
 {
 	if (dive != NULL) {
-		dive->sac = calculate_sac(dive);
-		dive->otu = calculate_otu(dive);
-		if (dive->maxcns == 0)
-			dive->maxcns = calculate_cns(dive);
+		update_sac_and_otu(dive);
+		update_cns(dive);
 	}
 }
 
+void update_cns(struct dive *dive)
+{
+	if (dive->maxcns == 0)
+		dive->maxcns = calculate_cns(dive);
+}
+
+/* The part of update_cylinder_related_info() that doesn't depend on other dives */
+void update_sac_and_otu(struct dive *dive)
+{
+	dive->sac = calculate_sac(dive);
+	dive->otu = calculate_otu(dive);
+}
+
 /* Like strcmp(), but don't crash on null-pointers */
 static int safe_strcmp(const char *s1, const char *s2)
 {
@@ -693,7 +786,7 @@ static MAKE_GROW_TABLE(dive_table, struct dive *, dives)
 MAKE_GET_INSERTION_INDEX(dive_table, struct dive *, dives, dive_less_than)
 MAKE_ADD_TO(dive_table, struct dive *, dives)
 static MAKE_REMOVE_FROM(dive_table, dives)
-static MAKE_GET_IDX(dive_table, struct dive *, dives)
+static MAKE_GET_IDX_SORTED(dive_table, struct dive *, dives, dive_less_than)
 MAKE_SORT(dive_table, struct dive *, dives, comp_dives)
 MAKE_REMOVE(dive_table, struct dive *, dive)
 MAKE_CLEAR_TABLE(dive_table, dives, dive)
@@ -737,6 +830,10 @@ static void autogroup_dives(struct dive_table *table, struct trip_table *trip_ta
  * It simply shrinks the table and frees the trip */
 void delete_dive_from_table(struct dive_table *table, int idx)
 {
+	if (table == divelog.dives) {
+		deco_cache_invalidate(table->dives[idx]);
+		diveindex_unregister(table->dives[idx]);
+	}
 	free_dive(table->dives[idx]);
 	remove_from_dive_table(table, idx);
 }
@@ -760,6 +857,8 @@ struct dive *unregister_dive(int idx)
 	/* When removing a dive from the global dive table,
 	 * we also have to unregister its fulltext cache. */
 	fulltext_unregister(dive);
+	deco_cache_invalidate(dive);	// Before unregistering, so that the dive is recognized
+	diveindex_unregister(dive);
 	remove_from_dive_table(divelog.dives, idx);
 	if (dive->selected)
 		amount_selected--;
@@ -769,6 +868,7 @@ struct dive *unregister_dive(int idx)
 
 void process_loaded_dives()
 {
+	deco_cache_clear();
 	sort_dive_table(divelog.dives);
 	sort_trip_table(divelog.trips);
 
@@ -776,6 +876,7 @@ void process_loaded_dives()
 	autogroup_dives(divelog.dives, divelog.trips);
 
 	fulltext_populate();
+	diveindex_populate();
 
 	/* Inform frontend of reset data. This should reset all the models. */
 	emit_reset_signal();
@@ -982,8 +1083,11 @@ void add_imported_dives(struct divelog *import_log, int flags)
 	dives_to_remove.nr = 0;
 
 	/* Add new dives */
-	for (i = 0; i < dives_to_add.nr; i++)
+	for (i = 0; i < dives_to_add.nr; i++) {
 		insert_dive(divelog.dives, dives_to_add.dives[i]);
+		diveindex_register(dives_to_add.dives[i]);
+		deco_cache_invalidate(dives_to_add.dives[i]);
+	}
 	dives_to_add.nr = 0;
 
 	/* Add new trips */
@@ -1286,6 +1390,8 @@ void clear_dive_file_data()
 	clear_divelog(&divelog);
 
 	clear_event_types();
+	deco_cache_clear();
+	plot_info_cache_clear();
 
 	reset_min_datafile_version();
 	clear_git_id();
@@ -1355,11 +1461,8 @@ timestamp_t get_surface_interval(timestamp_t when)
 	int i;
 	timestamp_t prev_end;
 
-	/* find previous dive. might want to use a binary search. */
-	for (i = divelog.dives->nr - 1; i >= 0; --i) {
-		if (divelog.dives->dives[i]->when < when)
-			break;
-	}
+	/* find previous dive */
+	i = first_dive_not_before(when) - 1;
 	if (i < 0)
 		return -1;
 
@@ -1378,11 +1481,7 @@ struct dive *find_next_visible_dive(timestamp_t when)
 	if (!divelog.dives->nr)
 		return NULL;
 
-	/* we might want to use binary search here */
-	for (i = 0; i < divelog.dives->nr; i++) {
-		if (when <= get_dive(i)->when)
-			break;
-	}
+	i = first_dive_not_before(when);
 
 	for (j = i - 1; j > 0; j--) {
 		if (!get_dive(j)->hidden_by_filter)
@@ -1399,19 +1498,5 @@ struct dive *find_next_visible_dive(timestamp_t when)
 
 bool has_dive(unsigned int deviceid, unsigned int diveid)
 {
-       int i;
-       struct dive *dive;
-
-       for_each_dive (i, dive) {
-	       struct divecomputer *dc;
-
-	       for_each_dc (dive, dc) {
-		       if (dc->deviceid != deviceid)
-			       continue;
-		       if (dc->diveid != diveid)
-			       continue;
-		       return 1;
-	       }
-       }
-       return 0;
+	return diveindex_has_dive(deviceid, diveid);
 }
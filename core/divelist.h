@@ -10,10 +10,12 @@ extern "C" {
 
 struct dive;
 struct divelog;
+struct dive_trip;
 struct trip_table;
 struct dive_site_table;
 struct device_table;
 struct deco_state;
+struct deco_config;
 
 struct dive_table {
 	int nr, allocated;
@@ -26,7 +28,12 @@ static const struct dive_table empty_dive_table = { 0, 0, (struct dive **)0 };
 
 extern void sort_dive_table(struct dive_table *table);
 extern void update_cylinder_related_info(struct dive *);
-extern int init_decompression(struct deco_state *ds, const struct dive *dive, bool in_planner);
+extern void update_sac_and_otu(struct dive *dive);
+extern void update_cns(struct dive *dive);
+extern double calculate_cns_dive(const struct dive *dive);
+extern int calculate_cns_partial(struct dive *dive, const struct dive_trip *trip, int nr,
+				 double (*dive_cns)(const struct dive *, void *), void *data);
+extern int init_decompression(struct deco_state *ds, const struct dive *dive, const struct deco_config *config);
 
 /* divelist core logic functions */
 extern void process_loaded_dives();
@@ -4,6 +4,7 @@
 #include "dive.h"
 #include "divelist.h"
 #include "divelog.h"
+#include "divesiteindex.h"
 #include "errorhelper.h"
 #include "membuffer.h"
 #include "subsurface-string.h"
@@ -12,27 +13,36 @@
 
 #include <math.h>
 
+/* The table is kept sorted by UUID by add_dive_site_to_table(). Returns
+ * the index of the first site whose UUID is not less than the given UUID. */
+static int uuid_lower_bound(uint32_t uuid, const struct dive_site_table *ds_table)
+{
+	int lo = 0, hi = ds_table->nr;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (ds_table->dive_sites[mid]->uuid < uuid)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
 int get_divesite_idx(const struct dive_site *ds, struct dive_site_table *ds_table)
 {
 	int i;
-	const struct dive_site *d;
 	// tempting as it may be, don't die when called with ds=NULL
-	if (ds)
-		for_each_dive_site(i, d, ds_table) {
-			if (d == ds)
-				return i;
-		}
-	return -1;
+	if (!ds)
+		return -1;
+	i = uuid_lower_bound(ds->uuid, ds_table);
+	return i < ds_table->nr && ds_table->dive_sites[i] == ds ? i : -1;
 }
 
-// TODO: keep table sorted by UUID and do a binary search?
 struct dive_site *get_dive_site_by_uuid(uint32_t uuid, struct dive_site_table *ds_table)
 {
-	int i;
-	struct dive_site *ds;
-	for_each_dive_site (i, ds, ds_table)
-		if (ds->uuid == uuid)
-			return get_dive_site(i, ds_table);
+	int i = uuid_lower_bound(uuid, ds_table);
+	if (i < ds_table->nr && ds_table->dive_sites[i]->uuid == uuid)
+		return ds_table->dive_sites[i];
 	return NULL;
 }
 
@@ -51,13 +61,12 @@ struct dive_site *get_dive_site_by_name(const char *name, struct dive_site_table
 /* there could be multiple sites at the same GPS fix - return the first one */
 struct dive_site *get_dive_site_by_gps(const location_t *loc, struct dive_site_table *ds_table)
 {
-	int i;
-	struct dive_site *ds;
-	for_each_dive_site (i, ds, ds_table) {
-		if (same_location(loc, &ds->location))
-			return ds;
-	}
-	return NULL;
+	return divesiteindex_find(loc, ds_table, NULL, NULL);
+}
+
+static bool dive_site_has_name(const struct dive_site *ds, const void *name)
+{
+	return same_string(ds->name, (const char *)name);
 }
 
 /* to avoid a bug where we have two dive sites with different name and the same GPS coordinates
@@ -65,13 +74,7 @@ struct dive_site *get_dive_site_by_gps(const location_t *loc, struct dive_site_t
  * this function allows us to verify if a very specific name/GPS combination already exists */
 struct dive_site *get_dive_site_by_gps_and_name(const char *name, const location_t *loc, struct dive_site_table *ds_table)
 {
-	int i;
-	struct dive_site *ds;
-	for_each_dive_site (i, ds, ds_table) {
-		if (same_location(loc, &ds->location) && same_string(ds->name, name))
-			return ds;
-	}
-	return NULL;
+	return divesiteindex_find(loc, ds_table, dive_site_has_name, name);
 }
 
 // Calculate the distance in meters between two coordinates.
@@ -95,17 +98,7 @@ unsigned int get_distance(const location_t *loc1, const location_t *loc2)
 /* find the closest one, no more than distance meters away - if more than one at same distance, pick the first */
 struct dive_site *get_dive_site_by_gps_proximity(const location_t *loc, int distance, struct dive_site_table *ds_table)
 {
-	int i;
-	struct dive_site *ds, *res = NULL;
-	unsigned int cur_distance, min_distance = distance;
-	for_each_dive_site (i, ds, ds_table) {
-		if (dive_site_has_gps_location(ds) &&
-		    (cur_distance = get_distance(&ds->location, loc)) < min_distance) {
-			min_distance = cur_distance;
-			res = ds;
-		}
-	}
-	return res;
+	return divesiteindex_nearest(loc, distance, ds_table);
 }
 
 int register_dive_site(struct dive_site *ds)
@@ -127,11 +120,22 @@ static MAKE_GROW_TABLE(dive_site_table, struct dive_site *, dive_sites)
 static MAKE_GET_INSERTION_INDEX(dive_site_table, struct dive_site *, dive_sites, site_less_than)
 static MAKE_ADD_TO(dive_site_table, struct dive_site *, dive_sites)
 static MAKE_REMOVE_FROM(dive_site_table, dive_sites)
-static MAKE_GET_IDX(dive_site_table, struct dive_site *, dive_sites)
+static MAKE_GET_IDX_SORTED(dive_site_table, struct dive_site *, dive_sites, site_less_than)
 MAKE_SORT(dive_site_table, struct dive_site *, dive_sites, compare_sites)
 static MAKE_REMOVE(dive_site_table, struct dive_site *, dive_site)
 MAKE_CLEAR_TABLE(dive_site_table, dive_sites, dive_site)
-MAKE_MOVE_TABLE(dive_site_table, dive_sites)
+
+/* Like MAKE_MOVE_TABLE(), but the sites have to be moved in the spatial index */
+void move_dive_site_table(struct dive_site_table *src, struct dive_site_table *dst)
+{
+	int i;
+	clear_dive_site_table(dst);
+	*dst = *src;
+	src->nr = src->allocated = 0;
+	src->dive_sites = NULL;
+	for (i = 0; i < dst->nr; i++)
+		divesiteindex_add(dst->dive_sites[i], dst);
+}
 
 int add_dive_site_to_table(struct dive_site *ds, struct dive_site_table *ds_table)
 {
@@ -159,6 +163,7 @@ int add_dive_site_to_table(struct dive_site *ds, struct dive_site_table *ds_tabl
 
 	int idx = dive_site_table_get_insertion_index(ds_table, ds);
 	add_to_dive_site_table(ds_table, idx, ds);
+	divesiteindex_add(ds, ds_table);
 	return idx;
 }
 
@@ -221,6 +226,7 @@ bool is_dive_site_selected(struct dive_site *ds)
 void free_dive_site(struct dive_site *ds)
 {
 	if (ds) {
+		divesiteindex_remove(ds);
 		free(ds->name);
 		free(ds->notes);
 		free(ds->description);
@@ -232,6 +238,7 @@ void free_dive_site(struct dive_site *ds)
 
 int unregister_dive_site(struct dive_site *ds)
 {
+	divesiteindex_remove(ds);
 	return remove_dive_site(ds, divelog.sites);
 }
 
@@ -240,7 +247,7 @@ void delete_dive_site(struct dive_site *ds, struct dive_site_table *ds_table)
 	if (!ds)
 		return;
 	remove_dive_site(ds, ds_table);
-	free_dive_site(ds);
+	free_dive_site(ds); // also removes it from the spatial index
 }
 
 /* allocate a new site and add it to the table */
@@ -280,6 +287,7 @@ void copy_dive_site(struct dive_site *orig, struct dive_site *copy)
 	copy->notes = copy_string(orig->notes);
 	copy->description = copy_string(orig->description);
 	copy_taxonomy(&orig->taxonomy, &copy->taxonomy);
+	divesiteindex_update(copy);
 }
 
 static void merge_string(char **a, char **b)
@@ -315,19 +323,23 @@ static bool same_dive_site(const struct dive_site *a, const struct dive_site *b)
 	    && same_string(a->notes, b->notes);
 }
 
+static bool is_same_dive_site(const struct dive_site *ds, const void *site)
+{
+	return same_dive_site(ds, (const struct dive_site *)site);
+}
+
 struct dive_site *get_same_dive_site(const struct dive_site *site)
 {
-	int i;
-	struct dive_site *ds;
-	for_each_dive_site (i, ds, divelog.sites)
-		if (same_dive_site(ds, site))
-			return ds;
-	return NULL;
+	/* Equal dive sites are at the same location */
+	return divesiteindex_find(&site->location, divelog.sites, is_same_dive_site, site);
 }
 
 void merge_dive_site(struct dive_site *a, struct dive_site *b)
 {
-	if (!has_location(&a->location)) a->location = b->location;
+	if (!has_location(&a->location)) {
+		a->location = b->location;
+		divesiteindex_update(a);
+	}
 	merge_string(&a->name, &b->name);
 	merge_string(&a->notes, &b->notes);
 	merge_string(&a->description, &b->description);
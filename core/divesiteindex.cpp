@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "divesiteindex.h"
+#include "divesite.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <unordered_map>
+
+// The size of a grid cell in micro-degrees. That's about 1.1 km in north-south direction.
+static const int cell_udeg = 10000;
+static const int lat_cells = 180000000 / cell_udeg;
+static const int lon_cells = 360000000 / cell_udeg;
+static const double earth_radius = 6371000.0; // As in get_distance()
+
+namespace {
+struct site_grid {
+	std::unordered_map<uint64_t, std::vector<dive_site *>> cells;
+	size_t size = 0;
+};
+
+struct site_entry {
+	dive_site_table *table;
+	uint64_t cell;
+};
+}
+
+// Sites may be looked up from a different thread than the UI thread when importing.
+static std::mutex divesiteindex_lock;
+static std::unordered_map<const dive_site_table *, site_grid> grids;
+static std::unordered_map<const dive_site *, site_entry> registered_sites;
+
+static int lat_cell(int udeg)
+{
+	int cell = udeg / cell_udeg - (udeg % cell_udeg < 0);
+	return std::clamp(cell, -lat_cells / 2, lat_cells / 2);
+}
+
+static int lon_cell(int udeg)
+{
+	int cell = udeg / cell_udeg - (udeg % cell_udeg < 0);
+	return ((cell % lon_cells) + lon_cells) % lon_cells;
+}
+
+static uint64_t cell_key(int lat, int lon)
+{
+	return ((uint64_t)(lat + lat_cells / 2) << 32) | (uint32_t)lon;
+}
+
+static uint64_t cell_key(const location_t *loc)
+{
+	return cell_key(lat_cell(loc->lat.udeg), lon_cell(loc->lon.udeg));
+}
+
+static void unregister_locked(const dive_site *ds)
+{
+	auto it = registered_sites.find(ds);
+	if (it == registered_sites.end())
+		return;
+	auto grid_it = grids.find(it->second.table);
+	if (grid_it != grids.end()) {
+		site_grid &grid = grid_it->second;
+		auto cell_it = grid.cells.find(it->second.cell);
+		if (cell_it != grid.cells.end()) {
+			std::vector<dive_site *> &sites = cell_it->second;
+			sites.erase(std::remove(sites.begin(), sites.end(), ds), sites.end());
+			if (sites.empty())
+				grid.cells.erase(cell_it);
+		}
+		if (--grid.size == 0)
+			grids.erase(grid_it);
+	}
+	registered_sites.erase(it);
+}
+
+static void register_locked(dive_site *ds, dive_site_table *ds_table)
+{
+	unregister_locked(ds);
+	uint64_t key = cell_key(&ds->location);
+	site_grid &grid = grids[ds_table];
+	grid.cells[key].push_back(ds);
+	++grid.size;
+	registered_sites[ds] = { ds_table, key };
+}
+
+// The index is not informed when sites are taken out of a table without
+// removing them (e.g. when they are moved into an undo command). Therefore,
+// check that the site is still in the table.
+static bool in_table(const dive_site *ds, dive_site_table *ds_table)
+{
+	return get_divesite_idx(ds, ds_table) >= 0;
+}
+
+// Call func for all sites of the table that may be at most distance meters away from loc.
+template <typename Func>
+static void for_each_candidate(const location_t *loc, double distance, const site_grid &grid, Func func)
+{
+	// Add some slack for rounding errors
+	double angle = (distance + 1.0) / earth_radius;
+	double dlat = angle * 180.0 / M_PI * 1000000.0 + 1.0;
+	double lat_min = std::max(loc->lat.udeg - dlat, -90000000.0);
+	double lat_max = std::min(loc->lat.udeg + dlat, 90000000.0);
+	int lat_from = lat_cell(lrint(floor(lat_min)));
+	int lat_to = lat_cell(lrint(ceil(lat_max)));
+
+	// The range of longitudes depends on the latitude. If the circle contains a pole, search all longitudes.
+	double cos_lat = cos(udeg_to_radians(loc->lat.udeg));
+	int lon_from = 0, lon_count = lon_cells;
+	if (lat_min > -90000000.0 && lat_max < 90000000.0 && sin(std::min(angle, M_PI / 2.0)) < cos_lat) {
+		double dlon = asin(sin(angle) / cos_lat) * 180.0 / M_PI * 1000000.0 + 1.0;
+		if (2.0 * (dlon + cell_udeg) < 360000000.0) {
+			lon_from = lon_cell(lrint(floor(loc->lon.udeg - dlon)));
+			int lon_to = lon_cell(lrint(ceil(loc->lon.udeg + dlon)));
+			lon_count = ((lon_to - lon_from) % lon_cells + lon_cells) % lon_cells + 1;
+		}
+	}
+
+	// If there are more cells to search than sites, simply look at all sites.
+	if ((double)(lat_to - lat_from + 1) * lon_count > (double)grid.size) {
+		for (const auto &[key, sites]: grid.cells) {
+			for (dive_site *ds: sites)
+				func(ds);
+		}
+		return;
+	}
+	for (int lat = lat_from; lat <= lat_to; ++lat) {
+		for (int i = 0; i < lon_count; ++i) {
+			auto it = grid.cells.find(cell_key(lat, (lon_from + i) % lon_cells));
+			if (it == grid.cells.end())
+				continue;
+			for (dive_site *ds: it->second)
+				func(ds);
+		}
+	}
+}
+
+extern "C" void divesiteindex_add(struct dive_site *ds, struct dive_site_table *ds_table)
+{
+	std::lock_guard<std::mutex> guard(divesiteindex_lock);
+	register_locked(ds, ds_table);
+}
+
+extern "C" void divesiteindex_remove(const struct dive_site *ds)
+{
+	std::lock_guard<std::mutex> guard(divesiteindex_lock);
+	unregister_locked(ds);
+}
+
+extern "C" void divesiteindex_update(struct dive_site *ds)
+{
+	std::lock_guard<std::mutex> guard(divesiteindex_lock);
+	auto it = registered_sites.find(ds);
+	if (it != registered_sites.end() && it->second.cell != cell_key(&ds->location))
+		register_locked(ds, it->second.table);
+}
+
+extern "C" struct dive_site *divesiteindex_find(const location_t *loc, struct dive_site_table *ds_table, dive_site_predicate pred, const void *data)
+{
+	std::lock_guard<std::mutex> guard(divesiteindex_lock);
+	auto grid_it = grids.find(ds_table);
+	if (grid_it == grids.end())
+		return nullptr;
+	auto it = grid_it->second.cells.find(cell_key(loc));
+	if (it == grid_it->second.cells.end())
+		return nullptr;
+
+	// The table is sorted by UUID, therefore the first site is the one with the lowest UUID.
+	dive_site *res = nullptr;
+	for (dive_site *ds: it->second) {
+		if ((!res || ds->uuid < res->uuid) && same_location(&ds->location, loc) &&
+		    (!pred || pred(ds, data)) && in_table(ds, ds_table))
+			res = ds;
+	}
+	return res;
+}
+
+extern "C" struct dive_site *divesiteindex_nearest(const location_t *loc, unsigned int distance, struct dive_site_table *ds_table)
+{
+	std::lock_guard<std::mutex> guard(divesiteindex_lock);
+	auto grid_it = grids.find(ds_table);
+	if (grid_it == grids.end())
+		return nullptr;
+
+	// Search in growing circles until a site is found that is inside the searched circle.
+	for (double radius = std::min(1000.0, (double)distance); ; radius = std::min(2.0 * radius, (double)distance)) {
+		dive_site *res = nullptr;
+		unsigned int min_distance = distance;
+		for_each_candidate(loc, radius, grid_it->second, [&](dive_site *ds) {
+			if (!has_location(&ds->location))
+				return;
+			unsigned int cur_distance = get_distance(&ds->location, loc);
+			if ((cur_distance < min_distance || (res && cur_distance == min_distance && ds->uuid < res->uuid)) &&
+			    in_table(ds, ds_table)) {
+				min_distance = cur_distance;
+				res = ds;
+			}
+		});
+		if ((res && min_distance <= radius) || radius >= distance)
+			return res;
+	}
+}
+
+std::vector<struct dive_site *> divesiteindex_within(const location_t *loc, unsigned int distance, struct dive_site_table *ds_table)
+{
+	std::lock_guard<std::mutex> guard(divesiteindex_lock);
+	std::vector<std::pair<unsigned int, dive_site *>> found;
+	auto grid_it = grids.find(ds_table);
+	if (grid_it == grids.end())
+		return {};
+	for_each_candidate(loc, distance, grid_it->second, [&](dive_site *ds) {
+		if (!has_location(&ds->location))
+			return;
+		unsigned int cur_distance = get_distance(&ds->location, loc);
+		if (cur_distance <= distance && in_table(ds, ds_table))
+			found.push_back({ cur_distance, ds });
+	});
+	std::sort(found.begin(), found.end(), [](const std::pair<unsigned int, dive_site *> &a, const std::pair<unsigned int, dive_site *> &b)
+		  { return a.first != b.first ? a.first < b.first : a.second->uuid < b.second->uuid; });
+	std::vector<dive_site *> res;
+	res.reserve(found.size());
+	for (auto [d, ds]: found)
+		res.push_back(ds);
+	return res;
+}
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: GPL-2.0
+// A spatial index of the dive sites in dive site tables. Used to find sites
+// at or near a location without computing the distance to every site.
+//
+// The sites are sorted into cells of a fixed latitude/longitude grid. The
+// index is updated when sites are added to or removed from a table and must
+// be informed by divesiteindex_update() when the location of a site that is
+// in a table is changed.
+#ifndef DIVESITEINDEX_H
+#define DIVESITEINDEX_H
+
+#include "units.h"
+
+#ifdef __cplusplus
+extern "C" {
+#else
+#include <stdbool.h>
+#endif
+
+struct dive_site;
+struct dive_site_table;
+
+typedef bool (*dive_site_predicate)(const struct dive_site *ds, const void *data);
+
+void divesiteindex_add(struct dive_site *ds, struct dive_site_table *ds_table); // Note: can be called repeatedly
+void divesiteindex_remove(const struct dive_site *ds); // Note: can be called repeatedly
+void divesiteindex_update(struct dive_site *ds);
+
+// The first site in the table at exactly the given location for which pred returns true.
+// If pred is NULL, the first site at the location is returned.
+struct dive_site *divesiteindex_find(const location_t *loc, struct dive_site_table *ds_table, dive_site_predicate pred, const void *data);
+
+// The closest site with a GPS location less than distance meters away.
+// If there are multiple sites at the same distance, the first one in the table is returned.
+struct dive_site *divesiteindex_nearest(const location_t *loc, unsigned int distance, struct dive_site_table *ds_table);
+
+#ifdef __cplusplus
+}
+
+#include <vector>
+
+// Sites with a GPS location at most distance meters away, sorted by distance.
+std::vector<struct dive_site *> divesiteindex_within(const location_t *loc, unsigned int distance, struct dive_site_table *ds_table);
+
+#endif
+
+#endif
@@ -29,12 +29,19 @@ void report_info(const char *fmt, ...)
 
 static void (*error_cb)(char *) = NULL;
 
+// Non-null if the errors of this thread are collected, see error_collector
+static thread_local std::vector<std::string> *collected_errors = nullptr;
+
 int report_error(const char *fmt, ...)
 {
 	struct membufferpp buf;
 
 	VA_BUF(&buf, fmt);
 	strip_mb(&buf);
+	if (collected_errors) {
+		collected_errors->push_back(mb_cstring(&buf));
+		return -1;
+	}
 	LOG_MSG("ERROR: %s\n", mb_cstring(&buf));
 
 	/* if there is no error callback registered, don't produce errors */
@@ -44,6 +51,22 @@ int report_error(const char *fmt, ...)
 	return -1;
 }
 
+void report_errors(const std::vector<std::string> &errors)
+{
+	for (const std::string &error: errors)
+		report_error("%s", error.c_str());
+}
+
+error_collector::error_collector(std::vector<std::string> &errors) : old(collected_errors)
+{
+	collected_errors = &errors;
+}
+
+error_collector::~error_collector()
+{
+	collected_errors = old;
+}
+
 void set_error_cb(void(*cb)(char *))
 {
 	error_cb = cb;
@@ -22,6 +22,22 @@ extern void set_error_cb(void(*cb)(char *));	// Callback takes ownership of pass
 
 #ifdef __cplusplus
 }
+
+#include <string>
+#include <vector>
+
+/* While an object of this class exists, report_error() stores the errors of the
+ * thread that created it in the given list. For parallel loaders, which pass the
+ * lists on with report_errors() in a defined order.
+ */
+class error_collector {
+public:
+	error_collector(std::vector<std::string> &errors);
+	~error_collector();
+private:
+	std::vector<std::string> *old;
+};
+extern void report_errors(const std::vector<std::string> &errors);
 #endif
 
 #endif
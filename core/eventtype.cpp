@@ -7,20 +7,20 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <mutex>
 
-struct event_type {
-	std::string name;
-	event_severity severity;
-	bool plot;
-	event_type(const struct event *ev) :
-		name(ev->name),
-		severity(get_event_severity(ev)),
-		plot(true)
-	{
-	}
-};
+event_type::event_type(const struct event *ev) :
+	name(ev->name),
+	severity(get_event_severity(ev)),
+	plot(true)
+{
+}
 
 static std::vector<event_type> event_types;
+static std::mutex event_types_lock;	// events may be created from several threads
+
+// Non-null if the event types of this thread are collected, see event_type_collector
+static thread_local std::vector<event_type> *collected_event_types = nullptr;
 
 static bool operator==(const event_type &en1, const event_type &en2)
 {
@@ -32,14 +32,40 @@ extern "C" void clear_event_types()
 	event_types.clear();
 }
 
+static void remember_event_type(event_type type, std::vector<event_type> &types)
+{
+	if (std::find(types.begin(), types.end(), type) != types.end())
+		return;
+	types.push_back(std::move(type));
+}
+
 extern "C" void remember_event_type(const struct event *ev)
 {
 	if (empty_string(ev->name))
 		return;
-	event_type type(ev);
-	if (std::find(event_types.begin(), event_types.end(), type) != event_types.end())
+	if (collected_event_types) {
+		remember_event_type(event_type(ev), *collected_event_types);
 		return;
-	event_types.push_back(std::move(type));
+	}
+	std::lock_guard<std::mutex> lock(event_types_lock);
+	remember_event_type(event_type(ev), event_types);
+}
+
+void remember_event_types(const std::vector<event_type> &types)
+{
+	std::lock_guard<std::mutex> lock(event_types_lock);
+	for (const event_type &type: types)
+		remember_event_type(type, event_types);
+}
+
+event_type_collector::event_type_collector(std::vector<event_type> &types) : old(collected_event_types)
+{
+	collected_event_types = &types;
+}
+
+event_type_collector::~event_type_collector()
+{
+	collected_event_types = old;
 }
 
 extern "C" bool is_event_type_hidden(const struct event *ev)
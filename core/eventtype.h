@@ -20,12 +20,35 @@ extern bool any_event_types_hidden();
 
 // C++-only functions
 
+#include <string>
 #include <vector>
 #include <QString>
+#include "event.h"
+
+struct event_type {
+	std::string name;
+	event_severity severity;
+	bool plot;
+	event_type(const struct event *ev);
+};
+
 extern std::vector<int> hidden_event_types();
 QString event_type_name(const event *ev);
 QString event_type_name(int idx);
 
+/* While an object of this class exists, remember_event_type() stores the event types
+ * of the thread that created it in the given list instead of the global list. For
+ * parallel loaders, which add the lists with remember_event_types() in a defined order.
+ */
+class event_type_collector {
+public:
+	event_type_collector(std::vector<event_type> &types);
+	~event_type_collector();
+private:
+	std::vector<event_type> *old;
+};
+extern void remember_event_types(const std::vector<event_type> &types);
+
 #endif
 
 #endif
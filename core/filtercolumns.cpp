@@ -0,0 +1,329 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "filtercolumns.h"
+#include "dive.h"
+#include "divelist.h"
+#include "divelog.h"
+#include "gas.h"
+#include "subsurface-time.h"
+
+#include <algorithm>
+#include <limits>
+
+// The semantics of these checks must be identical to the ones in filterconstraint.cpp
+
+static long days_since_epoch(timestamp_t timestamp)
+{
+	return timestamp / (3600 * 24);
+}
+
+static int seconds_since_midnight(timestamp_t timestamp)
+{
+	return timestamp % (3600 * 24);
+}
+
+// Inclusive bounds of a range constraint
+template <typename T>
+static std::pair<T, T> get_bounds(enum filter_constraint_range_mode mode, T from, T to)
+{
+	switch (mode) {
+	case FILTER_CONSTRAINT_EQUAL:
+		return { from, from };
+	case FILTER_CONSTRAINT_LESS:
+		return { std::numeric_limits<T>::min(), to };
+	case FILTER_CONSTRAINT_GREATER:
+		return { from, std::numeric_limits<T>::max() };
+	case FILTER_CONSTRAINT_RANGE:
+	default:
+		return { from, to };
+	}
+}
+
+void FilterColumns::ListColumn::resize(size_t size)
+{
+	begin.resize(size);
+	end.resize(size);
+}
+
+void FilterColumns::ListColumn::set(int row, const std::vector<int> &v)
+{
+	// If the new entries don't fit, append them. The old entries are
+	// lost until the next clear(), but dives are not edited that often.
+	if ((int)v.size() > end[row] - begin[row])
+		begin[row] = (int)values.size();
+	end[row] = begin[row] + (int)v.size();
+	if (end[row] > (int)values.size())
+		values.resize(end[row]);
+	std::copy(v.begin(), v.end(), values.begin() + begin[row]);
+}
+
+template <typename F>
+bool FilterColumns::ListColumn::any(int row, F f) const
+{
+	for (int i = begin[row]; i < end[row]; ++i) {
+		if (f(values[i]))
+			return true;
+	}
+	return false;
+}
+
+void FilterColumns::clear()
+{
+	dives.clear();
+	upToDate.clear();
+	rows.clear();
+	tableRows.clear();
+	when.clear();
+	endTime.clear();
+	endOfDay.clear();
+	for (int i = 0; i < num_types; ++i) {
+		values[i].clear();
+		lists[i] = ListColumn();
+		strings[i].clear();
+		stringIds[i].clear();
+	}
+}
+
+void FilterColumns::invalidate(const struct dive *d)
+{
+	auto it = rows.find(d);
+	if (it != rows.end())
+		upToDate[it->second] = false;
+}
+
+void FilterColumns::remove(const struct dive *d)
+{
+	auto it = rows.find(d);
+	if (it == rows.end())
+		return;
+	dives[it->second] = nullptr;
+	rows.erase(it);
+}
+
+void FilterColumns::refresh()
+{
+	int i;
+	struct dive *d;
+	tableRows.resize(divelog.dives->nr);
+	for_each_dive(i, d) {
+		auto it = rows.find(d);
+		if (it == rows.end()) {
+			tableRows[i] = addRow(d);
+		} else {
+			tableRows[i] = it->second;
+			if (!upToDate[it->second])
+				setRow(it->second, d);
+		}
+	}
+}
+
+int FilterColumns::addRow(const struct dive *d)
+{
+	int row = (int)dives.size();
+	size_t size = dives.size() + 1;
+	dives.push_back(d);
+	upToDate.resize(size);
+	when.resize(size);
+	endTime.resize(size);
+	endOfDay.resize(size);
+	for (int i = 0; i < num_types; ++i) {
+		values[i].resize(size);
+		lists[i].resize(size);
+	}
+	rows[d] = row;
+	setRow(row, d);
+	return row;
+}
+
+int FilterColumns::stringId(enum filter_constraint_type type, const QString &s)
+{
+	auto it = stringIds[type].find(s);
+	if (it != stringIds[type].end())
+		return *it;
+	int id = (int)strings[type].size();
+	strings[type].push_back(s);
+	stringIds[type].insert(s, id);
+	return id;
+}
+
+void FilterColumns::setRow(int row, const struct dive *d)
+{
+	when[row] = d->when;
+	endTime[row] = dive_endtime(d);
+	endOfDay[row] = seconds_since_midnight(endTime[row]);
+	values[FILTER_CONSTRAINT_TIME_OF_DAY][row] = seconds_since_midnight(d->when);
+	values[FILTER_CONSTRAINT_YEAR][row] = utc_year(d->when);
+	values[FILTER_CONSTRAINT_DAY_OF_WEEK][row] = utc_weekday(d->when);
+	values[FILTER_CONSTRAINT_RATING][row] = d->rating;
+	values[FILTER_CONSTRAINT_WAVESIZE][row] = d->wavesize;
+	values[FILTER_CONSTRAINT_CURRENT][row] = d->current;
+	values[FILTER_CONSTRAINT_VISIBILITY][row] = d->visibility;
+	values[FILTER_CONSTRAINT_SURGE][row] = d->surge;
+	values[FILTER_CONSTRAINT_CHILL][row] = d->chill;
+	values[FILTER_CONSTRAINT_DEPTH][row] = d->maxdepth.mm;
+	values[FILTER_CONSTRAINT_DURATION][row] = d->duration.seconds;
+	values[FILTER_CONSTRAINT_WEIGHT][row] = total_weight(d);
+	values[FILTER_CONSTRAINT_WATER_TEMP][row] = d->watertemp.mkelvin;
+	values[FILTER_CONSTRAINT_AIR_TEMP][row] = d->airtemp.mkelvin;
+	values[FILTER_CONSTRAINT_WATER_DENSITY][row] = d->user_salinity ? d->user_salinity : d->salinity;
+	values[FILTER_CONSTRAINT_SAC][row] = d->sac;
+	values[FILTER_CONSTRAINT_LOGGED][row] = is_logged(d);
+	values[FILTER_CONSTRAINT_PLANNED][row] = is_planned(d);
+	values[FILTER_CONSTRAINT_DIVE_MODE][row] = (int)d->dc.divemode;
+
+	std::vector<int> sizes, n2, o2, he;
+	for (int i = 0; i < d->cylinders.nr; ++i) {
+		const cylinder_t &cyl = d->cylinders.cylinders[i];
+		if (cyl.type.size.mliter)
+			sizes.push_back(cyl.type.size.mliter);
+		n2.push_back(get_gas_component_fraction(cyl.gasmix, N2).permille);
+		o2.push_back(get_gas_component_fraction(cyl.gasmix, O2).permille);
+		he.push_back(get_gas_component_fraction(cyl.gasmix, HE).permille);
+	}
+	lists[FILTER_CONSTRAINT_CYLINDER_SIZE].set(row, sizes);
+	lists[FILTER_CONSTRAINT_CYLINDER_N2].set(row, n2);
+	lists[FILTER_CONSTRAINT_CYLINDER_O2].set(row, o2);
+	lists[FILTER_CONSTRAINT_CYLINDER_HE].set(row, he);
+
+	for (int type = 0; type < num_types; ++type) {
+		if (!filter_constraint_is_string((filter_constraint_type)type))
+			continue;
+		std::vector<int> ids;
+		for (const QString &s: filter_constraint_get_dive_strings((filter_constraint_type)type, d))
+			ids.push_back(stringId((filter_constraint_type)type, s));
+		lists[type].set(row, ids);
+	}
+
+	upToDate[row] = true;
+}
+
+std::vector<char> FilterColumns::match(const std::vector<filter_constraint> &constraints) const
+{
+	std::vector<char> rowMatches(dives.size(), true);
+	for (const filter_constraint &c: constraints)
+		matchConstraint(c, rowMatches);
+
+	std::vector<char> res(tableRows.size());
+	for (size_t i = 0; i < tableRows.size(); ++i)
+		res[i] = rowMatches[tableRows[i]];
+	return res;
+}
+
+// Clear the entries of res of the rows that don't match the constraint
+void FilterColumns::matchConstraint(const filter_constraint &c, std::vector<char> &res) const
+{
+	const int size = (int)res.size();
+	const bool negate = c.negate;
+
+	if (filter_constraint_is_string(c.type)) {
+		if (c.data.string_list->isEmpty())
+			return;
+		const std::vector<QString> &s = strings[c.type];
+		std::vector<char> stringMatches(s.size());
+		for (size_t i = 0; i < s.size(); ++i)
+			stringMatches[i] = filter_constraint_match_string(c, s[i]);
+		const ListColumn &list = lists[c.type];
+		for (int i = 0; i < size; ++i)
+			res[i] &= list.any(i, [&stringMatches](int id) { return stringMatches[id]; }) != negate;
+		return;
+	}
+
+	auto [from, to] = get_bounds(c.range_mode, c.data.numerical_range.from, c.data.numerical_range.to);
+	auto in_range = [from = from, to = to, negate](int v) { return (v >= from && v <= to) != negate; };
+	const std::vector<int> &col = values[c.type];
+
+	switch (c.type) {
+	case FILTER_CONSTRAINT_DATE: {
+		// We don't consider dives past midnight. Should we?
+		auto [first_day, last_day] = get_bounds(c.range_mode, days_since_epoch(c.data.timestamp_range.from),
+							days_since_epoch(c.data.timestamp_range.to));
+		for (int i = 0; i < size; ++i) {
+			long day = days_since_epoch(when[i]);
+			res[i] &= (day >= first_day && day <= last_day) != negate;
+		}
+		break;
+	}
+	case FILTER_CONSTRAINT_DATE_TIME: {
+		timestamp_t start = c.data.timestamp_range.from;
+		timestamp_t end = c.data.timestamp_range.to;
+		switch (c.range_mode) {
+		case FILTER_CONSTRAINT_EQUAL:
+			// Any dive during which the given timestamp lies
+			for (int i = 0; i < size; ++i)
+				res[i] &= (when[i] <= start && start <= endTime[i]) != negate;
+			break;
+		case FILTER_CONSTRAINT_LESS:
+			for (int i = 0; i < size; ++i)
+				res[i] &= (endTime[i] <= end) != negate;
+			break;
+		case FILTER_CONSTRAINT_GREATER:
+			for (int i = 0; i < size; ++i)
+				res[i] &= (when[i] >= start) != negate;
+			break;
+		case FILTER_CONSTRAINT_RANGE:
+			for (int i = 0; i < size; ++i)
+				res[i] &= (when[i] >= start && endTime[i] <= end) != negate;
+			break;
+		}
+		break;
+	}
+	case FILTER_CONSTRAINT_TIME_OF_DAY: {
+		// Cyclic support, see check_time_of_day_range() in filterconstraint.cpp
+		int start = c.data.numerical_range.from;
+		int end = c.data.numerical_range.to;
+		bool neg = negate;
+		if ((c.range_mode == FILTER_CONSTRAINT_EQUAL || c.range_mode == FILTER_CONSTRAINT_RANGE) && start > end) {
+			std::swap(start, end);
+			neg = !neg;
+		}
+		switch (c.range_mode) {
+		case FILTER_CONSTRAINT_EQUAL:
+			for (int i = 0; i < size; ++i)
+				res[i] &= (col[i] <= start && endOfDay[i] >= start) != neg;
+			break;
+		case FILTER_CONSTRAINT_LESS:
+			for (int i = 0; i < size; ++i)
+				res[i] &= (endOfDay[i] <= end) != neg;
+			break;
+		case FILTER_CONSTRAINT_GREATER:
+			for (int i = 0; i < size; ++i)
+				res[i] &= (col[i] >= start) != neg;
+			break;
+		case FILTER_CONSTRAINT_RANGE:
+			for (int i = 0; i < size; ++i)
+				res[i] &= (col[i] >= start && endOfDay[i] <= end) != neg;
+			break;
+		}
+		break;
+	}
+	case FILTER_CONSTRAINT_DAY_OF_WEEK:
+	case FILTER_CONSTRAINT_DIVE_MODE: {
+		uint64_t bits = c.data.multiple_choice;
+		for (int i = 0; i < size; ++i)
+			res[i] &= (bool)((bits >> col[i]) & 1) != negate;
+		break;
+	}
+	case FILTER_CONSTRAINT_LOGGED:
+	case FILTER_CONSTRAINT_PLANNED:
+		for (int i = 0; i < size; ++i)
+			res[i] &= (col[i] != 0) != negate;
+		break;
+	case FILTER_CONSTRAINT_SAC:
+		// A value of 0 means "not set"
+		for (int i = 0; i < size; ++i)
+			res[i] &= col[i] ? in_range(col[i]) : negate;
+		break;
+	case FILTER_CONSTRAINT_CYLINDER_SIZE:
+	case FILTER_CONSTRAINT_CYLINDER_N2:
+	case FILTER_CONSTRAINT_CYLINDER_O2:
+	case FILTER_CONSTRAINT_CYLINDER_HE: {
+		const ListColumn &list = lists[c.type];
+		for (int i = 0; i < size; ++i)
+			res[i] &= list.any(i, in_range);
+		break;
+	}
+	default:
+		for (int i = 0; i < size; ++i)
+			res[i] &= in_range(col[i]);
+		break;
+	}
+}
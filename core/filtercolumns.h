@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-2.0
+// A column-oriented copy of the dive data that is accessed by the filter
+// constraints. Instead of testing every constraint on every dive, each
+// constraint is tested on a whole column in one tight loop. Strings are
+// interned, so that string constraints only compare every distinct string
+// once, instead of converting and comparing the strings of every dive.
+//
+// The data of a dive is only reread when it was invalidated, so that
+// changing the filter does not have to touch the dives at all.
+#ifndef FILTER_COLUMNS_H
+#define FILTER_COLUMNS_H
+
+#include "filterconstraint.h"
+#include <QHash>
+#include <QString>
+#include <unordered_map>
+#include <vector>
+
+struct dive;
+
+class FilterColumns {
+public:
+	void clear(); // Forget all dives
+	void invalidate(const struct dive *d); // Dive changed: reread on next refresh()
+	void remove(const struct dive *d); // Dive was removed from the dive table
+	void refresh(); // Add new dives of the dive table and reread invalidated dives
+	// Test all dives of the dive table against the constraints. Returns one entry
+	// per dive, indexed like the dive table. refresh() must be called first.
+	std::vector<char> match(const std::vector<filter_constraint> &constraints) const;
+private:
+	// A column with a variable number of entries per dive
+	struct ListColumn {
+		std::vector<int> begin, end; // Range of the entries of each dive in values
+		std::vector<int> values;
+		void resize(size_t size);
+		void set(int row, const std::vector<int> &v);
+		template <typename F> bool any(int row, F f) const;
+	};
+	static constexpr int num_types = FILTER_CONSTRAINT_NOTES + 1;
+
+	std::vector<const dive *> dives; // Dive of each row, null if the dive was removed
+	std::vector<char> upToDate;
+	std::unordered_map<const dive *, int> rows;
+	std::vector<int> tableRows; // Row of each dive of the dive table
+
+	std::vector<timestamp_t> when, endTime;
+	std::vector<int> endOfDay; // The start of the day is in the FILTER_CONSTRAINT_TIME_OF_DAY column
+	std::vector<int> values[num_types];
+	ListColumn lists[num_types];
+
+	// Distinct strings of each string column
+	std::vector<QString> strings[num_types];
+	QHash<QString, int> stringIds[num_types];
+
+	int addRow(const struct dive *d);
+	void setRow(int row, const struct dive *d);
+	int stringId(enum filter_constraint_type type, const QString &s);
+	void matchConstraint(const filter_constraint &c, std::vector<char> &res) const;
+};
+
+#endif
@@ -791,49 +791,53 @@ uint64_t filter_constraint_get_multiple_choice(const filter_constraint &c)
 // the first matches the second according to a criterion (substring, starts-with, exact).
 using StrCheck = bool (*) (const QString &s1, const QString &s2);
 
-// Check if a string-list contains at least one string containing the second argument.
-// Comparison is non case sensitive and removes white space.
-static bool listContainsSuperstring(const QStringList &list, const QString &s, StrCheck strchk)
+static StrCheck string_check(const filter_constraint &c)
 {
-	return std::any_of(list.begin(), list.end(), [&s,strchk](const QString &s2)
-			   { return strchk(s2, s); } );
-}
-
-// Check whether any of the items of the first list is in the second list as a super string.
-// The mode is controlled by the second argument
-static bool check(const filter_constraint &c, const QStringList &list)
-{
-	StrCheck strchk =
-		c.string_mode == FILTER_CONSTRAINT_SUBSTRING ?
+	return	c.string_mode == FILTER_CONSTRAINT_SUBSTRING ?
 			[](const QString &s1, const QString &s2) { return s1.contains(s2, Qt::CaseInsensitive); } :
 		c.string_mode == FILTER_CONSTRAINT_STARTS_WITH ?
 			[](const QString &s1, const QString &s2) { return s1.startsWith(s2, Qt::CaseInsensitive); } :
 		/* FILTER_CONSTRAINT_EXACT */
 			[](const QString &s1, const QString &s2) { return s1.compare(s2, Qt::CaseInsensitive) == 0; };
+}
+
+// Check whether any of the items of the constraint matches the given string.
+// Comparison is non case sensitive. Negation is not taken into account.
+bool filter_constraint_match_string(const filter_constraint &c, const QString &s)
+{
+	StrCheck strchk = string_check(c);
 	return std::any_of(c.data.string_list->begin(), c.data.string_list->end(),
-			   [&list, strchk](const QString &item)
-			   { return listContainsSuperstring(list, item, strchk); }) != c.negate;
+			   [&s, strchk](const QString &item)
+			   { return strchk(s, item); });
 }
 
-static bool has_tags(const filter_constraint &c, const struct dive *d)
+// Check whether any of the items of the constraint is in the list as a super string.
+// The mode is controlled by the string mode of the constraint.
+static bool check(const filter_constraint &c, const QStringList &list)
+{
+	return std::any_of(list.begin(), list.end(), [&c](const QString &s)
+			   { return filter_constraint_match_string(c, s); }) != c.negate;
+}
+
+static QStringList get_tags(const struct dive *d)
 {
 	QStringList dive_tags;
 	for (const tag_entry *tag = d->tag_list; tag; tag = tag->next)
 		dive_tags.push_back(QString::fromStdString(tag->tag->name).trimmed());
-	return check(c, dive_tags);
+	return dive_tags;
 }
 
-static bool has_people(const filter_constraint &c, const struct dive *d)
+static QStringList get_people(const struct dive *d)
 {
 	QStringList dive_people;
 	for (const QString &s: QString(d->buddy).split(",", SKIP_EMPTY))
 		dive_people.push_back(s.trimmed());
 	for (const QString &s: QString(d->diveguide).split(",", SKIP_EMPTY))
 		dive_people.push_back(s.trimmed());
-	return check(c, dive_people);
+	return dive_people;
 }
 
-static bool has_locations(const filter_constraint &c, const struct dive *d)
+static QStringList get_locations(const struct dive *d)
 {
 	QStringList diveLocations;
 	if (d->divetrip)
@@ -842,41 +846,63 @@ static bool has_locations(const filter_constraint &c, const struct dive *d)
 	if (d->dive_site)
 		diveLocations.push_back(QString(d->dive_site->name).trimmed());
 
-	return check(c, diveLocations);
+	return diveLocations;
 }
 
-static bool has_weight_type(const filter_constraint &c, const struct dive *d)
+static QStringList get_weight_types(const struct dive *d)
 {
 	QStringList weightsystemTypes;
 	for (int i = 0; i < d->weightsystems.nr; ++i)
 		weightsystemTypes.push_back(d->weightsystems.weightsystems[i].description);
 
-	return check(c, weightsystemTypes);
+	return weightsystemTypes;
 }
 
-static bool has_cylinder_type(const filter_constraint &c, const struct dive *d)
+static QStringList get_cylinder_types(const struct dive *d)
 {
 	QStringList cylinderTypes;
 	for (int i = 0; i < d->cylinders.nr; ++i)
 		cylinderTypes.push_back(d->cylinders.cylinders[i].type.description);
 
-	return check(c, cylinderTypes);
+	return cylinderTypes;
 }
 
-static bool has_suits(const filter_constraint &c, const struct dive *d)
+static QStringList get_suits(const struct dive *d)
 {
 	QStringList diveSuits;
 	if (d->suit)
 		diveSuits.push_back(QString(d->suit));
-	return check(c, diveSuits);
+	return diveSuits;
 }
 
-static bool has_notes(const filter_constraint &c, const struct dive *d)
+static QStringList get_notes(const struct dive *d)
 {
 	QStringList diveNotes;
 	if (d->notes)
 		diveNotes.push_back(QString(d->notes));
-	return check(c, diveNotes);
+	return diveNotes;
+}
+
+QStringList filter_constraint_get_dive_strings(enum filter_constraint_type type, const struct dive *d)
+{
+	switch (type) {
+	case FILTER_CONSTRAINT_TAGS:
+		return get_tags(d);
+	case FILTER_CONSTRAINT_PEOPLE:
+		return get_people(d);
+	case FILTER_CONSTRAINT_LOCATION:
+		return get_locations(d);
+	case FILTER_CONSTRAINT_WEIGHT_TYPE:
+		return get_weight_types(d);
+	case FILTER_CONSTRAINT_CYLINDER_TYPE:
+		return get_cylinder_types(d);
+	case FILTER_CONSTRAINT_SUIT:
+		return get_suits(d);
+	case FILTER_CONSTRAINT_NOTES:
+		return get_notes(d);
+	default:
+		return QStringList();
+	}
 }
 
 static bool check_numerical_range(const filter_constraint &c, int v)
@@ -1079,15 +1105,13 @@ bool filter_constraint_match_dive(const filter_constraint &c, const struct dive
 	case FILTER_CONSTRAINT_DIVE_MODE:
 		return check_multiple_choice(c, (int)d->dc.divemode); // should we be smarter and check all DCs?
 	case FILTER_CONSTRAINT_TAGS:
-		return has_tags(c, d);
 	case FILTER_CONSTRAINT_PEOPLE:
-		return has_people(c, d);
 	case FILTER_CONSTRAINT_LOCATION:
-		return has_locations(c, d);
 	case FILTER_CONSTRAINT_WEIGHT_TYPE:
-		return has_weight_type(c, d);
 	case FILTER_CONSTRAINT_CYLINDER_TYPE:
-		return has_cylinder_type(c, d);
+	case FILTER_CONSTRAINT_SUIT:
+	case FILTER_CONSTRAINT_NOTES:
+		return check(c, filter_constraint_get_dive_strings(c.type, d));
 	case FILTER_CONSTRAINT_CYLINDER_SIZE:
 		return check_cylinder_size(c, d);
 	case FILTER_CONSTRAINT_CYLINDER_N2:
@@ -1096,10 +1120,6 @@ bool filter_constraint_match_dive(const filter_constraint &c, const struct dive
 		return check_gas_range(c, d, O2);
 	case FILTER_CONSTRAINT_CYLINDER_HE:
 		return check_gas_range(c, d, HE);
-	case FILTER_CONSTRAINT_SUIT:
-		return has_suits(c, d);
-	case FILTER_CONSTRAINT_NOTES:
-		return has_notes(c, d);
 	}
 	return false;
 }
@@ -151,6 +151,8 @@ void filter_constraint_set_timestamp_from(filter_constraint &c, timestamp_t from
 void filter_constraint_set_timestamp_to(filter_constraint &c, timestamp_t to); // convert according to current units (metric or imperial)
 void filter_constraint_set_multiple_choice(filter_constraint &c, uint64_t);
 bool filter_constraint_match_dive(const filter_constraint &c, const struct dive *d);
+bool filter_constraint_match_string(const filter_constraint &c, const QString &s); // ignores negation
+QStringList filter_constraint_get_dive_strings(enum filter_constraint_type, const struct dive *d); // strings a string constraint is matched against
 std::string filter_constraint_data_to_string(const struct filter_constraint *constraint); // caller takes ownership of returned string
 
 #endif
@@ -8,25 +8,41 @@
 #include "trip.h"
 #include "qthelper.h"
 #include <QLocale>
+#include <algorithm>
 #include <map>
+#include <unordered_map>
 
-// This class caches each dives words, so that we can unregister a dive from the full text search
+// This class caches the ids of each dives words, so that we can unregister a dive from the full text search
 struct full_text_cache {
-	std::vector<QString> words;
+	std::vector<int> words;
 };
 
 // The FullText-search class
+// Every word gets an id, which is its index in the words array. Ids are never
+// reused, words that are not used anymore simply have an empty list of dives.
+// The lists of dives are sorted by address, so that they can be merged and
+// intersected in linear time.
 class FullText {
-	std::map<QString, std::vector<dive *>> words; // Dives that belong to each word
+	struct Word {
+		QString text;
+		std::vector<dive *> dives; // Dives that contain this word, sorted
+	};
+	std::vector<Word> words;
+	std::map<QString, int> wordIds; // Sorted, so that words with a common prefix form a contiguous block
+	std::unordered_map<uint64_t, std::vector<int>> trigrams; // Ids of words containing a trigram, sorted
 public:
 	void populate(); // Rebuild from current dive_table
 	void registerDive(struct dive *d); // Note: can be called repeatedly
 	void unregisterDive(struct dive *d); // Note: can be called repeatedly
 	void unregisterAll(); // Unregister all dives in the dive table
 	FullTextResult find(const FullTextQuery &q, StringFilterMode mode) const; // Find dives matchin all words.
+	const QString &word(int id) const;
 private:
-	void registerWords(struct dive *d, const std::vector<QString> &w);
-	void unregisterWords(struct dive *d, const std::vector<QString> &w);
+	int wordId(const QString &w); // Add word to dictionary if not yet known
+	std::vector<int> getWordIds(const dive *d);
+	void registerWords(struct dive *d, const std::vector<int> &w);
+	void unregisterWords(struct dive *d, const std::vector<int> &w);
+	std::vector<int> findSubstring(const QString &s) const; // Find words containing a substring
 	std::vector<dive *> findDives(const QString &s, StringFilterMode mode) const; // Find dives matching a given word.
 };
 
@@ -76,9 +92,9 @@ bool fulltext_dive_matches(const struct dive *d, const FullTextQuery &q, StringF
 		mode == StringFilterMode::EXACT ? [](const QString &s1, const QString &s2) { return s1 == s2; } :
 		mode == StringFilterMode::STARTSWITH ? [](const QString &s1, const QString &s2) { return s1.startsWith(s2); } :
 		/* mode == StringFilterMode::SUBSTRING ? */ [](const QString &s1, const QString &s2) { return s1.contains(s2); };
-	const std::vector<QString> &words = d->full_text->words;
+	const std::vector<int> &words = d->full_text->words;
 	for (const QString &search: q.words) {
-		if (std::any_of(words.begin(), words.end(), [&search,matchFunc](const QString &w) { return matchFunc(w, search); }))
+		if (std::any_of(words.begin(), words.end(), [&search,matchFunc](int id) { return matchFunc(self.word(id), search); }))
 			return true;
 	}
 	return false;
@@ -151,6 +167,46 @@ static std::vector<QString> getWords(const dive *d)
 	return res;
 }
 
+// Trigrams of upper case words, used to speed up substring searches. Characters
+// outside the basic multilingual plane are cut down, which only gives more candidates.
+static uint64_t trigram(const QChar *c)
+{
+	return ((uint64_t)c[0].unicode() << 32) | ((uint64_t)c[1].unicode() << 16) | c[2].unicode();
+}
+
+const QString &FullText::word(int id) const
+{
+	return words[id].text;
+}
+
+int FullText::wordId(const QString &w)
+{
+	auto it = wordIds.find(w);
+	if (it != wordIds.end())
+		return it->second;
+
+	int id = (int)words.size();
+	words.push_back({ w, {} });
+	wordIds.emplace(w, id);
+	// New ids are larger than all previous ids, thus the lists stay sorted
+	for (int i = 0; i + 3 <= w.size(); ++i) {
+		std::vector<int> &entry = trigrams[trigram(w.constData() + i)];
+		if (entry.empty() || entry.back() != id)
+			entry.push_back(id);
+	}
+	return id;
+}
+
+std::vector<int> FullText::getWordIds(const dive *d)
+{
+	std::vector<QString> w = getWords(d);
+	std::vector<int> res;
+	res.reserve(w.size());
+	for (const QString &s: w)
+		res.push_back(wordId(s));
+	return res;
+}
+
 void FullText::populate()
 {
 	// we want this to be two calls as the second text is overwritten below by the lines starting with "\r"
@@ -158,8 +214,19 @@ void FullText::populate()
 	uiNotification(QObject::tr("start processing"));
 	int i;
 	dive *d;
+	// Registering one dive at a time would insert into the middle of the lists of
+	// dives. Instead, append all dives first and sort the lists at the end.
 	for_each_dive(i, d)
-		registerDive(d);
+		unregisterDive(d);
+	for_each_dive(i, d) {
+		d->full_text = new full_text_cache { getWordIds(d) };
+		for (int id: d->full_text->words)
+			words[id].dives.push_back(d);
+	}
+	for (Word &w: words) {
+		std::sort(w.dives.begin(), w.dives.end());
+		w.dives.erase(std::unique(w.dives.begin(), w.dives.end()), w.dives.end());
+	}
 	uiNotification(QObject::tr("%1 dives processed").arg(divelog.dives->nr));
 }
 
@@ -169,7 +236,7 @@ void FullText::registerDive(struct dive *d)
 		unregisterWords(d, d->full_text->words);
 	else
 		d->full_text = new full_text_cache;
-	d->full_text->words = getWords(d);
+	d->full_text->words = getWordIds(d);
 	registerWords(d, d->full_text->words);
 }
 
@@ -191,79 +258,101 @@ void FullText::unregisterAll()
 		d->full_text = nullptr;
 	}
 	words.clear();
+	wordIds.clear();
+	trigrams.clear();
 }
 
 // Register words of a dive.
-void FullText::registerWords(struct dive *d, const std::vector<QString> &w)
+void FullText::registerWords(struct dive *d, const std::vector<int> &w)
 {
-	for (const QString &word: w) {
-		std::vector<dive *> &entry = words[word];
-		if (std::find(entry.begin(), entry.end(), d) == entry.end())
-			entry.push_back(d);
+	for (int id: w) {
+		std::vector<dive *> &entry = words[id].dives;
+		auto it = std::lower_bound(entry.begin(), entry.end(), d);
+		if (it == entry.end() || *it != d)
+			entry.insert(it, d);
 	}
 }
 
 // Unregister words of a dive.
-void FullText::unregisterWords(struct dive *d, const std::vector<QString> &w)
+void FullText::unregisterWords(struct dive *d, const std::vector<int> &w)
 {
-	for (const QString &word: w) {
-		auto it = words.find(word);
-		if (it == words.end()) {
-			qWarning("FullText::unregisterWords: didn't find word '%s' in index!?", qPrintable(word));
+	for (int id: w) {
+		std::vector<dive *> &entry = words[id].dives;
+		auto it = std::lower_bound(entry.begin(), entry.end(), d);
+		if (it == entry.end() || *it != d) {
+			qWarning("FullText::unregisterWords: didn't find word '%s' in index!?", qPrintable(words[id].text));
 			continue;
 		}
-		std::vector<dive *> &entry = it->second;
-		entry.erase(std::remove(entry.begin(), entry.end(), d));
-		if (entry.empty())
-			words.erase(it);
+		entry.erase(it);
 	}
 }
 
-// Add dives from second array to first, if not yet there
-void combineDives(std::vector<dive *> &to, const std::vector<dive *> &from)
+// Find the ids of all words that contain a substring. For substrings of at least
+// three characters, only the words that contain all trigrams of the substring are
+// checked. Shorter substrings match a large part of the dictionary anyway.
+std::vector<int> FullText::findSubstring(const QString &s) const
 {
-	for (dive *d: from) {
-		if (std::find(to.begin(), to.end(), d) == to.end())
-			to.push_back(d);
+	std::vector<int> res;
+	if (s.size() < 3) {
+		for (size_t id = 0; id < words.size(); ++id) {
+			if (words[id].text.contains(s))
+				res.push_back((int)id);
+		}
+		return res;
 	}
+
+	for (int i = 0; i + 3 <= s.size(); ++i) {
+		auto it = trigrams.find(trigram(s.constData() + i));
+		if (it == trigrams.end())
+			return {};
+		if (i == 0) {
+			res = it->second;
+		} else {
+			std::vector<int> tmp;
+			std::set_intersection(res.begin(), res.end(), it->second.begin(), it->second.end(), std::back_inserter(tmp));
+			res = std::move(tmp);
+		}
+		if (res.empty())
+			return res;
+	}
+	// The trigrams may appear in a different order
+	res.erase(std::remove_if(res.begin(), res.end(), [this, &s](int id) { return !words[id].text.contains(s); }), res.end());
+	return res;
 }
 
 std::vector<dive *> FullText::findDives(const QString &s, StringFilterMode mode) const
 {
+	std::vector<int> ids;
 	switch (mode) {
 	case StringFilterMode::EXACT:
 	default: {
 		// Try to access a single word
-		auto it = words.find(s);
-		if (it == words.end())
+		auto it = wordIds.find(s);
+		if (it == wordIds.end())
 			return {};
-		return it->second;
+		return words[it->second].dives;
 	}
-	case StringFilterMode::STARTSWITH: {
+	case StringFilterMode::STARTSWITH:
 		// Find all words that start with a substring. We use the fact
 		// that these words must form a contiguous block, since the words are
 		// ordered lexicographically.
-		auto it = words.lower_bound(s);
-		if (it == words.end() || !it->first.startsWith(s))
-			return {};
-		std::vector<dive *> res = it->second;
-		++it;
-		while (it != words.end() && it->first.startsWith(s)) {
-			combineDives(res, it->second);
-			++it;
-		}
-		return res;
-	}
-	case StringFilterMode::SUBSTRING: {
-		// Find all words that contain a substring. Here, we have to check all words!
-		std::vector<dive *> res;
-		for (auto it = words.begin(); it != words.end(); ++it) {
-			if (it->first.contains(s))
-				combineDives(res, it->second);
-		}
-		return res;
-	}
+		for (auto it = wordIds.lower_bound(s); it != wordIds.end() && it->first.startsWith(s); ++it)
+			ids.push_back(it->second);
+		break;
+	case StringFilterMode::SUBSTRING:
+		ids = findSubstring(s);
+		break;
 	}
+
+	// Unite the lists of dives of all found words
+	if (ids.size() == 1)
+		return words[ids[0]].dives;
+	std::vector<dive *> res;
+	for (int id: ids)
+		res.insert(res.end(), words[id].dives.begin(), words[id].dives.end());
+	std::sort(res.begin(), res.end());
+	res.erase(std::unique(res.begin(), res.end()), res.end());
+	return res;
 }
 
 FullTextResult FullText::find(const FullTextQuery &q, StringFilterMode mode) const
@@ -272,11 +361,12 @@ FullTextResult FullText::find(const FullTextQuery &q, StringFilterMode mode) con
 		return FullTextResult();
 
 	std::vector<dive *> res = findDives(q.words[0], mode);
-	for (size_t i = 1; i < q.words.size(); ++i) {
+	for (size_t i = 1; i < q.words.size() && !res.empty(); ++i) {
 		std::vector<dive *> res2 = findDives(q.words[i], mode);
 		// Remove dives from res that are not in res2
-		res.erase(std::remove_if(res.begin(), res.end(),
-				[&res2] (dive *d) { return std::find(res2.begin(), res2.end(), d) == res2.end(); }), res.end());
+		std::vector<dive *> tmp;
+		std::set_intersection(res.begin(), res.end(), res2.begin(), res2.end(), std::back_inserter(tmp));
+		res = std::move(tmp);
 	}
 
 	return { std::move(res) };
@@ -297,5 +387,5 @@ bool FullTextQuery::doit() const
 
 bool FullTextResult::dive_matches(const struct dive *d) const
 {
-	return std::find(dives.begin(), dives.end(), d) != dives.end();
+	return std::binary_search(dives.begin(), dives.end(), d);
 }
@@ -52,7 +52,7 @@ struct FullTextQuery {
 
 // Describes the result of a fulltext search
 struct FullTextResult {
-	std::vector<dive *> dives;
+	std::vector<dive *> dives; // Sorted by address, so that dive_matches() can do a binary search
 	bool dive_matches(const struct dive *d) const;
 };
 
@@ -158,7 +158,9 @@ Thumbnailer::Thumbnail Thumbnailer::getHashedImage(const QString &filename, bool
 Thumbnailer::Thumbnailer() : failImage(QPixmap(":filter-close").scaled(maxThumbnailSize(), maxThumbnailSize(), Qt::KeepAspectRatio).toImage()), // TODO: Don't misuse filter close icon
 			     dummyImage(QPixmap(":camera-icon").scaled(maxThumbnailSize(), maxThumbnailSize(), Qt::KeepAspectRatio).toImage()),
 			     videoImage(QPixmap(":video-icon").scaled(maxThumbnailSize(), maxThumbnailSize(), Qt::KeepAspectRatio).toImage()),
-			     unknownImage(QPixmap(":unknown-icon").scaled(maxThumbnailSize(), maxThumbnailSize(), Qt::KeepAspectRatio).toImage())
+			     unknownImage(QPixmap(":unknown-icon").scaled(maxThumbnailSize(), maxThumbnailSize(), Qt::KeepAspectRatio).toImage()),
+			     generation(0),
+			     store(thumbnailStoreFileName())
 {
 	// We have to do this little song and dance because QSvgRenderer produces artifacts when used with Qt::KeepAspectRatio
 	QSvgRenderer videoOverlayRenderer{QString(":video-overlay")};
@@ -234,38 +236,54 @@ Thumbnailer::Thumbnail Thumbnailer::getVideoThumbnailFromStream(QDataStream &str
 	return { res, MEDIATYPE_VIDEO, { (int32_t)duration } };
 }
 
+// Thumbnails used to be stored in one file per picture. Move such a file into the store.
+std::optional<ThumbnailStore::Entry> Thumbnailer::importThumbnailFile(const QString &picture_filename)
+{
+	QFile file(thumbnailFileName(picture_filename));
+	if (!file.open(QIODevice::ReadOnly))
+		return {};
+	QByteArray data = file.readAll();
+	qint64 created = QFileInfo(file).lastModified().toMSecsSinceEpoch();
+	file.close();
+	if (store.put(picture_filename, data, created))
+		file.remove();
+	return ThumbnailStore::Entry { std::move(data), created };
+}
+
 // Fetch a thumbnail from cache.
 // If Thumbnail::QImage is null, the thumbnail is scheduled for recreation.
 Thumbnailer::Thumbnail Thumbnailer::getThumbnailFromCache(const QString &picture_filename)
 {
-	QString filename = thumbnailFileName(picture_filename);
-	if (filename.isEmpty())
+	return getThumbnailFromEntry(picture_filename, store.get(picture_filename));
+}
+
+Thumbnailer::Thumbnail Thumbnailer::getThumbnailFromEntry(const QString &picture_filename, std::optional<ThumbnailStore::Entry> entry)
+{
+	if (picture_filename.isEmpty())
+		return { QImage(), MEDIATYPE_UNKNOWN, zero_duration };
+	if (!entry)
+		entry = importThumbnailFile(picture_filename);
+	if (!entry)
 		return { QImage(), MEDIATYPE_UNKNOWN, zero_duration };
-	QFile file(filename);
 
 	if (prefs.auto_recalculate_thumbnails) {
 		// Check if thumbnails is older than the (local) image file
 		QString filenameLocal = localFilePath(qPrintable(picture_filename));
 		QFileInfo pictureInfo(filenameLocal);
-		QFileInfo thumbnailInfo(file);
-		if (pictureInfo.exists() && thumbnailInfo.exists()) {
+		if (pictureInfo.exists()) {
 			QDateTime pictureTime = pictureInfo.lastModified();
-			QDateTime thumbnailTime = thumbnailInfo.lastModified();
-			if (pictureTime.isValid() && thumbnailTime.isValid() && thumbnailTime < pictureTime) {
-				// Both files exist, have valid timestamps and thumbnail was calculated before picture.
+			if (pictureTime.isValid() && entry->created < pictureTime.toMSecsSinceEpoch()) {
+				// Picture exists, has a valid timestamp and thumbnail was calculated before picture.
 				// Return an empty thumbnail to signal recalculation of the thumbnail
 				return { QImage(), MEDIATYPE_UNKNOWN, zero_duration };
 			}
 		}
 	}
 
-	if (!file.open(QIODevice::ReadOnly))
-		return { QImage(), MEDIATYPE_UNKNOWN, zero_duration };
-	QDataStream stream(&file);
+	QDataStream stream(entry->data);
 
-	// Each thumbnail file is composed of a media-type and an image file.
+	// Each thumbnail is composed of a media-type and an image file.
 	quint32 type;
-	QImage res;
 	stream >> type;
 
 	switch (type) {
@@ -276,6 +294,12 @@ Thumbnailer::Thumbnail Thumbnailer::getThumbnailFromCache(const QString &picture
 	}
 }
 
+void Thumbnailer::addThumbnailToCache(const QString &picture_filename, const QByteArray &data)
+{
+	if (!picture_filename.isEmpty())
+		store.put(picture_filename, data, QDateTime::currentMSecsSinceEpoch());
+}
+
 Thumbnailer::Thumbnail Thumbnailer::addVideoThumbnailToCache(const QString &picture_filename, duration_t duration,
 							     const QImage &image, duration_t position)
 {
@@ -286,26 +310,23 @@ Thumbnailer::Thumbnail Thumbnailer::addVideoThumbnailToCache(const QString &pict
 	//	for each picture:
 	//		uint32	offset in msec from begining of video
 	//		QImage	frame
-	QString filename = thumbnailFileName(picture_filename);
-	QSaveFile file(filename);
-	if (file.open(QIODevice::WriteOnly)) {
-		QDataStream stream(&file);
+	QByteArray data;
+	QDataStream stream(&data, QIODevice::WriteOnly);
 
-		stream << (quint32)MEDIATYPE_VIDEO;
-		stream << (quint32)duration.seconds;
+	stream << (quint32)MEDIATYPE_VIDEO;
+	stream << (quint32)duration.seconds;
 
-		if (image.isNull()) {
-			// No image provided
-			stream << (quint32)0;
-		} else {
-			// Currently, we support at most one image
-			stream << (quint32)1;
-			stream << (quint32)position.seconds;
-			stream << image;
-		}
-
-		file.commit();
+	if (image.isNull()) {
+		// No image provided
+		stream << (quint32)0;
+	} else {
+		// Currently, we support at most one image
+		stream << (quint32)1;
+		stream << (quint32)position.seconds;
+		stream << image;
 	}
+
+	addThumbnailToCache(picture_filename, data);
 	return { videoImage, MEDIATYPE_VIDEO, duration };
 }
 
@@ -328,26 +349,20 @@ Thumbnailer::Thumbnail Thumbnailer::addPictureThumbnailToCache(const QString &pi
 	// The format of a picture-thumbnail is very simple:
 	// 	uint32	MEDIATYPE_PICTURE
 	// 	QImage	thumbnail
-	QString filename = thumbnailFileName(picture_filename);
-	QSaveFile file(filename);
-	if (file.open(QIODevice::WriteOnly)) {
-		QDataStream stream(&file);
-
-		stream << (quint32)MEDIATYPE_PICTURE;
-		stream << thumbnail;
-		file.commit();
-	}
+	QByteArray data;
+	QDataStream stream(&data, QIODevice::WriteOnly);
+	stream << (quint32)MEDIATYPE_PICTURE;
+	stream << thumbnail;
+	addThumbnailToCache(picture_filename, data);
 	return { thumbnail, MEDIATYPE_PICTURE, zero_duration };
 }
 
 Thumbnailer::Thumbnail Thumbnailer::addUnknownThumbnailToCache(const QString &picture_filename)
 {
-	QString filename = thumbnailFileName(picture_filename);
-	QSaveFile file(filename);
-	if (file.open(QIODevice::WriteOnly)) {
-		QDataStream stream(&file);
-		stream << (quint32)MEDIATYPE_UNKNOWN;
-	}
+	QByteArray data;
+	QDataStream stream(&data, QIODevice::WriteOnly);
+	stream << (quint32)MEDIATYPE_UNKNOWN;
+	addThumbnailToCache(picture_filename, data);
 	return { unknownImage, MEDIATYPE_UNKNOWN, zero_duration };
 }
 
@@ -406,8 +421,26 @@ void Thumbnailer::recalculate(QString filename)
 
 void Thumbnailer::processItem(QString filename, bool tryDownload)
 {
-	Thumbnail thumbnail = getThumbnailFromCache(filename);
+	processThumbnail(filename, getThumbnailFromCache(filename), tryDownload);
+}
+
+void Thumbnailer::processItems(const QVector<QString> &filenames, int gen)
+{
+	std::vector<std::optional<ThumbnailStore::Entry>> entries = store.get(filenames);
+	for (int i = 0; i < filenames.size(); ++i) {
+		{
+			// Stop if the work queue was cleared in the meantime
+			QMutexLocker l(&lock);
+			if (gen != generation)
+				return;
+		}
+		processThumbnail(filenames[i], getThumbnailFromEntry(filenames[i], std::move(entries[i])), true);
+	}
+}
 
+// Send the thumbnail fetched from the cache. If there was none, create it.
+void Thumbnailer::processThumbnail(const QString &filename, Thumbnail thumbnail, bool tryDownload)
+{
 	if (thumbnail.img.isNull()) {
 		thumbnail = getHashedImage(filename, tryDownload);
 		if (thumbnail.type == MEDIATYPE_STILL_LOADING)
@@ -467,6 +500,25 @@ QImage Thumbnailer::fetchThumbnail(const QString &filename, bool synchronous)
 	return dummyImage;
 }
 
+QVector<QImage> Thumbnailer::fetchThumbnails(const QVector<QString> &filenames)
+{
+	QMutexLocker l(&lock);
+
+	// Fetch the thumbnails that we are not currently fetching in one go.
+	QVector<QString> todo;
+	for (const QString &filename: filenames) {
+		if (!workingOn.contains(filename))
+			todo.push_back(filename);
+	}
+	if (!todo.isEmpty()) {
+		int gen = generation;
+		QFuture<void> future = QtConcurrent::run(&pool, [this, todo, gen]() { processItems(todo, gen); });
+		for (const QString &filename: todo)
+			workingOn.insert(filename, future);
+	}
+	return QVector<QImage>(filenames.size(), dummyImage);
+}
+
 void Thumbnailer::calculateThumbnails(const QVector<QString> &filenames)
 {
 	QMutexLocker l(&lock);
@@ -488,6 +540,7 @@ void Thumbnailer::clearWorkQueue()
 	for (auto it = workingOn.begin(); it != workingOn.end(); ++it)
 		it->cancel();
 	workingOn.clear();
+	++generation;
 }
 
 static const int maxZoom = 3;	// Maximum zoom: thrice of standard size
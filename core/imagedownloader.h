@@ -3,6 +3,7 @@
 #define IMAGEDOWNLOADER_H
 
 #include "metadata.h"
+#include "thumbnailstore.h"
 #include <QImage>
 #include <QFuture>
 #include <QNetworkReply>
@@ -39,6 +40,10 @@ public:
 	// images are not supported.
 	QImage fetchThumbnail(const QString &filename, bool synchronous);
 
+	// Schedule multiple thumbnails for fetching. Returns placeholder thumbnails.
+	// The thumbnails are looked up in the cache in one go and sent via signals.
+	QVector<QImage> fetchThumbnails(const QVector<QString> &filenames);
+
 	// Schedule multiple thumbnails for forced recalculation
 	void calculateThumbnails(const QVector<QString> &filenames);
 
@@ -70,7 +75,12 @@ private:
 	Thumbnail addUnknownThumbnailToCache(const QString &picture_filename);
 	void recalculate(QString filename);
 	void processItem(QString filename, bool tryDownload);
+	void processItems(const QVector<QString> &filenames, int generation);
+	void processThumbnail(const QString &filename, Thumbnail thumbnail, bool tryDownload);
 	Thumbnail getThumbnailFromCache(const QString &picture_filename);
+	Thumbnail getThumbnailFromEntry(const QString &picture_filename, std::optional<ThumbnailStore::Entry> entry);
+	std::optional<ThumbnailStore::Entry> importThumbnailFile(const QString &picture_filename);
+	void addThumbnailToCache(const QString &picture_filename, const QByteArray &data);
 	Thumbnail getPictureThumbnailFromStream(QDataStream &stream);
 	Thumbnail getVideoThumbnailFromStream(QDataStream &stream, const QString &filename);
 	Thumbnail fetchImage(const QString &filename, const QString &originalFilename, bool tryDownload);
@@ -86,6 +96,8 @@ private:
 	QImage unknownImage;		// Place holder for files where we couldn't determine the type
 
 	QMap<QString,QFuture<void>> workingOn;
+	int generation;			// Incremented when the work queue is cleared
+	ThumbnailStore store;
 };
 
 #endif // IMAGEDOWNLOADER_H
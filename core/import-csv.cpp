@@ -1,6 +1,12 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <map>
+#include <vector>
 #include <libdivecomputer/parser.h>
 
 #include "dive.h"
@@ -270,6 +276,738 @@ static int parse_dan_format(const char *filename, struct xml_params *params, str
 	return ret;
 }
 
+/*
+ * Native reader for the generic "csv" template.
+ *
+ * Transforming a CSV file with csv2xml.xslt is slow, because the stylesheet
+ * recurses over the rest of the file for every line, and the transformation
+ * gives up on long recordings once the recursion limit is reached. Therefore,
+ * files in this format are read directly into the dive. The code mirrors the
+ * stylesheet and the way parse-xml.cpp interprets its output, quirks included,
+ * so that both ways give the same dives.
+ *
+ * The parameters of the stylesheet are XPath expressions. Only numbers and
+ * string literals are evaluated here, anything else is left to the XSLT path.
+ */
+namespace {
+struct csv_param {
+	double num;		// number($param)
+	std::string str;	// string($param)
+	bool is_string;
+};
+using csv_params = std::map<std::string, csv_param>;
+
+/* The starts of the first fields of a line */
+struct csv_line {
+	const char *begin, *end;
+	std::vector<const char *> fields;
+	void split(const char *b, const char *e, char fs, int count);
+	void get(int index, char fs, std::string &res) const;
+};
+}
+
+static bool xpath_blank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool xpath_is_blank(const std::string &s)
+{
+	return std::all_of(s.begin(), s.end(), xpath_blank);
+}
+
+static bool xpath_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+/*
+ * number() as implemented by libxml2. If comma is set, ',' is accepted
+ * as decimal separator, i.e. this is number(translate($s, ',', '.')).
+ */
+static double xpath_number(const char *p, const char *end, bool comma = false)
+{
+	double ret = 0.0;
+	bool ok = false, neg = false, neg_exponent = false;
+	int exponent = 0;
+
+	while (p < end && xpath_blank(*p))
+		p++;
+	if (p == end || (!xpath_digit(*p) && *p != '.' && *p != '-' && !(comma && *p == ',')))
+		return NAN;
+	if (*p == '-') {
+		neg = true;
+		p++;
+	}
+	for (; p < end && xpath_digit(*p); p++) {
+		ret = ret * 10 + (*p - '0');
+		ok = true;
+	}
+	if (p < end && (*p == '.' || (comma && *p == ','))) {
+		int frac = 0, max_frac;
+		double fraction = 0.0;
+
+		p++;
+		if ((p == end || !xpath_digit(*p)) && !ok)
+			return NAN;
+		for (; p < end && *p == '0'; p++)
+			frac++;
+		max_frac = frac + 20;
+		for (; p < end && xpath_digit(*p) && frac < max_frac; p++) {
+			fraction = fraction * 10 + (*p - '0');
+			frac++;
+		}
+		ret += fraction / pow(10.0, frac);
+		while (p < end && xpath_digit(*p))
+			p++;
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		if (p < end && *p == '-') {
+			neg_exponent = true;
+			p++;
+		} else if (p < end && *p == '+') {
+			p++;
+		}
+		for (; p < end && xpath_digit(*p); p++) {
+			if (exponent < 1000000)
+				exponent = exponent * 10 + (*p - '0');
+		}
+	}
+	while (p < end && xpath_blank(*p))
+		p++;
+	if (p != end)
+		return NAN;
+	if (neg)
+		ret = -ret;
+	if (neg_exponent)
+		exponent = -exponent;
+	return ret * pow(10.0, exponent);
+}
+
+static double xpath_number(const std::string &s, bool comma = false)
+{
+	return xpath_number(s.data(), s.data() + s.size(), comma);
+}
+
+/* string() of a number as implemented by libxml2 */
+static std::string xpath_string(double v)
+{
+	char buf[100];
+	bool scientific = false;
+
+	if (std::isnan(v))
+		return "NaN";
+	if (std::isinf(v))
+		return v > 0 ? "Infinity" : "-Infinity";
+	if (v == 0.0)
+		return "0";
+	if (v > INT_MIN && v < INT_MAX && v == (int)v) {
+		snprintf(buf, sizeof(buf), "%d", (int)v);
+		return buf;
+	}
+	if (fabs(v) > 1e9 || fabs(v) < 1e-5) {
+		snprintf(buf, sizeof(buf), "%*.*e", DBL_DIG + 6, DBL_DIG - 1, v);
+		scientific = true;
+	} else {
+		int integer_place = (int)log10(fabs(v));
+		int fraction_place = integer_place > 0 ? DBL_DIG - integer_place - 1 : DBL_DIG - integer_place;
+		snprintf(buf, sizeof(buf), "%0.*f", fraction_place, v);
+	}
+
+	// Remove leading spaces and trailing zeros of the fraction
+	std::string res(buf + strspn(buf, " "));
+	size_t fraction_end = scientific ? res.find('e') : res.size();
+	size_t pos = fraction_end - 1;
+	while (res[pos] == '0')
+		pos--;
+	if (res[pos] != '.')
+		pos++;
+	res.erase(pos, fraction_end - pos);
+	return res;
+}
+
+/* number(string($v)): a computed number that is passed to a template as text */
+static double xpath_string_number(double v)
+{
+	if (v > INT_MIN && v < INT_MAX && v == (int)v)
+		return v;
+	return xpath_number(xpath_string(v));
+}
+
+/* round() of XPath */
+static double xpath_round(double v)
+{
+	if (v >= -0.5 && v < 0.5)
+		return v * 0.0;
+	double rounded = floor(v);
+	if (v - rounded >= 0.5)
+		rounded += 1.0;
+	return rounded;
+}
+
+/* substring-before() and substring-after() of XPath. Note that an empty pattern is found at the start. */
+static std::string xpath_before(const std::string &s, const std::string &pattern)
+{
+	size_t pos = s.find(pattern);
+	return pos == std::string::npos ? std::string() : s.substr(0, pos);
+}
+
+static std::string xpath_after(const std::string &s, const std::string &pattern)
+{
+	size_t pos = s.find(pattern);
+	return pos == std::string::npos ? std::string() : s.substr(pos + pattern.size());
+}
+
+/* substring() of XPath with a one-based start */
+static std::string xpath_substring(const std::string &s, size_t start, size_t length)
+{
+	return start - 1 < s.size() ? s.substr(start - 1, length) : std::string();
+}
+
+/* The digits of an integer as written by format-number() of libxslt, at least width of them */
+static std::string xslt_format_digits(double number, int width)
+{
+	std::string res;
+	for (int i = 0; i < 500 && (i < width || fabs(number) >= 1.0); i++) {
+		res.insert(res.begin(), (char)('0' + (int)fmod(number, 10.0)));
+		number /= 10.0;
+	}
+	return res;
+}
+
+/* format-number() of libxslt for the patterns of the stylesheet ('#', '00', '0.0' and '0.00') */
+static std::string xslt_format_number(double v, int integer_digits, int decimals)
+{
+	if (std::isnan(v))
+		return "NaN";
+	if (std::isinf(v))
+		return v > 0.0 ? "Infinity" : "-Infinity";
+	double scale = pow(10.0, decimals);
+	double number = floor(fabs(v) * scale + 0.5) / scale;
+	std::string res = v < 0.0 ? "-" : "";
+	res += xslt_format_digits(floor(number), decimals > 0 ? integer_digits : std::max(integer_digits, 1));
+	if (decimals > 0)
+		res += "." + xslt_format_digits(floor(scale * (number - floor(number)) + 0.5), decimals);
+	return res;
+}
+
+/* Skip the separators as the getFieldByIndex template does: while the index is positive */
+static int csv_skip(double index)
+{
+	return index > 0 ? (int)std::min(ceil(index), 1000000.0) : 0;
+}
+
+/* The unquote template: within a quoted field, a doubled quote is a quote */
+static void csv_unquote(std::string field, std::string &res)
+{
+	std::string value;
+
+	for (;;) {
+		const char *quote = value.empty() ? "" : "\"";
+		size_t pos = field.find('"');
+		if (pos == std::string::npos || pos == 0) {
+			res = value + quote + field;
+			return;
+		}
+		value = value + quote + field.substr(0, pos);
+		pos = field.find('"', pos + 1);
+		field = pos == std::string::npos ? std::string() : field.substr(pos + 1);
+	}
+}
+
+/* As in the stylesheet, quotes are not taken into account when looking for separators */
+void csv_line::split(const char *b, const char *e, char fs, int count)
+{
+	begin = b;
+	end = e;
+	fields.clear();
+	fields.push_back(b);
+	for (int i = 0; i < count && b; i++) {
+		b = (const char *)memchr(b, fs, e - b);
+		if (b)
+			fields.push_back(++b);
+	}
+}
+
+/* The getFieldByIndex template. The line must have been split at least index times. */
+void csv_line::get(int index, char fs, std::string &res) const
+{
+	if ((size_t)index >= fields.size()) {
+		res.clear();
+		return;
+	}
+	const char *p = fields[index];
+	if (p < end && *p == '"') {
+		const char *rest = p + 1;
+
+		// The field ends with a quote followed by a separator
+		const char *close = rest;
+		while ((close = (const char *)memchr(close, '"', end - close)) != NULL) {
+			if (close + 1 < end && close[1] == fs)
+				break;
+			close++;
+		}
+		std::string field = close ? std::string(rest, close) : std::string();
+		size_t quote = field.find('"');
+		if (quote != std::string::npos && quote > 0) {
+			csv_unquote(std::move(field), res);
+		} else if (end[-1] == '"') {
+			const char *q = (const char *)memchr(rest, '"', end - rest);
+			res.assign(rest, q ? q : rest);
+		} else {
+			res = std::move(field);
+		}
+		return;
+	}
+	const char *sep = (const char *)memchr(p, fs, end - p);
+	res.assign(p, sep ? sep : end);
+}
+
+/* The XML parser turns "\r\n" and "\r" into "\n" */
+static void csv_normalize_newlines(std::string &mem)
+{
+	size_t pos = mem.find('\r');
+	if (pos == std::string::npos)
+		return;
+	char *out = mem.data() + pos;
+	const char *end = mem.data() + mem.size();
+	for (const char *in = out; in < end; in++) {
+		if (*in == '\r') {
+			*out++ = '\n';
+			if (in + 1 < end && in[1] == '\n')
+				in++;
+		} else {
+			*out++ = *in;
+		}
+	}
+	mem.resize(out - mem.data());
+}
+
+/*
+ * The sec2time template: "minutes:seconds", read by sampletime(). As that is
+ * the common case, small times are converted directly, which gives the same
+ * result.
+ */
+static void csv_sec2time(double t, duration_t *time)
+{
+	if (std::isfinite(t) && fabs(t) < 1e9) {
+		double seconds = floor(fabs(fmod(t, 60)) + 0.5);
+		time->seconds = (int)floor(t / 60) * 60 + (int)(t < 0.0 ? -seconds : seconds);
+		return;
+	}
+	std::string buf = xpath_string(floor(t / 60)) + ":" + xslt_format_number(fmod(t, 60), 2, 0);
+	sampletime(buf.c_str(), time);
+}
+
+/* The time of a sample as written by the printFields template. Returns false if the line is not a sample. */
+static bool csv_sample_time(const std::string &value, bool apd, duration_t *time)
+{
+	if (!std::isnan(xpath_number(value, true))) {
+		// Seconds, or minutes with a decimal fraction
+		std::string fraction = xpath_after(value, ".");
+		if (!fraction.empty() && !apd)
+			csv_sec2time(xpath_string_number(xpath_number(xpath_before(value, ".")) * 60 + xpath_number("." + fraction) * 60), time);
+		else if (!(fraction = xpath_after(value, ",")).empty())
+			csv_sec2time(xpath_string_number(xpath_number(xpath_before(value, ",")) * 60 + xpath_number("." + fraction) * 60), time);
+		else
+			csv_sec2time(xpath_number(value), time);
+		return true;
+	}
+	std::string minutes = xpath_before(value, ":");
+	if (std::isnan(xpath_number(minutes)))
+		return false;
+	std::string rest = xpath_after(value, ":");
+	std::string buf;
+	if (xpath_after(rest, ":").empty())
+		buf = xpath_string(xpath_number(minutes) * 60 + xpath_number(rest));
+	else
+		buf = xpath_string(xpath_number(minutes) * 60 + xpath_number(xpath_before(rest, ":"))) + ":" + xpath_after(rest, ":");
+	sampletime(buf.c_str(), time);
+	return true;
+}
+
+/* translate($s, translate($s, '0123456789,.', ''), '') with ',' turned into '.' */
+static double csv_imperial_number(const std::string &s)
+{
+	std::string digits;
+	for (char c: s) {
+		if (xpath_digit(c) || c == '.')
+			digits += c;
+		else if (c == ',')
+			digits += '.';
+	}
+	return xpath_number(digits);
+}
+
+static std::string csv_feet_to_m(const std::string &s)
+{
+	return xpath_string(xpath_round(csv_imperial_number(s) * 0.3048 * 1000) / 1000);
+}
+
+static std::string csv_fahrenheit_to_c(const std::string &s)
+{
+	return xslt_format_number((csv_imperial_number(s) - 32) * 5 / 9, 1, 1) + " C";
+}
+
+/* A depth or temperature of the header or a sample. Metric values are taken as they are. */
+static void csv_depth(std::string &value, bool metric, depth_t *res, struct parser_state *state)
+{
+	if (!metric) {
+		depth(csv_feet_to_m(value).c_str(), res, state);
+		return;
+	}
+	std::replace(value.begin(), value.end(), ',', '.');
+	if (!xpath_is_blank(value))
+		depth(value.c_str(), res, state);
+}
+
+static void csv_temperature(std::string &value, bool metric, temperature_t *res, struct parser_state *state)
+{
+	if (!metric) {
+		temperature(csv_fahrenheit_to_c(value).c_str(), res, state);
+		return;
+	}
+	std::replace(value.begin(), value.end(), ',', '.');
+	if (!xpath_is_blank(value))
+		temperature(value.c_str(), res, state);
+}
+
+static bool csv_param_value(const char *value, csv_param &param)
+{
+	const char *end = value + strlen(value);
+
+	while (xpath_blank(*value))
+		value++;
+	while (end > value && xpath_blank(end[-1]))
+		end--;
+
+	// A string literal
+	if (end - value >= 2 && (*value == '"' || *value == '\'') && end[-1] == *value &&
+	    !memchr(value + 1, *value, end - value - 2)) {
+		param.str.assign(value + 1, end - 1);
+		param.num = xpath_number(param.str);
+		param.is_string = true;
+		return true;
+	}
+
+	// A number: [-]digits[.digits]
+	const char *p = value;
+	bool digits = false, dot = false;
+	if (p < end && *p == '-')
+		p++;
+	for (; p < end; p++) {
+		if (xpath_digit(*p))
+			digits = true;
+		else if (*p == '.' && !dot)
+			dot = true;
+		else
+			return false;
+	}
+	if (!digits)
+		return false;
+	param.num = xpath_number(value, end);
+	param.str = xpath_string(param.num);
+	param.is_string = false;
+	return true;
+}
+
+/* Returns false if a parameter is an expression that is not supported. If a parameter is given twice, the first one wins. */
+static bool get_csv_params(const struct xml_params *params, csv_params &res)
+{
+	for (int i = 0; i < xml_params_count(params); i++) {
+		csv_param param;
+		if (!csv_param_value(xml_params_get_value(params, i), param))
+			return false;
+		res.insert({ xml_params_get_key(params, i), std::move(param) });
+	}
+	return true;
+}
+
+static int parse_csv_buffer(const char *filename, std::string &mem, const csv_params &params, struct divelog *log)
+{
+	auto num = [&params](const char *key) {
+		auto it = params.find(key);
+		return it != params.end() ? it->second.num : NAN;
+	};
+	auto str = [&params](const char *key) {
+		auto it = params.find(key);
+		return it != params.end() ? it->second.str : std::string();
+	};
+
+	if (mem.empty())
+		return report_error(translate("gettextFromC", "Failed to parse '%s'"), filename);
+	csv_normalize_newlines(mem);
+	if (xpath_is_blank(mem))
+		mem.clear();
+
+	double separator = num("separatorIndex");
+	char fs = separator == 0 ? '\t' : separator == 2 ? ';' : separator == 3 ? '|' : ',';
+	bool metric = num("units") == 0;
+	double delta = num("delta");
+	std::string hw = str("hw");
+	bool apd = hw.find("APD") != std::string::npos;
+
+	double time_field = num("timeField");
+	double depth_field = num("depthField");
+	double temp_field = num("tempField");
+	double po2_field = num("setpointField") >= 0 ? num("setpointField") : num("po2Field");
+	double sensor_field[] = { num("o2sensor1Field"), num("o2sensor2Field"), num("o2sensor3Field") };
+	double cns_field = num("cnsField");
+	double ndl_field = num("ndlField");
+	double tts_field = num("ttsField");
+	double stopdepth_field = num("stopdepthField");
+	double pressure_field = num("pressureField");
+	double heartbeat_field = num("heartBeat");
+	bool ccr = po2_field >= 0 || sensor_field[0] >= 0 || sensor_field[1] >= 0 || sensor_field[2] >= 0;
+
+	int max_skip = 0;
+	for (double field: { time_field, depth_field, temp_field, po2_field, sensor_field[0], sensor_field[1], sensor_field[2],
+			     cns_field, ndl_field, tts_field, stopdepth_field, pressure_field, heartbeat_field })
+		max_skip = std::max(max_skip, csv_skip(field));
+
+	const char *begin = mem.data(), *end = begin + mem.size();
+
+	// The date, time and number of the dive are taken from the text after the second line feed
+	const char *header = begin;
+	for (int i = 0; i < 2 && header; i++) {
+		header = (const char *)memchr(header, '\n', end - header);
+		if (header)
+			header++;
+	}
+	auto header_field = [header, end, fs](double index) {
+		csv_line line;
+		std::string res;
+		line.split(header ? header : end, end, fs, csv_skip(index));
+		line.get(csv_skip(index), fs, res);
+		return res;
+	};
+
+	std::string date;
+	if (num("dateField") >= 0) {
+		std::string indate = header_field(num("dateField"));
+		std::string sep;
+		for (const char *s: { ".", "-", "/" }) {
+			if (!xpath_before(indate, s).empty()) {
+				sep = s;
+				break;
+			}
+		}
+		std::string first = xpath_before(indate, sep);
+		std::string second = xpath_before(xpath_after(indate, sep), sep);
+		std::string third = xpath_after(xpath_after(indate, sep), sep);
+		double datefmt = num("datefmt");
+		if (datefmt == 0)
+			date = third + '-' + second + '-' + first;
+		else if (datefmt == 1)
+			date = third + '-' + first + '-' + second;
+		else if (datefmt == 2)
+			date = first + '-' + second + '-' + third;
+		else
+			date = "1900-1-1";
+		date.erase(std::remove(date.begin(), date.end(), ' '), date.end());
+	} else {
+		std::string d = str("date");
+		date = xpath_substring(d, 1, 4) + '-' + xpath_substring(d, 5, 2) + '-' + xpath_substring(d, 7, 2);
+	}
+
+	std::string starttime;
+	if (num("starttimeField") >= 0) {
+		starttime = header_field(num("starttimeField"));
+	} else {
+		std::string t = str("time");
+		starttime = xpath_substring(t, 2, 2) + ':' + xpath_substring(t, 4, 2);
+	}
+
+	std::string number;
+	if (num("numberField") >= 0)
+		number = header_field(num("numberField"));
+	if (!str("diveNro").empty())
+		number = str("diveNro");
+
+	// The stylesheet writes version 2 of the data format
+	last_xml_version = 2;
+	report_datafile_version(last_xml_version);
+
+	struct parser_state state;
+	state.log = log;
+	state.xml_parsing_units = SI_units;
+	dive_start(&state);
+	{
+		deferred_fixups fixups;
+		struct dive *dive = state.cur_dive;
+
+		if (!xpath_is_blank(date))
+			divedate(date.c_str(), &dive->when, &state);
+		if (!xpath_is_blank(starttime))
+			divetime(starttime.c_str(), &dive->when, &state);
+		if (!xpath_is_blank(number))
+			dive->number = atoi(number.c_str());
+
+		// If the dive is CCR, create oxygen and diluent cylinders
+		if (ccr) {
+			cylinder_t *cyl = cylinder_start(&state);
+			utf8_string("oxygen", (char **)&cyl->type.description);
+			cyl->gasmix.o2.permille = 1000;
+			cyl->cylinder_use = OXYGEN;
+			state.o2pressure_sensor = dive->cylinders.nr - 1;
+			cylinder_end(&state);
+
+			cyl = cylinder_start(&state);
+			utf8_string("diluent", (char **)&cyl->type.description);
+			cyl->gasmix.o2.permille = 210;
+			cyl->cylinder_use = DILUENT;
+			cylinder_end(&state);
+		}
+
+		divecomputer_start(&state);
+		struct divecomputer *dc = state.cur_dc;
+
+		std::string model = !hw.empty() ? hw : "Imported from CSV";
+		if (!xpath_is_blank(model))
+			utf8_string(model.c_str(), (char **)&dc->model);
+		if (ccr)
+			dc->no_o2sensors = (sensor_field[0] >= 0) + (sensor_field[1] >= 0) + (sensor_field[2] >= 0);
+
+		// Seabear specific dive modes replace the dive type. "OC" gives an empty type, which is ignored.
+		const char *dctype = ccr ? "CCR" : "";
+		auto mode = params.find("diveMode");
+		if (mode != params.end() && mode->second.is_string) {
+			const std::string &s = mode->second.str;
+			if (s == "APNEA")
+				dctype = "Freedive";
+			else if (s == "CCR" || s == "CCR SENSORBOARD")
+				dctype = "CCR";
+			else if (s == "OC")
+				dctype = "";
+		}
+		if (!strcmp(dctype, "CCR"))
+			dc->divemode = CCR;
+		else if (!strcmp(dctype, "Freedive"))
+			dc->divemode = FREEDIVE;
+
+		static const struct {
+			const char *param, *key;
+		} extra_data[] = {
+			{ "Firmware", "Firmware version" },
+			{ "Serial", "Serial number" },
+			{ "GF", "Gradient factors" }
+		};
+		for (auto [param, key]: extra_data) {
+			std::string value;
+			utf8_string_std(str(param).c_str(), &value);
+			if (!value.empty())
+				add_extra_data(dc, key, value.c_str());
+		}
+
+		std::string value, next_value;
+		if (!(value = str("maxDepth")).empty())
+			csv_depth(value, metric, &dc->maxdepth, &state);
+		if (!(value = str("meanDepth")).empty())
+			csv_depth(value, metric, &dc->meandepth, &state);
+		if (!(value = str("airTemp")).empty())
+			csv_temperature(value, metric, &dc->airtemp, &state);
+		if (!(value = str("waterTemp")).empty())
+			csv_temperature(value, metric, &dc->watertemp, &state);
+
+		// Only lines terminated by a line feed are read. Lines that are identical
+		// to the next line are skipped. With a sample interval, the time field of
+		// the next line must be different too.
+		csv_line line, next;
+		const char *p = begin, *q, *next_nl;
+		int lineno = 1;
+		for (const char *nl = (const char *)memchr(p, '\n', end - p); nl; lineno++, p = q, nl = next_nl) {
+			q = nl + 1;
+			next_nl = (const char *)memchr(q, '\n', end - q);
+			// An unterminated last line counts as empty
+			const char *next_line_end = next_nl ? next_nl : q;
+			if (nl - p == next_line_end - q && !memcmp(p, q, nl - p))
+				continue;
+
+			line.split(p, nl, fs, max_skip);
+			duration_t sample_time;
+			if (delta > 0) {
+				line.get(csv_skip(time_field), fs, value);
+				next.split(q, next_line_end, fs, csv_skip(time_field));
+				next.get(csv_skip(time_field), fs, next_value);
+				if (value == next_value)
+					continue;
+				csv_sec2time(xpath_string_number(lineno * delta), &sample_time);
+			} else {
+				line.get(csv_skip(time_field), fs, value);
+				if (!csv_sample_time(value, apd, &sample_time))
+					continue;
+			}
+
+			sample_start(&state);
+			struct sample *sample = state.cur_sample;
+			sample->time = sample_time;
+
+			line.get(csv_skip(depth_field), fs, value);
+			csv_depth(value, metric, &sample->depth, &state);
+
+			if (temp_field >= 0) {
+				line.get(csv_skip(temp_field), fs, value);
+				if (!value.empty())
+					csv_temperature(value, metric, &sample->temperature, &state);
+			}
+			if (po2_field >= 0) {
+				line.get(csv_skip(po2_field), fs, value);
+				if (!xpath_is_blank(value))
+					sample->setpoint.mbar = lrint(ascii_strtod(value.c_str(), NULL) * 1000.0);
+			}
+			for (int i = 0; i < 3; i++) {
+				if (!(sensor_field[i] >= 0))
+					continue;
+				line.get(csv_skip(sensor_field[i]), fs, value);
+				if (!xpath_is_blank(value))
+					sample->o2sensor[i].mbar = lrint(ascii_strtod(value.c_str(), NULL) * 1000.0);
+			}
+			if (cns_field >= 0) {
+				line.get(csv_skip(cns_field), fs, value);
+				if (!xpath_is_blank(value))
+					sample->cns = atoi(value.c_str());
+			}
+			if (ndl_field >= 0) {
+				line.get(csv_skip(ndl_field), fs, value);
+				if (!xpath_is_blank(value))
+					sampletime(value.c_str(), &sample->ndl);
+			}
+			if (tts_field >= 0) {
+				line.get(csv_skip(tts_field), fs, value);
+				if (!xpath_is_blank(value))
+					sampletime(value.c_str(), &sample->tts);
+			}
+			if (stopdepth_field >= 0) {
+				line.get(csv_skip(stopdepth_field), fs, value);
+				if (!metric)
+					depth(xslt_format_number(xpath_number(value) * 0.3048, 1, 2).c_str(), &sample->stopdepth, &state);
+				else if (!xpath_is_blank(value))
+					depth(value.c_str(), &sample->stopdepth, &state);
+				sample->in_deco = xpath_number(value) > 0;
+			}
+			if (pressure_field >= 0) {
+				line.get(csv_skip(pressure_field), fs, value);
+				double val = xpath_number(value);
+				if (val >= 0 && metric)
+					pressure(value.c_str(), &sample->pressure[0], &state);
+				else if (val >= 0)
+					pressure(xslt_format_number(val / 14.5037738007, 0, 0).c_str(), &sample->pressure[0], &state);
+			}
+			if (heartbeat_field >= 0) {
+				line.get(csv_skip(heartbeat_field), fs, value);
+				if (!xpath_is_blank(value))
+					sample->heartbeat = atoi(value.c_str());
+			}
+			sample_end(&state);
+		}
+
+		divecomputer_end(&state);
+		dive_end(&state);
+	}
+	return 0;
+}
+
 extern "C" int parse_csv_file(const char *filename, struct xml_params *params, const char *csvtemplate, struct divelog *log)
 {
 	int ret;
@@ -303,6 +1041,14 @@ extern "C" int parse_csv_file(const char *filename, struct xml_params *params, c
 		xml_params_add(params, "time", tmpbuf);
 	}
 
+	csv_params csv;
+	if (!strcmp(csvtemplate, "csv") && get_csv_params(params, csv)) {
+		auto [data, err] = readfile(filename);
+		if (err < 0)
+			return report_error(translate("gettextFromC", "Failed to read '%s'"), filename);
+		return parse_csv_buffer(filename, data, csv, log);
+	}
+
 	if (try_to_xslt_open_csv(filename, mem, csvtemplate))
 		return -1;
 
@@ -881,6 +1627,10 @@ static int parse_seabear_csv_file(const char *filename, struct xml_params *param
 	memmove(mem.data(), ptr_old, mem.size() - (ptr_old - mem.data()));
 	mem.resize(mem.size() - (ptr_old - mem.data()));
 
+	csv_params csv;
+	if (!strcmp(csvtemplate, "csv") && get_csv_params(params, csv))
+		return parse_csv_buffer(filename, mem, csv, log);
+
 	if (try_to_xslt_open_csv(filename, mem, csvtemplate))
 		return -1;
 
@@ -14,7 +14,6 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include "gettext.h"
-#include "divelog.h"
 #include "divesite.h"
 #include "sample.h"
 #include "subsurface-float.h"
@@ -22,6 +21,7 @@
 #include "format.h"
 #include "device.h"
 #include "dive.h"
+#include "diveindex.h"
 #include "errorhelper.h"
 #include "event.h"
 #include "sha1.h"
@@ -562,15 +562,15 @@ static int match_one_dive(struct divecomputer *a, struct dive *dive)
 }
 
 /*
- * Check if this dive already existed before the import
+ * Check if this dive already existed before the import.
+ *
+ * match_one_dive() only matches dives that have a dive computer with
+ * the same dive ID or the same start time, so it is sufficient to
+ * look at the dives that the index returns for these keys.
  */
 static int find_dive(struct divecomputer *match)
 {
-	int i;
-
-	for (i = divelog.dives->nr - 1; i >= 0; i--) {
-		struct dive *old = divelog.dives->dives[i];
-
+	for (struct dive *old: diveindex_candidates(match)) {
 		if (match_one_dive(match, old))
 			return 1;
 	}
@@ -12,14 +12,18 @@
 #include <git2.h>
 #include <array>
 #include <memory>
+#include <vector>
 #include <libdivecomputer/parser.h>
+#include <QtConcurrent>
 
 #include "gettext.h"
 
 #include "dive.h"
 #include "divelog.h"
 #include "divesite.h"
+#include "divesiteindex.h"
 #include "event.h"
+#include "eventtype.h"
 #include "errorhelper.h"
 #include "sample.h"
 #include "subsurface-string.h"
@@ -29,12 +33,40 @@
 #include "git-access.h"
 #include "picture.h"
 #include "qthelper.h"
+#include "snapshot.h"
 #include "tag.h"
 #include "subsurface-time.h"
 
 // TODO: Should probably be moved to struct divelog to allow for multi-document
 std::string saved_git_id;
 
+struct git_parser_state;
+
+/*
+ * The dive directories are parsed in parallel. Lines that access the dive
+ * site table or the global tag list are not executed by the parser threads,
+ * but recorded and replayed in order when the dives are added to the log.
+ */
+struct deferred_line {
+	void (*fn)(char *, struct git_parser_state *);
+	std::string line;
+	std::vector<std::string> converted_strings;
+};
+
+struct git_dive_file {
+	enum { DIVE, DIVECOMPUTER, PICTURE } type;
+	git_oid id;
+	std::string name;	// suffix of the dive file or name of the picture file
+};
+
+struct git_dive_dir {
+	struct dive *dive;
+	std::vector<git_dive_file> files;
+	std::vector<deferred_line> deferred_lines;
+	std::vector<event_type> event_types;	// collected while parsing in parallel
+	std::vector<std::string> errors;	// ditto
+};
+
 struct git_parser_state {
 	git_repository *repo = nullptr;
 	struct divecomputer *active_dc = nullptr;
@@ -54,6 +86,10 @@ struct git_parser_state {
 	int o2pressure_sensor = 0;
 	std::vector<std::string> converted_strings;
 	size_t act_converted_string = 0;
+	std::vector<git_dive_dir> dive_dirs;			/* dive directories found by the tree walk */
+	std::vector<deferred_line> *deferred_lines = nullptr;	/* non-null when parsing in parallel */
+	bool snapshot_loaded = false;				/* dives, trips and sites came from the snapshot */
+	bool write_snapshot = false;
 };
 
 struct keyword_action {
@@ -63,6 +99,14 @@ struct keyword_action {
 
 static git_blob *git_tree_entry_blob(git_repository *repo, const git_tree_entry *entry);
 
+static bool defer_line(void (*fn)(char *, struct git_parser_state *), char *line, struct git_parser_state *state)
+{
+	if (!state->deferred_lines)
+		return false;
+	state->deferred_lines->push_back({ fn, line, state->converted_strings });
+	return true;
+}
+
 static temperature_t get_temperature(const char *line)
 {
 	temperature_t t;
@@ -171,6 +215,9 @@ static int get_hex(const char *line)
 
 static void parse_dive_gps(char *line, struct git_parser_state *state)
 {
+	if (defer_line(parse_dive_gps, line, state))
+		return;
+
 	location_t location;
 	struct dive_site *ds = get_dive_site_for_dive(state->active_dive);
 
@@ -195,6 +242,7 @@ static void parse_dive_gps(char *line, struct git_parser_state *state)
 			ds->notes = strdup(new_text.c_str());
 		}
 		ds->location = location;
+		divesiteindex_update(ds);
 	}
 
 }
@@ -219,8 +267,11 @@ static char *get_first_converted_string_c(struct git_parser_state *state)
 	return strdup(get_first_converted_string(state).c_str());
 }
 
-static void parse_dive_location(char *, struct git_parser_state *state)
+static void parse_dive_location(char *line, struct git_parser_state *state)
 {
+	if (defer_line(parse_dive_location, line, state))
+		return;
+
 	std::string name = get_first_converted_string(state);
 	struct dive_site *ds = get_dive_site_for_dive(state->active_dive);
 	if (!ds) {
@@ -257,13 +308,20 @@ static void parse_dive_notes(char *, struct git_parser_state *state)
 { state->active_dive->notes = get_first_converted_string_c(state); }
 
 static void parse_dive_divesiteid(char *line, struct git_parser_state *state)
-{ add_dive_to_dive_site(state->active_dive, get_dive_site_by_uuid(get_hex(line), state->log->sites)); }
+{
+	if (defer_line(parse_dive_divesiteid, line, state))
+		return;
+	add_dive_to_dive_site(state->active_dive, get_dive_site_by_uuid(get_hex(line), state->log->sites));
+}
 
 /*
  * We can have multiple tags.
  */
-static void parse_dive_tags(char *, struct git_parser_state *state)
+static void parse_dive_tags(char *line, struct git_parser_state *state)
 {
+	if (defer_line(parse_dive_tags, line, state))
+		return;
+
 	for  (const std::string &tag: state->converted_strings) {
 		if (!tag.empty())
 			taglist_add_tag(&state->active_dive->tag_list, tag.c_str());
@@ -325,6 +383,7 @@ static void parse_site_notes(char *, struct git_parser_state *state)
 static void parse_site_gps(char *line, struct git_parser_state *state)
 {
 	parse_location(line, &state->active_site->location);
+	divesiteindex_update(state->active_site);
 }
 
 static void parse_site_geo(char *line, struct git_parser_state *state)
@@ -1368,11 +1427,8 @@ static unsigned parse_one_line(const char *buf, unsigned size, line_fn_t *fn, st
  * strings, but the callback function can consume the
  * strings.
  */
-static void for_each_line(git_blob *blob, line_fn_t *fn, struct git_parser_state *state)
+static void for_each_line(const char *content, unsigned int size, line_fn_t *fn, struct git_parser_state *state)
 {
-	const char *content = (const char *)git_blob_rawcontent(blob);
-	unsigned int size = git_blob_rawsize(blob);
-
 	while (size) {
 		state->converted_strings.clear();
 		state->act_converted_string = 0;
@@ -1382,6 +1438,11 @@ static void for_each_line(git_blob *blob, line_fn_t *fn, struct git_parser_state
 	}
 }
 
+static void for_each_line(git_blob *blob, line_fn_t *fn, struct git_parser_state *state)
+{
+	for_each_line((const char *)git_blob_rawcontent(blob), git_blob_rawsize(blob), fn, state);
+}
+
 #define GIT_WALK_OK   0
 #define GIT_WALK_SKIP 1
 
@@ -1395,19 +1456,16 @@ static void finish_active_trip(struct git_parser_state *state)
 	}
 }
 
+/* The dive is recorded after parsing its files, see parse_dive_dirs() */
 static void finish_active_dive(struct git_parser_state *state)
 {
-	struct dive *dive = state->active_dive;
-
-	if (dive) {
-		state->active_dive = NULL;
-		record_dive_to_table(dive, state->log->dives);
-	}
+	state->active_dive = NULL;
 }
 
 static void create_new_dive(timestamp_t when, struct git_parser_state *state)
 {
 	state->active_dive = alloc_dive();
+	state->dive_dirs.push_back({ state->active_dive, {}, {}, {}, {} });
 
 	/* We'll fill in more data from the dive file */
 	state->active_dive->when = when;
@@ -1601,6 +1659,10 @@ static int walk_tree_directory(const char *root, const git_tree_entry *entry, st
 	int digits = 0, len;
 	char c;
 
+	/* Only the settings and filter presets are not part of the snapshot */
+	if (state->snapshot_loaded)
+		return strcmp(name, "02-Filterpresets") ? GIT_WALK_SKIP : GIT_WALK_OK;
+
 	if (!strcmp(name, "Pictures"))
 		return picture_directory(root, name, state);
 
@@ -1676,18 +1738,15 @@ static struct divecomputer *create_new_dc(struct dive *dive)
  * cheap, but the loading of the git blob into memory can be pretty
  * costly.
  */
-static int parse_divecomputer_entry(struct git_parser_state *state, const git_tree_entry *entry, const char *)
+static void parse_divecomputer_entry(struct git_parser_state *state, const char *content, unsigned int size, const git_oid *id)
 {
-	git_blob *blob = git_tree_entry_blob(state->repo, entry);
-
-	if (!blob)
-		return report_error("Unable to read divecomputer file");
-
 	state->active_dc = create_new_dc(state->active_dive);
-	for_each_line(blob, divecomputer_parser, state);
-	git_blob_free(blob);
+	if (!state->active_dc)
+		return;
+	/* Remember the blob, so that an unchanged dive computer is not written again */
+	memcpy(state->active_dc->git_id, id->id, 20);
+	for_each_line(content, size, divecomputer_parser, state);
 	state->active_dc = NULL;
-	return 0;
 }
 
 /*
@@ -1696,19 +1755,14 @@ static int parse_divecomputer_entry(struct git_parser_state *state, const git_tr
  * pictures too. So if any of the dive computers change, the dive cache
  * has to be invalidated too.
  */
-static int parse_dive_entry(struct git_parser_state *state, const git_tree_entry *entry, const char *suffix)
+static void parse_dive_entry(struct git_parser_state *state, const char *content, unsigned int size, const char *suffix)
 {
 	struct dive *dive = state->active_dive;
-	git_blob *blob = git_tree_entry_blob(state->repo, entry);
-	if (!blob)
-		return report_error("Unable to read dive file");
 	if (*suffix)
 		dive->number = atoi(suffix + 1);
 	clear_weightsystem_table(&state->active_dive->weightsystems);
 	state->o2pressure_sensor = 1;
-	for_each_line(blob, dive_parser, state);
-	git_blob_free(blob);
-	return 0;
+	for_each_line(content, size, dive_parser, state);
 }
 
 static int parse_site_entry(struct git_parser_state *state, const git_tree_entry *entry, const char *suffix)
@@ -1746,9 +1800,8 @@ static int parse_settings_entry(struct git_parser_state *state, const git_tree_e
 	return 0;
 }
 
-static int parse_picture_entry(struct git_parser_state *state, const git_tree_entry *entry, const char *name)
+static int parse_picture_entry(struct git_parser_state *state, const char *content, unsigned int size, const char *name)
 {
-	git_blob *blob;
 	int hh, mm, ss, offset;
 	char sign;
 
@@ -1765,15 +1818,10 @@ static int parse_picture_entry(struct git_parser_state *state, const git_tree_en
 	if (sign == '-')
 		offset = -offset;
 
-	blob = git_tree_entry_blob(state->repo, entry);
-	if (!blob)
-		return report_error("Unable to read picture file");
-
 	state->active_pic.offset.seconds = offset;
 
-	for_each_line(blob, picture_parser, state);
+	for_each_line(content, size, picture_parser, state);
 	add_picture(&state->active_dive->pictures, state->active_pic);
-	git_blob_free(blob);
 
 	/* add_picture took ownership of the data -
 	 * clear out our copy just to be sure. */
@@ -1798,6 +1846,13 @@ static int parse_filter_preset(struct git_parser_state *state, const git_tree_en
 	return 0;
 }
 
+/* The files of dive directories are parsed later, see parse_dive_dirs() */
+static int add_dive_file(struct git_parser_state *state, const git_tree_entry *entry, decltype(git_dive_file::DIVE) type, const char *name)
+{
+	state->dive_dirs.back().files.push_back({ type, *git_tree_entry_id(entry), name });
+	return 0;
+}
+
 static int walk_tree_file(const char *root, const git_tree_entry *entry, struct git_parser_state *state)
 {
 	struct dive *dive = state->active_dive;
@@ -1808,13 +1863,13 @@ static int walk_tree_file(const char *root, const git_tree_entry *entry, struct
 	switch (*name) {
 	case '-': case '+':
 		if (dive)
-			return parse_picture_entry(state, entry, name);
+			return add_dive_file(state, entry, git_dive_file::PICTURE, name);
 		break;
 	case 'D':
 		if (dive && !strncmp(name, "Divecomputer", 12))
-			return parse_divecomputer_entry(state, entry, name + 12);
+			return add_dive_file(state, entry, git_dive_file::DIVECOMPUTER, name + 12);
 		if (dive && !strncmp(name, "Dive", 4))
-			return parse_dive_entry(state, entry, name + 4);
+			return add_dive_file(state, entry, git_dive_file::DIVE, name + 4);
 		break;
 	case 'P':
 		if (!strncmp(name, "Preset-", 7))
@@ -1848,9 +1903,84 @@ static int walk_tree_cb(const char *root, const git_tree_entry *entry, void *pay
 	return GIT_WALK_OK;
 }
 
+/*
+ * Parse the files of one dive directory with a parser state of its own.
+ * This is run in parallel for all dives. The object database of libgit2
+ * can be read from multiple threads. Event types and errors are collected
+ * in the directory and passed on in the order of the tree walk.
+ */
+static void parse_dive_dir(git_odb *odb, git_dive_dir &dir)
+{
+	struct git_parser_state state;
+	state.active_dive = dir.dive;
+	state.deferred_lines = &dir.deferred_lines;
+	event_type_collector event_types(dir.event_types);
+	error_collector errors(dir.errors);
+
+	for (const git_dive_file &file: dir.files) {
+		git_odb_object *obj;
+		if (git_odb_read(&obj, odb, &file.id)) {
+			report_error(file.type == git_dive_file::DIVE ? "Unable to read dive file" :
+				     file.type == git_dive_file::DIVECOMPUTER ? "Unable to read divecomputer file" :
+									       "Unable to read picture file");
+			continue;
+		}
+		const char *content = (const char *)git_odb_object_data(obj);
+		unsigned int size = git_odb_object_size(obj);
+		switch (file.type) {
+		case git_dive_file::DIVE:
+			parse_dive_entry(&state, content, size, file.name.c_str());
+			break;
+		case git_dive_file::DIVECOMPUTER:
+			parse_divecomputer_entry(&state, content, size, &file.id);
+			break;
+		case git_dive_file::PICTURE:
+			parse_picture_entry(&state, content, size, file.name.c_str());
+			break;
+		}
+		git_odb_object_free(obj);
+	}
+}
+
+/*
+ * Parse all dive directories in parallel, then pass on the collected event
+ * types and errors, replay the deferred lines and add the dives to the log
+ * in the order of the tree walk.
+ */
+static void parse_dive_dirs(git_repository *repo, struct git_parser_state *state)
+{
+	git_odb *odb;
+
+	if (git_repository_odb(&odb, repo)) {
+		report_error("Unable to open git object database");
+		for (git_dive_dir &dir: state->dive_dirs)
+			free_dive(dir.dive);
+		state->dive_dirs.clear();
+		return;
+	}
+	QtConcurrent::blockingMap(state->dive_dirs, [odb](git_dive_dir &dir) { parse_dive_dir(odb, dir); });
+	git_odb_free(odb);
+
+	for (git_dive_dir &dir: state->dive_dirs) {
+		remember_event_types(dir.event_types);
+		report_errors(dir.errors);
+		state->active_dive = dir.dive;
+		for (deferred_line &deferred: dir.deferred_lines) {
+			state->converted_strings = std::move(deferred.converted_strings);
+			state->act_converted_string = 0;
+			deferred.fn(deferred.line.data(), state);
+		}
+		record_dive_to_table(dir.dive, state->log->dives);
+	}
+	state->active_dive = NULL;
+	state->dive_dirs.clear();
+}
+
 static int load_dives_from_tree(git_repository *repo, git_tree *tree, struct git_parser_state *state)
 {
 	git_tree_walk(tree, GIT_TREEWALK_PRE, walk_tree_cb, state);
+	finish_active_dive(state);
+	parse_dive_dirs(repo, state);
 	return 0;
 }
 
@@ -1878,11 +2008,24 @@ static int find_commit(git_repository *repo, const char *branch, git_commit **co
 	return 0;
 }
 
+/* The binary snapshot is stored with the git metadata, see snapshot.cpp */
+static std::string snapshot_filename(git_repository *repo)
+{
+	return std::string(git_repository_path(repo)) + "subsurface-snapshot";
+}
+
+/* Only use snapshots when loading into an empty log, not when importing */
+static bool divelog_is_empty(const struct divelog *log)
+{
+	return log->dives->nr == 0 && log->trips->nr == 0 && log->sites->nr == 0;
+}
+
 static int do_git_load(git_repository *repo, const char *branch, struct git_parser_state *state)
 {
 	int ret;
 	git_commit *commit;
 	git_tree *tree;
+	char sha[GIT_OID_HEXSZ + 1];
 
 	ret = find_commit(repo, branch, &commit);
 	if (ret)
@@ -1890,6 +2033,11 @@ static int do_git_load(git_repository *repo, const char *branch, struct git_pars
 	if (git_commit_tree(&tree, commit))
 		return report_error("Could not look up tree of commit in branch '%s'", branch);
 	git_storage_update_progress(translate("gettextFromC", "Load dives from local cache"));
+	git_oid_tostr(sha, sizeof(sha), git_commit_id(commit));
+	if (divelog_is_empty(state->log)) {
+		state->snapshot_loaded = load_snapshot(snapshot_filename(repo), sha, state->log);
+		state->write_snapshot = !state->snapshot_loaded;
+	}
 	ret = load_dives_from_tree(repo, tree, state);
 	if (!ret) {
 		set_git_id(git_commit_id(commit));
@@ -1927,8 +2075,14 @@ int git_load_dives(struct git_info *info, struct divelog *log)
 
 	if (!info->repo)
 		return report_error("Unable to open git repository '%s[%s]'", info->url.c_str(), info->branch.c_str());
-	ret = do_git_load(info->repo, info->branch.c_str(), &state);
-	finish_active_dive(&state);
-	finish_active_trip(&state);
+	{
+		deferred_fixups fixups;
+		ret = do_git_load(info->repo, info->branch.c_str(), &state);
+		finish_active_dive(&state);
+		finish_active_trip(&state);
+	}
+	/* The snapshot is written after the fixups, i.e. once the dives are in the log */
+	if (!ret && state.write_snapshot)
+		save_snapshot(snapshot_filename(info->repo), saved_git_id, log);
 	return ret;
 }
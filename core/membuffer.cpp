@@ -8,6 +8,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <charconv>
 
 #include "units.h"
 #include "membuffer.h"
@@ -171,28 +172,65 @@ void put_format(struct membuffer *b, const char *fmt, ...)
 
 void put_milli(struct membuffer *b, const char *pre, int value, const char *post)
 {
-	int i;
-	char buf[4];
-	const char *sign = "";
-	unsigned v;
+	char buf[16], *p = buf;
+	unsigned v = value, frac;
 
-	v = value;
 	if (value < 0) {
-		sign = "-";
-		v = -value;
+		*p++ = '-';
+		v = 0u - v;
 	}
-	for (i = 2; i >= 0; i--) {
-		buf[i] = (v % 10) + '0';
-		v /= 10;
-	}
-	buf[3] = 0;
-	if (buf[2] == '0') {
-		buf[2] = 0;
-		if (buf[1] == '0')
-			buf[1] = 0;
+	p = std::to_chars(p, buf + sizeof(buf), v / 1000).ptr;
+
+	/* At least one decimal, but no trailing zeros */
+	frac = v % 1000;
+	*p++ = '.';
+	*p++ = '0' + frac / 100;
+	if (frac % 100) {
+		*p++ = '0' + frac / 10 % 10;
+		if (frac % 10)
+			*p++ = '0' + frac % 10;
 	}
 
-	put_format(b, "%s%s%u.%s%s", pre, sign, v, buf, post);
+	put_string(b, pre);
+	put_bytes(b, buf, p - buf);
+	put_string(b, post);
+}
+
+void put_int(struct membuffer *b, const char *pre, int value, const char *post)
+{
+	char buf[16];
+	char *end = std::to_chars(buf, buf + sizeof(buf), value).ptr;
+
+	put_string(b, pre);
+	put_bytes(b, buf, end - buf);
+	put_string(b, post);
+}
+
+void put_uint(struct membuffer *b, const char *pre, unsigned int value, const char *post)
+{
+	char buf[16];
+	char *end = std::to_chars(buf, buf + sizeof(buf), value).ptr;
+
+	put_string(b, pre);
+	put_bytes(b, buf, end - buf);
+	put_string(b, post);
+}
+
+void put_mmss(struct membuffer *b, const char *pre, unsigned int seconds, int width, const char *post)
+{
+	char buf[16], *p = buf;
+	unsigned sec = seconds % 60;
+	int len;
+
+	p = std::to_chars(buf, buf + sizeof(buf), seconds / 60).ptr;
+	put_string(b, pre);
+	for (len = p - buf; len < width; len++)
+		put_bytes(b, " ", 1);
+	*p++ = ':';
+	*p++ = '0' + sec / 10;
+	*p++ = '0' + sec % 10;
+	put_bytes(b, buf, p - buf);
+	put_string(b, post);
 }
 
 void put_temperature(struct membuffer *b, temperature_t temp, const char *pre, const char *post)
@@ -210,7 +248,7 @@ void put_depth(struct membuffer *b, depth_t depth, const char *pre, const char *
 void put_duration(struct membuffer *b, duration_t duration, const char *pre, const char *post)
 {
 	if (duration.seconds)
-		put_format(b, "%s%u:%02u%s", pre, FRACTION_TUPLE(duration.seconds, 60), post);
+		put_mmss(b, pre, duration.seconds, 0, post);
 }
 
 void put_pressure(struct membuffer *b, pressure_t pressure, const char *pre, const char *post)
@@ -222,19 +260,30 @@ void put_pressure(struct membuffer *b, pressure_t pressure, const char *pre, con
 void put_salinity(struct membuffer *b, int salinity, const char *pre, const char *post)
 {
 	if (salinity)
-		put_format(b, "%s%d%s", pre, salinity / 10, post);
+		put_int(b, pre, salinity / 10, post);
 }
 
 void put_degrees(struct membuffer *b, degrees_t value, const char *pre, const char *post)
 {
-	int udeg = value.udeg;
-	const char *sign = "";
+	char buf[24], *p = buf;
+	unsigned udeg = value.udeg, frac;
 
-	if (udeg < 0) {
-		udeg = -udeg;
-		sign = "-";
+	if (value.udeg < 0) {
+		*p++ = '-';
+		udeg = 0u - udeg;
+	}
+	p = std::to_chars(p, buf + sizeof(buf), udeg / 1000000).ptr;
+	*p++ = '.';
+	frac = udeg % 1000000;
+	for (int i = 5; i >= 0; i--) {
+		p[i] = '0' + frac % 10;
+		frac /= 10;
 	}
-	put_format(b, "%s%s%u.%06u%s", pre, sign, FRACTION_TUPLE(udeg, 1000000), post);
+	p += 6;
+
+	put_string(b, pre);
+	put_bytes(b, buf, p - buf);
+	put_string(b, post);
 }
 
 void put_location(struct membuffer *b, const location_t *loc, const char *pre, const char *post)
@@ -87,6 +87,18 @@ extern __printf(1, 2) char *format_string(const char *, ...);
 /* Output one of our "milli" values with type and pre/post data */
 extern void put_milli(struct membuffer *, const char *, int, const char *);
 
+/*
+ * Output integers with pre/post data. Like put_milli(), these don't
+ * go through printf, because the savers call them for every sample.
+ *
+ * put_mmss() outputs a number of seconds as "minutes:seconds", with
+ * the minutes padded by spaces to at least "width" characters, i.e.
+ * like printf("%*u:%02u").
+ */
+extern void put_int(struct membuffer *, const char *, int, const char *);
+extern void put_uint(struct membuffer *, const char *, unsigned int, const char *);
+extern void put_mmss(struct membuffer *, const char *, unsigned int, int, const char *);
+
 /*
  * Helper functions for showing particular types. If the type
  * is empty, nothing is done, and the function returns false.
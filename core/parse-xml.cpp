@@ -16,14 +16,19 @@
 #include <libxml/parser.h>
 #include <libxml/parserInternals.h>
 #include <libxml/tree.h>
+#include <libxml/xmlreader.h>
 #include <libxslt/transform.h>
 #include <libdivecomputer/parser.h>
+#include <string>
+#include <unordered_set>
+#include <vector>
 
 #include "gettext.h"
 
 #include "dive.h"
 #include "divelog.h"
 #include "divesite.h"
+#include "divesiteindex.h"
 #include "errorhelper.h"
 #include "parse.h"
 #include "format.h"
@@ -43,7 +48,7 @@ int last_xml_version = -1;
 
 static xmlDoc *test_xslt_transforms(xmlDoc *doc, const struct xml_params *params);
 
-static void divedate(const char *buffer, timestamp_t *when, struct parser_state *state)
+void divedate(const char *buffer, timestamp_t *when, struct parser_state *state)
 {
 	int d, m, y;
 	int hh, mm, ss;
@@ -69,7 +74,7 @@ static void divedate(const char *buffer, timestamp_t *when, struct parser_state
 	*when = utc_mktime(&state->cur_tm);
 }
 
-static void divetime(const char *buffer, timestamp_t *when, struct parser_state *state)
+void divetime(const char *buffer, timestamp_t *when, struct parser_state *state)
 {
 	int h, m, s = 0;
 
@@ -188,7 +193,7 @@ static enum number_type integer_or_float(const char *buffer, union int_or_float
 	return parse_float(buffer, &res->fp, &end);
 }
 
-static void pressure(const char *buffer, pressure_t *pressure, struct parser_state *state)
+void pressure(const char *buffer, pressure_t *pressure, struct parser_state *state)
 {
 	double mbar = 0.0;
 	union int_or_float val;
@@ -257,7 +262,7 @@ static void salinity(const char *buffer, int *salinity)
 	}
 }
 
-static void depth(const char *buffer, depth_t *depth, struct parser_state *state)
+void depth(const char *buffer, depth_t *depth, struct parser_state *state)
 {
 	union int_or_float val;
 
@@ -310,7 +315,7 @@ static void weight(const char *buffer, weight_t *weight, struct parser_state *st
 	}
 }
 
-static void temperature(const char *buffer, temperature_t *temperature, struct parser_state *state)
+void temperature(const char *buffer, temperature_t *temperature, struct parser_state *state)
 {
 	union int_or_float val;
 
@@ -337,7 +342,7 @@ static void temperature(const char *buffer, temperature_t *temperature, struct p
 		temperature->mkelvin = 0;
 }
 
-static void sampletime(const char *buffer, duration_t *time)
+void sampletime(const char *buffer, duration_t *time)
 {
 	int i;
 	int hr, min, sec;
@@ -528,6 +533,39 @@ static int match_state(const char *pattern, const char *name,
 	if (0) (fn)("test", dest, state);		\
 	match_state(pattern, name, (matchfn_state_t) (fn), buf, dest, state); })
 
+/*
+ * Samples and events are by far the most common elements. Instead of
+ * going through a chain of MATCH()es, they switch on a hash of the name.
+ * For the patterns, the hash is calculated at compile time, so that two
+ * patterns with the same hash give a duplicate case label. Names that are
+ * not patterns may still collide, therefore the MATCH() in the case checks
+ * the string. Like match_name(), the hash stops at a '.' after the given
+ * number of components.
+ */
+static constexpr uint32_t name_hash(const char *name, int components = 2)
+{
+	uint32_t hash = 2166136261u; // FNV-1a
+
+	for (; *name; name++) {
+		if (*name == '.' && !--components)
+			break;
+		hash = (hash ^ (unsigned char)*name) * 16777619u;
+	}
+	return hash;
+}
+
+#define MATCH_CASE(pattern, fn, dest)			\
+	case name_hash(pattern):			\
+		if (MATCH(pattern, fn, dest))		\
+			return;				\
+		break
+
+#define MATCH_STATE_CASE(pattern, fn, dest)		\
+	case name_hash(pattern):			\
+		if (MATCH_STATE(pattern, fn, dest))	\
+			return;				\
+		break
+
 static void get_index(const char *buffer, int *i)
 {
 	*i = atoi(buffer);
@@ -770,29 +808,24 @@ static void try_to_fill_fingerprint(const char *name, char *buf, struct parser_s
 static void try_to_fill_event(const char *name, char *buf, struct parser_state *state)
 {
 	start_match("event", name, buf);
-	if (MATCH("event", event_name, state->cur_event.name))
-		return;
-	if (MATCH("name", event_name, state->cur_event.name))
-		return;
-	if (MATCH_STATE("time", eventtime, &state->cur_event.time))
-		return;
-	if (MATCH("type", get_index, &state->cur_event.type))
-		return;
-	if (MATCH("flags", get_index, &state->cur_event.flags))
-		return;
-	if (MATCH("value", get_index, &state->cur_event.value))
-		return;
-	if (MATCH("divemode", event_divemode, &state->cur_event.value))
-		return;
-	if (MATCH("cylinder", get_index, &state->cur_event.gas.index)) {
-		/* We add one to indicate that we got an actual cylinder index value */
-		state->cur_event.gas.index++;
-		return;
+	switch (name_hash(name, 1)) {
+	MATCH_CASE("event", event_name, state->cur_event.name);
+	MATCH_CASE("name", event_name, state->cur_event.name);
+	MATCH_STATE_CASE("time", eventtime, &state->cur_event.time);
+	MATCH_CASE("type", get_index, &state->cur_event.type);
+	MATCH_CASE("flags", get_index, &state->cur_event.flags);
+	MATCH_CASE("value", get_index, &state->cur_event.value);
+	MATCH_CASE("divemode", event_divemode, &state->cur_event.value);
+	case name_hash("cylinder"):
+		if (MATCH("cylinder", get_index, &state->cur_event.gas.index)) {
+			/* We add one to indicate that we got an actual cylinder index value */
+			state->cur_event.gas.index++;
+			return;
+		}
+		break;
+	MATCH_CASE("o2", percent, &state->cur_event.gas.mix.o2);
+	MATCH_CASE("he", percent, &state->cur_event.gas.mix.he);
 	}
-	if (MATCH("o2", percent, &state->cur_event.gas.mix.o2))
-		return;
-	if (MATCH("he", percent, &state->cur_event.gas.mix.he))
-		return;
 	nonmatch("event", name, buf);
 }
 
@@ -875,95 +908,83 @@ static void try_to_fill_sample(struct sample *sample, const char *name, char *bu
 	pressure_t p;
 
 	start_match("sample", name, buf);
-	if (MATCH_STATE("pressure.sample", pressure, &sample->pressure[0]))
-		return;
-	if (MATCH_STATE("cylpress.sample", pressure, &sample->pressure[0]))
-		return;
-	if (MATCH_STATE("pdiluent.sample", pressure, &sample->pressure[0]))
-		return;
-	if (MATCH_STATE("o2pressure.sample", pressure, &sample->pressure[1]))
-		return;
+	switch (name_hash(name)) {
+	MATCH_STATE_CASE("pressure.sample", pressure, &sample->pressure[0]);
+	MATCH_STATE_CASE("cylpress.sample", pressure, &sample->pressure[0]);
+	MATCH_STATE_CASE("pdiluent.sample", pressure, &sample->pressure[0]);
+	MATCH_STATE_CASE("o2pressure.sample", pressure, &sample->pressure[1]);
 	/* Christ, this is ugly */
-	if (MATCH_STATE("pressure0.sample", pressure, &p)) {
-		add_sample_pressure(sample, 0, p.mbar);
-		return;
-	}
-	if (MATCH_STATE("pressure1.sample", pressure, &p)) {
-		add_sample_pressure(sample, 1, p.mbar);
-		return;
-	}
-	if (MATCH_STATE("pressure2.sample", pressure, &p)) {
-		add_sample_pressure(sample, 2, p.mbar);
-		return;
-	}
-	if (MATCH_STATE("pressure3.sample", pressure, &p)) {
-		add_sample_pressure(sample, 3, p.mbar);
-		return;
-	}
-	if (MATCH_STATE("pressure4.sample", pressure, &p)) {
-		add_sample_pressure(sample, 4, p.mbar);
-		return;
-	}
-	if (MATCH_STATE("cylinderindex.sample", get_cylinderindex, &sample->sensor[0]))
-		return;
-	if (MATCH("sensor.sample", get_sensor, &sample->sensor[0]))
-		return;
-	if (MATCH_STATE("depth.sample", depth, &sample->depth))
-		return;
-	if (MATCH_STATE("temp.sample", temperature, &sample->temperature))
-		return;
-	if (MATCH_STATE("temperature.sample", temperature, &sample->temperature))
-		return;
-	if (MATCH("sampletime.sample", sampletime, &sample->time))
-		return;
-	if (MATCH("time.sample", sampletime, &sample->time))
-		return;
-	if (MATCH("ndl.sample", sampletime, &sample->ndl))
-		return;
-	if (MATCH("tts.sample", sampletime, &sample->tts))
-		return;
-	if (MATCH("in_deco.sample", get_index, &in_deco)) {
-		sample->in_deco = (in_deco == 1);
-		return;
+	case name_hash("pressure0.sample"):
+		if (MATCH_STATE("pressure0.sample", pressure, &p)) {
+			add_sample_pressure(sample, 0, p.mbar);
+			return;
+		}
+		break;
+	case name_hash("pressure1.sample"):
+		if (MATCH_STATE("pressure1.sample", pressure, &p)) {
+			add_sample_pressure(sample, 1, p.mbar);
+			return;
+		}
+		break;
+	case name_hash("pressure2.sample"):
+		if (MATCH_STATE("pressure2.sample", pressure, &p)) {
+			add_sample_pressure(sample, 2, p.mbar);
+			return;
+		}
+		break;
+	case name_hash("pressure3.sample"):
+		if (MATCH_STATE("pressure3.sample", pressure, &p)) {
+			add_sample_pressure(sample, 3, p.mbar);
+			return;
+		}
+		break;
+	case name_hash("pressure4.sample"):
+		if (MATCH_STATE("pressure4.sample", pressure, &p)) {
+			add_sample_pressure(sample, 4, p.mbar);
+			return;
+		}
+		break;
+	MATCH_STATE_CASE("cylinderindex.sample", get_cylinderindex, &sample->sensor[0]);
+	MATCH_CASE("sensor.sample", get_sensor, &sample->sensor[0]);
+	MATCH_STATE_CASE("depth.sample", depth, &sample->depth);
+	MATCH_STATE_CASE("temp.sample", temperature, &sample->temperature);
+	MATCH_STATE_CASE("temperature.sample", temperature, &sample->temperature);
+	MATCH_CASE("sampletime.sample", sampletime, &sample->time);
+	MATCH_CASE("time.sample", sampletime, &sample->time);
+	MATCH_CASE("ndl.sample", sampletime, &sample->ndl);
+	MATCH_CASE("tts.sample", sampletime, &sample->tts);
+	case name_hash("in_deco.sample"):
+		if (MATCH("in_deco.sample", get_index, &in_deco)) {
+			sample->in_deco = (in_deco == 1);
+			return;
+		}
+		break;
+	MATCH_CASE("stoptime.sample", sampletime, &sample->stoptime);
+	MATCH_STATE_CASE("stopdepth.sample", depth, &sample->stopdepth);
+	MATCH_CASE("cns.sample", get_uint16, &sample->cns);
+	MATCH_CASE("rbt.sample", sampletime, &sample->rbt);
+	MATCH_CASE("sensor1.sample", double_to_o2pressure, &sample->o2sensor[0]); // CCR O2 sensor data
+	MATCH_CASE("sensor2.sample", double_to_o2pressure, &sample->o2sensor[1]);
+	MATCH_CASE("sensor3.sample", double_to_o2pressure, &sample->o2sensor[2]);
+	MATCH_CASE("sensor4.sample", double_to_o2pressure, &sample->o2sensor[3]);
+	MATCH_CASE("sensor5.sample", double_to_o2pressure, &sample->o2sensor[4]);
+	MATCH_CASE("sensor6.sample", double_to_o2pressure, &sample->o2sensor[5]); // up to 6 CCR sensors
+	MATCH_CASE("po2.sample", double_to_o2pressure, &sample->setpoint);
+	MATCH_CASE("setpoint.sample", double_to_o2pressure, &sample->setpoint);
+	case name_hash("ppo2.sample"):
+		if (MATCH("ppo2.sample", double_to_o2pressure, &sample->o2sensor[state->next_o2_sensor])) {
+			state->next_o2_sensor++;
+			return;
+		}
+		break;
+	MATCH_CASE("deco.sample", parse_libdc_deco, sample);
+	MATCH_CASE("time.deco", sampletime, &sample->stoptime);
+	MATCH_STATE_CASE("depth.deco", depth, &sample->stopdepth);
 	}
-	if (MATCH("stoptime.sample", sampletime, &sample->stoptime))
-		return;
-	if (MATCH_STATE("stopdepth.sample", depth, &sample->stopdepth))
-		return;
-	if (MATCH("cns.sample", get_uint16, &sample->cns))
-		return;
-	if (MATCH("rbt.sample", sampletime, &sample->rbt))
-		return;
-	if (MATCH("sensor1.sample", double_to_o2pressure, &sample->o2sensor[0])) // CCR O2 sensor data
-		return;
-	if (MATCH("sensor2.sample", double_to_o2pressure, &sample->o2sensor[1]))
-		return;
-	if (MATCH("sensor3.sample", double_to_o2pressure, &sample->o2sensor[2]))
-		return;
-	if (MATCH("sensor4.sample", double_to_o2pressure, &sample->o2sensor[3]))
-		return;
-	if (MATCH("sensor5.sample", double_to_o2pressure, &sample->o2sensor[4]))
-		return;
-	if (MATCH("sensor6.sample", double_to_o2pressure, &sample->o2sensor[5])) // up to 6 CCR sensors
-		return;
-	if (MATCH("po2.sample", double_to_o2pressure, &sample->setpoint))
-		return;
-	if (MATCH("heartbeat", get_uint8, &sample->heartbeat))
-		return;
-	if (MATCH("bearing", get_bearing, &sample->bearing))
-		return;
-	if (MATCH("setpoint.sample", double_to_o2pressure, &sample->setpoint))
-		return;
-	if (MATCH("ppo2.sample", double_to_o2pressure, &sample->o2sensor[state->next_o2_sensor])) {
-		state->next_o2_sensor++;
-		return;
+	switch (name_hash(name, 1)) {
+	MATCH_CASE("heartbeat", get_uint8, &sample->heartbeat);
+	MATCH_CASE("bearing", get_bearing, &sample->bearing);
 	}
-	if (MATCH("deco.sample", parse_libdc_deco, sample))
-		return;
-	if (MATCH("time.deco", sampletime, &sample->stoptime))
-		return;
-	if (MATCH_STATE("depth.deco", depth, &sample->stopdepth))
-		return;
 
 	switch (state->import_source) {
 	case parser_state::DIVINGLOG:
@@ -1171,6 +1192,7 @@ static void gps_lat(const char *buffer, struct dive *dive, struct parser_state *
 		if (ds->location.lat.udeg && ds->location.lat.udeg != location.lat.udeg)
 			report_info("Oops, changing the latitude of existing dive site id %8x name %s; not good", ds->uuid, ds->name ?: "(unknown)");
 		ds->location.lat = location.lat;
+		divesiteindex_update(ds);
 	}
 }
 
@@ -1187,6 +1209,7 @@ static void gps_long(const char *buffer, struct dive *dive, struct parser_state
 		if (ds->location.lon.udeg && ds->location.lon.udeg != location.lon.udeg)
 			report_info("Oops, changing the longitude of existing dive site id %8x name %s; not good", ds->uuid, ds->name ?: "(unknown)");
 		ds->location.lon = location.lon;
+		divesiteindex_update(ds);
 	}
 }
 
@@ -1202,6 +1225,7 @@ extern "C" void parse_location(const char *buffer, location_t *loc)
 static void gps_location(const char *buffer, struct dive_site *ds)
 {
 	parse_location(buffer, &ds->location);
+	divesiteindex_update(ds);
 }
 
 static void gps_in_dive(const char *buffer, struct dive *dive, struct parser_state *state)
@@ -1233,6 +1257,7 @@ static void gps_in_dive(const char *buffer, struct dive *dive, struct parser_sta
 			ds->notes = add_to_string(ds->notes, translate("gettextFromC", "multiple GPS locations for this dive site; also %s\n"), coords.c_str());
 		} else {
 			ds->location = location;
+			divesiteindex_update(ds);
 		}
 	}
 }
@@ -1687,26 +1712,32 @@ static struct nesting {
 	  { NULL, }
 };
 
+/* Returns the terminating entry if there is no rule for this element */
+static const struct nesting *find_nesting_rule(const char *name)
+{
+	const struct nesting *rule = nesting;
+
+	do {
+		if (!strcmp(rule->name, name))
+			break;
+		rule++;
+	} while (rule->name);
+	return rule;
+}
+
 static bool traverse(xmlNode *root, struct parser_state *state)
 {
 	xmlNode *n;
 	bool ret = true;
 
 	for (n = root; n; n = n->next) {
-		struct nesting *rule = nesting;
-
 		if (!n->name) {
 			if ((ret = visit(n, state)) == false)
 				break;
 			continue;
 		}
 
-		do {
-			if (!strcmp(rule->name, (const char *)n->name))
-				break;
-			rule++;
-		} while (rule->name);
-
+		const struct nesting *rule = find_nesting_rule((const char *)n->name);
 		if (rule->start)
 			rule->start(state);
 		if ((ret = visit(n, state)) == false)
@@ -1731,6 +1762,184 @@ static void reset_all(struct parser_state *state)
 	state->import_source = parser_state::UNKNOWN;
 }
 
+/*
+ * Native Subsurface files don't need an XSLT transformation. Instead of
+ * building the whole document tree, they are parsed with a streaming
+ * xmlTextReader. This calls the same functions in the same order as
+ * traverse(): start of the element, attributes, text and children, end
+ * of the element. The open elements are kept on a stack to construct the
+ * same names as nodename().
+ */
+struct stream_element {
+	std::string name;
+	const struct nesting *rule;
+};
+
+/* Like nodename(): "name.parent", lower case and cut to MAXNAME - 1 characters */
+static const char *stream_nodename(const char *name, const char *parent, char *buf)
+{
+	char *p = buf;
+	int len = MAXNAME - 1;
+
+	for (; *name && len; len--) {
+		char c = *name++;
+		*p++ = (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+	}
+	if (parent && len) {
+		*p++ = '.';
+		len--;
+		for (; *parent && len; len--) {
+			char c = *parent++;
+			*p++ = (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+		}
+	}
+	*p = 0;
+	return buf;
+}
+
+/* The callbacks may modify the buffer, therefore pass a copy of the content */
+static bool stream_entry(const char *name, const char *parent, const xmlChar *content, std::string &buf, struct parser_state *state)
+{
+	char namebuf[MAXNAME];
+	const xmlChar *p;
+
+	for (p = content; *p; p++) {
+		if (!IS_BLANK_CH(*p))
+			break;
+	}
+	if (!*p)
+		return true;
+
+	buf.assign((const char *)content);
+	return entry(stream_nodename(name, parent, namebuf), buf.data(), state);
+}
+
+/* Native files have a divelog root element */
+static bool is_native_divelog(const char *url, const char *buffer, size_t size)
+{
+	xmlTextReaderPtr reader = xmlReaderForMemory(buffer, size, url, NULL, XML_PARSE_HUGE);
+	bool res = false;
+
+	if (!reader)
+		return false;
+	while (xmlTextReaderRead(reader) == 1) {
+		if (xmlTextReaderNodeType(reader) == XML_READER_TYPE_ELEMENT) {
+			res = !strcasecmp((const char *)xmlTextReaderConstLocalName(reader), "divelog");
+			break;
+		}
+	}
+	xmlFreeTextReader(reader);
+	return res;
+}
+
+/*
+ * The streaming reader adds the dives to the log while reading. If the file
+ * turns out to be broken, remove what was added, so that the file is not
+ * imported partially.
+ */
+static std::unordered_set<const void *> log_objects(const struct divelog *log)
+{
+	std::unordered_set<const void *> res;
+	for (int i = 0; i < log->dives->nr; i++)
+		res.insert(log->dives->dives[i]);
+	for (int i = 0; i < log->trips->nr; i++)
+		res.insert(log->trips->trips[i]);
+	for (int i = 0; i < log->sites->nr; i++)
+		res.insert(log->sites->dive_sites[i]);
+	return res;
+}
+
+static void remove_new_objects(struct divelog *log, const std::unordered_set<const void *> &old)
+{
+	for (int i = log->dives->nr - 1; i >= 0; i--) {
+		if (!old.count(log->dives->dives[i]))
+			delete_single_dive(log, i);
+	}
+	for (int i = log->trips->nr - 1; i >= 0; i--) {
+		struct dive_trip *trip = log->trips->trips[i];
+		if (!old.count(trip)) {
+			remove_trip(trip, log->trips);
+			free_trip(trip);
+		}
+	}
+	for (int i = log->sites->nr - 1; i >= 0; i--) {
+		struct dive_site *ds = log->sites->dive_sites[i];
+		if (!old.count(ds))
+			delete_dive_site(ds, log->sites);
+	}
+}
+
+static int parse_xml_stream(const char *url, const char *buffer, size_t size, struct parser_state *state)
+{
+	xmlTextReaderPtr reader = xmlReaderForMemory(buffer, size, url, NULL, XML_PARSE_HUGE);
+	std::vector<stream_element> stack;
+	std::string buf;
+	bool ok = true;
+	int res = 1;
+
+	if (!reader)
+		return report_error(translate("gettextFromC", "Failed to parse '%s'"), url);
+
+	std::unordered_set<const void *> old_objects = log_objects(state->log);
+	reset_all(state);
+	dive_start(state);
+	{
+		deferred_fixups fixups;
+		while (ok && (res = xmlTextReaderRead(reader)) == 1) {
+			const char *parent = stack.size() >= 2 ? stack[stack.size() - 2].name.c_str() : NULL;
+			switch (xmlTextReaderNodeType(reader)) {
+			case XML_READER_TYPE_ELEMENT: {
+				bool empty = xmlTextReaderIsEmptyElement(reader);
+				const char *name = (const char *)xmlTextReaderConstLocalName(reader);
+				const struct nesting *rule = find_nesting_rule(name);
+				stack.push_back({ name, rule });
+				if (rule->start)
+					rule->start(state);
+				while (ok && xmlTextReaderMoveToNextAttribute(reader) == 1) {
+					if (!xmlTextReaderIsNamespaceDecl(reader))
+						ok = stream_entry((const char *)xmlTextReaderConstLocalName(reader), name,
+								  xmlTextReaderConstValue(reader), buf, state);
+				}
+				if (!ok || !empty)
+					break;
+			}
+			/* Fallthrough - empty elements have no end tag */
+			case XML_READER_TYPE_END_ELEMENT:
+				if (stack.empty())
+					break;
+				if (stack.back().rule->end)
+					stack.back().rule->end(state);
+				stack.pop_back();
+				break;
+			case XML_READER_TYPE_TEXT:
+			case XML_READER_TYPE_CDATA:
+				if (!stack.empty())
+					ok = stream_entry(stack.back().name.c_str(), parent, xmlTextReaderConstValue(reader), buf, state);
+				break;
+			case XML_READER_TYPE_COMMENT:
+				/* traverse() passes comments on, too */
+				if (!stack.empty()) {
+					char namebuf[MAXNAME];
+					buf.assign((const char *)xmlTextReaderConstValue(reader));
+					ok = entry(stream_nodename("comment", stack.back().name.c_str(), namebuf), buf.data(), state);
+				}
+				break;
+			}
+		}
+		dive_end(state);
+	}
+	xmlFreeTextReader(reader);
+
+	if (res < 0 || !ok) {
+		trip_end(state);	/* An open trip may contain dives that are removed */
+		remove_new_objects(state->log, old_objects);
+	}
+	if (res < 0)
+		return report_error(translate("gettextFromC", "Failed to parse '%s'"), url);
+	/* we decided to give up on parsing... why? */
+	return ok ? 0 : -1;
+}
+
 /* divelog.de sends us xml files that claim to be iso-8859-1
  * but once we decode the HTML encoded characters they turn
  * into UTF-8 instead. So skip the incorrect encoding
@@ -1766,6 +1975,14 @@ extern "C" int parse_xml_buffer(const char *url, const char *buffer, int, struct
 
 	state.log = log;
 	state.fingerprints = &fingerprint_table; // simply use the global table for now
+
+	/* Invalid UTF-8 is retried as latin1 below, which the stream parser can't do */
+	if (res == buffer && xmlCheckUTF8((const xmlChar *)buffer)) {
+		size_t size = strlen(buffer);
+		if (is_native_divelog(url, buffer, size))
+			return parse_xml_stream(url, buffer, size, &state);
+	}
+
 	doc = xmlReadMemory(res, strlen(res), url, NULL, XML_PARSE_HUGE);
 	if (!doc)
 		doc = xmlReadMemory(res, strlen(res), url, "latin1", XML_PARSE_HUGE);
@@ -1779,11 +1996,14 @@ extern "C" int parse_xml_buffer(const char *url, const char *buffer, int, struct
 	reset_all(&state);
 	dive_start(&state);
 	doc = test_xslt_transforms(doc, params);
-	if (!traverse(xmlDocGetRootElement(doc), &state)) {
-		// we decided to give up on parsing... why?
-		ret = -1;
+	{
+		deferred_fixups fixups;
+		if (!traverse(xmlDocGetRootElement(doc), &state)) {
+			// we decided to give up on parsing... why?
+			ret = -1;
+		}
+		dive_end(&state);
 	}
-	dive_end(&state);
 	xmlFreeDoc(doc);
 	return ret;
 }
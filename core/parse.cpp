@@ -11,14 +11,20 @@
 #include "dive.h"
 #include "divelog.h"
 #include "divesite.h"
+#include "divesiteindex.h"
 #include "errorhelper.h"
 #include "sample.h"
 #include "subsurface-string.h"
 #include "picture.h"
 #include "trip.h"
 #include "device.h"
+#include "divelist.h"
 #include "gettext.h"
 
+#include <unordered_map>
+#include <vector>
+#include <QtConcurrent>
+
 parser_state::~parser_state()
 {
 	free_dive(cur_dive);
@@ -35,12 +41,73 @@ struct divecomputer *get_dc(struct parser_state *state)
 	return state->cur_dc ?: &state->cur_dive->dc;
 }
 
+namespace {
+struct deferred_dive {
+	struct dive *dive;
+	const struct dive_trip *trip;	// trip of the dive when it was recorded
+	int nr;				// number of dives in the dive list when the dive was recorded, -1 if not added to the dive list
+	double cns;			// CNS of this dive alone
+};
+}
+
+// Non-null if fixups are deferred, see deferred_fixups
+static thread_local std::vector<deferred_dive> *deferred_dives = nullptr;
+
 /*
  * Add a dive into the dive_table array
  */
 extern "C" void record_dive_to_table(struct dive *dive, struct dive_table *table)
 {
-	add_to_dive_table(table, table->nr, fixup_dive(dive));
+	if (!deferred_dives) {
+		add_to_dive_table(table, table->nr, fixup_dive(dive));
+		return;
+	}
+	deferred_dives->push_back({ dive, dive->divetrip, table == divelog.dives ? table->nr : -1, 0.0 });
+	add_to_dive_table(table, table->nr, dive);
+}
+
+deferred_fixups::deferred_fixups() : owner(!deferred_dives)
+{
+	if (owner)
+		deferred_dives = new std::vector<deferred_dive>;
+}
+
+static double get_deferred_cns(const struct dive *dive, void *data)
+{
+	auto cns = static_cast<const std::unordered_map<const struct dive *, double> *>(data);
+	auto it = cns->find(dive);
+	return it != cns->end() ? it->second : calculate_cns_dive(dive);
+}
+
+/*
+ * Do the fixups in the order in which the dives were recorded. The results must
+ * be the same as if fixup_dive() had been called in record_dive_to_table().
+ * Therefore, the CNS of each dive is calculated with the dives that were in the
+ * dive list and the trip that was set at that time.
+ */
+deferred_fixups::~deferred_fixups()
+{
+	if (!owner)
+		return;
+	std::unique_ptr<std::vector<deferred_dive>> dives(deferred_dives);
+	deferred_dives = nullptr;
+
+	QtConcurrent::blockingMap(*dives, [](deferred_dive &d) {
+		fixup_dive_local(d.dive);
+		d.cns = calculate_cns_dive(d.dive);
+	});
+
+	std::unordered_map<const struct dive *, double> cns;
+	cns.reserve(dives->size());
+	for (const deferred_dive &d: *dives)
+		cns[d.dive] = d.cns;
+	for (const deferred_dive &d: *dives) {
+		fixup_dive_global(d.dive);
+		if (d.dive->maxcns == 0) {
+			int nr = d.nr >= 0 ? d.nr : divelog.dives->nr;
+			d.dive->maxcns = calculate_cns_partial(d.dive, d.trip, nr, &get_deferred_cns, &cns);
+		}
+	}
 }
 
 extern "C" void start_match(const char *type, const char *name, char *buffer)
@@ -493,6 +560,7 @@ void add_dive_site(const char *ds_name, struct dive *dive, struct parser_state *
 					} else {
 						newds->location = ds->location;
 					}
+					divesiteindex_update(newds);
 					newds->notes = add_to_string(newds->notes, translate("gettextFromC", "additional name for site: %s\n"), ds->name);
 				}
 			} else if (dive->dive_site != ds) {
@@ -143,6 +143,14 @@ void utf8_string_std(const char *buffer, std::string *res);
 
 void add_dive_site(const char *ds_name, struct dive *dive, struct parser_state *state);
 
+/* Values in the units of the XML file. Also used by the CSV importer. */
+void divedate(const char *buffer, timestamp_t *when, struct parser_state *state);
+void divetime(const char *buffer, timestamp_t *when, struct parser_state *state);
+void sampletime(const char *buffer, duration_t *time);
+void depth(const char *buffer, depth_t *depth, struct parser_state *state);
+void temperature(const char *buffer, temperature_t *temperature, struct parser_state *state);
+void pressure(const char *buffer, pressure_t *pressure, struct parser_state *state);
+
 extern "C" {
 #endif
 
@@ -28,13 +28,13 @@
 
 static constexpr int base_timestep = 2; // seconds
 
-static int decostoplevels_metric[] = { 0, 3000, 6000, 9000, 12000, 15000, 18000, 21000, 24000, 27000,
+static const int decostoplevels_metric[] = { 0, 3000, 6000, 9000, 12000, 15000, 18000, 21000, 24000, 27000,
 					30000, 33000, 36000, 39000, 42000, 45000, 48000, 51000, 54000, 57000,
 					60000, 63000, 66000, 69000, 72000, 75000, 78000, 81000, 84000, 87000,
 					90000, 100000, 110000, 120000, 130000, 140000, 150000, 160000, 170000,
 					180000, 190000, 200000, 220000, 240000, 260000, 280000, 300000,
 					320000, 340000, 360000, 380000 };
-static int decostoplevels_imperial[] = { 0, 3048, 6096, 9144, 12192, 15240, 18288, 21336, 24384, 27432,
+static const int decostoplevels_imperial[] = { 0, 3048, 6096, 9144, 12192, 15240, 18288, 21336, 24384, 27432,
 					30480, 33528, 36576, 39624, 42672, 45720, 48768, 51816, 54864, 57912,
 					60960, 64008, 67056, 70104, 73152, 76200, 79248, 82296, 85344, 88392,
 					91440, 101600, 111760, 121920, 132080, 142240, 152400, 162560, 172720,
@@ -104,7 +104,7 @@ static void interpolate_transition(struct deco_state *ds, struct dive *dive, dur
 
 	for (j = t0.seconds; j < t1.seconds; j++) {
 		int depth = interpolate(d0.mm, d1.mm, j - t0.seconds, t1.seconds - t0.seconds);
-		add_segment(ds, depth_to_bar(depth, dive), gasmix, 1, po2.mbar, divemode, prefs.bottomsac, true);
+		add_segment(ds, depth_to_bar(depth, dive), gasmix, 1, po2.mbar, divemode, prefs.bottomsac);
 	}
 	if (d1.mm > d0.mm)
 		calc_crushing_pressure(ds, depth_to_bar(d1.mm, dive));
@@ -125,7 +125,8 @@ static int tissue_at_end(struct deco_state *ds, struct dive *dive, const struct
 	if (cache) {
 		cache.restore(ds, true);
 	} else {
-		surface_interval = init_decompression(ds, dive, true);
+		struct deco_config config = ds->config;
+		surface_interval = init_decompression(ds, dive, &config);
 		cache.cache(ds);
 	}
 	if (!dc->samples)
@@ -134,6 +135,8 @@ static int tissue_at_end(struct deco_state *ds, struct dive *dive, const struct
 
 	const struct event *evdm = NULL;
 	enum divemode_t divemode = UNDEF_COMP_TYPE;
+	struct gas_change_table gases;
+	init_gas_change_table(&gases, dive, dc);
 
 	for (i = 0; i < dc->samples; i++, sample++) {
 		o2pressure_t setpoint;
@@ -144,7 +147,7 @@ static int tissue_at_end(struct deco_state *ds, struct dive *dive, const struct
 			setpoint = sample[0].setpoint;
 
 		t1 = sample->time;
-		gas = get_gasmix_at_time(dive, dc, t0);
+		gas = gas_change_table_at(&gases, t0.seconds);
 		if (i > 0)
 			lastdepth = psample->depth;
 
@@ -157,12 +160,12 @@ static int tissue_at_end(struct deco_state *ds, struct dive *dive, const struct
 		 * portion of the dive.
 		 * Remember the value for later.
 		 */
-		if ((decoMode(true) == VPMB) && (lastdepth.mm > sample->depth.mm)) {
+		if ((ds->config.mode == VPMB) && (lastdepth.mm > sample->depth.mm)) {
 			pressure_t ceiling_pressure;
 			nuclear_regeneration(ds, t0.seconds);
 			vpmb_start_gradient(ds);
 			ceiling_pressure.mbar = depth_to_mbar(deco_allowed_depth(tissue_tolerance_calc(ds, dive,
-													depth_to_bar(lastdepth.mm, dive), true),
+													depth_to_bar(lastdepth.mm, dive)),
 										dive->surface_pressure.mbar / 1000.0,
 										dive,
 										1),
@@ -176,6 +179,7 @@ static int tissue_at_end(struct deco_state *ds, struct dive *dive, const struct
 		psample = sample;
 		t0 = t1;
 	}
+	free_gas_change_table(&gases);
 	return surface_interval;
 }
 
@@ -552,9 +556,9 @@ static bool trial_ascent(struct deco_state *ds, int wait_time, int trial_depth,
 	if (wait_time)
 		add_segment(ds, depth_to_bar(trial_depth, dive),
 			    gasmix,
-			    wait_time, po2, divemode, prefs.decosac, true);
-	if (decoMode(true) == VPMB) {
-		double tolerance_limit = tissue_tolerance_calc(ds, dive, depth_to_bar(stoplevel, dive), true);
+			    wait_time, po2, divemode, prefs.decosac);
+	if (ds->config.mode == VPMB) {
+		double tolerance_limit = tissue_tolerance_calc(ds, dive, depth_to_bar(stoplevel, dive));
 		update_regression(ds, dive);
 		if (deco_allowed_depth(tolerance_limit, surface_pressure, dive, 1) > stoplevel) {
 			trial_cache.restore(ds, false);
@@ -569,9 +573,9 @@ static bool trial_ascent(struct deco_state *ds, int wait_time, int trial_depth,
 			deltad = trial_depth;
 		add_segment(ds, depth_to_bar(trial_depth, dive),
 			    gasmix,
-			    base_timestep, po2, divemode, prefs.decosac, true);
-		tolerance_limit = tissue_tolerance_calc(ds, dive, depth_to_bar(trial_depth, dive), true);
-		if (decoMode(true) == VPMB)
+			    base_timestep, po2, divemode, prefs.decosac);
+		tolerance_limit = tissue_tolerance_calc(ds, dive, depth_to_bar(trial_depth, dive));
+		if (ds->config.mode == VPMB)
 			update_regression(ds, dive);
 		if (deco_allowed_depth(tolerance_limit, surface_pressure, dive, 1) > trial_depth - deltad) {
 			/* We should have stopped */
@@ -651,7 +655,8 @@ static void average_max_depth(struct diveplan *dive, int *avg_depth, int *max_de
 		*avg_depth = *max_depth = 0;
 }
 
-bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int dcNr, int timestep, struct decostop *decostoptable, deco_state_cache &cache, bool is_planner, bool show_disclaimer)
+bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int dcNr, int timestep, struct decostop *decostoptable, deco_state_cache &cache, bool is_planner, bool show_disclaimer,
+	  const std::function<bool()> &cancelled)
 {
 
 	int bottom_depth;
@@ -667,8 +672,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	int current_cylinder, stop_cylinder;
 	size_t stopidx;
 	int depth;
-	int *decostoplevels;
-	size_t decostoplevelcount;
+	std::vector<int> decostoplevels;
 	std::vector<int> stoplevels;
 	bool stopping = false;
 	bool pendinggaschange = false;
@@ -689,8 +693,11 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	struct divecomputer *dc = get_dive_dc(dive, dcNr);
 	enum divemode_t divemode = dc->divemode;
 
-	set_gf(diveplan->gflow, diveplan->gfhigh);
-	set_vpmb_conservatism(diveplan->vpmb_conservatism);
+	struct deco_config config;
+
+	init_deco_config(&config, true);
+	set_gf(&config, diveplan->gflow, diveplan->gfhigh);
+	set_vpmb_conservatism(&config, diveplan->vpmb_conservatism);
 
 	if (!diveplan->surface_pressure) {
 		// Lets use dive's surface pressure in planner, if have one...
@@ -705,27 +712,20 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 		}
 	}
 
-	clear_deco(ds, dive->surface_pressure.mbar / 1000.0, true);
+	clear_deco(ds, &config, dive->surface_pressure.mbar / 1000.0);
 	ds->max_bottom_ceiling_pressure.mbar = ds->first_ceiling_pressure.mbar = 0;
 	create_dive_from_plan(diveplan, dive, dc, is_planner);
 
 	// Do we want deco stop array in metres or feet?
-	if (prefs.units.length == units::METERS ) {
-		decostoplevels = decostoplevels_metric;
-		decostoplevelcount = std::size(decostoplevels_metric);
-	} else {
-		decostoplevels = decostoplevels_imperial;
-		decostoplevelcount = std::size(decostoplevels_imperial);
-	}
+	// This is a copy, because plan() may run in several threads at once.
+	if (prefs.units.length == units::METERS )
+		decostoplevels.assign(std::begin(decostoplevels_metric), std::end(decostoplevels_metric));
+	else
+		decostoplevels.assign(std::begin(decostoplevels_imperial), std::end(decostoplevels_imperial));
 
-	/* If the user has selected last stop to be at 6m/20', we need to get rid of the 3m/10' stop.
-	 * Otherwise reinstate the last stop 3m/10' stop.
-	 * Remark: not reentrant, but the user probably won't change preferences while this is running.
-	 */
+	/* If the user has selected last stop to be at 6m/20', we need to get rid of the 3m/10' stop. */
 	if (prefs.last_stop)
-		*(decostoplevels + 1) = 0;
-	else
-		*(decostoplevels + 1) = M_OR_FT(3,10);
+		decostoplevels[1] = 0;
 
 	/* Let's start at the last 'sample', i.e. the last manually entered waypoint. */
 	sample = &dc->sample[dc->samples - 1];
@@ -767,13 +767,13 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	std::vector<gaschanges> gaschanges = analyze_gaslist(diveplan, dive, depth, &best_first_ascend_cylinder, divemode == CCR && !prefs.dobailout);
 
 	/* Find the first potential decostopdepth above current depth */
-	for (stopidx = 0; stopidx < decostoplevelcount; stopidx++)
+	for (stopidx = 0; stopidx < decostoplevels.size(); stopidx++)
 		if (decostoplevels[stopidx] > depth)
 			break;
 	if (stopidx > 0)
 		stopidx--;
 	/* Stoplevels are either depths of gas changes or potential deco stop depths. */
-	stoplevels = sort_stops(decostoplevels, stopidx + 1, gaschanges);
+	stoplevels = sort_stops(decostoplevels.data(), stopidx + 1, gaschanges);
 	stopidx += gaschanges.size();
 
 	gi = static_cast<int>(gaschanges.size()) - 1;
@@ -782,14 +782,14 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	diveplan->surface_interval = tissue_at_end(ds, dive, dc, cache);
 	nuclear_regeneration(ds, clock);
 	vpmb_start_gradient(ds);
-	if (decoMode(true) == RECREATIONAL) {
+	if (ds->config.mode == RECREATIONAL) {
 		bool safety_stop = prefs.safetystop && max_depth >= 10000;
 		track_ascent_gas(depth, dive, current_cylinder, avg_depth, bottom_time, safety_stop, divemode);
 		// How long can we stay at the current depth and still directly ascent to the surface?
 		do {
 			add_segment(ds, depth_to_bar(depth, dive),
 				    get_cylinder(dive, current_cylinder)->gasmix,
-				    timestep, po2, divemode, prefs.bottomsac, true);
+				    timestep, po2, divemode, prefs.bottomsac);
 			update_cylinder_pressure(dive, depth, depth, timestep, prefs.bottomsac, get_cylinder(dive, current_cylinder), false, divemode);
 			clock += timestep;
 		} while (trial_ascent(ds, 0, depth, 0, avg_depth, bottom_time, get_cylinder(dive, current_cylinder)->gasmix,
@@ -852,7 +852,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 		int bailoutsegment = std::max(prefs.min_switch_duration, 60 * prefs.problemsolvingtime);
 		add_segment(ds, depth_to_bar(depth, dive),
 			get_cylinder(dive, current_cylinder)->gasmix,
-			bailoutsegment, po2, divemode, prefs.bottomsac, true);
+			bailoutsegment, po2, divemode, prefs.bottomsac);
 		plan_add_segment(diveplan, bailoutsegment, depth, current_cylinder, po2, false, divemode);
 		bottom_time += bailoutsegment;
 	}
@@ -867,9 +867,9 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	//CVA
 	do {
 		decostopcounter = 0;
-		is_final_plan = (decoMode(true) == BUEHLMANN) || (previous_deco_time - ds->deco_time < 10);  // CVA time converges
+		is_final_plan = (ds->config.mode == BUEHLMANN) || (previous_deco_time - ds->deco_time < 10);  // CVA time converges
 		if (ds->deco_time != 10000000)
-			vpmb_next_gradient(ds, ds->deco_time, diveplan->surface_pressure / 1000.0, true);
+			vpmb_next_gradient(ds, ds->deco_time, diveplan->surface_pressure / 1000.0);
 
 		previous_deco_time = ds->deco_time;
 		bottom_cache.restore(ds, true);
@@ -883,7 +883,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 		first_stop_depth = 0;
 		stopidx = bottom_stopidx;
 		ds->first_ceiling_pressure.mbar = depth_to_mbar(
-					deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(depth, dive), true),
+					deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(depth, dive)),
 							   diveplan->surface_pressure / 1000.0, dive, 1),
 					dive);
 		if (ds->max_bottom_ceiling_pressure.mbar > ds->first_ceiling_pressure.mbar)
@@ -897,11 +897,18 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 		else
 			current_cylinder = get_gasidx(dive, gas);
 		if (current_cylinder == -1) {
-			report_error(translate("gettextFromC", "Can't find gas %s"), gasname(gas));
+			char gas_string[64];	// not gasname(): its static buffer isn't thread safe
+			get_gas_string(gas, gas_string, sizeof(gas_string));
+			report_error(translate("gettextFromC", "Can't find gas %s"), gas_string);
 			current_cylinder = 0;
 		}
 		reset_regression(ds);
 		while (1) {
+			/* The caller isn't interested in the result anymore. The plan is left incomplete. */
+			if (cancelled && cancelled()) {
+				decostoptable[decostopcounter].depth = 0;
+				return false;
+			}
 			/* We will break out when we hit the surface */
 			do {
 				/* Ascend to next stop depth */
@@ -918,7 +925,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 
 				add_segment(ds, depth_to_bar(depth, dive),
 								get_cylinder(dive, current_cylinder)->gasmix,
-								base_timestep, po2, divemode, prefs.decosac, true);
+								base_timestep, po2, divemode, prefs.decosac);
 				last_segment_min_switch = false;
 				clock += base_timestep;
 				depth -= deltad;
@@ -959,7 +966,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 						if (!last_segment_min_switch && get_o2(get_cylinder(dive, current_cylinder)->gasmix) != 1000) {
 							add_segment(ds, depth_to_bar(depth, dive),
 								get_cylinder(dive, current_cylinder)->gasmix,
-								prefs.min_switch_duration, po2, divemode, prefs.decosac, true);
+								prefs.min_switch_duration, po2, divemode, prefs.decosac);
 							clock += prefs.min_switch_duration;
 							last_segment_min_switch = true;
 						}
@@ -1015,7 +1022,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 					if (!last_segment_min_switch && get_o2(get_cylinder(dive, current_cylinder)->gasmix) != 1000) {
 						add_segment(ds, depth_to_bar(depth, dive),
 							get_cylinder(dive, current_cylinder)->gasmix,
-							prefs.min_switch_duration, po2, divemode, prefs.decosac, true);
+							prefs.min_switch_duration, po2, divemode, prefs.decosac);
 						clock += prefs.min_switch_duration;
 					}
 					pendinggaschange = false;
@@ -1068,7 +1075,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 					}
 				}
 				add_segment(ds, depth_to_bar(depth, dive), get_cylinder(dive, stop_cylinder)->gasmix,
-					    laststoptime, po2, divemode, prefs.decosac, true);
+					    laststoptime, po2, divemode, prefs.decosac);
 				last_segment_min_switch = false;
 				decostoptable[decostopcounter].depth = depth;
 				decostoptable[decostopcounter].time = laststoptime;
@@ -1095,7 +1102,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	decostoptable[decostopcounter].depth = 0;
 
 	plan_add_segment(diveplan, clock - previous_point_time, 0, current_cylinder, po2, false, divemode);
-	if (decoMode(true) == VPMB) {
+	if (ds->config.mode == VPMB) {
 		diveplan->eff_gfhigh = lrint(100.0 * regressionb(ds));
 		diveplan->eff_gflow = lrint(100.0 * (regressiona(ds) * first_stop_depth + regressionb(ds)));
 	}
@@ -58,8 +58,12 @@ struct decostop {
 #ifdef __cplusplus
 }
 
+#include <functional>
 #include <string>
 extern std::string get_planner_disclaimer_formatted();
-extern bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int dcNr, int timestep, struct decostop *decostoptable, deco_state_cache &cache, bool is_planner, bool show_disclaimer);
+// If cancelled is given, it is polled during the ascent and planning is aborted
+// as soon as it returns true. In that case the dive and the plan are incomplete.
+extern bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int dcNr, int timestep, struct decostop *decostoptable, deco_state_cache &cache, bool is_planner, bool show_disclaimer,
+		 const std::function<bool()> &cancelled = {});
 #endif
 #endif // PLANNER_H
@@ -20,6 +20,7 @@
 #include "profile.h"
 #include "gaspressures.h"
 #include "deco.h"
+#include "decocache.h"
 #include "errorhelper.h"
 #include "libdivecomputer/parser.h"
 #include "libdivecomputer/version.h"
@@ -27,6 +28,10 @@
 #include "qthelper.h"
 #include "format.h"
 
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
 //#define DEBUG_GAS 1
 
 #define MAX_PROFILE_DECO 7200
@@ -844,7 +849,7 @@ static void setup_gas_sensor_pressure(const struct dive *dive, const struct dive
 
 /* calculate DECO STOP / TTS / NDL */
 static void calculate_ndl_tts(struct deco_state *ds, const struct dive *dive, struct plot_data *entry, struct gasmix gasmix,
-			      double surface_pressure, enum divemode_t divemode, bool in_planner)
+			      double surface_pressure, enum divemode_t divemode)
 {
 	/* should this be configurable? */
 	/* ascent speed up to first deco stop */
@@ -855,7 +860,7 @@ static void calculate_ndl_tts(struct deco_state *ds, const struct dive *dive, st
 	const int deco_stepsize = M_OR_FT(3, 10);
 	/* at what depth is the current deco-step? */
 	int next_stop = round_up(deco_allowed_depth(
-					 tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive), in_planner),
+					 tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive)),
 					 surface_pressure, dive, 1), deco_stepsize);
 	int ascent_depth = entry->depth;
 	/* at what time should we give up and say that we got enuff NDL? */
@@ -871,12 +876,12 @@ static void calculate_ndl_tts(struct deco_state *ds, const struct dive *dive, st
 		}
 		/* stop if the ndl is above max_ndl seconds, and call it plenty of time */
 		while (entry->ndl_calc < MAX_PROFILE_DECO &&
-		       deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive), in_planner),
+		       deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive)),
 					  surface_pressure, dive, 1) <= 0
 		       ) {
 			entry->ndl_calc += time_stepsize;
 			add_segment(ds, depth_to_bar(entry->depth, dive),
-				    gasmix, time_stepsize, entry->o2pressure.mbar, divemode, prefs.bottomsac, in_planner);
+				    gasmix, time_stepsize, entry->o2pressure.mbar, divemode, prefs.bottomsac);
 		}
 		/* we don't need to calculate anything else */
 		return;
@@ -888,8 +893,8 @@ static void calculate_ndl_tts(struct deco_state *ds, const struct dive *dive, st
 	/* Add segments for movement to stopdepth */
 	for (; ascent_depth > next_stop; ascent_depth -= ascent_s_per_step * ascent_velocity(ascent_depth, entry->running_sum / entry->sec, 0), entry->tts_calc += ascent_s_per_step) {
 		add_segment(ds, depth_to_bar(ascent_depth, dive),
-			    gasmix, ascent_s_per_step, entry->o2pressure.mbar, divemode, prefs.decosac, in_planner);
-		next_stop = round_up(deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(ascent_depth, dive), in_planner),
+			    gasmix, ascent_s_per_step, entry->o2pressure.mbar, divemode, prefs.decosac);
+		next_stop = round_up(deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(ascent_depth, dive)),
 							surface_pressure, dive, 1), deco_stepsize);
 	}
 	ascent_depth = next_stop;
@@ -909,13 +914,13 @@ static void calculate_ndl_tts(struct deco_state *ds, const struct dive *dive, st
 		if (entry->tts_calc > MAX_PROFILE_DECO)
 			break;
 		add_segment(ds, depth_to_bar(ascent_depth, dive),
-			    gasmix, time_stepsize, entry->o2pressure.mbar, divemode, prefs.decosac, in_planner);
+			    gasmix, time_stepsize, entry->o2pressure.mbar, divemode, prefs.decosac);
 
-		if (deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(ascent_depth,dive), in_planner), surface_pressure, dive, 1) <= next_stop) {
+		if (deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(ascent_depth,dive)), surface_pressure, dive, 1) <= next_stop) {
 			/* move to the next stop and add the travel between stops */
 			for (; ascent_depth > next_stop; ascent_depth -= ascent_s_per_deco_step * ascent_velocity(ascent_depth, entry->running_sum / entry->sec, 0), entry->tts_calc += ascent_s_per_deco_step)
 				add_segment(ds, depth_to_bar(ascent_depth, dive),
-					    gasmix, ascent_s_per_deco_step, entry->o2pressure.mbar, divemode, prefs.decosac, in_planner);
+					    gasmix, ascent_s_per_deco_step, entry->o2pressure.mbar, divemode, prefs.decosac);
 			ascent_depth = next_stop;
 			next_stop -= deco_stepsize;
 		}
@@ -941,9 +946,8 @@ static void calculate_deco_information(struct deco_state *ds, const struct deco_
 		ds->first_ceiling_pressure = planner_ds->first_ceiling_pressure;
 	}
 	deco_state_cache cache_data_initial;
-	lock_planner();
 	/* For VPM-B outside the planner, cache the initial deco state for CVA iterations */
-	if (decoMode(in_planner) == VPMB) {
+	if (ds->config.mode == VPMB) {
 		cache_data_initial.cache(ds);
 	}
 	/* For VPM-B outside the planner, iterate until deco time converges (usually one or two iterations after the initial)
@@ -951,7 +955,7 @@ static void calculate_deco_information(struct deco_state *ds, const struct deco_
 
 	while ((abs(prev_deco_time - ds->deco_time) >= 30) && (count_iteration < 10)) {
 		int last_ndl_tts_calc_time = 0, first_ceiling = 0, current_ceiling, last_ceiling = 0, final_tts = 0 , time_clear_ceiling = 0;
-		if (decoMode(in_planner) == VPMB)
+		if (ds->config.mode == VPMB)
 			ds->first_ceiling_pressure.mbar = depth_to_mbar(first_ceiling, dive);
 		struct gasmix gasmix = gasmix_invalid;
 		const struct event *ev = NULL, *evd = NULL;
@@ -977,7 +981,7 @@ static void calculate_deco_information(struct deco_state *ds, const struct deco_
 			for (j = t0 + time_stepsize; j <= t1; j += time_stepsize) {
 				int depth = interpolate(entry[-1].depth, entry[0].depth, j - t0, t1 - t0);
 				add_segment(ds, depth_to_bar(depth, dive),
-					    gasmix, time_stepsize, entry->o2pressure.mbar, current_divemode, entry->sac, in_planner);
+					    gasmix, time_stepsize, entry->o2pressure.mbar, current_divemode, entry->sac);
 				entry->icd_warning = ds->icd_warning;
 				if ((t1 - j < time_stepsize) && (j < t1))
 					time_stepsize = t1 - j;
@@ -986,21 +990,21 @@ static void calculate_deco_information(struct deco_state *ds, const struct deco_
 				entry->ceiling = (entry - 1)->ceiling;
 			} else {
 				/* Keep updating the VPM-B gradients until the start of the ascent phase of the dive. */
-				if (decoMode(in_planner) == VPMB && last_ceiling >= first_ceiling && first_iteration == true) {
+				if (ds->config.mode == VPMB && last_ceiling >= first_ceiling && first_iteration == true) {
 					nuclear_regeneration(ds, t1);
 					vpmb_start_gradient(ds);
 					/* For CVA iterations, calculate next gradient */
 					if (!first_iteration || in_planner)
-						vpmb_next_gradient(ds, ds->deco_time, surface_pressure / 1000.0, in_planner);
+						vpmb_next_gradient(ds, ds->deco_time, surface_pressure / 1000.0);
 				}
-				entry->ceiling = deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive), in_planner), surface_pressure, dive, !prefs.calcceiling3m);
+				entry->ceiling = deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive)), surface_pressure, dive, !prefs.calcceiling3m);
 				if (prefs.calcceiling3m)
-					current_ceiling = deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive), in_planner), surface_pressure, dive, true);
+					current_ceiling = deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive)), surface_pressure, dive, true);
 				else
 					current_ceiling = entry->ceiling;
 				last_ceiling = current_ceiling;
 				/* If using VPM-B, take first_ceiling_pressure as the deepest ceiling */
-				if (decoMode(in_planner) == VPMB) {
+				if (ds->config.mode == VPMB) {
 					if  (current_ceiling >= first_ceiling ||
 					     (time_deep_ceiling == t0 && entry->depth == (entry - 1)->depth)) {
 						time_deep_ceiling = t1;
@@ -1014,7 +1018,7 @@ static void calculate_deco_information(struct deco_state *ds, const struct deco_
 							   converges correctly, so add 30min*/
 							if (!in_planner)
 								ds->deco_time = pi->maxtime - t1 + 1800;
-							vpmb_next_gradient(ds, ds->deco_time, surface_pressure / 1000.0, in_planner);
+							vpmb_next_gradient(ds, ds->deco_time, surface_pressure / 1000.0);
 						}
 					}
 					// Use the point where the ceiling clears as the end of deco phase for CVA calculations
@@ -1061,8 +1065,8 @@ static void calculate_deco_information(struct deco_state *ds, const struct deco_
 			* We don't for print-mode because this info doesn't show up there
 			* If the ceiling hasn't cleared by the last data point, we need tts for VPM-B CVA calculation
 			* It is not necessary to do these calculation on the first VPMB iteration, except for the last data point */
-			if ((prefs.calcndltts && (decoMode(in_planner) != VPMB || in_planner || !first_iteration)) ||
-			    (decoMode(in_planner) == VPMB && !in_planner && i == pi->nr - 1)) {
+			if ((prefs.calcndltts && (ds->config.mode != VPMB || in_planner || !first_iteration)) ||
+			    (ds->config.mode == VPMB && !in_planner && i == pi->nr - 1)) {
 				/* only calculate ndl/tts on every 30 seconds */
 				if ((entry->sec - last_ndl_tts_calc_time) < 30 && i != pi->nr - 1) {
 					struct plot_data *prev_entry = (entry - 1);
@@ -1077,14 +1081,14 @@ static void calculate_deco_information(struct deco_state *ds, const struct deco_
 				/* We are going to mess up deco state, so store it for later restore */
 				deco_state_cache cache_data;
 				cache_data.cache(ds);
-				calculate_ndl_tts(ds, dive, entry, gasmix, surface_pressure, current_divemode, in_planner);
-				if (decoMode(in_planner) == VPMB && !in_planner && i == pi->nr - 1)
+				calculate_ndl_tts(ds, dive, entry, gasmix, surface_pressure, current_divemode);
+				if (ds->config.mode == VPMB && !in_planner && i == pi->nr - 1)
 					final_tts = entry->tts_calc;
 				/* Restore "real" deco state for next real time step */
-				cache_data.restore(ds, decoMode(in_planner) == VPMB);
+				cache_data.restore(ds, ds->config.mode == VPMB);
 			}
 		}
-		if (decoMode(in_planner) == VPMB && !in_planner) {
+		if (ds->config.mode == VPMB && !in_planner) {
 			int this_deco_time;
 			prev_deco_time = ds->deco_time;
 			// Do we need to update deco_time?
@@ -1096,7 +1100,7 @@ static void calculate_deco_information(struct deco_state *ds, const struct deco_
 				 * comes typically 10-60s after the end of the bottom time, so add 20s to the calculated
 				 * deco time. */
 					ds->deco_time = round_up(time_clear_ceiling - time_deep_ceiling + 20, 60) + 20;
-			vpmb_next_gradient(ds, ds->deco_time, surface_pressure / 1000.0, in_planner);
+			vpmb_next_gradient(ds, ds->deco_time, surface_pressure / 1000.0);
 			final_tts = 0;
 			last_ndl_tts_calc_time = 0;
 			first_ceiling = 0;
@@ -1114,7 +1118,6 @@ static void calculate_deco_information(struct deco_state *ds, const struct deco_
 #if DECO_CALC_DEBUG & 1
 	dump_tissues(ds);
 #endif
-	unlock_planner();
 }
 
 /* Sort the o2 pressure values. There are so few that a simple bubble sort
@@ -1320,8 +1323,13 @@ extern "C" void create_plot_info_new(const struct dive *dive, const struct divec
 {
 	int o2, he, o2max;
 	struct deco_state plot_deco_state;
+	struct deco_config config;
 	bool in_planner = planner_ds != NULL;
-	init_decompression(&plot_deco_state, dive, in_planner);
+	if (in_planner)
+		config = planner_ds->config;
+	else
+		init_deco_config(&config, false);
+	init_decompression(&plot_deco_state, dive, &config);
 	free_plot_info_data(pi);
 	calculate_max_limits_new(dive, dc, pi, in_planner);
 	get_dive_gas(dive, &o2, &he, &o2max);
@@ -1357,6 +1365,117 @@ extern "C" void create_plot_info_new(const struct dive *dive, const struct divec
 	analyze_plot_info(pi);
 }
 
+/*
+ * The profile is replotted on resizing, zooming and when display items are
+ * toggled. Moreover, users often switch back and forth between a few dives.
+ * Therefore, keep the plot info of the most recently shown dives, because
+ * calculating the deco information is expensive.
+ *
+ * An entry is valid as long as the deco cache generation didn't change, i.e.
+ * no dive of the log was changed, added or removed, and as long as the settings
+ * that enter the calculation are unchanged. Since only dives in the dive list
+ * invalidate the generation, other dives (copies, planned dives) are not cached.
+ */
+namespace {
+struct plot_info_settings {
+	enum deco_mode mode;
+	int gflow, gfhigh, vpmb_conservatism;
+	bool calcceiling3m, calcndltts, show_icd;
+	int bottomsac, decosac, o2consumption, pscr_ratio;
+	double modpO2;
+	int ascrate75, ascrate50, ascratestops, ascratelast6m;	// used for TTS and NDL
+
+	static plot_info_settings current()
+	{
+		return { decoMode(false), prefs.gflow, prefs.gfhigh, prefs.vpmb_conservatism,
+			 prefs.calcceiling3m, prefs.calcndltts, prefs.show_icd,
+			 prefs.bottomsac, prefs.decosac, prefs.o2consumption, prefs.pscr_ratio,
+			 prefs.modpO2, prefs.ascrate75, prefs.ascrate50, prefs.ascratestops,
+			 prefs.ascratelast6m };
+	}
+	bool operator==(const plot_info_settings &s) const
+	{
+		return mode == s.mode && gflow == s.gflow && gfhigh == s.gfhigh &&
+		       vpmb_conservatism == s.vpmb_conservatism && calcceiling3m == s.calcceiling3m &&
+		       calcndltts == s.calcndltts && show_icd == s.show_icd && bottomsac == s.bottomsac &&
+		       decosac == s.decosac && o2consumption == s.o2consumption &&
+		       pscr_ratio == s.pscr_ratio && modpO2 == s.modpO2 &&
+		       ascrate75 == s.ascrate75 && ascrate50 == s.ascrate50 &&
+		       ascratestops == s.ascratestops && ascratelast6m == s.ascratelast6m;
+	}
+};
+
+struct plot_info_cache_entry {
+	const struct dive *dive;
+	int id;
+	int dcNr;
+	uint64_t generation;
+	plot_info_settings settings;
+	struct plot_info pi;
+};
+}
+
+static const size_t plot_info_cache_size = 8;
+static std::mutex plot_info_cache_lock;
+static std::vector<plot_info_cache_entry> plot_info_cache; // Most recently used last
+
+static void copy_plot_info(const struct plot_info *src, struct plot_info *dst)
+{
+	size_t nr_pressures = (size_t)src->nr * (size_t)src->nr_cylinders;
+	free_plot_info_data(dst);
+	*dst = *src;
+	dst->entry = (struct plot_data *)malloc(src->nr * sizeof(struct plot_data));
+	dst->pressures = (struct plot_pressure_data *)malloc(nr_pressures * sizeof(struct plot_pressure_data));
+	memcpy(dst->entry, src->entry, src->nr * sizeof(struct plot_data));
+	memcpy(dst->pressures, src->pressures, nr_pressures * sizeof(struct plot_pressure_data));
+}
+
+extern "C" void create_plot_info_cached(const struct dive *dive, const struct divecomputer *dc, struct plot_info *pi)
+{
+	if (get_dive(get_divenr(dive)) != dive) {
+		create_plot_info_new(dive, dc, pi, NULL);
+		return;
+	}
+
+	int dcNr = 0;
+	for (const struct divecomputer *it = &dive->dc; it && it != dc; it = it->next)
+		++dcNr;
+	uint64_t generation = deco_cache_generation();
+	plot_info_settings settings = plot_info_settings::current();
+
+	std::lock_guard<std::mutex> guard(plot_info_cache_lock);
+	for (auto it = plot_info_cache.begin(); it != plot_info_cache.end(); ++it) {
+		if (it->dive != dive || it->id != dive->id || it->dcNr != dcNr)
+			continue;
+		if (it->generation == generation && it->settings == settings) {
+			copy_plot_info(&it->pi, pi);
+			std::rotate(it, it + 1, plot_info_cache.end());
+			return;
+		}
+		free_plot_info_data(&it->pi);
+		plot_info_cache.erase(it);
+		break;
+	}
+
+	create_plot_info_new(dive, dc, pi, NULL);
+
+	if (plot_info_cache.size() >= plot_info_cache_size) {
+		free_plot_info_data(&plot_info_cache.front().pi);
+		plot_info_cache.erase(plot_info_cache.begin());
+	}
+	plot_info_cache_entry entry { dive, dive->id, dcNr, generation, settings, { 0 } };
+	copy_plot_info(pi, &entry.pi);
+	plot_info_cache.push_back(entry);
+}
+
+extern "C" void plot_info_cache_clear()
+{
+	std::lock_guard<std::mutex> guard(plot_info_cache_lock);
+	for (plot_info_cache_entry &entry: plot_info_cache)
+		free_plot_info_data(&entry.pi);
+	plot_info_cache.clear();
+}
+
 static std::vector<std::string> plot_string(const struct dive *d, const struct plot_info *pi, int idx)
 {
 	int pressurevalue, mod, ead, end, eadd;
@@ -101,6 +101,9 @@ extern void init_plot_info(struct plot_info *pi);
 /* when planner_dc is non-null, this is called in planner mode. */
 extern void create_plot_info_new(const struct dive *dive, const struct divecomputer *dc, struct plot_info *pi, const struct deco_state *planner_ds);
 extern void free_plot_info_data(struct plot_info *pi);
+/* like create_plot_info_new() outside of the planner, but reuses the plot info of recently shown dives */
+extern void create_plot_info_cached(const struct dive *dive, const struct divecomputer *dc, struct plot_info *pi);
+extern void plot_info_cache_clear(void);
 
 /*
  * When showing dive profiles, we scale things to the
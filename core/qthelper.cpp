@@ -1069,6 +1069,11 @@ QString thumbnailFileName(const QString &filename)
 	return thumbnailDir() + hash.result().toHex();
 }
 
+QString thumbnailStoreFileName()
+{
+	return thumbnailDir() + "thumbnails";
+}
+
 extern "C" char *hashfile_name_string()
 {
 	return copy_qstring(hashfile_name());
@@ -40,6 +40,7 @@ QStringList stringToList(const QString &s);
 void read_hashes();
 void write_hashes();
 QString thumbnailFileName(const QString &filename);
+QString thumbnailStoreFileName();
 void learnPictureFilename(const QString &originalName, const QString &localName);
 QString localFilePath(const QString &originalFilename);
 std::optional<std::string> getCloudURL(); // move to prefs.h, probably.
@@ -16,7 +16,11 @@
 #include <fcntl.h>
 #include <git2.h>
 #include <memory>
+#include <unordered_map>
+#include <vector>
+#include <QtConcurrent>
 
+#include "compressedsamples.h"
 #include "dive.h"
 #include "divelog.h"
 #include "divesite.h"
@@ -232,7 +236,8 @@ static void show_date(struct membuffer *b, timestamp_t when)
 
 static void show_integer(struct membuffer *b, int value, const char *pre, const char *post)
 {
-	put_format(b, " %s%d%s", pre, value, post);
+	put_string(b, " ");
+	put_int(b, pre, value, post);
 }
 
 static void show_index(struct membuffer *b, int value, const char *pre, const char *post)
@@ -247,11 +252,11 @@ static void show_index(struct membuffer *b, int value, const char *pre, const ch
  *
  * For parsing, look at the units to figure out what the numbers are.
  */
-static void save_sample(struct membuffer *b, struct sample *sample, struct sample *old, int o2sensor)
+static void save_sample(struct membuffer *b, const struct sample *sample, struct sample *old, int o2sensor)
 {
 	int idx;
 
-	put_format(b, "%3u:%02u", FRACTION_TUPLE(sample->time.seconds, 60));
+	put_mmss(b, "", sample->time.seconds, 3, "");
 	put_milli(b, " ", sample->depth.mm, "m");
 	put_temperature(b, sample->temperature, " ", "°C");
 
@@ -280,7 +285,7 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 			 * mode, and "old->sensor[0]" contains that index.
 			 */
 			if (sensor != old->sensor[0]) {
-				put_format(b, " sensor=%d", sensor);
+				put_int(b, " sensor=", sensor, "");
 				old->sensor[0] = sensor;
 			}
 			continue;
@@ -288,24 +293,24 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 
 		/* The new-style format is much simpler: the sensor is always encoded */
 		put_pressure(b, p, " ", "bar");
-		put_format(b, ":%d", sensor);
+		put_int(b, ":", sensor, "");
 	}
 
 	/* the deco/ndl values are stored whenever they change */
 	if (sample->ndl.seconds != old->ndl.seconds) {
-		put_format(b, " ndl=%u:%02u", FRACTION_TUPLE(sample->ndl.seconds, 60));
+		put_mmss(b, " ndl=", sample->ndl.seconds, 0, "");
 		old->ndl = sample->ndl;
 	}
 	if (sample->tts.seconds != old->tts.seconds) {
-		put_format(b, " tts=%u:%02u", FRACTION_TUPLE(sample->tts.seconds, 60));
+		put_mmss(b, " tts=", sample->tts.seconds, 0, "");
 		old->tts = sample->tts;
 	}
 	if (sample->in_deco != old->in_deco) {
-		put_format(b, " in_deco=%d", sample->in_deco ? 1 : 0);
+		put_int(b, " in_deco=", sample->in_deco ? 1 : 0, "");
 		old->in_deco = sample->in_deco;
 	}
 	if (sample->stoptime.seconds != old->stoptime.seconds) {
-		put_format(b, " stoptime=%u:%02u", FRACTION_TUPLE(sample->stoptime.seconds, 60));
+		put_mmss(b, " stoptime=", sample->stoptime.seconds, 0, "");
 		old->stoptime = sample->stoptime;
 	}
 
@@ -315,12 +320,12 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 	}
 
 	if (sample->cns != old->cns) {
-		put_format(b, " cns=%u%%", sample->cns);
+		put_uint(b, " cns=", sample->cns, "%");
 		old->cns = sample->cns;
 	}
 
 	if (sample->rbt.seconds != old->rbt.seconds) {
-		put_format(b, " rbt=%u:%02u", FRACTION_TUPLE(sample->rbt.seconds, 60));
+		put_mmss(b, " rbt=", sample->rbt.seconds, 0, "");
 		old->rbt.seconds = sample->rbt.seconds;
 	}
 
@@ -366,14 +371,13 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 		show_index(b, sample->bearing.degrees, "bearing=", "°");
 		old->bearing.degrees = sample->bearing.degrees;
 	}
-	put_format(b, "\n");
+	put_string(b, "\n");
 }
 
 static void save_samples(struct membuffer *b, struct dive *dive, struct divecomputer *dc)
 {
-	int nr;
 	int o2sensor;
-	struct sample *s;
+	const struct sample *s;
 	struct sample dummy;
 
 	/* Is this a CCR dive with the old-style "o2pressure" sensor? */
@@ -383,12 +387,10 @@ static void save_samples(struct membuffer *b, struct dive *dive, struct divecomp
 		dummy.sensor[1] = o2sensor;
 	}
 
-	s = dc->sample;
-	nr = dc->samples;
-	while (--nr >= 0) {
+	/* The samples may be packed, see pack_samples() */
+	sample_iterator it(dc);
+	while ((s = it.next()) != NULL)
 		save_sample(b, s, &dummy, o2sensor);
-		s++;
-	}
 }
 
 static void save_one_event(struct membuffer *b, struct dive *dive, struct event *ev)
@@ -621,16 +623,68 @@ static int blob_insert(git_repository *repo, struct dir *tree, struct membuffer
 	return ret;
 }
 
-static int save_one_divecomputer(git_repository *repo, struct dir *tree, struct dive *dive, struct divecomputer *dc, int idx)
-{
+/*
+ * The text files of the dives that have to be written are created and
+ * written to the object database in parallel, before the tree is built.
+ * The tree is then built in the same order as before from the resulting
+ * blob ids, so that it doesn't depend on the order the threads ran in.
+ * Dives that are not in the map must be unchanged and are saved as cached
+ * trees.
+ */
+struct dive_blobs {
+	struct dive *dive;
 	int ret;
-	struct membufferpp buf;
+	git_oid dive_id;
+	std::vector<git_oid> dc_ids;
+};
+using dive_blob_map = std::unordered_map<const struct dive *, const dive_blobs *>;
 
-	save_dc(&buf, dive, dc);
-	ret = blob_insert(repo, tree, &buf, "Divecomputer%c%03u", idx ? '-' : 0, idx);
-	if (ret)
-		report_error("divecomputer tree insert failed");
-	return ret;
+static int write_blob(git_odb *odb, git_oid *id, const struct membuffer *b)
+{
+	return git_odb_write(id, odb, b->buffer, b->len, GIT_OBJ_BLOB);
+}
+
+/*
+ * The blobs of dive computers that were not changed since they were loaded
+ * or saved are still in the repository and are not written again, see
+ * invalidate_dive_cache_except_dcs(). The blobs of the written dive computers
+ * are remembered for the next save.
+ */
+static void create_dive_blobs(git_odb *odb, dive_blobs &blobs, bool cached_ok)
+{
+	struct dive *dive = blobs.dive;
+	struct divecomputer *dc;
+
+	{
+		membufferpp buf;
+		create_dive_buffer(dive, &buf);
+		blobs.ret = write_blob(odb, &blobs.dive_id, &buf);
+	}
+
+	for (dc = &dive->dc; dc; dc = dc->next) {
+		git_oid id;
+		if (cached_ok && dc_cache_is_valid(dc)) {
+			git_oid_fromraw(&id, dc->git_id);
+		} else {
+			membufferpp buf;
+			save_dc(&buf, dive, dc);
+			int ret = write_blob(odb, &id, &buf);
+			if (ret && !blobs.ret)
+				blobs.ret = ret;
+			if (!ret)
+				memcpy(dc->git_id, id.id, 20);
+		}
+		blobs.dc_ids.push_back(id);
+	}
+}
+
+static int insert_blob(struct dir *tree, const git_oid *id, const char *fmt, ...)
+{
+	struct membufferpp name;
+	git_oid blob_id = *id;
+
+	VA_BUF(&name, fmt);
+	return tree_insert(tree->files, mb_cstring(&name), 1, &blob_id, GIT_FILEMODE_BLOB);
 }
 
 static int save_one_picture(git_repository *repo, struct dir *dir, struct picture *pic)
@@ -667,10 +721,9 @@ static int save_pictures(git_repository *repo, struct dir *dir, struct dive *div
 	return 0;
 }
 
-static int save_one_dive(git_repository *repo, struct dir *tree, struct dive *dive, struct tm *tm, bool cached_ok)
+static int save_one_dive(git_repository *repo, struct dir *tree, struct dive *dive, struct tm *tm, const dive_blob_map &blobs, bool cached_ok)
 {
-	struct divecomputer *dc;
-	struct membufferpp buf, name;
+	struct membufferpp name;
 	struct dir *subdir;
 	int ret, nr;
 
@@ -681,7 +734,10 @@ static int save_one_dive(git_repository *repo, struct dir *tree, struct dive *di
 	 * If the dive git ID is valid, we just create the whole directory
 	 * with that ID
 	 */
-	if (cached_ok && dive_cache_is_valid(dive)) {
+	auto it = blobs.find(dive);
+	if (it == blobs.end()) {
+		if (!cached_ok || !dive_cache_is_valid(dive))
+			return report_error("no blobs for changed dive");
 		git_oid oid;
 		git_oid_fromraw(&oid, dive->git_id);
 		ret = tree_insert(tree->files, mb_cstring(&name), 1,
@@ -690,13 +746,15 @@ static int save_one_dive(git_repository *repo, struct dir *tree, struct dive *di
 			return report_error("cached dive tree insert failed");
 		return 0;
 	}
+	const dive_blobs &saved = *it->second;
+	if (saved.ret)
+		return report_error("dive blob creation failed");
 
 	subdir = new_directory(repo, tree, &name);
 	subdir->unique = true;
 
-	create_dive_buffer(dive, &buf);
 	nr = dive->number;
-	ret = blob_insert(repo, subdir, &buf,
+	ret = insert_blob(subdir, &saved.dive_id,
 		"Dive%c%d", nr ? '-' : 0, nr);
 	if (ret)
 		return report_error("dive save-file tree insert failed");
@@ -706,12 +764,12 @@ static int save_one_dive(git_repository *repo, struct dir *tree, struct dive *di
 	 * computer, use index 0 for that (which disables the index
 	 * generation when naming it).
 	 */
-	dc = &dive->dc;
-	nr = dc->next ? 1 : 0;
-	do {
-		save_one_divecomputer(repo, subdir, dive, dc, nr++);
-		dc = dc->next;
-	} while (dc);
+	nr = saved.dc_ids.size() > 1 ? 1 : 0;
+	for (const git_oid &id: saved.dc_ids) {
+		if (insert_blob(subdir, &id, "Divecomputer%c%03u", nr ? '-' : 0, nr))
+			report_error("divecomputer tree insert failed");
+		nr++;
+	}
 
 	/* Save the picture data, if any */
 	save_pictures(repo, subdir, dive);
@@ -805,7 +863,7 @@ static void verify_shared_date(timestamp_t when, struct tm *tm)
 #define MIN_TIMESTAMP (0)
 #define MAX_TIMESTAMP (0x7fffffffffffffff)
 
-static int save_one_trip(git_repository *repo, struct dir *tree, dive_trip_t *trip, struct tm *tm, bool cached_ok)
+static int save_one_trip(git_repository *repo, struct dir *tree, dive_trip_t *trip, struct tm *tm, const dive_blob_map &blobs, bool cached_ok)
 {
 	int i;
 	struct dive *dive;
@@ -838,7 +896,7 @@ static int save_one_trip(git_repository *repo, struct dir *tree, dive_trip_t *tr
 	/* Save each dive in the directory */
 	for_each_dive(i, dive) {
 		if (dive->divetrip == trip)
-			save_one_dive(repo, subdir, dive, tm, cached_ok);
+			save_one_dive(repo, subdir, dive, tm, blobs, cached_ok);
 	}
 
 	return 0;
@@ -1016,6 +1074,16 @@ static void save_filter_presets(git_repository *repo, struct dir *tree)
 	}
 }
 
+/*
+ * When saving only the selected dives, the trips are not saved. Therefore,
+ * the tree contains exactly the selected dives. Otherwise, it contains all
+ * dives, be it directly or inside of their trip.
+ */
+static bool is_saved_dive(const struct dive *dive, bool select_only)
+{
+	return !select_only || dive->selected;
+}
+
 static int create_git_tree(git_repository *repo, struct dir *root, bool select_only, bool cached_ok)
 {
 	int i;
@@ -1033,18 +1101,37 @@ static int create_git_tree(git_repository *repo, struct dir *root, bool select_o
 
 	/* save the dives */
 	git_storage_update_progress(translate("gettextFromC", "Start saving dives"));
+
+	/* Write the text of all changed dives in parallel, see struct dive_blobs */
+	std::vector<dive_blobs> changed_dives;
+	for_each_dive(i, dive) {
+		if (!is_saved_dive(dive, select_only))
+			continue;
+		if (cached_ok && dive_cache_is_valid(dive))
+			continue;
+		changed_dives.push_back({ dive, 0, {}, {} });
+	}
+	git_odb *odb;
+	if (git_repository_odb(&odb, repo))
+		return report_error("Unable to open git object database");
+	QtConcurrent::blockingMap(changed_dives, [odb, cached_ok](dive_blobs &blobs) { create_dive_blobs(odb, blobs, cached_ok); });
+	git_odb_free(odb);
+
+	dive_blob_map blobs;
+	for (const dive_blobs &b: changed_dives)
+		blobs[b.dive] = &b;
+
 	for_each_dive(i, dive) {
 		struct tm tm;
 		struct dir *tree;
 
 		trip = dive->divetrip;
 
-		if (select_only) {
-			if (!dive->selected)
-				continue;
-			/* We don't save trips when doing selected dive saves */
+		if (!is_saved_dive(dive, select_only))
+			continue;
+		/* We don't save trips when doing selected dive saves */
+		if (select_only)
 			trip = NULL;
-		}
 
 		/* Create the date-based hierarchy */
 		utc_mkdate(trip ? trip_date(trip) : dive->when, &tm);
@@ -1058,11 +1145,11 @@ static int create_git_tree(git_repository *repo, struct dir *root, bool select_o
 			trip->saved = 1;
 
 			/* Pass that new subdirectory in for save-trip */
-			save_one_trip(repo, tree, trip, &tm, cached_ok);
+			save_one_trip(repo, tree, trip, &tm, blobs, cached_ok);
 			continue;
 		}
 
-		save_one_dive(repo, tree, dive, &tm, cached_ok);
+		save_one_dive(repo, tree, dive, &tm, blobs, cached_ok);
 	}
 	git_storage_update_progress(translate("gettextFromC", "Done creating local cache"));
 	return 0;
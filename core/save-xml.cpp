@@ -12,6 +12,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 
+#include "compressedsamples.h"
 #include "dive.h"
 #include "divelog.h"
 #include "divesite.h"
@@ -223,7 +224,8 @@ static void save_weightsystem_info(struct membuffer *b, struct dive *dive)
 
 static void show_integer(struct membuffer *b, int value, const char *pre, const char *post)
 {
-	put_format(b, " %s%d%s", pre, value, post);
+	put_string(b, " ");
+	put_int(b, pre, value, post);
 }
 
 static void show_index(struct membuffer *b, int value, const char *pre, const char *post)
@@ -232,11 +234,11 @@ static void show_index(struct membuffer *b, int value, const char *pre, const ch
 		show_integer(b, value, pre, post);
 }
 
-static void save_sample(struct membuffer *b, struct sample *sample, struct sample *old, int o2sensor)
+static void save_sample(struct membuffer *b, const struct sample *sample, struct sample *old, int o2sensor)
 {
 	int idx;
 
-	put_format(b, "  <sample time='%u:%02u min'", FRACTION_TUPLE(sample->time.seconds, 60));
+	put_mmss(b, "  <sample time='", sample->time.seconds, 0, " min'");
 	put_milli(b, " depth='", sample->depth.mm, " m'");
 	if (sample->temperature.mkelvin && sample->temperature.mkelvin != old->temperature.mkelvin) {
 		put_temperature(b, sample->temperature, " temp='", " C'");
@@ -265,36 +267,36 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 			}
 			put_pressure(b, p, " pressure='", " bar'");
 			if (sensor != old->sensor[0]) {
-				put_format(b, " sensor='%d'", sensor);
+				put_int(b, " sensor='", sensor, "'");
 				old->sensor[0] = sensor;
 			}
 			continue;
 		}
 
 		/* The new-style format is much simpler: the sensor is always encoded */
-		put_format(b, " pressure%d=", sensor);
+		put_int(b, " pressure", sensor, "=");
 		put_pressure(b, p, "'", " bar'");
 	}
 
 	/* the deco/ndl values are stored whenever they change */
 	if (sample->ndl.seconds != old->ndl.seconds) {
-		put_format(b, " ndl='%u:%02u min'", FRACTION_TUPLE(sample->ndl.seconds, 60));
+		put_mmss(b, " ndl='", sample->ndl.seconds, 0, " min'");
 		old->ndl = sample->ndl;
 	}
 	if (sample->tts.seconds != old->tts.seconds) {
-		put_format(b, " tts='%u:%02u min'", FRACTION_TUPLE(sample->tts.seconds, 60));
+		put_mmss(b, " tts='", sample->tts.seconds, 0, " min'");
 		old->tts = sample->tts;
 	}
 	if (sample->rbt.seconds != old->rbt.seconds) {
-		put_format(b, " rbt='%u:%02u min'", FRACTION_TUPLE(sample->rbt.seconds, 60));
+		put_mmss(b, " rbt='", sample->rbt.seconds, 0, " min'");
 		old->rbt = sample->rbt;
 	}
 	if (sample->in_deco != old->in_deco) {
-		put_format(b, " in_deco='%d'", sample->in_deco ? 1 : 0);
+		put_int(b, " in_deco='", sample->in_deco ? 1 : 0, "'");
 		old->in_deco = sample->in_deco;
 	}
 	if (sample->stoptime.seconds != old->stoptime.seconds) {
-		put_format(b, " stoptime='%u:%02u min'", FRACTION_TUPLE(sample->stoptime.seconds, 60));
+		put_mmss(b, " stoptime='", sample->stoptime.seconds, 0, " min'");
 		old->stoptime = sample->stoptime;
 	}
 
@@ -304,7 +306,7 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 	}
 
 	if (sample->cns != old->cns) {
-		put_format(b, " cns='%u%%'", sample->cns);
+		put_uint(b, " cns='", sample->cns, "%'");
 		old->cns = sample->cns;
 	}
 
@@ -350,7 +352,7 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 		show_index(b, sample->bearing.degrees, "bearing='", "'");
 		old->bearing.degrees = sample->bearing.degrees;
 	}
-	put_format(b, " />\n");
+	put_string(b, " />\n");
 }
 
 static void save_one_event(struct membuffer *b, struct dive *dive, struct event *ev)
@@ -424,9 +426,8 @@ static void show_date(struct membuffer *b, timestamp_t when)
 
 static void save_samples(struct membuffer *b, struct dive *dive, struct divecomputer *dc)
 {
-	int nr;
 	int o2sensor;
-	struct sample *s;
+	const struct sample *s;
 	struct sample dummy;
 
 	/* Set up default pressure sensor indices */
@@ -436,12 +437,10 @@ static void save_samples(struct membuffer *b, struct dive *dive, struct divecomp
 		dummy.sensor[1] = o2sensor;
 	}
 
-	s = dc->sample;
-	nr = dc->samples;
-	while (--nr >= 0) {
+	/* The samples may be packed, see pack_samples() */
+	sample_iterator it(dc);
+	while ((s = it.next()) != NULL)
 		save_sample(b, s, &dummy, o2sensor);
-		s++;
-	}
 }
 
 static void save_dc(struct membuffer *b, struct dive *dive, struct divecomputer *dc)
@@ -0,0 +1,618 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Parsing the text files of a large git repository takes a few seconds,
+ * even if nothing changed since the last time it was opened. Therefore,
+ * after loading a repository, the dives, trips and dive sites are written
+ * into a binary snapshot, tagged with the SHA of the loaded commit. If that
+ * commit is loaded again, the data is read from the memory-mapped snapshot.
+ *
+ * The snapshot is only a local cache: data is written in native byte order
+ * and layout. If anything doesn't fit, the snapshot is ignored and the
+ * caller falls back to the git parser, which will then write a new one.
+ * The samples, which make up most of the data, are stored compressed.
+ */
+#include "snapshot.h"
+#include "dive.h"
+#include "compressedsamples.h"
+#include "divelist.h"
+#include "divelog.h"
+#include "divesite.h"
+#include "errorhelper.h"
+#include "event.h"
+#include "extradata.h"
+#include "owning_ptrs.h"
+#include "subsurface-string.h"
+#include "tag.h"
+#include "trip.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <string.h>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+static const char snapshot_magic[8] = { 'S', 'S', 'R', 'F', 'S', 'N', 'A', 'P' };
+static const uint32_t snapshot_version = 3;
+static const uint32_t null_string = UINT32_MAX;
+
+namespace {
+
+class snapshot_writer {
+	std::string buf;
+public:
+	template <typename T>
+	void put(const T &v)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "only plain data can be written");
+		buf.append((const char *)&v, sizeof(v));
+	}
+	void put_raw(const void *data, size_t size)
+	{
+		buf.append((const char *)data, size);
+	}
+	void put_string(const char *s)
+	{
+		if (!s)
+			return put(null_string);
+		uint32_t len = strlen(s);
+		put(len);
+		buf.append(s, len);
+	}
+	const std::string &data() const
+	{
+		return buf;
+	}
+};
+
+// All accesses are bounds-checked. After the first failure, good()
+// returns false and all further reads return empty values.
+class snapshot_reader {
+	const char *p, *end;
+	bool ok = true;
+	bool check(size_t size)
+	{
+		if (ok && (size_t)(end - p) >= size)
+			return true;
+		ok = false;
+		return false;
+	}
+public:
+	snapshot_reader(const char *data, size_t size) : p(data), end(data + size)
+	{
+	}
+	bool good() const
+	{
+		return ok;
+	}
+	bool at_end() const
+	{
+		return p == end;
+	}
+	template <typename T>
+	T get()
+	{
+		T res { };
+		if (check(sizeof(T))) {
+			memcpy(&res, p, sizeof(T));
+			p += sizeof(T);
+		}
+		return res;
+	}
+	void get_raw(void *data, size_t size)
+	{
+		if (check(size)) {
+			memcpy(data, p, size);
+			p += size;
+		}
+	}
+	// Returns a pointer to the next size bytes or NULL
+	const char *get_data(size_t size)
+	{
+		if (!check(size))
+			return NULL;
+		const char *res = p;
+		p += size;
+		return res;
+	}
+	void fail()
+	{
+		ok = false;
+	}
+	// Returns a malloc()ed string or NULL
+	char *get_string()
+	{
+		uint32_t len = get<uint32_t>();
+		if (len == null_string || !check(len))
+			return NULL;
+		char *res = (char *)malloc(len + 1);
+		memcpy(res, p, len);
+		res[len] = '\0';
+		p += len;
+		return res;
+	}
+	std::string get_std_string()
+	{
+		uint32_t len = get<uint32_t>();
+		if (len == null_string || !check(len))
+			return std::string();
+		std::string res(p, len);
+		p += len;
+		return res;
+	}
+	// Number of items that take at least min_size bytes each.
+	// Protects against huge allocations on corrupted files.
+	uint32_t get_count(size_t min_size)
+	{
+		uint32_t n = get<uint32_t>();
+		return check((size_t)n * min_size) ? n : 0;
+	}
+};
+
+}
+
+static void save_dc(snapshot_writer &w, const struct divecomputer *dc)
+{
+	w.put(dc->when);
+	w.put(dc->duration);
+	w.put(dc->surfacetime);
+	w.put(dc->last_manual_time);
+	w.put(dc->maxdepth);
+	w.put(dc->meandepth);
+	w.put(dc->airtemp);
+	w.put(dc->watertemp);
+	w.put(dc->surface_pressure);
+	w.put((int32_t)dc->divemode);
+	w.put(dc->no_o2sensors);
+	w.put(dc->salinity);
+	w.put_string(dc->model);
+	w.put_string(dc->serial);
+	w.put_string(dc->fw_version);
+	w.put(dc->deviceid);
+	w.put(dc->diveid);
+	w.put(dc->git_id);
+
+	if (dc->packed_samples) {
+		// Already in the snapshot encoding
+		w.put((uint32_t)dc->packed_size);
+		w.put_raw(dc->packed_samples, dc->packed_size);
+	} else {
+		std::vector<unsigned char> samples = compress_samples(dc->sample, dc->samples);
+		w.put((uint32_t)samples.size());
+		w.put_raw(samples.data(), samples.size());
+	}
+
+	uint32_t nr_events = 0;
+	for (const struct event *ev = dc->events; ev; ev = ev->next)
+		nr_events++;
+	w.put(nr_events);
+	for (const struct event *ev = dc->events; ev; ev = ev->next) {
+		w.put(ev->time);
+		w.put(ev->type);
+		w.put(ev->flags);
+		w.put(ev->value);
+		// The divemode shares its storage with the gas index
+		w.put(ev->gas.index);
+		w.put(ev->gas.mix);
+		w.put(ev->deleted);
+		w.put(ev->hidden);
+		w.put_string(ev->name);
+	}
+
+	uint32_t nr_extra_data = 0;
+	for (const struct extra_data *ed = dc->extra_data; ed; ed = ed->next)
+		nr_extra_data++;
+	w.put(nr_extra_data);
+	for (const struct extra_data *ed = dc->extra_data; ed; ed = ed->next) {
+		w.put_string(ed->key);
+		w.put_string(ed->value);
+	}
+}
+
+static void load_dc(snapshot_reader &r, struct divecomputer *dc)
+{
+	dc->when = r.get<timestamp_t>();
+	dc->duration = r.get<duration_t>();
+	dc->surfacetime = r.get<duration_t>();
+	dc->last_manual_time = r.get<duration_t>();
+	dc->maxdepth = r.get<depth_t>();
+	dc->meandepth = r.get<depth_t>();
+	dc->airtemp = r.get<temperature_t>();
+	dc->watertemp = r.get<temperature_t>();
+	dc->surface_pressure = r.get<pressure_t>();
+	dc->divemode = (enum divemode_t)r.get<int32_t>();
+	dc->no_o2sensors = r.get<uint8_t>();
+	dc->salinity = r.get<int>();
+	dc->model = r.get_string();
+	dc->serial = r.get_string();
+	dc->fw_version = r.get_string();
+	dc->deviceid = r.get<uint32_t>();
+	dc->diveid = r.get<uint32_t>();
+	r.get_raw(dc->git_id, sizeof(dc->git_id));
+
+	uint32_t samples_size = r.get<uint32_t>();
+	const char *samples = r.get_data(samples_size);
+	if (samples && !decompress_samples((const unsigned char *)samples, samples_size, dc))
+		r.fail();
+
+	// Append events in the saved order, add_event() would sort them
+	uint32_t nr_events = r.get_count(sizeof(duration_t));
+	struct event **evp = &dc->events;
+	for (uint32_t i = 0; i < nr_events && r.good(); i++) {
+		duration_t time = r.get<duration_t>();
+		int type = r.get<int>();
+		int flags = r.get<int>();
+		int value = r.get<int>();
+		int index = r.get<int>();
+		struct gasmix mix = r.get<struct gasmix>();
+		bool deleted = r.get<bool>();
+		bool hidden = r.get<bool>();
+		std::string name = r.get_std_string();
+		struct event *ev = create_event(time.seconds, type, flags, value, name.c_str());
+		if (!ev)
+			continue;
+		ev->gas.index = index;
+		ev->gas.mix = mix;
+		ev->deleted = deleted;
+		ev->hidden = hidden;
+		*evp = ev;
+		evp = &ev->next;
+	}
+
+	uint32_t nr_extra_data = r.get_count(2 * sizeof(uint32_t));
+	struct extra_data **edp = &dc->extra_data;
+	for (uint32_t i = 0; i < nr_extra_data && r.good(); i++) {
+		struct extra_data *ed = (struct extra_data *)calloc(1, sizeof(*ed));
+		ed->key = r.get_string();
+		ed->value = r.get_string();
+		*edp = ed;
+		edp = &ed->next;
+	}
+}
+
+static void save_dive(snapshot_writer &w, const struct dive *d,
+		      const std::unordered_map<const dive_trip *, int> &trip_idx,
+		      const std::unordered_map<const dive_site *, int> &site_idx)
+{
+	w.put(d->when);
+	w.put(d->number);
+	w.put(d->rating);
+	w.put(d->wavesize);
+	w.put(d->current);
+	w.put(d->visibility);
+	w.put(d->surge);
+	w.put(d->chill);
+	w.put(d->sac);
+	w.put(d->otu);
+	w.put(d->cns);
+	w.put(d->maxcns);
+	w.put(d->mintemp);
+	w.put(d->maxtemp);
+	w.put(d->watertemp);
+	w.put(d->airtemp);
+	w.put(d->maxdepth);
+	w.put(d->meandepth);
+	w.put(d->surface_pressure);
+	w.put(d->duration);
+	w.put(d->salinity);
+	w.put(d->user_salinity);
+	w.put(d->notrip);
+	w.put(d->invalid);
+	w.put(d->git_id);
+
+	auto trip = d->divetrip ? trip_idx.find(d->divetrip) : trip_idx.end();
+	w.put((int32_t)(trip != trip_idx.end() ? trip->second : -1));
+	auto site = d->dive_site ? site_idx.find(d->dive_site) : site_idx.end();
+	w.put((int32_t)(site != site_idx.end() ? site->second : -1));
+
+	w.put_string(d->notes);
+	w.put_string(d->diveguide);
+	w.put_string(d->buddy);
+	w.put_string(d->suit);
+
+	uint32_t nr_tags = 0;
+	for (const struct tag_entry *tag = d->tag_list; tag; tag = tag->next)
+		nr_tags++;
+	w.put(nr_tags);
+	for (const struct tag_entry *tag = d->tag_list; tag; tag = tag->next)
+		w.put_string(tag->tag->source.empty() ? tag->tag->name.c_str() : tag->tag->source.c_str());
+
+	w.put((uint32_t)d->cylinders.nr);
+	for (int i = 0; i < d->cylinders.nr; i++) {
+		const cylinder_t &cyl = d->cylinders.cylinders[i];
+		w.put(cyl.type.size);
+		w.put(cyl.type.workingpressure);
+		w.put_string(cyl.type.description);
+		w.put(cyl.gasmix);
+		w.put(cyl.start);
+		w.put(cyl.end);
+		w.put(cyl.sample_start);
+		w.put(cyl.sample_end);
+		w.put(cyl.depth);
+		w.put(cyl.manually_added);
+		w.put(cyl.gas_used);
+		w.put(cyl.deco_gas_used);
+		w.put((int32_t)cyl.cylinder_use);
+		w.put(cyl.bestmix_o2);
+		w.put(cyl.bestmix_he);
+	}
+
+	w.put((uint32_t)d->weightsystems.nr);
+	for (int i = 0; i < d->weightsystems.nr; i++) {
+		const weightsystem_t &ws = d->weightsystems.weightsystems[i];
+		w.put(ws.weight);
+		w.put_string(ws.description);
+		w.put(ws.auto_filled);
+	}
+
+	w.put((uint32_t)d->pictures.nr);
+	for (int i = 0; i < d->pictures.nr; i++) {
+		const struct picture &pic = d->pictures.pictures[i];
+		w.put_string(pic.filename);
+		w.put(pic.offset);
+		w.put(pic.location);
+	}
+
+	uint32_t nr_dcs = 0;
+	for (const struct divecomputer *dc = &d->dc; dc; dc = dc->next)
+		nr_dcs++;
+	w.put(nr_dcs);
+	for (const struct divecomputer *dc = &d->dc; dc; dc = dc->next)
+		save_dc(w, dc);
+}
+
+static struct dive *load_dive(snapshot_reader &r, int &trip, int &site)
+{
+	struct dive *d = alloc_dive();
+
+	d->when = r.get<timestamp_t>();
+	d->number = r.get<int>();
+	d->rating = r.get<int>();
+	d->wavesize = r.get<int>();
+	d->current = r.get<int>();
+	d->visibility = r.get<int>();
+	d->surge = r.get<int>();
+	d->chill = r.get<int>();
+	d->sac = r.get<int>();
+	d->otu = r.get<int>();
+	d->cns = r.get<int>();
+	d->maxcns = r.get<int>();
+	d->mintemp = r.get<temperature_t>();
+	d->maxtemp = r.get<temperature_t>();
+	d->watertemp = r.get<temperature_t>();
+	d->airtemp = r.get<temperature_t>();
+	d->maxdepth = r.get<depth_t>();
+	d->meandepth = r.get<depth_t>();
+	d->surface_pressure = r.get<pressure_t>();
+	d->duration = r.get<duration_t>();
+	d->salinity = r.get<int>();
+	d->user_salinity = r.get<int>();
+	d->notrip = r.get<bool>();
+	d->invalid = r.get<bool>();
+	r.get_raw(d->git_id, sizeof(d->git_id));
+
+	trip = r.get<int32_t>();
+	site = r.get<int32_t>();
+
+	d->notes = r.get_string();
+	d->diveguide = r.get_string();
+	d->buddy = r.get_string();
+	d->suit = r.get_string();
+
+	uint32_t nr_tags = r.get_count(sizeof(uint32_t));
+	for (uint32_t i = 0; i < nr_tags && r.good(); i++)
+		taglist_add_tag(&d->tag_list, r.get_std_string().c_str());
+
+	uint32_t nr_cylinders = r.get_count(sizeof(uint32_t));
+	for (uint32_t i = 0; i < nr_cylinders && r.good(); i++) {
+		cylinder_t cyl = empty_cylinder;
+		cyl.type.size = r.get<volume_t>();
+		cyl.type.workingpressure = r.get<pressure_t>();
+		cyl.type.description = r.get_string();
+		cyl.gasmix = r.get<struct gasmix>();
+		cyl.start = r.get<pressure_t>();
+		cyl.end = r.get<pressure_t>();
+		cyl.sample_start = r.get<pressure_t>();
+		cyl.sample_end = r.get<pressure_t>();
+		cyl.depth = r.get<depth_t>();
+		cyl.manually_added = r.get<bool>();
+		cyl.gas_used = r.get<volume_t>();
+		cyl.deco_gas_used = r.get<volume_t>();
+		cyl.cylinder_use = (enum cylinderuse)r.get<int32_t>();
+		cyl.bestmix_o2 = r.get<bool>();
+		cyl.bestmix_he = r.get<bool>();
+		add_cylinder(&d->cylinders, d->cylinders.nr, cyl);
+	}
+
+	uint32_t nr_weightsystems = r.get_count(sizeof(uint32_t));
+	for (uint32_t i = 0; i < nr_weightsystems && r.good(); i++) {
+		weightsystem_t ws = empty_weightsystem;
+		ws.weight = r.get<weight_t>();
+		ws.description = r.get_string();
+		ws.auto_filled = r.get<bool>();
+		add_to_weightsystem_table(&d->weightsystems, d->weightsystems.nr, ws);
+	}
+
+	uint32_t nr_pictures = r.get_count(sizeof(uint32_t));
+	for (uint32_t i = 0; i < nr_pictures && r.good(); i++) {
+		struct picture pic = empty_picture;
+		pic.filename = r.get_string();
+		pic.offset = r.get<offset_t>();
+		pic.location = r.get<location_t>();
+		add_to_picture_table(&d->pictures, d->pictures.nr, pic);
+	}
+
+	uint32_t nr_dcs = r.get_count(sizeof(timestamp_t));
+	struct divecomputer *dc = &d->dc;
+	for (uint32_t i = 0; i < nr_dcs && r.good(); i++) {
+		if (i > 0) {
+			dc->next = (struct divecomputer *)calloc(1, sizeof(*dc));
+			dc = dc->next;
+		}
+		load_dc(r, dc);
+	}
+
+	return d;
+}
+
+static void save_site(snapshot_writer &w, const struct dive_site *ds)
+{
+	w.put(ds->uuid);
+	w.put_string(ds->name);
+	w.put(ds->location);
+	w.put_string(ds->description);
+	w.put_string(ds->notes);
+	w.put((uint32_t)ds->taxonomy.nr);
+	for (int i = 0; i < ds->taxonomy.nr; i++) {
+		const struct taxonomy &t = ds->taxonomy.category[i];
+		w.put((int32_t)t.category);
+		w.put_string(t.value);
+		w.put((int32_t)t.origin);
+	}
+}
+
+static struct dive_site *load_site(snapshot_reader &r)
+{
+	struct dive_site *ds = alloc_dive_site();
+	ds->uuid = r.get<uint32_t>();
+	ds->name = r.get_string();
+	ds->location = r.get<location_t>();
+	ds->description = r.get_string();
+	ds->notes = r.get_string();
+	uint32_t nr_taxonomy = r.get_count(3 * sizeof(int32_t));
+	for (uint32_t i = 0; i < nr_taxonomy && r.good(); i++) {
+		enum taxonomy_category category = (enum taxonomy_category)r.get<int32_t>();
+		std::string value = r.get_std_string();
+		enum taxonomy_origin origin = (enum taxonomy_origin)r.get<int32_t>();
+		taxonomy_set_category(&ds->taxonomy, category, value.c_str(), origin);
+	}
+	return ds;
+}
+
+static void save_trip(snapshot_writer &w, const struct dive_trip *trip)
+{
+	w.put_string(trip->location);
+	w.put_string(trip->notes);
+	w.put(trip->autogen);
+}
+
+static struct dive_trip *load_trip(snapshot_reader &r)
+{
+	struct dive_trip *trip = alloc_trip();
+	trip->location = r.get_string();
+	trip->notes = r.get_string();
+	trip->autogen = r.get<bool>();
+	return trip;
+}
+
+static void save_header(snapshot_writer &w, const std::string &sha)
+{
+	w.put_raw(snapshot_magic, sizeof(snapshot_magic));
+	w.put(snapshot_version);
+	w.put_string(sha.c_str());
+}
+
+static bool check_header(snapshot_reader &r, const std::string &sha)
+{
+	char magic[sizeof(snapshot_magic)];
+	r.get_raw(magic, sizeof(magic));
+	return r.good() && !memcmp(magic, snapshot_magic, sizeof(magic)) &&
+	       r.get<uint32_t>() == snapshot_version &&
+	       r.get_std_string() == sha && r.good();
+}
+
+void save_snapshot(const std::string &filename, const std::string &sha, const struct divelog *log)
+{
+	snapshot_writer w;
+	std::unordered_map<const dive_trip *, int> trip_idx;
+	std::unordered_map<const dive_site *, int> site_idx;
+
+	save_header(w, sha);
+
+	w.put((uint32_t)log->sites->nr);
+	for (int i = 0; i < log->sites->nr; i++) {
+		site_idx[log->sites->dive_sites[i]] = i;
+		save_site(w, log->sites->dive_sites[i]);
+	}
+
+	w.put((uint32_t)log->trips->nr);
+	for (int i = 0; i < log->trips->nr; i++) {
+		trip_idx[log->trips->trips[i]] = i;
+		save_trip(w, log->trips->trips[i]);
+	}
+
+	w.put((uint32_t)log->dives->nr);
+	for (int i = 0; i < log->dives->nr; i++)
+		save_dive(w, log->dives->dives[i], trip_idx, site_idx);
+
+	QSaveFile f(QString::fromStdString(filename));
+	if (!f.open(QIODevice::WriteOnly) ||
+	    f.write(w.data().data(), w.data().size()) != (qint64)w.data().size() ||
+	    !f.commit())
+		report_info("Couldn't write snapshot %s", filename.c_str());
+}
+
+static bool load_snapshot_data(snapshot_reader &r, const std::string &sha, struct divelog *log)
+{
+	std::vector<OwningDiveSitePtr> sites;
+	std::vector<OwningTripPtr> trips;
+	std::vector<OwningDivePtr> dives;
+	std::vector<std::pair<int, int>> dive_links; // index of trip and dive site of each dive
+
+	if (!check_header(r, sha))
+		return false;
+
+	uint32_t nr_sites = r.get_count(sizeof(uint32_t));
+	for (uint32_t i = 0; i < nr_sites && r.good(); i++)
+		sites.emplace_back(load_site(r));
+
+	uint32_t nr_trips = r.get_count(sizeof(uint32_t));
+	for (uint32_t i = 0; i < nr_trips && r.good(); i++)
+		trips.emplace_back(load_trip(r));
+
+	uint32_t nr_dives = r.get_count(sizeof(timestamp_t));
+	for (uint32_t i = 0; i < nr_dives && r.good(); i++) {
+		int trip, site;
+		dives.emplace_back(load_dive(r, trip, site));
+		if (trip >= (int)trips.size() || site >= (int)sites.size())
+			return false;
+		dive_links.emplace_back(trip, site);
+	}
+
+	if (!r.good() || !r.at_end())
+		return false;
+
+	// Everything was read successfully, hand the objects over to the log.
+	// Trips are sorted by their first dive, so fill them before inserting.
+	for (size_t i = 0; i < dives.size(); i++) {
+		if (dive_links[i].first >= 0)
+			add_dive_to_trip(dives[i].get(), trips[dive_links[i].first].get());
+		if (dive_links[i].second >= 0)
+			add_dive_to_dive_site(dives[i].get(), sites[dive_links[i].second].get());
+	}
+	for (OwningDiveSitePtr &ds: sites)
+		add_dive_site_to_table(ds.release(), log->sites);
+	for (OwningTripPtr &trip: trips)
+		insert_trip(trip.release(), log->trips);
+	for (OwningDivePtr &d: dives)
+		record_dive_to_table(d.release(), log->dives);
+	return true;
+}
+
+bool load_snapshot(const std::string &filename, const std::string &sha, struct divelog *log)
+{
+	QFile f(QString::fromStdString(filename));
+	if (!f.open(QIODevice::ReadOnly))
+		return false;
+	qint64 size = f.size();
+	uchar *data = size > 0 ? f.map(0, size) : nullptr;
+	if (!data)
+		return false;
+
+	snapshot_reader r((const char *)data, size);
+	bool res = load_snapshot_data(r, sha, log);
+	f.unmap(data);
+
+	if (verbose)
+		report_info("%s snapshot %s", res ? "loaded" : "ignored", filename.c_str());
+	return res;
+}
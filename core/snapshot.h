@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: GPL-2.0
+// Binary snapshots of the dives, trips and dive sites loaded from a git
+// repository. Used to skip parsing the text files if the repository
+// didn't change since the snapshot was written.
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <string>
+
+struct divelog;
+
+// Returns false if there is no snapshot for this sha or the snapshot is unusable.
+// On success, the dives are added with record_dive_to_table() and the caller
+// is responsible for the fixups.
+extern bool load_snapshot(const std::string &filename, const std::string &sha, struct divelog *log);
+extern void save_snapshot(const std::string &filename, const std::string &sha, const struct divelog *log);
+
+#endif
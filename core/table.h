@@ -23,39 +23,38 @@
 	}
 
 /* get the index where we want to insert an object so that everything stays
- * ordered according to a comparison function() */
+ * ordered according to a comparison function(). The table must be sorted,
+ * so that we can do a binary search. Objects are inserted after equal objects. */
 #define MAKE_GET_INSERTION_INDEX(table_type, item_type, array_name, fun)		\
 	int table_type##_get_insertion_index(struct table_type *table, item_type item)	\
 	{										\
-		/* we might want to use binary search here */				\
-		for (int i = 0; i < table->nr; i++) {					\
-			if (fun(item, table->array_name[i]))				\
-				return i;						\
+		int lo = 0, hi = table->nr;						\
+		while (lo < hi) {							\
+			int mid = lo + (hi - lo) / 2;					\
+			if (fun(item, table->array_name[mid]))				\
+				hi = mid;						\
+			else								\
+				lo = mid + 1;						\
 		}									\
-		return table->nr;							\
+		return lo;								\
 	}
 
 /* add object at the given index to a table. */
 #define MAKE_ADD_TO(table_type, item_type, array_name)					\
 	void add_to_##table_type(struct table_type *table, int idx, item_type item)	\
 	{										\
-		int i;									\
 		grow_##table_type(table);						\
+		memmove(&table->array_name[idx + 1], &table->array_name[idx],		\
+			(table->nr - idx) * sizeof(item_type));				\
+		table->array_name[idx] = item;						\
 		table->nr++;								\
-											\
-		for (i = idx; i < table->nr; i++) {					\
-			item_type tmp = table->array_name[i];				\
-			table->array_name[i] = item;					\
-			item = tmp;							\
-		}									\
 	}
 
 #define MAKE_REMOVE_FROM(table_type, array_name)						\
 	void remove_from_##table_type(struct table_type *table, int idx)			\
 	{											\
-		int i;										\
-		for (i = idx; i < table->nr - 1; i++)						\
-			table->array_name[i] = table->array_name[i + 1];			\
+		memmove(&table->array_name[idx], &table->array_name[idx + 1],			\
+			(table->nr - idx - 1) * sizeof(table->array_name[0]));			\
 		memset(&table->array_name[--table->nr], 0, sizeof(table->array_name[0]));	\
 	}
 
@@ -69,6 +68,32 @@
 		return -1;									\
 	}
 
+/* Like MAKE_GET_IDX, but for tables that are sorted according to a comparison
+ * function(). The object is searched by binary search at its sorted position.
+ * If it isn't found there, because it was changed after it was inserted, we fall
+ * back to a linear search. */
+#define MAKE_GET_IDX_SORTED(table_type, item_type, array_name, fun)				\
+	int get_idx_in_##table_type(const struct table_type *table, const item_type item)	\
+	{											\
+		int lo = 0, hi = table->nr;							\
+		while (lo < hi) {								\
+			int mid = lo + (hi - lo) / 2;						\
+			if (fun(table->array_name[mid], item))					\
+				lo = mid + 1;							\
+			else									\
+				hi = mid;							\
+		}										\
+		for (int i = lo; i < table->nr && !fun(item, table->array_name[i]); ++i) {	\
+			if (table->array_name[i] == item)					\
+				return i;							\
+		}										\
+		for (int i = 0; i < table->nr; ++i) {						\
+			if (table->array_name[i] == item)					\
+				return i;							\
+		}										\
+		return -1;									\
+	}
+
 #define MAKE_SORT(table_type, item_type, array_name, fun)					\
 	static int sortfn_##table_type(const void *_a, const void *_b)				\
 	{											\
@@ -0,0 +1,230 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "thumbnailstore.h"
+#include "errorhelper.h"
+
+#include <QSaveFile>
+#include <string.h>
+
+static const char store_magic[8] = { 'S', 'S', 'R', 'F', 'T', 'H', 'M', 'B' };
+static const quint32 store_version = 1;
+static const quint32 byte_order_mark = 0x01020304;	// The file is not portable
+static const qint64 header_size = sizeof(store_magic) + 2 * sizeof(quint32);
+
+struct record_header {
+	quint32 key_size;
+	quint32 data_size;
+	qint64 created;
+};
+static_assert(sizeof(record_header) == 16, "unexpected padding of record header");
+
+ThumbnailStore::ThumbnailStore(const QString &filename) :
+	file(filename), end(0), garbage(0), opened(false)
+{
+}
+
+ThumbnailStore::~ThumbnailStore()
+{
+	clear();
+}
+
+void ThumbnailStore::clear()
+{
+	index.clear();
+	for (uchar *m: mappings)
+		file.unmap(m);
+	mappings.clear();
+	buffers.clear();
+	file.close();
+	end = garbage = 0;
+}
+
+// The mapping stays valid until clear() is called.
+const char *ThumbnailStore::map(qint64 offset, qint64 size)
+{
+	uchar *m = file.map(offset, size);
+	if (m) {
+		mappings.push_back(m);
+		return (const char *)m;
+	}
+	// Can't map the file (maybe on a network drive?) -> read it instead
+	if (!file.seek(offset))
+		return nullptr;
+	QByteArray data = file.read(size);
+	if (data.size() != size)
+		return nullptr;
+	buffers.push_back(data);
+	return buffers.back().constData();
+}
+
+// Build the index from the record headers. A partially written record at the
+// end (e.g. after a crash) is ignored and cut off later.
+bool ThumbnailStore::scan(const char *p, qint64 size)
+{
+	quint32 version, bom;
+	if (size < header_size || memcmp(p, store_magic, sizeof(store_magic)))
+		return false;
+	memcpy(&version, p + sizeof(store_magic), sizeof(version));
+	memcpy(&bom, p + sizeof(store_magic) + sizeof(version), sizeof(bom));
+	if (version != store_version || bom != byte_order_mark)
+		return false;
+
+	qint64 offset = header_size;
+	while (size - offset >= (qint64)sizeof(record_header)) {
+		record_header h;
+		memcpy(&h, p + offset, sizeof(h));
+		qint64 record_size = (qint64)sizeof(h) + h.key_size + h.data_size;
+		if (record_size > size - offset)
+			break;
+		const char *key_data = p + offset + sizeof(h);
+		QString key = QString::fromUtf8(key_data, h.key_size);
+		Record r { key_data + h.key_size, h.data_size, h.created };
+		auto it = index.find(key);
+		if (it != index.end()) {
+			garbage += (qint64)sizeof(h) + h.key_size + it->size;
+			*it = r;
+		} else {
+			index.insert(key, r);
+		}
+		offset += record_size;
+	}
+	end = offset;
+	return true;
+}
+
+// Open the file and build the index. If the file doesn't exist or can't be
+// read, it is (re)created. Returns false if the file can't be opened.
+bool ThumbnailStore::load()
+{
+	if (!file.open(QIODevice::ReadWrite)) {
+		report_info("Cannot open thumbnail store %s: %s", qPrintable(file.fileName()), qPrintable(file.errorString()));
+		return false;
+	}
+
+	qint64 size = file.size();
+	if (size > header_size) {
+		const char *p = map(0, size);
+		if (p && scan(p, size)) {
+			if (end < size)
+				file.resize(end);
+			return true;
+		}
+		report_info("Thumbnail store %s is not readable, recreating it", qPrintable(file.fileName()));
+	}
+
+	clear();
+	if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate) ||
+	    file.write(store_magic, sizeof(store_magic)) != sizeof(store_magic) ||
+	    file.write((const char *)&store_version, sizeof(store_version)) != sizeof(store_version) ||
+	    file.write((const char *)&byte_order_mark, sizeof(byte_order_mark)) != sizeof(byte_order_mark) ||
+	    !file.flush()) {
+		report_info("Cannot create thumbnail store %s: %s", qPrintable(file.fileName()), qPrintable(file.errorString()));
+		file.close();
+		return false;
+	}
+	end = header_size;
+	return true;
+}
+
+// Write the current thumbnails to a new file. The old file is closed, because
+// on some platforms an open file can't be replaced.
+bool ThumbnailStore::compact()
+{
+	QSaveFile out(file.fileName());
+	if (!out.open(QIODevice::WriteOnly))
+		return false;
+	out.write(store_magic, sizeof(store_magic));
+	out.write((const char *)&store_version, sizeof(store_version));
+	out.write((const char *)&byte_order_mark, sizeof(byte_order_mark));
+	for (auto it = index.cbegin(); it != index.cend(); ++it) {
+		QByteArray key = it.key().toUtf8();
+		record_header h { (quint32)key.size(), it->size, it->created };
+		out.write((const char *)&h, sizeof(h));
+		out.write(key);
+		out.write(it->data, it->size);
+	}
+	clear();
+	return out.commit();
+}
+
+void ThumbnailStore::open()
+{
+	opened = true;
+	if (!load())
+		return;
+	if (garbage > end / 2) {
+		compact();
+		load();
+	}
+}
+
+std::optional<ThumbnailStore::Entry> ThumbnailStore::getLocked(const QString &key) const
+{
+	auto it = index.find(key);
+	if (it == index.end())
+		return {};
+	return Entry { QByteArray::fromRawData(it->data, it->size), it->created };
+}
+
+std::optional<ThumbnailStore::Entry> ThumbnailStore::get(const QString &key)
+{
+	QMutexLocker l(&lock);
+	if (!opened)
+		open();
+	return getLocked(key);
+}
+
+std::vector<std::optional<ThumbnailStore::Entry>> ThumbnailStore::get(const QVector<QString> &keys)
+{
+	QMutexLocker l(&lock);
+	if (!opened)
+		open();
+	std::vector<std::optional<Entry>> res;
+	res.reserve(keys.size());
+	for (const QString &key: keys)
+		res.push_back(getLocked(key));
+	return res;
+}
+
+bool ThumbnailStore::put(const QString &key, const QByteArray &data, qint64 created)
+{
+	QMutexLocker l(&lock);
+	if (!opened)
+		open();
+	if (!file.isOpen())
+		return false;
+
+	QByteArray k = key.toUtf8();
+	record_header h { (quint32)k.size(), (quint32)data.size(), created };
+	qint64 record_size = (qint64)sizeof(h) + k.size() + data.size();
+	const char *p = nullptr;
+	if (file.seek(end) &&
+	    file.write((const char *)&h, sizeof(h)) == sizeof(h) &&
+	    file.write(k) == k.size() &&
+	    file.write(data) == data.size() &&
+	    file.flush())
+		p = map(end, record_size);
+	if (!p) {
+		report_info("Cannot write to thumbnail store %s: %s", qPrintable(file.fileName()), qPrintable(file.errorString()));
+		file.resize(end);
+		return false;
+	}
+
+	Record r { p + sizeof(h) + k.size(), h.data_size, created };
+	auto it = index.find(key);
+	if (it != index.end()) {
+		garbage += (qint64)sizeof(h) + h.key_size + it->size;
+		*it = r;
+	} else {
+		index.insert(key, r);
+	}
+	end += record_size;
+	return true;
+}
+
+int ThumbnailStore::size()
+{
+	QMutexLocker l(&lock);
+	if (!opened)
+		open();
+	return index.size();
+}
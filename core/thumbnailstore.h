@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: GPL-2.0
+// A packed store of thumbnails in a single file.
+//
+// The file starts with a short header and is followed by records, each
+// consisting of the key (the canonical filename of the picture), the
+// creation time of the thumbnail and the serialized thumbnail. Records are
+// only ever appended. If a thumbnail is stored again, the newer record wins.
+// The file is memory-mapped and the index from key to record is built from
+// the record headers when the file is opened. When more than half of the file
+// consists of replaced records, it is compacted on opening.
+//
+// The data is stored in native byte order. This is a cache: if the file
+// can't be read, it is simply recreated.
+#ifndef THUMBNAILSTORE_H
+#define THUMBNAILSTORE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <optional>
+#include <vector>
+
+class ThumbnailStore {
+public:
+	struct Entry {
+		QByteArray data;	// Refers to the mapped file. Valid as long as the store exists.
+		qint64 created;		// Creation time of the thumbnail in ms since epoch
+	};
+
+	ThumbnailStore(const QString &filename);
+	~ThumbnailStore();
+	std::optional<Entry> get(const QString &key);
+	std::vector<std::optional<Entry>> get(const QVector<QString> &keys); // Looks up all keys in one go
+	bool put(const QString &key, const QByteArray &data, qint64 created);
+	int size(); // Number of stored thumbnails
+private:
+	struct Record {
+		const char *data;
+		quint32 size;
+		qint64 created;
+	};
+	QMutex lock;
+	QFile file;
+	qint64 end;	// End of the last complete record
+	qint64 garbage;	// Size of replaced records
+	bool opened;
+	QHash<QString, Record> index;
+	std::vector<uchar *> mappings;
+	std::vector<QByteArray> buffers;	// In case the file can't be mapped
+
+	void open();
+	bool load();
+	bool scan(const char *p, qint64 size);
+	bool compact();
+	void clear();
+	const char *map(qint64 offset, qint64 size);
+	std::optional<Entry> getLocked(const QString &key) const;
+};
+
+#endif
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0
 
 #include "trip.h"
+#include "decocache.h"
 #include "dive.h"
 #include "divelog.h"
 #include "subsurface-time.h"
@@ -95,6 +96,7 @@ void add_dive_to_trip(struct dive *dive, dive_trip_t *trip)
 		report_info("Warning: adding dive to trip that has trip set\n");
 	insert_dive(&trip->dives, dive);
 	dive->divetrip = trip;
+	deco_cache_invalidate(dive);
 }
 
 /* remove a dive from the trip it's associated to, but don't delete the
@@ -110,6 +112,7 @@ struct dive_trip *unregister_dive_from_trip(struct dive *dive)
 
 	remove_dive(dive, &trip->dives);
 	dive->divetrip = NULL;
+	deco_cache_invalidate(dive);
 	return trip;
 }
 
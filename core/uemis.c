@@ -15,6 +15,7 @@
 
 #include "uemis.h"
 #include "divesite.h"
+#include "divesiteindex.h"
 #include "errorhelper.h"
 #include "sample.h"
 #include <libdivecomputer/parser.h>
@@ -178,6 +179,7 @@ void uemis_set_divelocation(int divespot, char *text, double longitude, double l
 			if (ds) {
 				ds->name = strdup(text);
 				ds->location = create_location(latitude, longitude);
+				divesiteindex_update(ds);
 			}
 		}
 		hp = hp->next;
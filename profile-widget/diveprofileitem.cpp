@@ -11,6 +11,121 @@
 #include "libdivecomputer/parser.h"
 #include "profile-widget/profilewidget2.h"
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+static const size_t maxDecimationLevels = 4;
+
+static long pixelColumn(const plot_info &pInfo, int i, double secondsPerPixel)
+{
+	return lrint(floor(pInfo.entry[i].sec / secondsPerPixel));
+}
+
+// Append the first, the last, the minimum and the maximum of the samples
+// in [from, to) of each pixel column to indexes.
+static void addExtremes(std::vector<int> &indexes, const plot_info &pInfo, double secondsPerPixel,
+			int from, int to, const ProfileDecimator::ValueFunc &value)
+{
+	long column = 0;
+	int first = -1, last = -1, min = -1, max = -1;
+	double minValue = 0.0, maxValue = 0.0;
+	auto flush = [&indexes, &first, &last, &min, &max]() {
+		if (first < 0)
+			return;
+		int keep[4] = { first, min, max, last };
+		std::sort(keep, keep + 4);
+		for (int i: keep) {
+			if (indexes.empty() || indexes.back() != i)
+				indexes.push_back(i);
+		}
+	};
+	for (int i = from; i < to; ++i) {
+		double v = value(i);
+		if (std::isnan(v))
+			continue;
+		long act_column = pixelColumn(pInfo, i, secondsPerPixel);
+		if (first < 0 || act_column != column) {
+			flush();
+			column = act_column;
+			first = last = min = max = i;
+			minValue = maxValue = v;
+			continue;
+		}
+		last = i;
+		if (v < minValue) {
+			min = i;
+			minValue = v;
+		}
+		if (v > maxValue) {
+			max = i;
+			maxValue = v;
+		}
+	}
+	flush();
+}
+
+void ProfileDecimator::clear()
+{
+	levels.clear();
+}
+
+const ProfileDecimator::Level &ProfileDecimator::getLevel(const plot_info &pInfo, double secondsPerPixel, const ValueFunc &value)
+{
+	auto it = std::find_if(levels.begin(), levels.end(), [secondsPerPixel](const Level &l)
+			       { return fabs(l.secondsPerPixel - secondsPerPixel) <= 1e-9 * secondsPerPixel; });
+	if (it != levels.end()) {
+		std::rotate(levels.begin(), it, it + 1);
+		return levels.front();
+	}
+
+	Level level { secondsPerPixel, {} };
+	addExtremes(level.indexes, pInfo, secondsPerPixel, 0, pInfo.nr, value);
+	if (levels.size() >= maxDecimationLevels)
+		levels.pop_back();
+	levels.insert(levels.begin(), std::move(level));
+	return levels.front();
+}
+
+std::vector<int> ProfileDecimator::get(const plot_info &pInfo, double secondsPerPixel, int from, int to, const ValueFunc &value)
+{
+	std::vector<int> res;
+	if (from >= to)
+		return res;
+
+	// Zoomed in so far that there are more pixel columns than samples?
+	if (!std::isfinite(secondsPerPixel) || secondsPerPixel <= 0.0 ||
+	    pInfo.entry[to - 1].sec - pInfo.entry[from].sec >= (to - from) * secondsPerPixel) {
+		res.resize(to - from);
+		for (int i = from; i < to; ++i)
+			res[i - from] = i;
+		return res;
+	}
+
+	// The first and the last pixel column may be only partially visible.
+	// Their extremes are calculated from the visible samples.
+	long first_column = pixelColumn(pInfo, from, secondsPerPixel);
+	long last_column = pixelColumn(pInfo, to - 1, secondsPerPixel);
+	int first_end = from;
+	while (first_end < to && pixelColumn(pInfo, first_end, secondsPerPixel) == first_column)
+		++first_end;
+	int last_start = to;
+	while (last_start > first_end && pixelColumn(pInfo, last_start - 1, secondsPerPixel) == last_column)
+		--last_start;
+
+	const std::vector<int> &indexes = getLevel(pInfo, secondsPerPixel, value).indexes;
+	auto it1 = std::lower_bound(indexes.begin(), indexes.end(), first_end);
+	auto it2 = std::lower_bound(it1, indexes.end(), last_start);
+	res.reserve(it2 - it1 + 10);
+	res.push_back(from);
+	addExtremes(res, pInfo, secondsPerPixel, from, first_end, value);
+	res.insert(res.end(), it1, it2);
+	addExtremes(res, pInfo, secondsPerPixel, last_start, to, value);
+	res.push_back(to - 1);
+	res.erase(std::unique(res.begin(), res.end()), res.end());
+	return res;
+}
+
 AbstractProfilePolygonItem::AbstractProfilePolygonItem(const plot_info &pInfo, const DiveCartesianAxis &horizontal,
 						       const DiveCartesianAxis &vertical, DataAccessor accessor,
 						       double dpr) :
@@ -26,9 +141,25 @@ AbstractProfilePolygonItem::~AbstractProfilePolygonItem()
 void AbstractProfilePolygonItem::clear()
 {
 	setPolygon(QPolygonF());
+	indexes.clear();
 	texts.clear();
 }
 
+void AbstractProfilePolygonItem::clearDecimation()
+{
+	for (ProfileDecimator &decimator: decimators)
+		decimator.clear();
+}
+
+std::vector<int> AbstractProfilePolygonItem::decimate(int from, int to, const ProfileDecimator::ValueFunc &value, int series)
+{
+	if (series >= (int)decimators.size())
+		decimators.resize(series + 1);
+	double width = fabs(hAxis.posAtValue(hAxis.maximum()) - hAxis.posAtValue(hAxis.minimum()));
+	double secondsPerPixel = width > 0.0 ? (hAxis.maximum() - hAxis.minimum()) / width : 0.0;
+	return decimators[series].get(pInfo, secondsPerPixel, from, to, value);
+}
+
 static std::pair<double,double> clip(double x1, double y1, double x2, double y2, double x)
 {
 	double rel = fabs(x2 - x1) > 1e-10 ? (x - x1) / (x2 - x1) : 0.5;
@@ -78,8 +209,10 @@ void AbstractProfilePolygonItem::makePolygon(int fromIn, int toIn)
 	// regarting our cartesian plane ( made by the hAxis and vAxis ), the QPolygonF
 	// is an array of QPointF's, so we basically get the point from the model, convert
 	// to our coordinates, store. no painting is done here.
+	// Only the samples that are distinguishable at the current zoom level are used.
+	indexes = decimate(from, to, [this](int i) { return accessor(pInfo.entry[i]); });
 	QPolygonF poly;
-	for (int i = from; i < to; i++) {
+	for (int i: indexes) {
 		auto [horizontalValue, verticalValue] = getPoint(i);
 
 		if (i == from) {
@@ -123,12 +256,13 @@ void DiveProfileItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *o
 	QPolygonF poly = polygon();
 	const struct plot_data *data = pInfo.entry;
 	// This paints the colors of the velocities.
-	for (int i = from + 1; i < to; i++) {
-		QColor color = getColor((color_index_t)(VELOCITY_COLORS_START_IDX + data[i].velocity));
+	// The first point of the polygon is at the surface, therefore point i+1 corresponds to sample indexes[i].
+	for (int i = 1; i < (int)indexes.size(); i++) {
+		QColor color = getColor((color_index_t)(VELOCITY_COLORS_START_IDX + data[indexes[i]].velocity));
 		pen.setBrush(QBrush(color));
 		painter->setPen(pen);
-		if (i - from < poly.count() - 1)
-			painter->drawLine(poly[i - from], poly[i - from + 1]);
+		if (i < poly.count() - 1)
+			painter->drawLine(poly[i], poly[i + 1]);
 	}
 	painter->restore();
 }
@@ -150,8 +284,13 @@ void DiveProfileItem::replot(const dive *d, int from, int to, bool in_planner)
 	/* Show any ceiling we may have encountered */
 	if (prefs.dcceiling && !prefs.redceiling) {
 		QPolygonF p = polygon();
-		plot_data *entry = pInfo.entry + to - 1;
-		for (int i = to - 1; i >= from; i--, entry--) {
+		auto ceilingAt = [this](int i) {
+			const plot_data &entry = pInfo.entry[i];
+			return entry.in_deco ? static_cast<double>(std::min(entry.stopdepth, entry.depth)) : 0.0;
+		};
+		std::vector<int> ceiling = decimate(from, to, ceilingAt, 1);
+		for (auto it = ceiling.rbegin(); it != ceiling.rend(); ++it) {
+			const plot_data *entry = pInfo.entry + *it;
 			if (!entry->in_deco) {
 				/* not in deco implies this is a safety stop, no ceiling */
 				p.append(QPointF(hAxis.posAtValue(entry->sec), vAxis.posAtValue(0)));
@@ -284,7 +423,15 @@ void DiveHeartrateItem::replot(const dive *, int fromIn, int toIn, bool)
 
 	texts.clear();
 	// Ignore empty values. a heart rate of 0 would be a bad sign.
+	// The labels are placed according to all samples, but only the samples
+	// that are distinguishable at the current zoom level are plotted.
 	QPolygonF poly;
+	auto hrAt = [this](int i) {
+		double hr = accessor(pInfo.entry[i]);
+		return lrint(hr) ? hr : NAN;
+	};
+	std::vector<int> plotted = decimate(from, to, hrAt);
+	auto next_plotted = plotted.begin();
 	int interval = vAxis.getMinLabelDistance(hAxis);
 	for (int i = from; i < to; i++) {
 		auto [sec_double, hr_double] = getPoint(i);
@@ -292,8 +439,10 @@ void DiveHeartrateItem::replot(const dive *, int fromIn, int toIn, bool)
 		if (!hr)
 			continue;
 		int sec = lrint(sec_double);
-		QPointF point(hAxis.posAtValue(sec_double), vAxis.posAtValue(hr_double));
-		poly.append(point);
+		while (next_plotted != plotted.end() && *next_plotted < i)
+			++next_plotted;
+		if (next_plotted != plotted.end() && *next_plotted == i)
+			poly.append(QPointF(hAxis.posAtValue(sec_double), vAxis.posAtValue(hr_double)));
 		if (hr == hist[2].hr)
 			// same as last one, no point in looking at printing
 			continue;
@@ -369,14 +518,23 @@ void DiveTemperatureItem::replot(const dive *, int fromIn, int toIn, bool)
 
 	texts.clear();
 	// Ignore empty values. things do not look good with '0' as temperature in kelvin...
+	// As for the heart rate, the labels are placed according to all samples.
 	QPolygonF poly;
+	auto temperatureAt = [this](int i) {
+		double mkelvin = accessor(pInfo.entry[i]);
+		return mkelvin >= 1.0 ? mkelvin : NAN;
+	};
+	std::vector<int> plotted = decimate(from, to, temperatureAt);
+	auto next_plotted = plotted.begin();
 	int interval = vAxis.getMinLabelDistance(hAxis);
 	for (int i = from; i < to; i++) {
 		auto [sec, mkelvin] = getPoint(i);
 		if (mkelvin < 1.0)
 			continue;
-		QPointF point(hAxis.posAtValue(sec), vAxis.posAtValue(mkelvin));
-		poly.append(point);
+		while (next_plotted != plotted.end() && *next_plotted < i)
+			++next_plotted;
+		if (next_plotted != plotted.end() && *next_plotted == i)
+			poly.append(QPointF(hAxis.posAtValue(sec), vAxis.posAtValue(mkelvin)));
 		last_valid_temp = sec;
 
 		/* don't print a temperature
@@ -477,7 +635,11 @@ void DiveMeanDepthItem::replot(const dive *, int fromIn, int toIn, bool)
 	double prevSec = 0.0, prevMeanDepth = 0.0;
 
 	QPolygonF poly;
-	for (int i = from; i < to; i++) {
+	auto meanDepthAt = [this](int i) {
+		const plot_data &entry = pInfo.entry[i];
+		return entry.running_sum > 0 ? static_cast<double>(entry.running_sum) / entry.sec : NAN;
+	};
+	for (int i: decimate(from, to, meanDepthAt)) {
 		auto [sec, meanDepth] = getMeanDepth(i);
 		// Ignore empty values
 		if (meanDepth == 0)
@@ -532,7 +694,20 @@ void DiveGasPressureItem::replot(const dive *d, int fromIn, int toIn, bool in_pl
 	QPolygonF boundingPoly;
 	segments.clear();
 
-	for (int i = from; i < to; i++) {
+	// Plot the samples that are needed for any of the cylinders
+	std::vector<int> plotted;
+	for (int cyl = 0; cyl < pInfo.nr_cylinders; cyl++) {
+		auto pressureAt = [this, cyl](int i) {
+			int mbar = get_plot_pressure(&pInfo, i, cyl);
+			return mbar >= 1 ? static_cast<double>(mbar) : NAN;
+		};
+		std::vector<int> cyl_plotted = decimate(from, to, pressureAt, cyl);
+		std::vector<int> merged;
+		std::set_union(plotted.begin(), plotted.end(), cyl_plotted.begin(), cyl_plotted.end(), std::back_inserter(merged));
+		plotted = std::move(merged);
+	}
+
+	for (int i: plotted) {
 		const struct plot_data *entry = pInfo.entry + i;
 
 		for (int cyl = 0; cyl < pInfo.nr_cylinders; cyl++) {
@@ -745,7 +920,7 @@ void DiveReportedCeiling::replot(const dive *, int fromIn, int toIn, bool)
 	to = toIn;
 
 	QPolygonF p;
-	for (int i = from; i < to; i++) {
+	for (int i: decimate(from, to, [this](int i) { return getTimeValue(i).second; })) {
 		auto [sec, value] = getPoint(i);
 		if (i == from)
 			p.append(QPointF(hAxis.posAtValue(sec), vAxis.posAtValue(0.0)));
@@ -789,7 +964,7 @@ void PartialPressureGasItem::replot(const dive *, int fromIn, int toIn, bool)
 	if (thresholdPtrMin)
 		threshold_min = *thresholdPtrMin;
 	bool inAlertFragment = false;
-	for (int i = from; i < to; i++) {
+	for (int i: decimate(from, to, [this](int i) { return accessor(pInfo.entry[i]); })) {
 		auto [time, value] = getPoint(i);
 		QPointF point(hAxis.posAtValue(time), vAxis.posAtValue(value));
 		poly.push_back(point);
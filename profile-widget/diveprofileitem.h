@@ -3,7 +3,9 @@
 #define DIVEPROFILEITEM_H
 
 #include <QGraphicsPolygonItem>
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include "divelineitem.h"
 
@@ -24,6 +26,29 @@ struct plot_data;
 struct plot_info;
 struct dive;
 
+// Reduces a curve to the samples that are visible at a given zoom level. Of all
+// samples that fall into the same pixel column, only the first, the last, the
+// minimum and the maximum are kept. Thus, extremes such as the maximum depth or
+// a ceiling violation are drawn exactly. The reduced curve is calculated for the
+// whole dive and cached for a few zoom levels, so that panning is fast.
+class ProfileDecimator {
+public:
+	// Returns the value of the sample with the given index, or NaN if the sample is not plotted.
+	using ValueFunc = std::function<double(int)>;
+
+	// Indexes of the samples in [from, to) that are to be plotted. The first
+	// and the last sample are always included, so that they can be clipped.
+	std::vector<int> get(const plot_info &pInfo, double secondsPerPixel, int from, int to, const ValueFunc &value);
+	void clear();
+private:
+	struct Level {
+		double secondsPerPixel;
+		std::vector<int> indexes;
+	};
+	std::vector<Level> levels; // Most recently used first
+	const Level &getLevel(const plot_info &pInfo, double secondsPerPixel, const ValueFunc &value);
+};
+
 class AbstractProfilePolygonItem : public QGraphicsPolygonItem {
 public:
 	using DataAccessor = double (*)(const plot_data &data); // The pointer-to-function syntax is hilarious.
@@ -32,6 +57,7 @@ public:
 	~AbstractProfilePolygonItem();
 	virtual void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0) = 0;
 	void clear();
+	void clearDecimation(); // To be called when the plot info changes
 
 	// Plot the range (from, to), given as indexes. The caller guarantees that
 	// only the first and the last segment will have to be clipped.
@@ -42,13 +68,18 @@ protected:
 	void clipStart(double &x, double &y, double next_x, double next_y) const;
 	void clipStop(double &x, double &y, double prev_x, double prev_y) const;
 	std::pair<double, double> getPoint(int i) const;
+	// Samples in [from, to) to be plotted at the current zoom level. An item
+	// may plot more than one curve, each of which is identified by "series".
+	std::vector<int> decimate(int from, int to, const ProfileDecimator::ValueFunc &value, int series = 0);
 	const DiveCartesianAxis &hAxis;
 	const DiveCartesianAxis &vAxis;
 	const plot_info &pInfo;
 	DataAccessor accessor;
 	double dpr;
 	int from, to;
+	std::vector<int> indexes; // Samples plotted by makePolygon()
 	std::vector<std::unique_ptr<DiveTextItem>> texts;
+	std::vector<ProfileDecimator> decimators;
 };
 
 class DiveProfileItem : public AbstractProfilePolygonItem {
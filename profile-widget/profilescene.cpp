@@ -452,9 +452,16 @@ void ProfileScene::plotDive(const struct dive *dIn, int dcIn, DivePlannerPointsM
 	 * so I'll *not* calculate everything if something is not being
 	 * shown.
 	 * create_plot_info_new() automatically frees old plot data.
+	 * Outside of the planner, the plot info of recently shown dives is reused.
 	 */
-	if (!keepPlotInfo)
-		create_plot_info_new(d, currentdc, &plotInfo, planner_ds);
+	if (!keepPlotInfo) {
+		if (planner_ds)
+			create_plot_info_new(d, currentdc, &plotInfo, planner_ds);
+		else
+			create_plot_info_cached(d, currentdc, &plotInfo);
+		for (AbstractProfilePolygonItem *item: profileItems)
+			item->clearDecimation();
+	}
 
 	bool hasHeartBeat = plotInfo.maxhr;
 	// For mobile we might want to turn of some features that are normally shown.
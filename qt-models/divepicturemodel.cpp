@@ -77,8 +77,13 @@ void DivePictureModel::updateZoom()
 void DivePictureModel::updateThumbnails()
 {
 	updateZoom();
-	for (PictureEntry &entry: pictures)
-		entry.image = Thumbnailer::instance()->fetchThumbnail(QString::fromStdString(entry.filename), false);
+	QVector<QString> filenames;
+	filenames.reserve(pictures.size());
+	for (const PictureEntry &entry: pictures)
+		filenames.push_back(QString::fromStdString(entry.filename));
+	QVector<QImage> images = Thumbnailer::instance()->fetchThumbnails(filenames);
+	for (size_t i = 0; i < pictures.size(); ++i)
+		pictures[i].image = images[i];
 }
 
 void DivePictureModel::updateDivePictures()
@@ -227,8 +232,13 @@ void DivePictureModel::picturesAdded(dive *d, QVector<PictureObj> picsIn)
 		beginInsertRows(QModelIndex(), dest, dest + batch_size - 1);
 		pictures.insert(pictures.begin() + dest, from, to);
 		// Get thumbnails of inserted pictures
+		QVector<QString> filenames;
+		filenames.reserve(batch_size);
 		for (auto it = pictures.begin() + dest; it < pictures.begin() + dest + batch_size; ++it)
-			it->image = Thumbnailer::instance()->fetchThumbnail(QString::fromStdString(it->filename), false);
+			filenames.push_back(QString::fromStdString(it->filename));
+		QVector<QImage> images = Thumbnailer::instance()->fetchThumbnails(filenames);
+		for (int i = 0; i < batch_size; ++i)
+			pictures[dest + i].image = images[i];
 		endInsertRows();
 		from = to;
 		dest += batch_size;
@@ -242,12 +242,6 @@ void DivePlannerPointsModel::addCylinder_clicked()
 void DivePlannerPointsModel::setPlanMode(Mode m)
 {
 	mode = m;
-	// the planner may reset our GF settings that are used to show deco
-	// reset them to what's in the preferences
-	if (m != PLAN) {
-		set_gf(prefs.gflow, prefs.gfhigh);
-		set_vpmb_conservatism(prefs.vpmb_conservatism);
-	}
 }
 
 bool DivePlannerPointsModel::isPlanner() const
@@ -1179,22 +1173,30 @@ void DivePlannerPointsModel::computeVariationsFreeDeco(struct diveplan *original
 	delete previous_ds;
 }
 
+namespace {
+// One variation of the plan. Each variation is calculated on its own copy of
+// the dive and the deco state, so that they can be planned concurrently.
+struct PlanVariation {
+	struct diveplan plan;
+	struct dive *dive;
+	struct deco_state ds;
+	struct decostop stoptable[60];
+};
+}
+
 void DivePlannerPointsModel::computeVariations(struct diveplan *original_plan, const struct deco_state *previous_ds)
 {
 	// nothing to do unless there's an original plan
 	if (!original_plan)
 		return;
 
+	enum { ORIGINAL, DEEPER, SHALLOWER, LONGER, SHORTER, NUM_VARIATIONS };
+	std::vector<PlanVariation> variations(NUM_VARIATIONS);
 	struct dive *dive = alloc_dive();
 	copy_dive(d, dive);
-	struct decostop original[60], deeper[60], shallower[60], shorter[60], longer[60];
-	deco_state_cache cache, save;
-	struct diveplan plan_copy;
-	struct divedatapoint *last_segment;
-	struct deco_state ds = *previous_ds;
 
 	int my_instance = ++instanceCounter;
-	save.cache(&ds);
+	auto cancelled = [this, my_instance]() { return my_instance != instanceCounter; };
 
 	duration_t delta_time = { .seconds = 60 };
 	QString time_units = tr("min");
@@ -1209,60 +1211,62 @@ void DivePlannerPointsModel::computeVariations(struct diveplan *original_plan, c
 		depth_units = tr("ft");
 	}
 
-	last_segment = cloneDiveplan(original_plan, &plan_copy);
-	if (!last_segment)
-		goto finish;
-	if (my_instance != instanceCounter)
-		goto finish;
-	plan(&ds, &plan_copy, dive, dcNr, 1, original, cache, true, false);
-	free_dps(&plan_copy);
-	save.restore(&ds, false);
-
-	last_segment = cloneDiveplan(original_plan, &plan_copy);
-	last_segment->depth.mm += delta_depth.mm;
-	last_segment->next->depth.mm += delta_depth.mm;
-	if (my_instance != instanceCounter)
-		goto finish;
-	plan(&ds, &plan_copy, dive, dcNr, 1, deeper, cache, true, false);
-	free_dps(&plan_copy);
-	save.restore(&ds, false);
-
-	last_segment = cloneDiveplan(original_plan, &plan_copy);
-	last_segment->depth.mm -= delta_depth.mm;
-	last_segment->next->depth.mm -= delta_depth.mm;
-	if (my_instance != instanceCounter)
-		goto finish;
-	plan(&ds, &plan_copy, dive, dcNr, 1, shallower, cache, true, false);
-	free_dps(&plan_copy);
-	save.restore(&ds, false);
-
-	last_segment = cloneDiveplan(original_plan, &plan_copy);
-	last_segment->next->time += delta_time.seconds;
-	if (my_instance != instanceCounter)
-		goto finish;
-	plan(&ds, &plan_copy, dive, dcNr, 1, longer, cache, true, false);
-	free_dps(&plan_copy);
-	save.restore(&ds, false);
-
-	last_segment = cloneDiveplan(original_plan, &plan_copy);
-	last_segment->next->time -= delta_time.seconds;
-	if (my_instance != instanceCounter)
-		goto finish;
-	plan(&ds, &plan_copy, dive, dcNr, 1, shorter, cache, true, false);
-	free_dps(&plan_copy);
-	save.restore(&ds, false);
-
-	char buf[200];
-	sprintf(buf, ", %s: %c %d:%02d /%s %c %d:%02d /min", qPrintable(tr("Stop times")),
-		SIGNED_FRAC_TRIPLET(analyzeVariations(shallower, original, deeper, qPrintable(depth_units)), 60), qPrintable(depth_units),
-		SIGNED_FRAC_TRIPLET(analyzeVariations(shorter, original, longer, qPrintable(time_units)), 60));
-
-	// By using a signal, we can transport the variations to the main thread.
-	emit variationsComputed(QString(buf));
+	bool success = true;
+	for (int i = 0; i < NUM_VARIATIONS; ++i) {
+		PlanVariation &v = variations[i];
+		struct divedatapoint *last_segment = cloneDiveplan(original_plan, &v.plan);
+		v.dive = alloc_dive();
+		copy_dive(dive, v.dive);
+		v.ds = *previous_ds;
+		if (!last_segment || !last_segment->next) {
+			success = false;
+			continue;
+		}
+		switch (i) {
+		case DEEPER:
+			last_segment->depth.mm += delta_depth.mm;
+			last_segment->next->depth.mm += delta_depth.mm;
+			break;
+		case SHALLOWER:
+			last_segment->depth.mm -= delta_depth.mm;
+			last_segment->next->depth.mm -= delta_depth.mm;
+			break;
+		case LONGER:
+			last_segment->next->time += delta_time.seconds;
+			break;
+		case SHORTER:
+			last_segment->next->time -= delta_time.seconds;
+			break;
+		}
+	}
+
+	if (success && !cancelled()) {
+		QtConcurrent::blockingMap(variations, [this, &cancelled](PlanVariation &v) {
+			deco_state_cache cache;
+			plan(&v.ds, &v.plan, v.dive, dcNr, 1, v.stoptable, cache, true, false, cancelled);
+		});
+	}
+
+	// If a newer calculation was started, the stop tables may be incomplete.
+	if (success && !cancelled()) {
+		char buf[200];
+		sprintf(buf, ", %s: %c %d:%02d /%s %c %d:%02d /min", qPrintable(tr("Stop times")),
+			SIGNED_FRAC_TRIPLET(analyzeVariations(variations[SHALLOWER].stoptable, variations[ORIGINAL].stoptable,
+							      variations[DEEPER].stoptable, qPrintable(depth_units)), 60), qPrintable(depth_units),
+			SIGNED_FRAC_TRIPLET(analyzeVariations(variations[SHORTER].stoptable, variations[ORIGINAL].stoptable,
+							      variations[LONGER].stoptable, qPrintable(time_units)), 60));
+
+		// By using a signal, we can transport the variations to the main thread.
+		emit variationsComputed(QString(buf));
 #ifdef DEBUG_STOPVAR
-	printf("\n\n");
+		printf("\n\n");
 #endif
-finish:
+	}
+
+	for (PlanVariation &v: variations) {
+		free_dps(&v.plan);
+		free_dive(v.dive);
+	}
 	free_dps(original_plan);
 	free(original_plan);
 	free_dive(dive);
@@ -4,6 +4,7 @@
 
 #include <QAbstractTableModel>
 #include <QDateTime>
+#include <atomic>
 #include <vector>
 
 #include "core/deco.h"
@@ -140,7 +141,7 @@ private:
 	Mode mode;
 	QVector<divedatapoint> divepoints;
 	QDateTime startTime;
-	int instanceCounter = 0;
+	std::atomic<int> instanceCounter = 0; // Incremented to cancel running variation calculations
 	struct deco_state ds_after_previous_dives;
 	duration_t preserved_until;
 };
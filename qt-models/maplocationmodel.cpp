@@ -2,6 +2,7 @@
 #include "maplocationmodel.h"
 #include "divelocationmodel.h"
 #include "core/divesite.h"
+#include "core/divesiteindex.h"
 #include "core/divefilter.h"
 #include "core/divelog.h"
 #include "core/settings/qPrefDisplay.h"
@@ -10,7 +11,10 @@
 #include "desktop-widgets/mapwidget.h"
 #endif
 
-#define MIN_DISTANCE_BETWEEN_DIVE_SITES_M 50.0
+#include <unordered_map>
+#include <unordered_set>
+
+#define MIN_DISTANCE_BETWEEN_DIVE_SITES_M 50
 
 // MKW If "Map Short Names" preference is set, only return the last component
 // of the full dive site name.
@@ -134,8 +138,9 @@ void MapLocationModel::selectionChanged()
 {
 	if (m_mapLocations.isEmpty())
 		return;
+	std::unordered_set<const dive_site *> selected(m_selectedDs.begin(), m_selectedDs.end());
 	for(MapLocation *m: m_mapLocations)
-		m->selected = m_selectedDs.contains(m->divesite);
+		m->selected = selected.count(m->divesite) > 0;
 	emit dataChanged(createIndex(0, 0), createIndex(m_mapLocations.size() - 1, 0));
 }
 
@@ -147,7 +152,8 @@ void MapLocationModel::reload(QObject *map)
 	m_mapLocations.clear();
 	m_selectedDs.clear();
 
-	QMap<QString, MapLocation *> locationNameMap;
+	// The sites that are shown on the map. Used to skip close-by sites with the same name.
+	std::unordered_map<const dive_site *, MapLocation *> shownSites;
 
 #if defined(SUBSURFACE_MOBILE) || defined(SUBSURFACE_DOWNLOADER)
 	bool diveSiteMode = false;
@@ -160,6 +166,7 @@ void MapLocationModel::reload(QObject *map)
 	if (diveSiteMode)
 		m_selectedDs = DiveFilter::instance()->filteredDiveSites();
 #endif
+	std::unordered_set<const dive_site *> selected(m_selectedDs.begin(), m_selectedDs.end());
 	for (int i = 0; i < divelog.sites->nr; ++i) {
 		struct dive_site *ds = divelog.sites->dive_sites[i];
 		QGeoCoordinate dsCoord;
@@ -171,7 +178,7 @@ void MapLocationModel::reload(QObject *map)
 			// Dive sites that do not have a gps location are not shown in normal mode.
 			// In dive-edit mode, selected sites are placed at the center of the map,
 			// so that the user can drag them somewhere without having to enter coordinates.
-			if (!diveSiteMode || !m_selectedDs.contains(ds) || !map)
+			if (!diveSiteMode || !selected.count(ds) || !map)
 				continue;
 			dsCoord = map->property("center").value<QGeoCoordinate>();
 		} else {
@@ -179,24 +186,21 @@ void MapLocationModel::reload(QObject *map)
 			qreal longitude = ds->location.lon.udeg * 0.000001;
 			dsCoord = QGeoCoordinate(latitude, longitude);
 		}
-		if (!diveSiteMode && hasSelectedDive(ds) && !m_selectedDs.contains(ds))
+		if (!diveSiteMode && hasSelectedDive(ds) && selected.insert(ds).second)
 			m_selectedDs.append(ds);
 		QString name = siteMapDisplayName(ds->name);
 		if (!diveSiteMode) {
 			// don't add dive locations with the same name, unless they are
 			// at least MIN_DISTANCE_BETWEEN_DIVE_SITES_M apart
-			if (locationNameMap.contains(name)) {
-				MapLocation *existingLocation = locationNameMap[name];
-				QGeoCoordinate coord = existingLocation->coordinate;
-				if (dsCoord.distanceTo(coord) < MIN_DISTANCE_BETWEEN_DIVE_SITES_M)
-					continue;
-			}
+			std::vector<dive_site *> close = divesiteindex_within(&ds->location, MIN_DISTANCE_BETWEEN_DIVE_SITES_M - 1, divelog.sites);
+			if (std::any_of(close.begin(), close.end(), [&shownSites, &name](const dive_site *other)
+					{ auto it = shownSites.find(other); return it != shownSites.end() && it->second->name == name; }))
+				continue;
 		}
-		bool selected = m_selectedDs.contains(ds);
-		MapLocation *location = new MapLocation(ds, dsCoord, name, selected);
+		MapLocation *location = new MapLocation(ds, dsCoord, name, selected.count(ds) > 0);
 		m_mapLocations.append(location);
 		if (!diveSiteMode)
-			locationNameMap[name] = location;
+			shownSites[ds] = location;
 	}
 
 	endResetModel();
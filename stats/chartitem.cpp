@@ -108,111 +108,6 @@ QRectF ChartPixmapItem::getRect() const
 	return rect;
 }
 
-static const int scatterItemDiameter = 10;
-static const int scatterItemBorder = 1;
-
-ChartScatterItem::ChartScatterItem(StatsView &v, ChartZValue z, bool selected) : HideableChartItem(v, z),
-	positionDirty(false), textureDirty(false),
-	highlight(selected ? Highlight::Selected : Highlight::Unselected)
-{
-	rect.setSize(QSizeF(static_cast<double>(scatterItemDiameter), static_cast<double>(scatterItemDiameter)));
-}
-
-ChartScatterItem::~ChartScatterItem()
-{
-}
-
-static QSGTexture *createScatterTexture(StatsView &view, const QColor &color, const QColor &borderColor)
-{
-	QImage img(scatterItemDiameter, scatterItemDiameter, QImage::Format_ARGB32);
-	img.fill(Qt::transparent);
-	QPainter painter(&img);
-	painter.setPen(Qt::NoPen);
-	painter.setRenderHint(QPainter::Antialiasing);
-	painter.setBrush(borderColor);
-	painter.drawEllipse(0, 0, scatterItemDiameter, scatterItemDiameter);
-	painter.setBrush(color);
-	painter.drawEllipse(scatterItemBorder, scatterItemBorder,
-			    scatterItemDiameter - 2 * scatterItemBorder,
-			    scatterItemDiameter - 2 * scatterItemBorder);
-	return view.w()->createTextureFromImage(img, QQuickWindow::TextureHasAlphaChannel);
-}
-
-QSGTexture *ChartScatterItem::getTexture(const StatsTheme &theme) const
-{
-	switch (highlight) {
-	default:
-	case Highlight::Unselected:
-		return theme.scatterItemTexture;
-	case Highlight::Selected:
-		return theme.scatterItemSelectedTexture;
-	case Highlight::Highlighted:
-		return theme.scatterItemHighlightedTexture;
-	}
-}
-
-void ChartScatterItem::render(const StatsTheme &theme)
-{
-	if (!theme.scatterItemTexture) {
-		theme.scatterItemTexture = register_global(createScatterTexture(view, theme.fillColor, theme.borderColor));
-		theme.scatterItemSelectedTexture = register_global(createScatterTexture(view, theme.selectedColor, theme.selectedBorderColor));
-		theme.scatterItemHighlightedTexture = register_global(createScatterTexture(view, theme.highlightedColor, theme.highlightedBorderColor));
-	}
-	if (!node) {
-		createNode(view.w()->createImageNode());
-		view.addQSGNode(node.get(), zValue);
-		textureDirty = positionDirty = true;
-	}
-	updateVisible();
-	if (textureDirty) {
-		node->node->setTexture(getTexture(theme));
-		textureDirty = false;
-	}
-	if (positionDirty) {
-		node->node->setRect(rect);
-		positionDirty = false;
-	}
-}
-
-void ChartScatterItem::setPos(QPointF pos)
-{
-	pos -= QPointF(scatterItemDiameter / 2.0, scatterItemDiameter / 2.0);
-	rect.moveTopLeft(pos);
-	positionDirty = true;
-	markDirty();
-}
-
-static double squareDist(const QPointF &p1, const QPointF &p2)
-{
-	QPointF diff = p1 - p2;
-	return QPointF::dotProduct(diff, diff);
-}
-
-bool ChartScatterItem::contains(QPointF point) const
-{
-	return squareDist(point, rect.center()) <= (scatterItemDiameter / 2.0) * (scatterItemDiameter / 2.0);
-}
-
-// For rectangular selections, we are more crude: simply check whether the center is in the selection.
-bool ChartScatterItem::inRect(const QRectF &selection) const
-{
-	return selection.contains(rect.center());
-}
-
-void ChartScatterItem::setHighlight(Highlight highlightIn)
-{
-	if (highlight == highlightIn)
-		return;
-	highlight = highlightIn;
-	textureDirty = true;
-	markDirty();
-}
-
-QRectF ChartScatterItem::getRect() const
-{
-	return rect;
-}
-
 ChartRectItem::ChartRectItem(StatsView &v, ChartZValue z,
 			     const QPen &pen, const QBrush &brush, double radius) : ChartPixmapItem(v, z),
 	pen(pen), brush(brush), radius(radius)
@@ -618,3 +513,164 @@ QRectF ChartBoxItem::getRect() const
 	res.setBottom(max);
 	return rect;
 }
+
+static const int scatterItemDiameter = 10;
+static const int scatterItemBorder = 1;
+
+// The texture contains the three states side by side. Add a transparent border
+// around each state, so that the states don't bleed into each other.
+static const int scatterTexturePadding = 1;
+static const int scatterTextureCellSize = scatterItemDiameter + 2 * scatterTexturePadding;
+
+static void drawScatterItem(QPainter &painter, int idx, const QColor &color, const QColor &borderColor)
+{
+	int x = idx * scatterTextureCellSize + scatterTexturePadding;
+	int y = scatterTexturePadding;
+	painter.setBrush(borderColor);
+	painter.drawEllipse(x, y, scatterItemDiameter, scatterItemDiameter);
+	painter.setBrush(color);
+	painter.drawEllipse(x + scatterItemBorder, y + scatterItemBorder,
+			    scatterItemDiameter - 2 * scatterItemBorder,
+			    scatterItemDiameter - 2 * scatterItemBorder);
+}
+
+// The order of the states must correspond to the ChartScatterItems::Highlight enum.
+static QSGTexture *createScatterTexture(StatsView &view, const StatsTheme &theme)
+{
+	QImage img(3 * scatterTextureCellSize, scatterTextureCellSize, QImage::Format_ARGB32);
+	img.fill(Qt::transparent);
+	QPainter painter(&img);
+	painter.setPen(Qt::NoPen);
+	painter.setRenderHint(QPainter::Antialiasing);
+	drawScatterItem(painter, 0, theme.fillColor, theme.borderColor);
+	drawScatterItem(painter, 1, theme.selectedColor, theme.selectedBorderColor);
+	drawScatterItem(painter, 2, theme.highlightedColor, theme.highlightedBorderColor);
+	return view.w()->createTextureFromImage(img, QQuickWindow::TextureHasAlphaChannel);
+}
+
+ChartScatterItems::ChartScatterItems(StatsView &v, ChartZValue z) : HideableChartItem(v, z),
+	allDirty(false)
+{
+}
+
+ChartScatterItems::~ChartScatterItems()
+{
+}
+
+void ChartScatterItems::append(QPointF pos, Highlight highlight)
+{
+	items.push_back({ pos, highlight });
+	allDirty = true;
+	markDirty();
+}
+
+void ChartScatterItems::setDirty(int idx)
+{
+	if (!allDirty)
+		dirtyItems.push_back(idx);
+	markDirty();
+}
+
+void ChartScatterItems::setPos(int idx, QPointF pos)
+{
+	items[idx].pos = pos;
+	setDirty(idx);
+}
+
+void ChartScatterItems::setHighlight(int idx, Highlight highlight)
+{
+	if (items[idx].highlight == highlight)
+		return;
+	items[idx].highlight = highlight;
+	setDirty(idx);
+}
+
+// Each item is drawn as two triangles, i.e. six vertices.
+static void setScatterItemVertices(QSGGeometry::TexturedPoint2D *v, QPointF pos, int state, const QRectF &textureRect)
+{
+	double r = scatterTextureCellSize / 2.0;
+	double w = textureRect.width() / 3.0;
+	QPointF topLeft(pos.x() - r, pos.y() - r), bottomRight(pos.x() + r, pos.y() + r);
+	QPointF texTopLeft(textureRect.left() + state * w, textureRect.top());
+	QPointF texBottomRight(texTopLeft.x() + w, textureRect.bottom());
+	setPoint(v[0], topLeft, texTopLeft);
+	setPoint(v[1], QPointF(bottomRight.x(), topLeft.y()), QPointF(texBottomRight.x(), texTopLeft.y()));
+	setPoint(v[2], QPointF(topLeft.x(), bottomRight.y()), QPointF(texTopLeft.x(), texBottomRight.y()));
+	v[3] = v[2];
+	v[4] = v[1];
+	setPoint(v[5], bottomRight, texBottomRight);
+}
+
+void ChartScatterItems::render(const StatsTheme &theme)
+{
+	if (!theme.scatterItemTexture)
+		theme.scatterItemTexture = register_global(createScatterTexture(view, theme));
+	if (!node) {
+		material.reset(new QSGTextureMaterial);
+		material->setTexture(theme.scatterItemTexture);
+		material->setFiltering(QSGTexture::Linear);
+		createNode();
+		node->setMaterial(material.get());
+		view.addQSGNode(node.get(), zValue);
+		allDirty = true;
+	}
+	updateVisible();
+
+	if (!allDirty && dirtyItems.empty())
+		return;
+
+	// The texture might be part of a texture atlas.
+	QRectF textureRect = theme.scatterItemTexture->normalizedTextureSubRect();
+	if (allDirty) {
+		int numVertices = static_cast<int>(items.size()) * 6;
+		if (!geometry || geometry->vertexCount() != numVertices) {
+			geometry.reset(new QSGGeometry(QSGGeometry::defaultAttributes_TexturedPoint2D(), numVertices));
+			geometry->setDrawingMode(QSGGeometry::DrawTriangles);
+			node->setGeometry(geometry.get());
+		}
+		auto vertices = geometry->vertexDataAsTexturedPoint2D();
+		for (const Item &item: items) {
+			setScatterItemVertices(vertices, item.pos, static_cast<int>(item.highlight), textureRect);
+			vertices += 6;
+		}
+	} else {
+		auto vertices = geometry->vertexDataAsTexturedPoint2D();
+		for (int idx: dirtyItems)
+			setScatterItemVertices(vertices + idx * 6, items[idx].pos, static_cast<int>(items[idx].highlight), textureRect);
+	}
+	node->markDirty(QSGNode::DirtyGeometry);
+	dirtyItems.clear();
+	allDirty = false;
+}
+
+int ChartScatterItems::size() const
+{
+	return static_cast<int>(items.size());
+}
+
+QPointF ChartScatterItems::getPos(int idx) const
+{
+	return items[idx].pos;
+}
+
+double ChartScatterItems::radius()
+{
+	return scatterItemDiameter / 2.0;
+}
+
+static double squareDist(const QPointF &p1, const QPointF &p2)
+{
+	QPointF diff = p1 - p2;
+	return QPointF::dotProduct(diff, diff);
+}
+
+bool ChartScatterItems::contains(int idx, QPointF point) const
+{
+	return squareDist(point, items[idx].pos) <= radius() * radius();
+}
+
+// For rectangular selections, we are more crude: simply check whether the center is in the selection.
+bool ChartScatterItems::inRect(int idx, const QRectF &selection) const
+{
+	return selection.contains(items[idx].pos);
+}
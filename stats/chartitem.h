@@ -188,14 +188,15 @@ private:
 	std::unique_ptr<QSGGeometry> whiskersGeometry;
 };
 
-// An item in a scatter chart. This is not simply a normal pixmap item,
-// because we want that all items share the *same* texture for memory
-// efficiency. It is somewhat questionable to define the form of the
-// scatter item here, but so it is for now.
-class ChartScatterItem : public HideableChartProxyItem<QSGImageNode> {
+// All items of a scatter chart. To be able to show large numbers of dives,
+// the items are not represented by individual nodes, but are rendered as
+// one geometry node. The different states of the items (selected, highlighted)
+// are different regions of the same texture. It is somewhat questionable to
+// define the form of the scatter items here, but so it is for now.
+class ChartScatterItems : public HideableChartItem<HideableQSGNode<QSGGeometryNode>> {
 public:
-	ChartScatterItem(StatsView &v, ChartZValue z, bool selected);
-	~ChartScatterItem();
+	ChartScatterItems(StatsView &v, ChartZValue z);
+	~ChartScatterItems();
 
 	// Currently, there is no highlighted and selected status.
 	enum class Highlight {
@@ -203,18 +204,26 @@ public:
 		Selected,
 		Highlighted
 	};
-	void setPos(QPointF pos);		// Specifies the *center* of the item.
-	void setHighlight(Highlight highlight);	// In the future, support different kinds of scatter items.
+	void append(QPointF pos, Highlight highlight);
+	void setPos(int idx, QPointF pos);		// Specifies the *center* of the item.
+	void setHighlight(int idx, Highlight highlight);
 	void render(const StatsTheme &theme) override;
-	QRectF getRect() const;
-	bool contains(QPointF point) const;
-	bool inRect(const QRectF &rect) const;
+	int size() const;
+	QPointF getPos(int idx) const;
+	bool contains(int idx, QPointF point) const;
+	bool inRect(int idx, const QRectF &rect) const;
+	static double radius();
 private:
-	QSGTexture *getTexture(const StatsTheme &theme) const;
-	QRectF rect;
-	QSizeF textureSize;
-	bool positionDirty, textureDirty;
-	Highlight highlight;
+	struct Item {
+		QPointF pos;
+		Highlight highlight;
+	};
+	std::vector<Item> items;
+	std::vector<int> dirtyItems;	// Items that changed since last render
+	bool allDirty;			// All items changed, e.g. after resizing or adding items
+	std::unique_ptr<QSGTextureMaterial> material;
+	std::unique_ptr<QSGGeometry> geometry;
+	void setDirty(int idx);
 };
 
 // Implementation detail of templates - move to serparate header file
@@ -13,9 +13,14 @@
 #include "core/qthelper.h"
 #include "core/selection.h"
 
+#include <algorithm>
+#include <cmath>
+
 ScatterSeries::ScatterSeries(StatsView &view, StatsAxis *xAxis, StatsAxis *yAxis,
 			     const StatsVariable &varX, const StatsVariable &varY) :
 	StatsSeries(view, xAxis, yAxis),
+	scatterItems(view.createChartItem<ChartScatterItems>(ChartZValue::Series)),
+	gridDirty(true),
 	varX(varX), varY(varY)
 {
 }
@@ -24,75 +29,123 @@ ScatterSeries::~ScatterSeries()
 {
 }
 
-ScatterSeries::Item::Item(StatsView &view, ScatterSeries *series, dive *d, double pos, double value) :
-	item(view.createChartItem<ChartScatterItem>(ChartZValue::Series, d->selected)),
-	d(d),
-	selected(d->selected),
-	pos(pos),
-	value(value)
+static ChartScatterItems::Highlight highlightStatus(const dive *d, bool highlight)
 {
-	updatePosition(series);
+	if (highlight)
+		return ChartScatterItems::Highlight::Highlighted;
+	return d->selected ? ChartScatterItems::Highlight::Selected : ChartScatterItems::Highlight::Unselected;
 }
 
-void ScatterSeries::Item::updatePosition(ScatterSeries *series)
+void ScatterSeries::highlight(int idx, bool highlight)
 {
-	item->setPos(series->toScreen(QPointF(pos, value)));
+	scatterItems->setHighlight(idx, highlightStatus(items[idx].d, highlight));
 }
 
-void ScatterSeries::Item::highlight(bool highlight)
+void ScatterSeries::append(dive *d, double pos, double value)
 {
-	ChartScatterItem::Highlight status = d->selected ?
-		ChartScatterItem::Highlight::Selected : ChartScatterItem::Highlight::Unselected;
-	if (highlight)
-		status = ChartScatterItem::Highlight::Highlighted;
-	item->setHighlight(status);
+	items.push_back({ d, d->selected, pos, value });
+	scatterItems->append(toScreen(QPointF(pos, value)), highlightStatus(d, false));
+	gridDirty = true;
 }
 
-void ScatterSeries::append(dive *d, double pos, double value)
+void ScatterSeries::updatePositions()
 {
-	items.emplace_back(view, this, d, pos, value);
+	for (size_t i = 0; i < items.size(); ++i)
+		scatterItems->setPos(static_cast<int>(i), toScreen(QPointF(items[i].pos, items[i].value)));
+	gridDirty = true;
 }
 
-void ScatterSeries::updatePositions()
+// Use cells of the size of an item: a point is covered by items of at most four cells.
+// Limit the number of cells for degenerate cases, e.g. items far outside of the chart.
+static const int maxGridCells = 1 << 20;
+
+void ScatterSeries::Grid::build(const ChartScatterItems &scatterItems)
 {
-	for (Item &item: items)
-		item.updatePosition(this);
+	int n = scatterItems.size();
+	cellStart.clear();
+	items.clear();
+	width = height = 0;
+	if (n <= 0)
+		return;
+
+	QRectF bounds(scatterItems.getPos(0), QSizeF());
+	for (int i = 1; i < n; ++i) {
+		QPointF pos = scatterItems.getPos(i);
+		bounds.setLeft(std::min(bounds.left(), pos.x()));
+		bounds.setRight(std::max(bounds.right(), pos.x()));
+		bounds.setTop(std::min(bounds.top(), pos.y()));
+		bounds.setBottom(std::max(bounds.bottom(), pos.y()));
+	}
+	origin = bounds.topLeft();
+	cellSize = 2.0 * ChartScatterItems::radius();
+	while ((bounds.width() / cellSize + 1.0) * (bounds.height() / cellSize + 1.0) > maxGridCells)
+		cellSize *= 2.0;
+	width = static_cast<int>(bounds.width() / cellSize) + 1;
+	height = static_cast<int>(bounds.height() / cellSize) + 1;
+
+	// Counting sort of the items by cell
+	std::vector<int> cellOfItem(n);
+	cellStart.assign(width * height + 1, 0);
+	for (int i = 0; i < n; ++i) {
+		QPointF pos = scatterItems.getPos(i) - origin;
+		int x = std::min(static_cast<int>(pos.x() / cellSize), width - 1);
+		int y = std::min(static_cast<int>(pos.y() / cellSize), height - 1);
+		cellOfItem[i] = y * width + x;
+		++cellStart[cellOfItem[i] + 1];
+	}
+	for (int i = 0; i < width * height; ++i)
+		cellStart[i + 1] += cellStart[i];
+	std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+	items.resize(n);
+	for (int i = 0; i < n; ++i)
+		items[fill[cellOfItem[i]]++] = i;
 }
 
-std::vector<int> ScatterSeries::getItemsUnderMouse(const QPointF &point) const
+std::vector<int> ScatterSeries::Grid::itemsInRect(const QRectF &rect) const
 {
 	std::vector<int> res;
-	double x = point.x();
-
-	auto low = std::lower_bound(items.begin(), items.end(), x,
-				    [] (const Item &item, double x) { return item.item->getRect().right() < x; });
-	auto high = std::upper_bound(low, items.end(), x,
-				    [] (double x, const Item &item) { return x < item.item->getRect().left(); });
-	// Hopefully that narrows it down enough. For discrete scatter plots, we could also partition
-	// by equal x and do a binary search in these partitions. But that's probably not worth it.
-	res.reserve(high - low);
-	for (auto it = low; it < high; ++it) {
-		if (it->item->contains(point))
-			res.push_back(it - items.begin());
+	if (width <= 0 || height <= 0)
+		return res;
+	QRectF r = rect.translated(-origin);
+	int x1 = std::max(static_cast<int>(floor(r.left() / cellSize)), 0);
+	int x2 = std::min(static_cast<int>(floor(r.right() / cellSize)), width - 1);
+	int y1 = std::max(static_cast<int>(floor(r.top() / cellSize)), 0);
+	int y2 = std::min(static_cast<int>(floor(r.bottom() / cellSize)), height - 1);
+	for (int y = y1; y <= y2; ++y) {
+		for (int x = x1; x <= x2; ++x) {
+			int cell = y * width + x;
+			res.insert(res.end(), items.begin() + cellStart[cell], items.begin() + cellStart[cell + 1]);
+		}
 	}
+	std::sort(res.begin(), res.end());
 	return res;
 }
 
-std::vector<int> ScatterSeries::getItemsInRect(const QRectF &rect) const
+const ScatterSeries::Grid &ScatterSeries::getGrid() const
 {
-	std::vector<int> res;
-
-	auto low = std::lower_bound(items.begin(), items.end(), rect.left(),
-				    [] (const Item &item, double x) { return item.item->getRect().right() < x; });
-	auto high = std::upper_bound(low, items.end(), rect.right(),
-				    [] (double x, const Item &item) { return x < item.item->getRect().left(); });
-	// Hopefully that narrows it down enough. For discrete scatter plots, we could also partition
-	// by equal x and do a binary search in these partitions. But that's probably not worth it.
-	res.reserve(high - low);
-	for (auto it = low; it < high; ++it) {
-		if (it->item->inRect(rect))
-			res.push_back(it - items.begin());
+	if (gridDirty) {
+		grid.build(*scatterItems);
+		gridDirty = false;
 	}
+	return grid;
+}
+
+std::vector<int> ScatterSeries::getItemsUnderMouse(const QPointF &point) const
+{
+	double r = ChartScatterItems::radius();
+	std::vector<int> res = getGrid().itemsInRect(QRectF(point.x() - r, point.y() - r, 2.0 * r, 2.0 * r));
+	res.erase(std::remove_if(res.begin(), res.end(),
+				 [this, &point](int idx) { return !scatterItems->contains(idx, point); }),
+		  res.end());
+	return res;
+}
+
+std::vector<int> ScatterSeries::getItemsInRect(const QRectF &rect) const
+{
+	std::vector<int> res = getGrid().itemsInRect(rect);
+	res.erase(std::remove_if(res.begin(), res.end(),
+				 [this, &rect](int idx) { return !scatterItems->inRect(idx, rect); }),
+		  res.end());
 	return res;
 }
 
@@ -122,9 +175,10 @@ void ScatterSeries::selectItemsInRect(const QRectF &rect, SelectionModifier modi
 
 	if (modifier.ctrl) {
 		selected = oldSelection;
-		// Ouch - this primitive merging of the selections grows with O(n^2). Fix this.
+		std::vector<dive *> sortedOldSelection = oldSelection;
+		std::sort(sortedOldSelection.begin(), sortedOldSelection.end());
 		for (int idx: indices) {
-			if (std::find(selected.begin(), selected.end(), items[idx].d) == selected.end())
+			if (!std::binary_search(sortedOldSelection.begin(), sortedOldSelection.end(), items[idx].d))
 				selected.push_back(items[idx].d);
 		}
 	} else {
@@ -168,13 +222,14 @@ bool ScatterSeries::hover(QPointF pos)
 	}
 
 	// This might be overkill: differential unhighlighting / highlighting of items.
+	// Note: both lists are sorted.
 	for (int idx: highlighted) {
-		if (std::find(newHighlighted.begin(), newHighlighted.end(), idx) == newHighlighted.end())
-			items[idx].highlight(false);
+		if (!std::binary_search(newHighlighted.begin(), newHighlighted.end(), idx))
+			highlight(idx, false);
 	}
 	for (int idx: newHighlighted) {
-		if (std::find(highlighted.begin(), highlighted.end(), idx) == highlighted.end())
-			items[idx].highlight(true);
+		if (!std::binary_search(highlighted.begin(), highlighted.end(), idx))
+			highlight(idx, true);
 	}
 	highlighted = std::move(newHighlighted);
 
@@ -213,7 +268,7 @@ bool ScatterSeries::hover(QPointF pos)
 void ScatterSeries::unhighlight()
 {
 	for (int idx: highlighted)
-		items[idx].highlight(false);
+		highlight(idx, false);
 	highlighted.clear();
 }
 
@@ -223,8 +278,8 @@ void ScatterSeries::divesSelected(const QVector<dive *> &)
 		if (item.selected != item.d->selected) {
 			item.selected = item.d->selected;
 			int idx = &item - &items[0];
-			bool highlight = std::find(highlighted.begin(), highlighted.end(), idx) != highlighted.end();
-			item.highlight(highlight);
+			bool isHighlighted = std::binary_search(highlighted.begin(), highlighted.end(), idx);
+			highlight(idx, isHighlighted);
 		}
 	}
 }
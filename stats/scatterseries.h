@@ -10,7 +10,7 @@
 #include <memory>
 #include <vector>
 
-class ChartScatterItem;
+class ChartScatterItems;
 struct InformationBox;
 struct StatsVariable;
 struct dive;
@@ -37,15 +37,30 @@ private:
 	std::vector<int> getItemsInRect(const QRectF &f) const;
 
 	struct Item {
-		ChartItemPtr<ChartScatterItem> item;
 		dive *d;
 		bool selected;
 		double pos, value;
-		Item(StatsView &view, ScatterSeries *series, dive *d, double pos, double value);
-		void updatePosition(ScatterSeries *series);
-		void highlight(bool highlight);
 	};
 
+	// A uniform grid of the item positions on the screen, so that hovering
+	// and selection don't have to test every item. Rebuilt on demand after
+	// the positions changed.
+	struct Grid {
+		QPointF origin;
+		double cellSize;
+		int width, height;
+		std::vector<int> cellStart;	// Start of the items of each cell in the items array. One additional element at the end.
+		std::vector<int> items;		// Item indices, sorted by cell
+		void build(const ChartScatterItems &scatterItems);
+		std::vector<int> itemsInRect(const QRectF &rect) const;	// Items whose cell overlaps the rectangle. Sorted.
+	};
+
+	ChartItemPtr<ChartScatterItems> scatterItems;
+	mutable Grid grid;
+	mutable bool gridDirty;
+	const Grid &getGrid() const;
+	void highlight(int idx, bool highlight);
+
 	ChartItemPtr<InformationBox> information;
 	std::vector<Item> items;
 	std::vector<int> highlighted;
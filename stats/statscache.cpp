@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "statscache.h"
+#include "core/subsurface-qt/divelistnotifier.h"
+#include "core/settings/qPrefUnit.h"
+
+#include <algorithm>
+#include <vector>
+
+// The caches are members of the statically allocated variables and binners.
+// Use a function-local static to avoid problems with the order of initialization.
+static std::vector<StatsCacheBase *> &caches()
+{
+	static std::vector<StatsCacheBase *> res;
+	return res;
+}
+
+static void clearCaches()
+{
+	for (StatsCacheBase *cache: caches())
+		cache->clear();
+}
+
+static void invalidateDive(const dive *d)
+{
+	for (StatsCacheBase *cache: caches())
+		cache->invalidate(d);
+}
+
+static void invalidateDives(const QVector<dive *> &dives)
+{
+	for (const dive *d: dives)
+		invalidateDive(d);
+}
+
+StatsCacheBase::StatsCacheBase()
+{
+	caches().push_back(this);
+}
+
+// A copy starts out empty, but has to be registered on its own.
+StatsCacheBase::StatsCacheBase(const StatsCacheBase &) : StatsCacheBase()
+{
+}
+
+StatsCacheBase &StatsCacheBase::operator=(const StatsCacheBase &)
+{
+	return *this;
+}
+
+StatsCacheBase::~StatsCacheBase()
+{
+	std::vector<StatsCacheBase *> &c = caches();
+	c.erase(std::remove(c.begin(), c.end(), this), c.end());
+}
+
+// This can't be done when registering the caches, because they are
+// constructed before the DiveListNotifier.
+void StatsCacheBase::connectNotifier()
+{
+	static bool connected = false;
+	if (connected)
+		return;
+	connected = true;
+
+	QObject::connect(&diveListNotifier, &DiveListNotifier::dataReset, &clearCaches);
+	QObject::connect(&diveListNotifier, &DiveListNotifier::settingsChanged, &clearCaches);
+	QObject::connect(&diveListNotifier, &DiveListNotifier::divesImported, &clearCaches);
+	QObject::connect(&diveListNotifier, &DiveListNotifier::diveComputerEdited, &clearCaches);
+	QObject::connect(&diveListNotifier, &DiveListNotifier::deviceEdited, &clearCaches);
+	QObject::connect(&diveListNotifier, &DiveListNotifier::tripChanged, &clearCaches);
+	QObject::connect(&diveListNotifier, &DiveListNotifier::diveSiteChanged, &clearCaches);
+	QObject::connect(&diveListNotifier, &DiveListNotifier::diveSiteDeleted, &clearCaches);
+	QObject::connect(&diveListNotifier, &DiveListNotifier::diveSiteDivesChanged, &clearCaches);
+
+	// The values are in the units of the user, but changes of the units
+	// are not necessarily followed by settingsChanged.
+	QObject::connect(qPrefUnits::instance(), &qPrefUnits::unit_systemChanged, &clearCaches);
+	QObject::connect(qPrefUnits::instance(), &qPrefUnits::lengthChanged, &clearCaches);
+	QObject::connect(qPrefUnits::instance(), &qPrefUnits::pressureChanged, &clearCaches);
+	QObject::connect(qPrefUnits::instance(), &qPrefUnits::temperatureChanged, &clearCaches);
+	QObject::connect(qPrefUnits::instance(), &qPrefUnits::volumeChanged, &clearCaches);
+	QObject::connect(qPrefUnits::instance(), &qPrefUnits::weightChanged, &clearCaches);
+
+	// Dive pointers may be reused after deletion. Therefore, also remove deleted dives.
+	QObject::connect(&diveListNotifier, &DiveListNotifier::divesAdded,
+			 [](dive_trip *, bool, const QVector<dive *> &dives) { invalidateDives(dives); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::divesDeleted,
+			 [](dive_trip *, bool, const QVector<dive *> &dives) { invalidateDives(dives); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::divesMovedBetweenTrips,
+			 [](dive_trip *, dive_trip *, bool, bool, const QVector<dive *> &dives) { invalidateDives(dives); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::divesChanged,
+			 [](const QVector<dive *> &dives, DiveField) { invalidateDives(dives); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::divesTimeChanged,
+			 [](timestamp_t, const QVector<dive *> &dives) { invalidateDives(dives); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::cylindersReset, &invalidateDives);
+	QObject::connect(&diveListNotifier, &DiveListNotifier::weightsystemsReset, &invalidateDives);
+	QObject::connect(&diveListNotifier, &DiveListNotifier::cylinderAdded, [](dive *d, int) { invalidateDive(d); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::cylinderRemoved, [](dive *d, int) { invalidateDive(d); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::cylinderEdited, [](dive *d, int) { invalidateDive(d); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::weightAdded, [](dive *d, int) { invalidateDive(d); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::weightRemoved, [](dive *d, int) { invalidateDive(d); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::weightEdited, [](dive *d, int) { invalidateDive(d); });
+	QObject::connect(&diveListNotifier, &DiveListNotifier::eventsChanged, [](dive *d) { invalidateDive(d); });
+}
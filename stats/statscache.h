@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0
+// Caches of the per-dive values of the statistics variables and binners.
+// Some of these values are expensive to calculate (e.g. SAC, gas use or
+// the formatted trip title) and they are needed anew every time the
+// chart type or one of the variables is changed.
+//
+// Entries of single dives are dropped when these dives are edited or
+// deleted. All entries are dropped when the dive log is reset or when
+// the settings (e.g. units), trips or dive sites change. To this end, all
+// caches register themselves in a global list, which is informed by the
+// DiveListNotifier and by qPrefUnits.
+#ifndef STATS_CACHE_H
+#define STATS_CACHE_H
+
+#include <unordered_map>
+
+struct dive;
+
+class StatsCacheBase {
+public:
+	StatsCacheBase();
+	StatsCacheBase(const StatsCacheBase &);
+	StatsCacheBase &operator=(const StatsCacheBase &);
+	virtual ~StatsCacheBase();
+	virtual void invalidate(const dive *d) = 0;
+	virtual void clear() = 0;
+protected:
+	static void connectNotifier();
+};
+
+template <typename T>
+class StatsDiveCache : public StatsCacheBase {
+	std::unordered_map<const dive *, T> values;
+public:
+	// Returns the cached value or calculates it with func(d).
+	template <typename Func>
+	const T &get(const dive *d, Func func)
+	{
+		connectNotifier();
+		auto it = values.find(d);
+		if (it == values.end())
+			it = values.emplace(d, func(d)).first;
+		return it->second;
+	}
+	void invalidate(const dive *d) override
+	{
+		values.erase(d);
+	}
+	void clear() override
+	{
+		values.clear();
+	}
+};
+
+#endif
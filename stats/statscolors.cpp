@@ -20,8 +20,6 @@ static const QColor binColors[] = {
 
 StatsTheme::StatsTheme() :
 	scatterItemTexture(nullptr),
-	scatterItemSelectedTexture(nullptr),
-	scatterItemHighlightedTexture(nullptr),
 	selectedTexture(nullptr)
 {
 }
@@ -52,9 +52,7 @@ public:
 	// freed the textures on exit. However, destroying textures after
 	// QApplication finished its thread leads to crashes. Therefore, these
 	// are now normal pointers and the texture objects are leaked.
-	mutable QSGTexture *scatterItemTexture = nullptr;
-	mutable QSGTexture *scatterItemSelectedTexture = nullptr;
-	mutable QSGTexture *scatterItemHighlightedTexture = nullptr;
+	mutable QSGTexture *scatterItemTexture = nullptr; // All states of the scatter items side by side.
 	mutable QSGTexture *selectedTexture = nullptr; // A checkerboard pattern.
 };
 
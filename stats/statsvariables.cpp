@@ -325,6 +325,11 @@ double StatsVariable::toFloat(const dive *d) const
 	return invalid_value<double>();
 }
 
+double StatsVariable::toFloatCached(const dive *d) const
+{
+	return valueCache.get(d, [this](const dive *d) { return toFloat(d); });
+}
+
 QString StatsVariable::nameWithUnit() const
 {
 	QString s = name();
@@ -400,7 +405,7 @@ std::vector<StatsValue> StatsVariable::values(const std::vector<dive *> &dives)
 	std::vector<StatsValue> vec;
 	vec.reserve(dives.size());
 	for (dive *d: dives) {
-		double v = toFloat(d);
+		double v = toFloatCached(d);
 		if (!is_invalid_value(v))
 			vec.push_back({ v, d });
 	}
@@ -528,8 +533,8 @@ std::vector<StatsScatterItem> StatsVariable::scatter(const StatsVariable &t2, co
 	std::vector<StatsScatterItem> res;
 	res.reserve(dives.size());
 	for (dive *d: dives) {
-		double v1 = toFloat(d);
-		double v2 = t2.toFloat(d);
+		double v1 = toFloatCached(d);
+		double v2 = t2.toFloatCached(d);
 		if (is_invalid_value(v1) || is_invalid_value(v2))
 			continue;
 		res.push_back({ v1, v2, d });
@@ -631,6 +636,8 @@ public:
 	const Bin &derived_bin(const StatsBin &bin) const {
 		return dynamic_cast<const Bin &>(bin);
 	}
+private:
+	mutable StatsDiveCache<Type> cache; // Values of the dives, see to_bin_value()
 };
 
 // Wrapper around std::lower_bound that searches for a value in a
@@ -693,7 +700,7 @@ std::vector<StatsBinDives> SimpleBinner<Binner, Bin>::bin_dives(const std::vecto
 	using Pair = std::pair<Type, std::vector<dive *>>;
 	std::vector<Pair> value_bins;
 	for (dive *d: dives) {
-		Type value = derived().to_bin_value(d);
+		const Type &value = cache.get(d, [this](const dive *d) { return derived().to_bin_value(d); });
 		if (is_invalid_value(value))
 			continue;
 		register_bin_value(value_bins, value,
@@ -806,6 +813,8 @@ public:
 	const Bin &derived_bin(const StatsBin &bin) const {
 		return dynamic_cast<const Bin &>(bin);
 	}
+private:
+	mutable StatsDiveCache<std::vector<Type>> cache; // Values of the dives, see to_bin_values()
 };
 
 template<typename Binner, typename Bin>
@@ -816,7 +825,7 @@ std::vector<StatsBinDives> MultiBinner<Binner, Bin>::bin_dives(const std::vector
 	using Pair = std::pair<Type, std::vector<dive *>>;
 	std::vector<Pair> value_bins;
 	for (dive *d: dives) {
-		for (const Type &val: derived().to_bin_values(d)) {
+		for (const Type &val: cache.get(d, [this](const dive *d) { return derived().to_bin_values(d); })) {
 			if (is_invalid_value(val))
 				continue;
 			register_bin_value(value_bins, val,
@@ -13,6 +13,7 @@
 #ifndef STATS_TYPES_H
 #define STATS_TYPES_H
 
+#include "statscache.h"
 #include <vector>
 #include <memory>
 #include <QString>
@@ -141,7 +142,9 @@ struct StatsVariable {
 	std::vector<StatsScatterItem> scatter(const StatsVariable &t2, const std::vector<dive *> &dives) const;
 private:
 	virtual double toFloat(const struct dive *d) const; // For numeric variables - if dive doesn't have that value, returns NaN
+	double toFloatCached(const struct dive *d) const;
 	StatsOperationResults applyOperations(const std::vector<dive *> &dives) const;
+	mutable StatsDiveCache<double> valueCache; // Numeric values of the dives, see toFloatCached()
 };
 
 extern const std::vector<const StatsVariable *> stats_variables;
@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testcompressedsamples.h"
+#include "core/compressedsamples.h"
+#include "core/dive.h"
+#include "core/divecomputer.h"
+#include "core/divelist.h"
+#include "core/divelog.h"
+#include "core/file.h"
+#include "core/pref.h"
+#include "core/sample.h"
+
+void TestCompressedSamples::initTestCase()
+{
+	/* we need to manually tell that the resource exists, because we are using it as library. */
+	Q_INIT_RESOURCE(subsurface);
+	copy_prefs(&default_prefs, &prefs);
+}
+
+void TestCompressedSamples::cleanup()
+{
+	clear_dive_file_data();
+}
+
+static void compare_samples(const struct sample &s1, const struct sample &s2)
+{
+	QCOMPARE(s1.time.seconds, s2.time.seconds);
+	QCOMPARE(s1.stoptime.seconds, s2.stoptime.seconds);
+	QCOMPARE(s1.ndl.seconds, s2.ndl.seconds);
+	QCOMPARE(s1.tts.seconds, s2.tts.seconds);
+	QCOMPARE(s1.rbt.seconds, s2.rbt.seconds);
+	QCOMPARE(s1.depth.mm, s2.depth.mm);
+	QCOMPARE(s1.stopdepth.mm, s2.stopdepth.mm);
+	QCOMPARE(s1.temperature.mkelvin, s2.temperature.mkelvin);
+	for (int i = 0; i < MAX_SENSORS; ++i) {
+		QCOMPARE(s1.pressure[i].mbar, s2.pressure[i].mbar);
+		QCOMPARE(s1.sensor[i], s2.sensor[i]);
+	}
+	QCOMPARE(s1.setpoint.mbar, s2.setpoint.mbar);
+	for (int i = 0; i < MAX_O2_SENSORS; ++i)
+		QCOMPARE(s1.o2sensor[i].mbar, s2.o2sensor[i].mbar);
+	QCOMPARE(s1.bearing.degrees, s2.bearing.degrees);
+	QCOMPARE(s1.cns, s2.cns);
+	QCOMPARE(s1.heartbeat, s2.heartbeat);
+	QCOMPARE(s1.sac.mliter, s2.sac.mliter);
+	QCOMPARE(s1.in_deco, s2.in_deco);
+	QCOMPARE(s1.manually_entered, s2.manually_entered);
+}
+
+void TestCompressedSamples::testRoundTrip()
+{
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &divelog), 0);
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/abitofeverything.ssrf", &divelog), 0);
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/testsensormove.xml", &divelog), 0);
+	process_loaded_dives();
+
+	size_t raw_size = 0, compressed_size = 0;
+	int i;
+	struct dive *d;
+	for_each_dive(i, d) {
+		for (const struct divecomputer *dc = &d->dc; dc; dc = dc->next) {
+			std::vector<unsigned char> data = compress_samples(dc->sample, dc->samples);
+
+			struct divecomputer copy = {};
+			QVERIFY(decompress_samples(data.data(), data.size(), &copy));
+			QCOMPARE(copy.samples, dc->samples);
+			for (int j = 0; j < dc->samples; ++j)
+				compare_samples(copy.sample[j], dc->sample[j]);
+			free_samples(&copy);
+
+			compressed_sample_reader reader(data.data(), data.size());
+			QCOMPARE(reader.size(), dc->samples);
+			struct sample s;
+			for (int j = 0; j < dc->samples; ++j) {
+				QVERIFY(reader.next(s));
+				compare_samples(s, dc->sample[j]);
+			}
+			QVERIFY(!reader.next(s));
+			QVERIFY(reader.good());
+
+			raw_size += dc->samples * sizeof(struct sample);
+			compressed_size += data.size();
+		}
+	}
+	QVERIFY(compressed_size < raw_size / 4);
+}
+
+void TestCompressedSamples::testEmpty()
+{
+	std::vector<unsigned char> data = compress_samples(nullptr, 0);
+	struct divecomputer dc = {};
+	QVERIFY(decompress_samples(data.data(), data.size(), &dc));
+	QCOMPARE(dc.samples, 0);
+}
+
+void TestCompressedSamples::testMalformed()
+{
+	struct sample samples[100];
+	for (int i = 0; i < 100; ++i) {
+		samples[i].time.seconds = i * 10;
+		samples[i].depth.mm = i * (100 - i) * 10;
+		samples[i].temperature.mkelvin = 290000 - i * 7;
+	}
+	std::vector<unsigned char> data = compress_samples(samples, 100);
+	struct divecomputer dc = {};
+	for (size_t size = 0; size < data.size(); ++size)
+		QVERIFY(!decompress_samples(data.data(), size, &dc));
+	QCOMPARE(dc.samples, 0);
+	QVERIFY(decompress_samples(data.data(), data.size(), &dc));
+	QCOMPARE(dc.samples, 100);
+	free_samples(&dc);
+}
+
+static QByteArray read_file(const char *filename)
+{
+	QFile f(filename);
+	if (!f.open(QFile::ReadOnly))
+		return QByteArray();
+	return f.readAll();
+}
+
+void TestCompressedSamples::testPackedSamples()
+{
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &divelog), 0);
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/abitofeverything.ssrf", &divelog), 0);
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/testsensormove.xml", &divelog), 0);
+	process_loaded_dives();
+	QCOMPARE(save_dives("./testunpackedsamples.ssrf"), 0);
+
+	// Unpacked copies to compare with
+	std::vector<struct dive *> copies;
+	size_t array_size = 0, packed_size = 0;
+	int i;
+	struct dive *d;
+	for_each_dive(i, d) {
+		struct dive *copy = alloc_dive();
+		copy_dive(d, copy);
+		copies.push_back(copy);
+		for (struct divecomputer *dc = &d->dc; dc; dc = dc->next) {
+			int nr = dc->samples;
+			array_size += dc->alloc_samples * sizeof(struct sample);
+			pack_samples(dc);
+			QCOMPARE(dc->samples, nr);
+			QVERIFY(!nr || (dc->packed_samples && !dc->sample));
+			packed_size += dc->packed_size;
+		}
+	}
+	QVERIFY(packed_size < array_size / 4);
+
+	// The savers read packed samples
+	QCOMPARE(save_dives("./testpackedsamples.ssrf"), 0);
+	QCOMPARE(read_file("./testpackedsamples.ssrf"), read_file("./testunpackedsamples.ssrf"));
+
+	for_each_dive(i, d) {
+		// Copies of packed dive computers stay packed
+		struct dive *copy = alloc_dive();
+		copy_dive(d, copy);
+		for (struct divecomputer *dc = &copy->dc; dc; dc = dc->next)
+			QVERIFY(!dc->samples || dc->packed_samples);
+		free_dive(copy);
+
+		const struct divecomputer *orig = &copies[i]->dc;
+		for (struct divecomputer *dc = &d->dc; dc; dc = dc->next, orig = orig->next) {
+			QVERIFY(unpack_samples(dc));
+			QVERIFY(!dc->packed_samples);
+			QCOMPARE(dc->samples, orig->samples);
+			for (int j = 0; j < dc->samples; ++j)
+				compare_samples(dc->sample[j], orig->sample[j]);
+		}
+		free_dive(copies[i]);
+	}
+}
+
+QTEST_GUILESS_MAIN(TestCompressedSamples)
@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTCOMPRESSEDSAMPLES_H
+#define TESTCOMPRESSEDSAMPLES_H
+
+#include <QtTest>
+
+class TestCompressedSamples : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanup();
+
+	void testRoundTrip();
+	void testEmpty();
+	void testMalformed();
+	void testPackedSamples();
+};
+
+#endif
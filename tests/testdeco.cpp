@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testdeco.h"
+#include "core/deco.h"
+#include "core/decocache.h"
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/divelog.h"
+#include "core/file.h"
+#include "core/gas.h"
+#include "core/pref.h"
+#include "core/subsurfacestartup.h"
+#include <math.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+// Compare the compartment kernel in add_segment() to the straightforward
+// per-compartment implementation it replaced.
+
+static const double ref_N2_t_halflife[] = { 5.0, 8.0, 12.5, 18.5,
+					    27.0, 38.3, 54.3, 77.0,
+					    109.0, 146.0, 187.0, 239.0,
+					    305.0, 390.0, 498.0, 635.0 };
+
+static const double ref_He_t_halflife[] = { 1.88, 3.02, 4.72, 6.99,
+					    10.21, 14.48, 20.53, 29.11,
+					    41.20, 55.19, 70.69, 90.34,
+					    115.29, 147.42, 188.24, 240.03 };
+
+#define WV_PRESSURE 0.0627
+
+static void reference_add_segment(struct deco_state *ds, double pressure, struct gasmix gasmix, int period_in_seconds)
+{
+	struct gas_pressures pressures;
+	fill_pressures(&pressures, pressure - WV_PRESSURE, gasmix, 0.0, OC);
+
+	for (int ci = 0; ci < 16; ci++) {
+		double pn2_oversat = pressures.n2 - ds->tissue_n2_sat[ci];
+		double phe_oversat = pressures.he - ds->tissue_he_sat[ci];
+		double n2_f = 1.0 - exp(-period_in_seconds * 1.155245301e-02 / ref_N2_t_halflife[ci]);
+		double he_f = 1.0 - exp(-period_in_seconds * 1.155245301e-02 / ref_He_t_halflife[ci]);
+
+		ds->tissue_n2_sat[ci] += pn2_oversat * n2_f;
+		ds->tissue_he_sat[ci] += phe_oversat * he_f;
+		ds->tissue_inertgas_saturation[ci] = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci];
+	}
+}
+
+// A simple square profile with a slow ascent, similar to what calculate_deco_information()
+// feeds into the deco code in 20 second steps.
+template <typename F>
+static void run_profile(struct deco_state *ds, F add)
+{
+	struct gasmix tx21_35 = {{210}, {350}};
+	struct gasmix ean50 = {{500}, {0}};
+
+	for (int i = 0; i < 90; i++)
+		add(ds, 1.013 + 0.05 * i, tx21_35, 20);
+	for (int i = 0; i < 60; i++)
+		add(ds, 5.5, tx21_35, 20);
+	for (int i = 0; i < 90; i++)
+		add(ds, 5.5 - 0.05 * i, i < 60 ? tx21_35 : ean50, 20);
+	for (int i = 0; i < 60; i++)
+		add(ds, 1.013, gasmix_air, 7);
+}
+
+static void kernel_add_segment(struct deco_state *ds, double pressure, struct gasmix gasmix, int period_in_seconds)
+{
+	add_segment(ds, pressure, gasmix, period_in_seconds, 0, OC, 0);
+}
+
+static struct deco_config config;
+
+void TestDeco::initTestCase()
+{
+	copy_prefs(&default_prefs, &prefs);
+	prefs.display_deco_mode = BUEHLMANN;
+	init_deco_config(&config, false);
+	set_gf(&config, 30, 75);
+}
+
+void TestDeco::testAddSegmentMatchesReference()
+{
+	struct deco_state ref, kernel;
+
+	clear_deco(&ref, &config, 1.013);
+	clear_deco(&kernel, &config, 1.013);
+	run_profile(&ref, reference_add_segment);
+	run_profile(&kernel, kernel_add_segment);
+
+	for (int ci = 0; ci < 16; ci++) {
+		QCOMPARE(kernel.tissue_n2_sat[ci], ref.tissue_n2_sat[ci]);
+		QCOMPARE(kernel.tissue_he_sat[ci], ref.tissue_he_sat[ci]);
+		QCOMPARE(kernel.tissue_inertgas_saturation[ci], ref.tissue_inertgas_saturation[ci]);
+	}
+}
+
+void TestDeco::benchmarkAddSegmentReference()
+{
+	struct deco_state ds;
+	clear_deco(&ds, &config, 1.013);
+	QBENCHMARK {
+		run_profile(&ds, reference_add_segment);
+	}
+}
+
+void TestDeco::benchmarkAddSegment()
+{
+	struct deco_state ds;
+	clear_deco(&ds, &config, 1.013);
+	QBENCHMARK {
+		run_profile(&ds, kernel_add_segment);
+	}
+}
+
+// Starting from cached end-of-dive states must give the same tissues as replaying
+// all previous dives.
+void TestDeco::testRepetitiveDiveCache()
+{
+	std::vector<deco_state> replayed;
+	struct deco_state ds;
+	int i;
+	struct dive *d;
+
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/abitofeverything.ssrf", &divelog), 0);
+	sort_dive_table(divelog.dives);
+
+	for_each_dive (i, d) {
+		deco_cache_clear();
+		init_decompression(&ds, d, &config);
+		replayed.push_back(ds);
+	}
+
+	// Fill the cache in reverse order and then check once more with a warm cache
+	deco_cache_clear();
+	for (int pass = 0; pass < 2; pass++) {
+		for (i = divelog.dives->nr - 1; i >= 0; i--) {
+			init_decompression(&ds, get_dive(i), &config);
+			QCOMPARE(memcmp(ds.tissue_n2_sat, replayed[i].tissue_n2_sat, sizeof(ds.tissue_n2_sat)), 0);
+			QCOMPARE(memcmp(ds.tissue_he_sat, replayed[i].tissue_he_sat, sizeof(ds.tissue_he_sat)), 0);
+		}
+	}
+	clear_dive_file_data();
+}
+
+static double ceiling_after_profile(const struct deco_config *c, const struct dive *d)
+{
+	struct deco_state ds;
+	clear_deco(&ds, c, 1.013);
+	run_profile(&ds, kernel_add_segment);
+	return tissue_tolerance_calc(&ds, d, 1.013);
+}
+
+// The model settings are part of the deco_state. Calculations with different
+// settings must not influence each other, even when run concurrently.
+void TestDeco::testConcurrentSettings()
+{
+	struct deco_config conservative = config, liberal = config;
+	struct dive *d = alloc_dive();
+	set_gf(&conservative, 30, 70);
+	set_gf(&liberal, 90, 90);
+
+	double conservative_ceiling = ceiling_after_profile(&conservative, d);
+	double liberal_ceiling = ceiling_after_profile(&liberal, d);
+	QVERIFY(conservative_ceiling != liberal_ceiling);
+
+	std::vector<double> results(8);
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < results.size(); i++) {
+		threads.emplace_back([&, i] {
+			results[i] = ceiling_after_profile(i % 2 ? &liberal : &conservative, d);
+		});
+	}
+	for (std::thread &t: threads)
+		t.join();
+	for (size_t i = 0; i < results.size(); i++)
+		QCOMPARE(results[i], i % 2 ? liberal_ceiling : conservative_ceiling);
+	free_dive(d);
+}
+
+QTEST_GUILESS_MAIN(TestDeco)
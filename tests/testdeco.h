@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTDECO_H
+#define TESTDECO_H
+
+#include <QtTest>
+
+class TestDeco : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void testAddSegmentMatchesReference();
+	void benchmarkAddSegmentReference();
+	void benchmarkAddSegment();
+	void testRepetitiveDiveCache();
+	void testConcurrentSettings();
+};
+
+#endif // TESTDECO_H
@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testdiveindex.h"
+#include "core/dive.h"
+#include "core/diveindex.h"
+#include "core/divelist.h"
+#include "core/divelog.h"
+#include "core/file.h"
+#include "core/pref.h"
+
+#include <algorithm>
+
+static bool is_candidate(const struct divecomputer *dc, const struct dive *d)
+{
+	std::vector<dive *> candidates = diveindex_candidates(dc);
+	return std::find(candidates.begin(), candidates.end(), d) != candidates.end();
+}
+
+void TestDiveIndex::init()
+{
+	/* we need to manually tell that the resource exists, because we are using it as library. */
+	Q_INIT_RESOURCE(subsurface);
+	copy_prefs(&default_prefs, &prefs);
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/mergedVyperOstc.xml", &divelog), 0);
+	process_loaded_dives();
+	QCOMPARE(divelog.dives->nr, 4);
+}
+
+void TestDiveIndex::cleanup()
+{
+	clear_dive_file_data();
+}
+
+void TestDiveIndex::testLoad()
+{
+	int i;
+	struct dive *d;
+	for_each_dive (i, d) {
+		struct divecomputer *dc;
+		for_each_dc (d, dc) {
+			QVERIFY(has_dive(dc->deviceid, dc->diveid));
+			QVERIFY(is_candidate(dc, d));
+		}
+	}
+	QVERIFY(!has_dive(0x8e8f3f68, 0x12345678));
+
+	// A dive computer with a different dive ID but the same start time
+	struct divecomputer dc = {};
+	dc.when = get_dive(0)->dc.when;
+	dc.deviceid = 0x12345678;
+	QVERIFY(is_candidate(&dc, get_dive(0)));
+	dc.when++;
+	QVERIFY(diveindex_candidates(&dc).empty());
+}
+
+void TestDiveIndex::testReregister()
+{
+	struct dive *d = get_dive(0);
+	uint32_t deviceid = d->dc.deviceid, diveid = d->dc.diveid;
+	d->dc.diveid = 0x12345678;
+	diveindex_register(d);
+	QVERIFY(!has_dive(deviceid, diveid));
+	QVERIFY(has_dive(deviceid, 0x12345678));
+	QCOMPARE((int)diveindex_candidates(&d->dc).size(), 1);
+}
+
+void TestDiveIndex::testDelete()
+{
+	struct divecomputer dc = get_dive(0)->dc;
+	delete_single_dive(&divelog, 0);
+	QVERIFY(!has_dive(dc.deviceid, dc.diveid));
+	QVERIFY(diveindex_candidates(&dc).empty());
+	QVERIFY(has_dive(get_dive(0)->dc.deviceid, get_dive(0)->dc.diveid));
+
+	clear_dive_file_data();
+	QVERIFY(!has_dive(0x8e8f3f68, 0x7ab00781));
+}
+
+QTEST_GUILESS_MAIN(TestDiveIndex)
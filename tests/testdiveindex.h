@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTDIVEINDEX_H
+#define TESTDIVEINDEX_H
+
+#include <QtTest>
+
+class TestDiveIndex : public QObject {
+	Q_OBJECT
+private slots:
+	void init();
+	void cleanup();
+
+	void testLoad();
+	void testReregister();
+	void testDelete();
+};
+
+#endif
@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testdivesiteindex.h"
+#include "core/dive.h"
+#include "core/divesite.h"
+#include "core/divesiteindex.h"
+
+#include <random>
+
+static struct dive_site_table sites = empty_dive_site_table;
+
+static location_t location(double lat, double lon)
+{
+	return create_location(lat, lon);
+}
+
+// What get_dive_site_by_gps_proximity() used to do
+static struct dive_site *nearest_by_scan(const location_t *loc, unsigned int distance)
+{
+	int i;
+	struct dive_site *ds, *res = NULL;
+	unsigned int cur_distance, min_distance = distance;
+	for_each_dive_site (i, ds, &sites) {
+		if (dive_site_has_gps_location(ds) &&
+		    (cur_distance = get_distance(&ds->location, loc)) < min_distance) {
+			min_distance = cur_distance;
+			res = ds;
+		}
+	}
+	return res;
+}
+
+static int nr_within_by_scan(const location_t *loc, unsigned int distance)
+{
+	int i, res = 0;
+	struct dive_site *ds;
+	for_each_dive_site (i, ds, &sites) {
+		if (dive_site_has_gps_location(ds) && get_distance(&ds->location, loc) <= distance)
+			++res;
+	}
+	return res;
+}
+
+void TestDiveSiteIndex::cleanup()
+{
+	clear_dive_site_table(&sites);
+}
+
+void TestDiveSiteIndex::testExact()
+{
+	location_t loc = location(47.123456, 8.654321);
+	struct dive_site *ds1 = create_dive_site_with_gps("Site A", &loc, &sites);
+	struct dive_site *ds2 = create_dive_site_with_gps("Site B", &loc, &sites);
+	create_dive_site("No location", &sites);
+
+	struct dive_site *first = ds1->uuid < ds2->uuid ? ds1 : ds2;
+	QCOMPARE(get_dive_site_by_gps(&loc, &sites), first);
+	QCOMPARE(get_dive_site_by_gps_and_name("Site A", &loc, &sites), ds1);
+	QCOMPARE(get_dive_site_by_gps_and_name("Site B", &loc, &sites), ds2);
+	QVERIFY(!get_dive_site_by_gps_and_name("Site C", &loc, &sites));
+
+	location_t other = location(47.123457, 8.654321);
+	QVERIFY(!get_dive_site_by_gps(&other, &sites));
+	QCOMPARE(get_dive_site_by_gps_proximity(&other, 20, &sites), first);
+
+	delete_dive_site(first, &sites);
+	QCOMPARE(get_dive_site_by_gps(&loc, &sites), first == ds1 ? ds2 : ds1);
+}
+
+void TestDiveSiteIndex::testProximity()
+{
+	// Sites in a few clusters, so that there are both dense and empty regions
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<double> cluster_lat(-70.0, 70.0), cluster_lon(-180.0, 180.0);
+	std::normal_distribution<double> offset(0.0, 0.02);
+	for (int cluster = 0; cluster < 20; ++cluster) {
+		double lat = cluster_lat(gen), lon = cluster_lon(gen);
+		for (int i = 0; i < 100; ++i) {
+			location_t loc = location(lat + offset(gen), lon + offset(gen));
+			create_dive_site_with_gps(qPrintable(QString("Site %1/%2").arg(cluster).arg(i)), &loc, &sites);
+		}
+	}
+
+	const unsigned int distances[] = { 0, 20, 500, 5000, 100000, 40075000 };
+	for (int i = 0; i < 200; ++i) {
+		// Every other query is close to an existing site
+		location_t loc;
+		if (i % 2) {
+			const location_t &site_loc = sites.dive_sites[gen() % sites.nr]->location;
+			loc = location(site_loc.lat.udeg / 1000000.0 + offset(gen) / 10.0, site_loc.lon.udeg / 1000000.0 + offset(gen) / 10.0);
+		} else {
+			loc = location(cluster_lat(gen), cluster_lon(gen));
+		}
+		for (unsigned int distance: distances) {
+			QCOMPARE(get_dive_site_by_gps_proximity(&loc, distance, &sites), nearest_by_scan(&loc, distance));
+			std::vector<dive_site *> within = divesiteindex_within(&loc, distance, &sites);
+			QCOMPARE((int)within.size(), nr_within_by_scan(&loc, distance));
+			for (size_t j = 1; j < within.size(); ++j)
+				QVERIFY(get_distance(&within[j - 1]->location, &loc) <= get_distance(&within[j]->location, &loc));
+		}
+	}
+}
+
+void TestDiveSiteIndex::testDateline()
+{
+	location_t west = location(-17.0, 179.9999);
+	location_t east = location(-17.0, -179.9999);
+	location_t north = location(89.9999, 10.0);
+	location_t north2 = location(89.9999, -170.0);
+	struct dive_site *ds_west = create_dive_site_with_gps("West", &west, &sites);
+	struct dive_site *ds_north = create_dive_site_with_gps("North", &north, &sites);
+	QCOMPARE(get_dive_site_by_gps_proximity(&east, 50, &sites), ds_west);
+	QCOMPARE(get_dive_site_by_gps_proximity(&north2, 50, &sites), ds_north);
+	QCOMPARE((int)divesiteindex_within(&east, 50, &sites).size(), 1);
+}
+
+void TestDiveSiteIndex::testUpdate()
+{
+	location_t loc1 = location(10.0, 20.0);
+	location_t loc2 = location(-30.0, 40.0);
+	struct dive_site *ds = create_dive_site_with_gps("Moving site", &loc1, &sites);
+	QCOMPARE(get_dive_site_by_gps(&loc1, &sites), ds);
+
+	ds->location = loc2;
+	divesiteindex_update(ds);
+	QVERIFY(!get_dive_site_by_gps(&loc1, &sites));
+	QVERIFY(!get_dive_site_by_gps_proximity(&loc1, 1000, &sites));
+	QCOMPARE(get_dive_site_by_gps(&loc2, &sites), ds);
+	QCOMPARE(get_dive_site_by_gps_proximity(&loc2, 1000, &sites), ds);
+}
+
+void TestDiveSiteIndex::testMoveTable()
+{
+	struct dive_site_table other = empty_dive_site_table;
+	location_t loc = location(1.0, 2.0);
+	struct dive_site *ds = create_dive_site_with_gps("Site", &loc, &sites);
+	move_dive_site_table(&sites, &other);
+	QVERIFY(!get_dive_site_by_gps(&loc, &sites));
+	QCOMPARE(get_dive_site_by_gps(&loc, &other), ds);
+
+	// Sites that are taken out of the table are not found anymore
+	other.nr = 0;
+	QVERIFY(!get_dive_site_by_gps(&loc, &other));
+	free_dive_site(ds);
+	free(other.dive_sites);
+}
+
+QTEST_GUILESS_MAIN(TestDiveSiteIndex)
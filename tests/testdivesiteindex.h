@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTDIVESITEINDEX_H
+#define TESTDIVESITEINDEX_H
+
+#include <QtTest>
+
+class TestDiveSiteIndex : public QObject {
+	Q_OBJECT
+private slots:
+	void cleanup();
+
+	void testExact();
+	void testProximity();
+	void testDateline();
+	void testUpdate();
+	void testMoveTable();
+};
+
+#endif
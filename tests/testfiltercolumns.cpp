@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testfiltercolumns.h"
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/divelog.h"
+#include "core/file.h"
+#include "core/filtercolumns.h"
+#include "core/pref.h"
+
+// The column store must give the same results as testing every dive
+static void compare(FilterColumns &columns, const filter_constraint &c)
+{
+	static const filter_constraint_range_mode modes[] = {
+		FILTER_CONSTRAINT_EQUAL, FILTER_CONSTRAINT_LESS, FILTER_CONSTRAINT_GREATER, FILTER_CONSTRAINT_RANGE
+	};
+	columns.refresh();
+	for (filter_constraint_range_mode mode: modes) {
+		for (bool negate: { false, true }) {
+			filter_constraint c2 = c;
+			c2.range_mode = mode;
+			c2.negate = negate;
+			std::vector<char> matches = columns.match({ c2 });
+			QCOMPARE((int)matches.size(), divelog.dives->nr);
+			int i;
+			dive *d;
+			for_each_dive(i, d)
+				QCOMPARE((bool)matches[i], filter_constraint_match_dive(c2, d));
+		}
+	}
+}
+
+static void compare_range(FilterColumns &columns, filter_constraint_type type, int from, int to)
+{
+	filter_constraint c(type);
+	c.data.numerical_range.from = from;
+	c.data.numerical_range.to = to;
+	compare(columns, c);
+}
+
+void TestFilterColumns::initTestCase()
+{
+	/* we need to manually tell that the resource exists, because we are using it as library. */
+	Q_INIT_RESOURCE(subsurface);
+	copy_prefs(&default_prefs, &prefs);
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &divelog), 0);
+	process_loaded_dives();
+	QVERIFY(divelog.dives->nr > 0);
+}
+
+void TestFilterColumns::cleanupTestCase()
+{
+	clear_dive_file_data();
+}
+
+void TestFilterColumns::testRanges()
+{
+	FilterColumns columns;
+	compare_range(columns, FILTER_CONSTRAINT_RATING, 2, 4);
+	compare_range(columns, FILTER_CONSTRAINT_DEPTH, 10000, 30000);
+	compare_range(columns, FILTER_CONSTRAINT_DURATION, 1800, 3600);
+	compare_range(columns, FILTER_CONSTRAINT_WATER_TEMP, 290000, 300000);
+	compare_range(columns, FILTER_CONSTRAINT_SAC, 10000, 20000);
+	compare_range(columns, FILTER_CONSTRAINT_YEAR, 2010, 2012);
+	compare_range(columns, FILTER_CONSTRAINT_CYLINDER_SIZE, 10000, 12000);
+	compare_range(columns, FILTER_CONSTRAINT_CYLINDER_O2, 210, 320);
+}
+
+void TestFilterColumns::testTimes()
+{
+	FilterColumns columns;
+	// Time of day constraints with from > to wrap around midnight
+	compare_range(columns, FILTER_CONSTRAINT_TIME_OF_DAY, 9 * 3600, 14 * 3600);
+	compare_range(columns, FILTER_CONSTRAINT_TIME_OF_DAY, 14 * 3600, 9 * 3600);
+
+	int i;
+	dive *d;
+	for_each_dive(i, d) {
+		filter_constraint date(FILTER_CONSTRAINT_DATE);
+		date.data.timestamp_range.from = d->when;
+		date.data.timestamp_range.to = d->when + 30 * 24 * 3600;
+		compare(columns, date);
+
+		filter_constraint date_time(FILTER_CONSTRAINT_DATE_TIME);
+		date_time.data.timestamp_range.from = d->when + 60;
+		date_time.data.timestamp_range.to = d->when + 7 * 24 * 3600;
+		compare(columns, date_time);
+	}
+}
+
+void TestFilterColumns::testMultipleChoice()
+{
+	FilterColumns columns;
+	filter_constraint c(FILTER_CONSTRAINT_DAY_OF_WEEK);
+	c.data.multiple_choice = (1 << 0) | (1 << 6);
+	compare(columns, c);
+	compare(columns, filter_constraint(FILTER_CONSTRAINT_LOGGED));
+	compare(columns, filter_constraint(FILTER_CONSTRAINT_PLANNED));
+}
+
+void TestFilterColumns::testStrings()
+{
+	static const filter_constraint_string_mode modes[] = {
+		FILTER_CONSTRAINT_STARTS_WITH, FILTER_CONSTRAINT_SUBSTRING, FILTER_CONSTRAINT_EXACT
+	};
+	FilterColumns columns;
+	for (filter_constraint_string_mode mode: modes) {
+		filter_constraint tags(FILTER_CONSTRAINT_TAGS);
+		tags.string_mode = mode;
+		filter_constraint_set_stringlist(tags, "boat, shore");
+		compare(columns, tags);
+
+		filter_constraint people(FILTER_CONSTRAINT_PEOPLE);
+		people.string_mode = mode;
+		filter_constraint_set_stringlist(people, "dirk, lin");
+		compare(columns, people);
+
+		filter_constraint location(FILTER_CONSTRAINT_LOCATION);
+		location.string_mode = mode;
+		filter_constraint_set_stringlist(location, "Blue");
+		compare(columns, location);
+	}
+
+	// An empty list matches everything
+	compare(columns, filter_constraint(FILTER_CONSTRAINT_NOTES));
+}
+
+void TestFilterColumns::testInvalidate()
+{
+	FilterColumns columns;
+	filter_constraint c(FILTER_CONSTRAINT_RATING);
+	c.range_mode = FILTER_CONSTRAINT_EQUAL;
+	c.data.numerical_range.from = 5;
+
+	dive *d = get_dive(0);
+	int old_rating = d->rating;
+	d->rating = 0;
+	columns.refresh();
+	QVERIFY(!columns.match({ c })[0]);
+
+	// Changes are not seen until the dive is invalidated
+	d->rating = 5;
+	columns.refresh();
+	QVERIFY(!columns.match({ c })[0]);
+	columns.invalidate(d);
+	columns.refresh();
+	QVERIFY(columns.match({ c })[0]);
+
+	d->rating = old_rating;
+}
+
+QTEST_GUILESS_MAIN(TestFilterColumns)
@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTFILTERCOLUMNS_H
+#define TESTFILTERCOLUMNS_H
+
+#include <QtTest>
+
+class TestFilterColumns : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void testRanges();
+	void testTimes();
+	void testMultipleChoice();
+	void testStrings();
+	void testInvalidate();
+};
+
+#endif
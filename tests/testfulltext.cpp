@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testfulltext.h"
+#include "core/dive.h"
+#include "core/fulltext.h"
+
+#include <string.h>
+
+static dive *create_dive(const char *notes, const char *buddy)
+{
+	dive *d = alloc_dive();
+	d->notes = strdup(notes);
+	d->buddy = strdup(buddy);
+	fulltext_register(d);
+	return d;
+}
+
+static int count(const QString &query, StringFilterMode mode)
+{
+	FullTextQuery q;
+	q = query;
+	return (int)fulltext_find_dives(q, mode).dives.size();
+}
+
+static bool matches(const dive *d, const QString &query, StringFilterMode mode)
+{
+	FullTextQuery q;
+	q = query;
+	return fulltext_find_dives(q, mode).dive_matches(d);
+}
+
+void TestFullText::init()
+{
+	d1 = create_dive("Wreck dive on the Thistlegorm", "Alice");
+	d2 = create_dive("Reef dive, many turtles", "Bob");
+	d3 = create_dive("Night dive at the wreckage", "Alice Bob");
+}
+
+void TestFullText::cleanup()
+{
+	for (dive *d: { d1, d2, d3 }) {
+		fulltext_unregister(d);
+		free_dive(d);
+	}
+}
+
+void TestFullText::testExact()
+{
+	QCOMPARE(count("dive", StringFilterMode::EXACT), 3);
+	QCOMPARE(count("wreck", StringFilterMode::EXACT), 1);
+	QVERIFY(matches(d1, "wreck", StringFilterMode::EXACT));
+	QVERIFY(!matches(d3, "wreck", StringFilterMode::EXACT));
+	QCOMPARE(count("wre", StringFilterMode::EXACT), 0);
+}
+
+void TestFullText::testStartsWith()
+{
+	QCOMPARE(count("wre", StringFilterMode::STARTSWITH), 2);
+	QVERIFY(matches(d1, "wre", StringFilterMode::STARTSWITH));
+	QVERIFY(matches(d3, "wre", StringFilterMode::STARTSWITH));
+	QVERIFY(!matches(d2, "wre", StringFilterMode::STARTSWITH));
+	QCOMPARE(count("reck", StringFilterMode::STARTSWITH), 0);
+}
+
+void TestFullText::testSubstring()
+{
+	QCOMPARE(count("reck", StringFilterMode::SUBSTRING), 2);
+	QCOMPARE(count("urt", StringFilterMode::SUBSTRING), 1);
+	QVERIFY(matches(d2, "urt", StringFilterMode::SUBSTRING));
+	// Short substrings don't use the trigram index
+	QCOMPARE(count("o", StringFilterMode::SUBSTRING), 3);
+	// Trigram that doesn't appear in any word
+	QCOMPARE(count("ageck", StringFilterMode::SUBSTRING), 0);
+}
+
+void TestFullText::testMultipleWords()
+{
+	QCOMPARE(count("alice bob", StringFilterMode::EXACT), 1);
+	QVERIFY(matches(d3, "alice bob", StringFilterMode::EXACT));
+	QCOMPARE(count("dive al", StringFilterMode::STARTSWITH), 2);
+	QCOMPARE(count("wreck turtles", StringFilterMode::SUBSTRING), 0);
+}
+
+void TestFullText::testReregister()
+{
+	free(d2->notes);
+	d2->notes = strdup("Drift dive along the wreck");
+	fulltext_register(d2);
+	QCOMPARE(count("turtles", StringFilterMode::EXACT), 0);
+	QCOMPARE(count("wreck", StringFilterMode::EXACT), 2);
+	QVERIFY(matches(d2, "wreck", StringFilterMode::EXACT));
+	fulltext_unregister(d1);
+	QCOMPARE(count("wreck", StringFilterMode::EXACT), 1);
+	fulltext_register(d1);
+	QCOMPARE(count("wreck", StringFilterMode::EXACT), 2);
+}
+
+QTEST_GUILESS_MAIN(TestFullText)
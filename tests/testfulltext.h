@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTFULLTEXT_H
+#define TESTFULLTEXT_H
+
+#include <QtTest>
+
+struct dive;
+
+class TestFullText : public QObject {
+	Q_OBJECT
+private slots:
+	void init();
+	void cleanup();
+
+	void testExact();
+	void testStartsWith();
+	void testSubstring();
+	void testMultipleWords();
+	void testReregister();
+private:
+	dive *d1, *d2, *d3;
+};
+
+#endif
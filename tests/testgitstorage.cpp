@@ -213,6 +213,71 @@ void TestGitStorage::testGitStorageLocal()
 	QCOMPARE(readin, written);
 }
 
+void TestGitStorage::testGitStorageSnapshot()
+{
+	// the first load from git writes a snapshot, the second one reads it
+	git_repository *repo;
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &divelog), 0);
+	QDir testDir("./gittestsnapshot");
+	QCOMPARE(testDir.removeRecursively(), true);
+	QCOMPARE(QDir().mkdir("./gittestsnapshot"), true);
+	QCOMPARE(git_repository_init(&repo, "./gittestsnapshot", false), 0);
+	QCOMPARE(save_dives("./gittestsnapshot[test]"), 0);
+	clear_dive_file_data();
+	QCOMPARE(parse_file("./gittestsnapshot[test]", &divelog), 0);
+	QCOMPARE(save_dives("./SampleDivesV3viagit.ssrf"), 0);
+	QCOMPARE(QFile::exists("./gittestsnapshot/.git/subsurface-snapshot"), true);
+	clear_dive_file_data();
+	QCOMPARE(parse_file("./gittestsnapshot[test]", &divelog), 0);
+	QCOMPARE(save_dives("./SampleDivesV3viasnapshot.ssrf"), 0);
+	QFile org("./SampleDivesV3viagit.ssrf");
+	org.open(QFile::ReadOnly);
+	QFile out("./SampleDivesV3viasnapshot.ssrf");
+	out.open(QFile::ReadOnly);
+	QTextStream orgS(&org);
+	QTextStream outS(&out);
+	QString readin = orgS.readAll();
+	QString written = outS.readAll();
+	QCOMPARE(readin, written);
+}
+
+void TestGitStorage::testGitStorageCachedDcs()
+{
+	// after a metadata edit only the dive file is rewritten,
+	// the cached dive computer files must be saved unchanged
+	git_repository *repo;
+	int i;
+	struct dive *d;
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &divelog), 0);
+	QDir testDir("./gittestcacheddcs");
+	QCOMPARE(testDir.removeRecursively(), true);
+	QCOMPARE(QDir().mkdir("./gittestcacheddcs"), true);
+	QCOMPARE(git_repository_init(&repo, "./gittestcacheddcs", false), 0);
+	QCOMPARE(save_dives("./gittestcacheddcs[test]"), 0);
+	clear_dive_file_data();
+	QCOMPARE(parse_file("./gittestcacheddcs[test]", &divelog), 0);
+	for_each_dive (i, d) {
+		QVERIFY(dc_cache_is_valid(&d->dc));
+		free(d->notes);
+		d->notes = strdup("changed notes");
+		invalidate_dive_cache_except_dcs(d);
+	}
+	QCOMPARE(save_dives("./SampleDivesV3cacheddcs.ssrf"), 0);
+	QCOMPARE(save_dives("./gittestcacheddcs[test]"), 0);
+	clear_dive_file_data();
+	QCOMPARE(parse_file("./gittestcacheddcs[test]", &divelog), 0);
+	QCOMPARE(save_dives("./SampleDivesV3cacheddcsviagit.ssrf"), 0);
+	QFile org("./SampleDivesV3cacheddcs.ssrf");
+	org.open(QFile::ReadOnly);
+	QFile out("./SampleDivesV3cacheddcsviagit.ssrf");
+	out.open(QFile::ReadOnly);
+	QTextStream orgS(&org);
+	QTextStream outS(&out);
+	QString readin = orgS.readAll();
+	QString written = outS.readAll();
+	QCOMPARE(readin, written);
+}
+
 void TestGitStorage::testGitStorageCloud()
 {
 	// test writing and reading back from cloud storage
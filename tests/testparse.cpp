@@ -205,6 +205,109 @@ void TestParse::testParseHUDC()
 		     SUBSURFACE_TEST_DATA "/dives/TestDiveSeabearHUDC.xml");
 }
 
+/*
+ * Generic CSV files are read without the XSLT transformation. Parse the file
+ * both ways and check that the same dives are created. The native reader
+ * only understands parameters that are numbers or strings and leaves files
+ * with other parameters to the stylesheet. Therefore, an additional unused
+ * parameter that is an XPath expression selects the stylesheet.
+ */
+static void compareCSVNative(const char *filename, const xml_params &fields, const char *native, const char *xslt)
+{
+	// Use a fixed date, so that both imports give the same start time
+	xml_params params;
+	xml_params_add(&params, "date", "20240101");
+	xml_params_add(&params, "time", "11200");
+	for (int i = 0; i < xml_params_count(&fields); i++)
+		xml_params_add(&params, xml_params_get_key(&fields, i), xml_params_get_value(&fields, i));
+
+	QCOMPARE(parse_csv_file(filename, &params, "csv", &divelog), 0);
+	QVERIFY(divelog.dives->nr > 0);
+	QCOMPARE(save_dives(native), 0);
+	clear_dive_file_data();
+
+	xml_params_add(&params, "useStylesheet", "true()");
+	QCOMPARE(parse_csv_file(filename, &params, "csv", &divelog), 0);
+	QVERIFY(divelog.dives->nr > 0);
+	QCOMPARE(save_dives(xslt), 0);
+	clear_dive_file_data();
+
+	FILE_COMPARE(native, xslt);
+}
+
+void TestParse::testParseCSVNative()
+{
+	xml_params apd;
+	xml_params_add_int(&apd, "timeField", 0);
+	xml_params_add_int(&apd, "depthField", 1);
+	xml_params_add_int(&apd, "tempField", 15);
+	xml_params_add_int(&apd, "po2Field", 6);
+	xml_params_add_int(&apd, "o2sensor1Field", 3);
+	xml_params_add_int(&apd, "o2sensor2Field", 4);
+	xml_params_add_int(&apd, "o2sensor3Field", 5);
+	xml_params_add_int(&apd, "cnsField", 17);
+	xml_params_add_int(&apd, "ndlField", -1);
+	xml_params_add_int(&apd, "ttsField", -1);
+	xml_params_add_int(&apd, "stopdepthField", 18);
+	xml_params_add_int(&apd, "pressureField", -1);
+	xml_params_add_int(&apd, "setpointField", 2);
+	xml_params_add_int(&apd, "separatorIndex", 0);
+	xml_params_add_int(&apd, "units", 0);
+	xml_params_add(&apd, "hw", "\"APD Log Viewer\"");
+	compareCSVNative(SUBSURFACE_TEST_DATA "/dives/TestAPDLogViewer.csv", apd,
+			 "./testapdnative.ssrf", "./testapdxslt.ssrf");
+
+	xml_params hudc;
+	xml_params_add_int(&hudc, "timeField", 0);
+	xml_params_add_int(&hudc, "depthField", 1);
+	xml_params_add_int(&hudc, "tempField", 5);
+	xml_params_add_int(&hudc, "ndlField", 2);
+	xml_params_add_int(&hudc, "ttsField", 3);
+	xml_params_add_int(&hudc, "stopdepthField", 4);
+	xml_params_add_int(&hudc, "pressureField", 6);
+	xml_params_add_int(&hudc, "separatorIndex", 2);
+	xml_params_add_int(&hudc, "units", 1);
+	compareCSVNative(SUBSURFACE_TEST_DATA "/dives/TestDiveSeabearHUDC.csv", hudc,
+			 "./testhudcnative.ssrf", "./testhudcxslt.ssrf");
+
+	// Quoted fields with decimal commas, a repeated line
+	xml_params quoted;
+	xml_params_add_int(&quoted, "timeField", 0);
+	xml_params_add_int(&quoted, "depthField", 1);
+	xml_params_add_int(&quoted, "tempField", 2);
+	xml_params_add_int(&quoted, "pressureField", 3);
+	xml_params_add_int(&quoted, "separatorIndex", 1);
+	xml_params_add_int(&quoted, "units", 0);
+	compareCSVNative(SUBSURFACE_TEST_DATA "/dives/TestCSVQuoted.csv", quoted,
+			 "./testquotednative.ssrf", "./testquotedxslt.ssrf");
+
+	// Imperial units, ';' separator, minutes:seconds and CRLF line endings
+	xml_params imperial;
+	xml_params_add_int(&imperial, "timeField", 0);
+	xml_params_add_int(&imperial, "depthField", 1);
+	xml_params_add_int(&imperial, "tempField", 2);
+	xml_params_add_int(&imperial, "pressureField", 3);
+	xml_params_add_int(&imperial, "ndlField", 4);
+	xml_params_add_int(&imperial, "ttsField", 5);
+	xml_params_add_int(&imperial, "stopdepthField", 6);
+	xml_params_add_int(&imperial, "cnsField", 7);
+	xml_params_add_int(&imperial, "separatorIndex", 2);
+	xml_params_add_int(&imperial, "units", 1);
+	compareCSVNative(SUBSURFACE_TEST_DATA "/dives/TestCSVImperial.csv", imperial,
+			 "./testimperialnative.ssrf", "./testimperialxslt.ssrf");
+
+	// A sample interval, '|' separator and no newline at the end of the file
+	xml_params delta;
+	xml_params_add_int(&delta, "timeField", 0);
+	xml_params_add_int(&delta, "depthField", 1);
+	xml_params_add_int(&delta, "tempField", 2);
+	xml_params_add_int(&delta, "separatorIndex", 3);
+	xml_params_add_int(&delta, "units", 0);
+	xml_params_add_int(&delta, "delta", 2);
+	compareCSVNative(SUBSURFACE_TEST_DATA "/dives/TestCSVDelta.csv", delta,
+			 "./testdeltanative.ssrf", "./testdeltaxslt.ssrf");
+}
+
 void TestParse::testParseNewFormat()
 {
 	QDir dir;
@@ -278,6 +381,20 @@ void TestParse::testParseMerge()
 		     SUBSURFACE_TEST_DATA "/dives/mergedVyperOstc.xml");
 }
 
+void TestParse::testParseTruncated()
+{
+	/*
+	 * check that a broken native file is not imported partially
+	 */
+	auto [mem, err] = readfile(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf");
+	QVERIFY(err > 0);
+	mem.resize(mem.size() / 2);
+	QVERIFY(parse_xml_buffer("truncated.ssrf", mem.c_str(), mem.size(), &divelog, NULL) < 0);
+	QCOMPARE(divelog.dives->nr, 0);
+	QCOMPARE(divelog.trips->nr, 0);
+	QCOMPARE(divelog.sites->nr, 0);
+}
+
 int TestParse::parseCSVmanual(int units, std::string file)
 {
 	verbose = 1;
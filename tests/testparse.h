@@ -21,9 +21,11 @@ private slots:
 	void testParseDM4();
 	void testParseDM5();
 	void testParseHUDC();
+	void testParseCSVNative();
 	void testParseNewFormat();
 	void testParseDLD();
 	void testParseMerge();
+	void testParseTruncated();
 
 	int parseCSVmanual(int, std::string);
 	void exportSubsurfaceCSV();
@@ -7,10 +7,13 @@
 #include "core/trip.h"
 #include "core/file.h"
 #include "core/git-access.h"
+#include "core/import-csv.h"
+#include "core/xmlparams.h"
 #include "core/settings/qPrefProxy.h"
 #include "core/settings/qPrefCloudStorage.h"
 #include <QFile>
 #include <QNetworkProxy>
+#include <QTemporaryDir>
 #include "QTextCodec"
 
 #define LARGE_TEST_REPO "https://github.com/Subsurface/large-anonymous-sample-data"
@@ -86,4 +89,37 @@ void TestParsePerformance::parseGit()
 	}
 }
 
+void TestParsePerformance::parseCsv()
+{
+	// A generated profile of about 100 MB, i.e. a few million samples
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+	QString filename = dir.filePath("large.csv");
+	QFile file(filename);
+	QVERIFY(file.open(QFile::WriteOnly));
+	QByteArray data = "time,depth,temp,pressure,ndl,cns\n";
+	for (int t = 2; data.size() < 100 * 1024 * 1024; t += 2) {
+		int depth = (t * 7919) % 60000;
+		data += QString::asprintf("%d,%d.%02d,%d.%d,%d.%d,%d,%d\n", t, depth / 1000, depth / 10 % 100,
+					  10 + t % 15, t % 10, 200 - t % 150, t % 10, 99 - t % 90, t % 80).toLatin1();
+	}
+	QCOMPARE(file.write(data), (qint64)data.size());
+	file.close();
+	data.clear();
+
+	QBENCHMARK {
+		xml_params params;
+		xml_params_add_int(&params, "timeField", 0);
+		xml_params_add_int(&params, "depthField", 1);
+		xml_params_add_int(&params, "tempField", 2);
+		xml_params_add_int(&params, "pressureField", 3);
+		xml_params_add_int(&params, "ndlField", 4);
+		xml_params_add_int(&params, "cnsField", 5);
+		xml_params_add_int(&params, "separatorIndex", 1);
+		xml_params_add_int(&params, "units", 0);
+		QCOMPARE(parse_csv_file(qPrintable(filename), &params, "csv", &divelog), 0);
+		cleanup();
+	}
+}
+
 QTEST_GUILESS_MAIN(TestParsePerformance)
@@ -13,6 +13,7 @@ private slots:
 
 	void parseSsrf();
 	void parseGit();
+	void parseCsv();
 };
 
 #endif
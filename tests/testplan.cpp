@@ -15,7 +15,6 @@
 static struct dive dive = { 0 };
 static struct decostop stoptable[60];
 static struct deco_state test_deco_state;
-extern bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int dcNr, int timestep, struct decostop *decostoptable, deco_state_cache &cache, bool is_planner, bool show_disclaimer);
 void setupPrefs()
 {
 	copy_prefs(&default_prefs, &prefs);
@@ -781,6 +780,18 @@ void TestPlan::testMultipleGases()
 	gas = get_gasmix_at_time(&dive, &dive.dc, {20 * 60 + 1});
 	QCOMPARE(get_o2(gas), 110);
 	QVERIFY(compareDecoTime(dive.dc.duration.seconds, 2480u, 2480u));
+
+	// The table of gas changes must agree with walking the events
+	struct gas_change_table gases;
+	init_gas_change_table(&gases, &dive, &dive.dc);
+	QVERIFY(gases.nr > 0);
+	for (int t = 0; t <= dive.dc.duration.seconds; t += 10) {
+		gasmix gas2 = gas_change_table_at(&gases, t);
+		gas = get_gasmix_at_time(&dive, &dive.dc, { t });
+		QCOMPARE(get_o2(gas2), get_o2(gas));
+		QCOMPARE(get_he(gas2), get_he(gas));
+	}
+	free_gas_change_table(&gases);
 }
 
 void TestPlan::testVpmbMetricMultiLevelAir()
@@ -1,11 +1,14 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "testprofile.h"
 #include "core/device.h"
+#include "core/divelist.h"
 #include "core/divelog.h"
 #include "core/divesite.h"
 #include "core/trip.h"
 #include "core/file.h"
 #include "core/save-profiledata.h"
+#include "core/profile.h"
+#include "core/sample.h"
 #include "core/pref.h"
 #include "QTextCodec"
 
@@ -65,4 +68,73 @@ void TestProfile::testProfileExportVPMB()
 
 }
 
+static bool same_plot_info(const struct plot_info &pi1, const struct plot_info &pi2)
+{
+	return pi1.nr == pi2.nr && pi1.nr_cylinders == pi2.nr_cylinders &&
+	       pi1.maxtime == pi2.maxtime && pi1.maxdepth == pi2.maxdepth &&
+	       !memcmp(pi1.entry, pi2.entry, pi1.nr * sizeof(struct plot_data)) &&
+	       !memcmp(pi1.pressures, pi2.pressures, pi1.nr * pi1.nr_cylinders * sizeof(struct plot_pressure_data));
+}
+
+// The cached plot info must always be the same as a freshly calculated one.
+void TestProfile::testPlotInfoCache()
+{
+	parse_file(SUBSURFACE_TEST_DATA "/dives/abitofeverything.ssrf", &divelog);
+	sort_dive_table(divelog.dives);
+	struct dive *d = nullptr;
+	int i;
+	for (i = 0; i < divelog.dives->nr; i++) {
+		if (divelog.dives->dives[i]->dc.samples > 10) {
+			d = divelog.dives->dives[i];
+			break;
+		}
+	}
+	QVERIFY(d != nullptr);
+
+	struct plot_info cached, fresh;
+	init_plot_info(&cached);
+	init_plot_info(&fresh);
+	create_plot_info_new(d, &d->dc, &fresh, nullptr);
+
+	// First call calculates, second call uses the cache
+	create_plot_info_cached(d, &d->dc, &cached);
+	QVERIFY(same_plot_info(cached, fresh));
+	create_plot_info_cached(d, &d->dc, &cached);
+	QVERIFY(same_plot_info(cached, fresh));
+
+	// Changed settings
+	int gflow = prefs.gflow, gfhigh = prefs.gfhigh;
+	prefs.gflow = 20;
+	prefs.gfhigh = 60;
+	create_plot_info_cached(d, &d->dc, &cached);
+	create_plot_info_new(d, &d->dc, &fresh, nullptr);
+	QVERIFY(same_plot_info(cached, fresh));
+
+	// Changed ascent rate, which is used for TTS and NDL
+	bool calcndltts = prefs.calcndltts;
+	int ascrate75 = prefs.ascrate75;
+	prefs.calcndltts = true;
+	create_plot_info_cached(d, &d->dc, &cached);
+	prefs.ascrate75 /= 2;
+	create_plot_info_cached(d, &d->dc, &cached);
+	create_plot_info_new(d, &d->dc, &fresh, nullptr);
+	QVERIFY(same_plot_info(cached, fresh));
+
+	// Changed dive
+	d->dc.sample[d->dc.samples / 2].depth.mm += 1000;
+	invalidate_dive_cache(d);
+	create_plot_info_cached(d, &d->dc, &cached);
+	create_plot_info_new(d, &d->dc, &fresh, nullptr);
+	QVERIFY(same_plot_info(cached, fresh));
+
+	free_plot_info_data(&cached);
+	free_plot_info_data(&fresh);
+	plot_info_cache_clear();
+	prefs.gflow = gflow;
+	prefs.gfhigh = gfhigh;
+	prefs.calcndltts = calcndltts;
+	prefs.ascrate75 = ascrate75;
+	clear_dive_file_data();
+}
+
 QTEST_GUILESS_MAIN(TestProfile)
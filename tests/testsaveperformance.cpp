@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testsaveperformance.h"
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/divelog.h"
+#include "core/errorhelper.h"
+#include "core/file.h"
+#include "core/membuffer.h"
+#include "core/pref.h"
+#include "core/sample.h"
+#include "git2.h"
+#include <QDir>
+#include <QFile>
+#include <cstdlib>
+#include <string>
+
+#define LARGE_TEST_FILE SUBSURFACE_TEST_DATA "/dives/large-anon.ssrf"
+#define SMALL_TEST_FILE SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf"
+
+static std::string take(struct membuffer &b)
+{
+	std::string res(b.buffer, b.len);
+	b.len = 0;
+	return res;
+}
+
+// How put_milli() used to format values
+static void put_milli_printf(struct membuffer *b, const char *pre, int value, const char *post)
+{
+	int i;
+	char buf[4];
+	const char *sign = "";
+	unsigned v;
+
+	v = value;
+	if (value < 0) {
+		sign = "-";
+		v = 0u - v;
+	}
+	for (i = 2; i >= 0; i--) {
+		buf[i] = (v % 10) + '0';
+		v /= 10;
+	}
+	buf[3] = 0;
+	if (buf[2] == '0') {
+		buf[2] = 0;
+		if (buf[1] == '0')
+			buf[1] = 0;
+	}
+
+	put_format(b, "%s%s%u.%s%s", pre, sign, v, buf, post);
+}
+
+// The fields that are written for every sample, formatted with printf
+static void format_sample_printf(struct membuffer *b, const struct sample *s)
+{
+	put_format(b, "%3u:%02u", FRACTION_TUPLE(s->time.seconds, 60));
+	put_milli_printf(b, " ", s->depth.mm, "m");
+	if (s->temperature.mkelvin)
+		put_milli_printf(b, " ", s->temperature.mkelvin - ZERO_C_IN_MKELVIN, "°C");
+	if (s->pressure[0].mbar) {
+		put_milli_printf(b, " ", s->pressure[0].mbar, "bar");
+		put_format(b, ":%d", s->sensor[0]);
+	}
+	put_format(b, " ndl=%u:%02u", FRACTION_TUPLE(s->ndl.seconds, 60));
+	put_format(b, " cns=%u%%\n", s->cns);
+}
+
+// The same with the membuffer helpers that the savers use
+static void format_sample(struct membuffer *b, const struct sample *s)
+{
+	put_mmss(b, "", s->time.seconds, 3, "");
+	put_milli(b, " ", s->depth.mm, "m");
+	put_temperature(b, s->temperature, " ", "°C");
+	if (s->pressure[0].mbar) {
+		put_pressure(b, s->pressure[0], " ", "bar");
+		put_int(b, ":", s->sensor[0], "");
+	}
+	put_mmss(b, " ndl=", s->ndl.seconds, 0, "");
+	put_uint(b, " cns=", s->cns, "%\n");
+}
+
+template <typename F>
+static void format_all_samples(F f)
+{
+	struct membufferpp b;
+	int i;
+	struct dive *d;
+	for_each_dive (i, d) {
+		for (const struct divecomputer *dc = &d->dc; dc; dc = dc->next) {
+			for (int j = 0; j < dc->samples; j++)
+				f(&b, &dc->sample[j]);
+			b.len = 0;
+		}
+	}
+}
+
+void TestSavePerformance::initTestCase()
+{
+	/* we need to manually tell that the resource exists, because we are using it as library. */
+	Q_INIT_RESOURCE(subsurface);
+	copy_prefs(&default_prefs, &prefs);
+	git_libgit2_init();
+
+	// Use the large anonymized log if available, see TestParsePerformance
+	const char *file = QFile::exists(LARGE_TEST_FILE) ? LARGE_TEST_FILE : SMALL_TEST_FILE;
+	report_info("benchmarking with %s", file);
+	QCOMPARE(parse_file(file, &divelog), 0);
+	process_loaded_dives();
+}
+
+void TestSavePerformance::cleanupTestCase()
+{
+	clear_dive_file_data();
+	QFile::remove("./savebenchmark.ssrf");
+	QDir("./savebenchmark").removeRecursively();
+}
+
+void TestSavePerformance::compareFormats()
+{
+	struct membufferpp a, b;
+	for (int v = -100000; v <= 100000; v += 7) {
+		put_milli(&a, "<", v, ">");
+		put_milli_printf(&b, "<", v, ">");
+		QCOMPARE(take(a), take(b));
+		put_int(&a, "<", v, ">");
+		put_format(&b, "<%d>", v);
+		QCOMPARE(take(a), take(b));
+		put_uint(&a, "<", (unsigned)v, ">");
+		put_format(&b, "<%u>", (unsigned)v);
+		QCOMPARE(take(a), take(b));
+		put_mmss(&a, "<", v, 3, ">");
+		put_format(&b, "<%3u:%02u>", FRACTION_TUPLE(v, 60));
+		QCOMPARE(take(a), take(b));
+		put_degrees(&a, degrees_t { v * 997 }, "<", ">");
+		put_format(&b, "<%s%u.%06u>", v < 0 ? "-" : "", FRACTION_TUPLE(abs(v * 997), 1000000));
+		QCOMPARE(take(a), take(b));
+	}
+	format_all_samples([&a, &b](struct membuffer *, const struct sample *s) {
+		format_sample(&a, s);
+		format_sample_printf(&b, s);
+		QCOMPARE(take(a), take(b));
+	});
+}
+
+void TestSavePerformance::formatSamplesPrintf()
+{
+	QBENCHMARK {
+		format_all_samples(format_sample_printf);
+	}
+}
+
+void TestSavePerformance::formatSamples()
+{
+	QBENCHMARK {
+		format_all_samples(format_sample);
+	}
+}
+
+void TestSavePerformance::saveXml()
+{
+	QBENCHMARK {
+		QCOMPARE(save_dives("./savebenchmark.ssrf"), 0);
+	}
+}
+
+void TestSavePerformance::saveGit()
+{
+	QBENCHMARK {
+		// Only changed dives are written to the repository. Save all of them.
+		int i;
+		struct dive *d;
+		for_each_dive (i, d)
+			invalidate_dive_cache(d);
+		QCOMPARE(save_dives("./savebenchmark[test]"), 0);
+	}
+}
+
+QTEST_GUILESS_MAIN(TestSavePerformance)
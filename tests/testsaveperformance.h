@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTSAVEPERFORMANCE_H
+#define TESTSAVEPERFORMANCE_H
+
+#include <QtTest>
+
+class TestSavePerformance : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void compareFormats();
+	void formatSamplesPrintf();
+	void formatSamples();
+	void saveXml();
+	void saveGit();
+};
+
+#endif
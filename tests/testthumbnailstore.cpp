@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testthumbnailstore.h"
+#include "core/thumbnailstore.h"
+
+#include <QFile>
+#include <QFileInfo>
+
+static const char *store_name = "./thumbnailstoretest";
+
+static QByteArray get_data(ThumbnailStore &store, const QString &key)
+{
+	std::optional<ThumbnailStore::Entry> entry = store.get(key);
+	return entry ? QByteArray(entry->data.constData(), entry->data.size()) : QByteArray("missing");
+}
+
+void TestThumbnailStore::init()
+{
+	QFile::remove(store_name);
+}
+
+void TestThumbnailStore::cleanup()
+{
+	QFile::remove(store_name);
+}
+
+void TestThumbnailStore::testPutGet()
+{
+	ThumbnailStore store(store_name);
+	QCOMPARE(store.size(), 0);
+	QVERIFY(store.put("/pictures/a.jpg", "first", 1000));
+	QVERIFY(store.put("/pictures/b.jpg", "second", 2000));
+	QVERIFY(store.put(QString::fromUtf8("/pictures/é.jpg"), QByteArray(), 3000));
+	QCOMPARE(store.size(), 3);
+	QCOMPARE(get_data(store, "/pictures/a.jpg"), QByteArray("first"));
+	QCOMPARE(get_data(store, "/pictures/b.jpg"), QByteArray("second"));
+	QCOMPARE(get_data(store, QString::fromUtf8("/pictures/é.jpg")), QByteArray());
+	QCOMPARE(store.get("/pictures/b.jpg")->created, (qint64)2000);
+
+	std::vector<std::optional<ThumbnailStore::Entry>> entries =
+		store.get(QVector<QString> { "/pictures/b.jpg", "/pictures/c.jpg", "/pictures/a.jpg" });
+	QCOMPARE(entries.size(), (size_t)3);
+	QVERIFY(entries[0] && entries[0]->data == "second");
+	QVERIFY(!entries[1]);
+	QVERIFY(entries[2] && entries[2]->data == "first");
+}
+
+void TestThumbnailStore::testReopen()
+{
+	{
+		ThumbnailStore store(store_name);
+		QVERIFY(store.put("/pictures/a.jpg", "first", 1000));
+		QVERIFY(store.put("/pictures/b.jpg", "second", 2000));
+		QVERIFY(store.put("/pictures/c.jpg", "third", 3000));
+		QVERIFY(store.put("/pictures/a.jpg", "replaced", 4000));
+		// The old data stays valid until the store is destroyed
+		QCOMPARE(get_data(store, "/pictures/a.jpg"), QByteArray("replaced"));
+	}
+	ThumbnailStore store(store_name);
+	QCOMPARE(store.size(), 3);
+	QCOMPARE(get_data(store, "/pictures/a.jpg"), QByteArray("replaced"));
+	QCOMPARE(store.get("/pictures/a.jpg")->created, (qint64)4000);
+	QCOMPARE(get_data(store, "/pictures/c.jpg"), QByteArray("third"));
+}
+
+void TestThumbnailStore::testTruncated()
+{
+	{
+		ThumbnailStore store(store_name);
+		QVERIFY(store.put("/pictures/a.jpg", "first", 1000));
+		QVERIFY(store.put("/pictures/b.jpg", "second", 2000));
+	}
+	// Cut the last record in half, as if we crashed while writing it
+	QFile file(store_name);
+	qint64 size = file.size();
+	QVERIFY(file.resize(size - 4));
+	{
+		ThumbnailStore store(store_name);
+		QCOMPARE(store.size(), 1);
+		QCOMPARE(get_data(store, "/pictures/a.jpg"), QByteArray("first"));
+		QVERIFY(store.put("/pictures/b.jpg", "again", 3000));
+	}
+	ThumbnailStore store(store_name);
+	QCOMPARE(store.size(), 2);
+	QCOMPARE(get_data(store, "/pictures/b.jpg"), QByteArray("again"));
+
+	// A file that is not a thumbnail store is replaced
+	QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+	file.write("this is not a thumbnail store");
+	file.close();
+	ThumbnailStore store2(store_name);
+	QCOMPARE(store2.size(), 0);
+	QVERIFY(store2.put("/pictures/a.jpg", "first", 1000));
+	QCOMPARE(get_data(store2, "/pictures/a.jpg"), QByteArray("first"));
+}
+
+void TestThumbnailStore::testCompaction()
+{
+	QByteArray data(1000, 'x');
+	{
+		ThumbnailStore store(store_name);
+		QVERIFY(store.put("/pictures/b.jpg", "second", 1000));
+		for (int i = 0; i < 10; ++i)
+			QVERIFY(store.put("/pictures/a.jpg", data, i));
+	}
+	qint64 size = QFileInfo(store_name).size();
+	QVERIFY(size > 10000);
+	{
+		ThumbnailStore store(store_name);
+		QCOMPARE(store.size(), 2);
+		QCOMPARE(get_data(store, "/pictures/a.jpg"), data);
+		QCOMPARE(store.get("/pictures/a.jpg")->created, (qint64)9);
+		QCOMPARE(get_data(store, "/pictures/b.jpg"), QByteArray("second"));
+	}
+	QVERIFY(QFileInfo(store_name).size() < 2000);
+}
+
+QTEST_GUILESS_MAIN(TestThumbnailStore)
@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTTHUMBNAILSTORE_H
+#define TESTTHUMBNAILSTORE_H
+
+#include <QtTest>
+
+class TestThumbnailStore : public QObject {
+	Q_OBJECT
+private slots:
+	void init();
+	void cleanup();
+
+	void testPutGet();
+	void testReopen();
+	void testTruncated();
+	void testCompaction();
+};
+
+#endif